@@ -0,0 +1,122 @@
+/*
+ * This file is part of mod-host.
+ *
+ * mod-host is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mod-host is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mod-host.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+************************************************************************************************************************
+*
+* Binary feedback format, used by a feedback port connection after it sends "binary_feedback 1".
+*
+* Only that connection switches: a last text message "binary_feedback 1" is sent to it, and everything after it is a
+* stream of records in host byte order. Each record is a fixed-size binary_feedback_record_t, followed by "size" bytes
+* of payload. Sending "binary_feedback 0" ends the stream with a BINARY_FEEDBACK_END record, text follows.
+*
+* Symbols and URIs are sent as ids, each id is defined by a BINARY_FEEDBACK_SYMBOL record before its first use on
+* each connection. Ids are only valid until the stream ends, and a later definition of the same id replaces the
+* earlier one.
+*
+************************************************************************************************************************
+*/
+
+#ifndef BINARY_FEEDBACK_H
+#define BINARY_FEEDBACK_H
+
+/*
+************************************************************************************************************************
+*           INCLUDE FILES
+************************************************************************************************************************
+*/
+
+#include <stdint.h>
+
+
+/*
+************************************************************************************************************************
+*           DO NOT CHANGE THESE DEFINES
+************************************************************************************************************************
+*/
+
+#define BINARY_FEEDBACK_VERSION 1
+
+
+/*
+************************************************************************************************************************
+*           DATA TYPES
+************************************************************************************************************************
+*/
+
+typedef enum {
+    BINARY_FEEDBACK_END = 0,         // end of the binary stream, text follows
+    BINARY_FEEDBACK_SYMBOL,          // defines id "symbol", payload is the symbol or URI string, without terminator
+    BINARY_FEEDBACK_TEXT,            // any other feedback message, payload is its text, without terminator
+    BINARY_FEEDBACK_DATA_FINISH,     // same as the "data_finish" text message
+    BINARY_FEEDBACK_PARAM_SET,       // "instance", "symbol" and float "value"
+    BINARY_FEEDBACK_OUTPUT_SET,      // "instance", "symbol" and float "value"
+    BINARY_FEEDBACK_AUDIO_MONITOR,   // "instance" is the monitor index, float "value"
+    BINARY_FEEDBACK_PATCH_SET,       // "instance", "symbol" is the property URI, value as per "value_type"
+} BinaryFeedbackType;
+
+typedef enum {
+    BINARY_FEEDBACK_VALUE_NONE = 0,
+    BINARY_FEEDBACK_VALUE_BOOL,      // value.i, 0 or 1
+    BINARY_FEEDBACK_VALUE_INT,       // value.i
+    BINARY_FEEDBACK_VALUE_LONG,      // value.l
+    BINARY_FEEDBACK_VALUE_FLOAT,     // value.f
+    BINARY_FEEDBACK_VALUE_DOUBLE,    // value.d
+    BINARY_FEEDBACK_VALUE_STRING,    // payload is the raw atom body, including its terminator
+    BINARY_FEEDBACK_VALUE_PATH,      // payload is the raw atom body, including its terminator
+    BINARY_FEEDBACK_VALUE_URI,       // payload is the raw atom body, including its terminator
+    BINARY_FEEDBACK_VALUE_VECTOR,    // payload is the raw vector elements of "child_type", value.i is the element count
+} BinaryFeedbackValueType;
+
+typedef struct BINARY_FEEDBACK_RECORD_T {
+    uint8_t type;        // BinaryFeedbackType
+    uint8_t value_type;  // BinaryFeedbackValueType
+    uint8_t child_type;  // BinaryFeedbackValueType of vector elements
+    uint8_t reserved;
+    int32_t instance;
+    uint32_t symbol;
+    uint32_t size;       // payload bytes following this record
+    union {
+        int32_t i;
+        int64_t l;
+        float f;
+        double d;
+    } value;
+} binary_feedback_record_t;
+
+
+/*
+************************************************************************************************************************
+*           CONFIGURATION ERRORS
+************************************************************************************************************************
+*/
+
+#ifdef __cplusplus
+static_assert(sizeof(binary_feedback_record_t) == 24, "binary feedback records must be 24 bytes");
+#else
+_Static_assert(sizeof(binary_feedback_record_t) == 24, "binary feedback records must be 24 bytes");
+#endif
+
+
+/*
+************************************************************************************************************************
+*           END HEADER
+************************************************************************************************************************
+*/
+
+#endif
@@ -34,6 +34,8 @@
 #include <limits.h>
 #include <math.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #include <sys/stat.h>
 
 #ifdef _WIN32
@@ -53,6 +55,7 @@ typedef unsigned int uint;
 #define unsetenv(...)
 #else
 #include <dlfcn.h>
+#include <sys/mman.h>
 #endif
 
 #if defined(_MOD_DEVICE_RK358x)
@@ -102,6 +105,11 @@ typedef unsigned int uint;
 #define WITH_EXTERNAL_UI_SUPPORT
 #endif
 
+// shared memory feedback needs process-shared semaphores and locked mappings
+#ifdef __linux__
+#define WITH_FEEDBACK_SHM
+#endif
+
 #ifdef WITH_EXTERNAL_UI_SUPPORT
 #include <lv2/data-access/data-access.h>
 #include <lv2/instance-access/instance-access.h>
@@ -170,10 +178,12 @@ typedef struct {
 #include "effects.h"
 #include "monitor.h"
 #include "socket.h"
+#include "protocol.h"
 #include "uridmap.h"
 #include "lv2_evbuf.h"
 #include "worker.h"
 #include "state-paths.h"
+#include "plugin-cache.h"
 #include "symap.h"
 #include "monitor/monitor-client.h"
 #include "sha1/sha1.h"
@@ -181,6 +191,11 @@ typedef struct {
 #include "rtmempool/rtmempool.h"
 #include "filter.h"
 #include "mod-memset.h"
+#include "binary-feedback.h"
+
+#ifdef WITH_FEEDBACK_SHM
+#include "feedback-shm.h"
+#endif
 
 #ifdef MOD_HMI_CONTROL_ENABLED
 #include "sys_host.h"
@@ -197,6 +212,9 @@ typedef struct {
 */
 
 #define REMOVE_ALL        (-1)
+
+// clients that can have a transaction open at the same time
+#define MAX_TRANSACTIONS  32
 #define GLOBAL_EFFECT_ID  (9995)
 
 #define ASSIGNMENT_UNUSED -1 // item was used before, so there might other valid items after this one
@@ -214,6 +232,29 @@ typedef struct {
 // transport defaults
 #define TRANSPORT_TICKS_PER_BEAT 1920.0
 
+// maximum number of helper threads for the in-process graph engine
+#define MAX_GRAPH_WORKERS 7
+
+// maximum number of threads instantiating plugins for multi_add
+#define MAX_ADD_THREADS 8
+
+// alignment of each audio/cv port buffer, a cache line on all supported CPUs
+#define PORT_BUFFER_ALIGNMENT 64
+
+// peak level under which a bypassed plugin output is considered silent (-90 dBFS)
+#define BYPASS_TAIL_THRESHOLD 3.1623e-5f
+
+// peak level under which a plugin input is considered silent (-120 dBFS)
+#define SILENCE_THRESHOLD 1e-6f
+
+// weight of the latest cycle in the plugin dsp load average
+#define PLUGIN_LOAD_EWMA_ALPHA 0.05f
+
+// plugin log messages, formatted by the caller into a fixed slot and written out by the feedback thread
+#define LOG_RING_SIZE     128 // must be a power of 2
+#define LOG_MESSAGE_SIZE  256
+#define LOG_RATE_LIMIT    20  // per plugin and second, the rest is only counted
+
 
 /*
 ************************************************************************************************************************
@@ -264,6 +305,7 @@ enum PluginHints {
     HINT_STATE_UNSAFE    = 1 << 5, // state restore needs mutex protection
     HINT_IS_LIVE         = 1 << 6, // needs to be always running, cannot have processing disabled
     HINT_NO_PRE_RUN      = 1 << 7, // do not keep plugin active for pre-run
+    HINT_IN_PLACE_BROKEN = 1 << 8, // audio/cv ports cannot be connected directly to jack buffers
 };
 
 enum TransportSyncMode {
@@ -298,20 +340,28 @@ enum {
 };
 
 enum PostPonedEventType {
-    POSTPONED_PARAM_SET,
     POSTPONED_PARAM_STATE,
     POSTPONED_AUDIO_MONITOR,
-    POSTPONED_OUTPUT_MONITOR,
     POSTPONED_MIDI_CONTROL_CHANGE,
     POSTPONED_MIDI_PROGRAM_CHANGE,
     POSTPONED_MIDI_MAP,
     POSTPONED_TRANSPORT,
     POSTPONED_JACK_MIDI_CONNECT,
-    POSTPONED_LOG_TRACE, // stack allocated, rt-safe
-    POSTPONED_LOG_MESSAGE, // heap allocated
     POSTPONED_PROCESS_OUTPUT_BUFFER
 };
 
+enum FeedbackMode {
+    FEEDBACK_MODE_SOCKET, // each feedback port client gets the format it asked for
+    FEEDBACK_MODE_SHM     // binary-feedback.h records on the feedback-shm.h channel
+};
+
+// param_set and output_set feedback goes through the per-effect slot table instead of the rt queue
+enum FeedbackSlotKind {
+    FEEDBACK_SLOT_PARAM_SET,
+    FEEDBACK_SLOT_OUTPUT_SET,
+    FEEDBACK_SLOT_KINDS
+};
+
 enum UpdatePositionFlag {
     UPDATE_POSITION_SKIP,
     UPDATE_POSITION_IF_CHANGED,
@@ -368,6 +418,10 @@ typedef struct PORT_T {
 #ifdef MOD_HMI_CONTROL_ENABLED
     hmi_addressing_t* hmi_addressing;
 #endif
+    // audio/cv buffers for in-process effects, used in place of the jack port buffers
+    float *graph_buffer; // host-owned storage
+    float *graph_data;   // data for the current cycle, may point to another port's graph_buffer
+    float *bound_buffer; // connected to the plugin in place of buffer (zero-copy), NULL if not
 } port_t;
 
 typedef struct PROPERTY_T {
@@ -392,6 +446,61 @@ typedef struct MONITOR_T {
     float last_notified_value;
 } monitor_t;
 
+typedef struct PORT_INDEX_ENTRY_T {
+    uint32_t hash;
+    port_t *port; // NULL if unused
+} port_index_entry_t;
+
+// what effects_add learns about a port from lilv, see plugin_descriptor_t
+typedef struct PORT_DESCRIPTOR_T {
+    const char* symbol;
+    enum PortType type;
+    enum PortFlow flow;
+    enum PortHints hints;
+    float min_value;
+    float max_value;
+    float def_value;
+    uint32_t minimum_size; // event buffer size requested by the plugin, 0 if none
+    bool raw_midi_clock;
+    LilvScalePoints* scale_points;
+} port_descriptor_t;
+
+// immutable plugin information built on the first effects_add of an URI and shared by all its instances
+typedef struct PLUGIN_DESCRIPTOR_T {
+    char *uri;
+    const LilvPlugin *lilv_plugin;
+    int refcount; // one for the descriptors list plus one per instance
+
+    enum PluginHints hints;
+    bool has_worker_interface;
+    bool has_options_interface;
+    bool has_license_interface;
+    bool has_hmi_interface;
+    bool load_default_state;
+    uint32_t worker_buf_size;
+
+    port_descriptor_t *ports;
+    uint32_t ports_count;
+
+    // indexes of specially designated ports (-1 if unavailable)
+    int32_t control_index;
+    int32_t enabled_index;
+    int32_t freewheel_index;
+    int32_t reset_index;
+    int32_t bpb_index;
+    int32_t bpm_index;
+    int32_t speed_index;
+
+    // instances copy these, uri and type nodes stay owned by the descriptor
+    property_t *properties;
+    uint32_t properties_count;
+
+    preset_t **presets;
+    uint32_t presets_count;
+
+    struct PLUGIN_DESCRIPTOR_T *next;
+} plugin_descriptor_t;
+
 typedef struct EFFECT_T {
     int instance;
     jack_client_t *jack_client;
@@ -399,6 +508,10 @@ typedef struct EFFECT_T {
     const LilvPlugin *lilv_plugin;
     const LV2_Feature **features;
 
+    // shared plugin information, and the allocation holding ports, port lists and properties built from it
+    plugin_descriptor_t *descriptor;
+    void *instance_arena;
+
     port_t **ports;
     uint32_t ports_count;
 
@@ -463,6 +576,16 @@ typedef struct EFFECT_T {
     bool jack_activated;
     bool lv2_activated;
 
+    // processed by the in-process graph engine, shares the global client
+    bool in_graph;
+
+    // audio/cv bytes that did not need copying during the last cycle
+    uint32_t zero_copy_bytes;
+    // audio/cv port buffers are carved from this, sized to the current block length
+    void *ports_arena;
+    size_t ports_arena_size;
+    uint32_t ports_arena_frames;
+
     // previous transport state
     bool transport_rolling;
     uint32_t transport_frame;
@@ -473,10 +596,43 @@ typedef struct EFFECT_T {
     port_t bypass_port;
     float bypass;
     bool was_bypassed;
+    // what to do with the plugin while bypassed, and if its tail has faded out
+    BypassPolicy bypass_policy;
+    bool bypass_tail_done;
+
+    // sleep on silent inputs, tail is negative when disabled
+    int32_t sleep_tail_frames;
+    uint32_t silent_frames;
+    bool sleeping;
+    uint32_t sleep_cycles, sleep_total_cycles, sleep_wakeups; // atomic
+
+    // dsp time as percentage of the cycle period, only written by the audio thread
+    volatile float load_average, load_maximum;
+    volatile uint32_t load_histogram[PLUGIN_LOAD_HISTOGRAM_SIZE];
+    volatile bool load_reset;
 
     // cached plugin information, avoids iterating controls each cycle
     enum PluginHints hints;
 
+    // param handles point to this effect's ports and need invalidating on remove
+    bool has_param_handles;
+
+    // set while effects_add is still building the instance, other threads treat it as non-existent
+    bool adding;
+
+    // latest param_set/output_set values not yet reported, one slot per port plus bypass and presets
+    float *feedback_values;   // [FEEDBACK_SLOT_KINDS][feedback_slots_count]
+    uint32_t *feedback_dirty; // [FEEDBACK_SLOT_KINDS][FEEDBACK_DIRTY_WORDS(feedback_slots_count)]
+    uint32_t feedback_slots_count;
+
+    // control ports plus bypass and presets, open-addressed by symbol hash
+    port_index_entry_t *port_index;
+    uint32_t port_index_mask;
+
+    // plugin log messages allowed until the next refill, and how many were dropped since the last report
+    int32_t log_budget;
+    uint32_t log_suppressed;
+
     // virtual presets port
     port_t presets_port;
     float preset_value;
@@ -508,6 +664,7 @@ typedef struct LILV_NODES_T {
     LilvNode *event;
     LilvNode *freeWheeling;
     LilvNode *hmi_interface;
+    LilvNode *inPlaceBroken;
     LilvNode *input;
     LilvNode *integer;
     LilvNode *is_live;
@@ -621,13 +778,26 @@ typedef struct HMI_ADDRESSING_T {
 typedef struct SYNC_SCHEDULED_PARAM_T {
     port_t *port;
     float value;
+    int effect_id;
 } sync_scheduled_param_t;
 
-typedef struct POSTPONED_PARAMETER_EVENT_T {
-    int effect_id;
-    const char* symbol;
-    float value;
-} postponed_parameter_event_t;
+typedef struct SYNC_SCHEDULED_BATCH_T {
+    sync_scheduled_param_t *params;
+    uint32_t count;
+    uint32_t size;
+} sync_scheduled_batch_t;
+
+// values held back by one client between txn_begin and txn_commit
+typedef struct SYNC_SCHEDULED_TXN_T {
+    int client; // protocol sender, -1 if unused
+    sync_scheduled_batch_t batch;
+} sync_scheduled_txn_t;
+
+enum SyncScheduledState {
+    SYNC_SCHEDULED_IDLE,
+    SYNC_SCHEDULED_PENDING,  // published, not yet picked up by the audio thread
+    SYNC_SCHEDULED_APPLYING
+};
 
 typedef struct POSTPONED_PARAMETER_STATE_T {
     int effect_id;
@@ -671,15 +841,6 @@ typedef struct POSTPONED_JACK_MIDI_CONNECT_EVENT_T {
     jack_port_id_t port;
 } postponed_jack_midi_connect_event_t;
 
-typedef struct POSTPONED_LOG_TRACE_EVENT_T {
-    char msg[32];
-} postponed_log_trace_event_t;
-
-typedef struct POSTPONED_LOG_MESSAGE_EVENT_T {
-    LogType type;
-    char *msg; // NOTE: heap allocated, needs to be freed on reader side
-} postponed_log_message_event_t;
-
 typedef struct POSTPONED_PROCESS_OUTPUT_BUFFER_EVENT_T {
     int effect_id;
 } postponed_process_output_buffer_event_t;
@@ -687,7 +848,6 @@ typedef struct POSTPONED_PROCESS_OUTPUT_BUFFER_EVENT_T {
 typedef struct POSTPONED_EVENT_T {
     enum PostPonedEventType type;
     union {
-        postponed_parameter_event_t parameter;
         postponed_parameter_state_t state;
         postponed_audio_monitor_event_t audio_monitor;
         postponed_midi_control_change_event_t control_change;
@@ -695,17 +855,29 @@ typedef struct POSTPONED_EVENT_T {
         postponed_midi_map_event_t midi_map;
         postponed_transport_event_t transport;
         postponed_jack_midi_connect_event_t jack_midi_connect;
-        postponed_log_trace_event_t log_trace;
-        postponed_log_message_event_t log_message;
         postponed_process_output_buffer_event_t process_out_buf;
     };
 } postponed_event_t;
 
+typedef struct LOG_RING_SLOT_T {
+    uint32_t sequence;
+    LogType type;
+    char msg[LOG_MESSAGE_SIZE];
+} log_ring_slot_t;
+
 typedef struct POSTPONED_EVENT_LIST_DATA {
     postponed_event_t event;
     struct list_head siblings;
+    struct POSTPONED_EVENT_LIST_DATA *next; // rtsafe queue link
 } postponed_event_list_data;
 
+// intrusive multi-producer single-consumer queue, producers never block
+typedef struct RTSAFE_QUEUE_T {
+    postponed_event_list_data *head; // last pushed, exchanged by producers
+    postponed_event_list_data *tail; // next to pop, only used by the consumer
+    postponed_event_list_data stub;
+} rtsafe_queue_t;
+
 typedef struct POSTPONED_CACHED_EFFECT_LIST_DATA {
     int effect_id;
     struct list_head siblings;
@@ -728,17 +900,87 @@ typedef struct POSTPONED_CACHED_SYMBOL_EVENTS {
     postponed_cached_symbol_list_data symbols;
 } postponed_cached_symbol_events;
 
+typedef struct BINARY_FEEDBACK_SYMBOL_T {
+    char *symbol;
+    uint32_t hash;
+    uint32_t id;
+} binary_feedback_symbol_t;
+
 typedef struct RAW_MIDI_PORT_ITEM {
     int instance;
     jack_port_t* jack_port;
     struct list_head siblings;
 } raw_midi_port_item;
 
-typedef struct CACHED_EFFECT_FLUSH_T {
+typedef struct GRAPH_EDGE_T {
+    int source_id;
+    int target_id;
+    port_t *source;
+    port_t *target;
+} graph_edge_t;
+
+typedef struct GRAPH_INPUT_T {
+    port_t *port;
+    jack_port_t *jack_port; // connection from outside the graph, may be NULL
+    port_t **sources;
+    uint32_t sources_count;
+} graph_input_t;
+
+typedef struct GRAPH_OUTPUT_T {
+    port_t *port;
+    jack_port_t *jack_port; // connection to outside the graph, may be NULL
+} graph_output_t;
+
+typedef struct GRAPH_NODE_T {
     effect_t *effect;
-    port_t **ports;
-    int num_ports;
-} cached_effect_flush_t;
+    graph_input_t *inputs;
+    uint32_t inputs_count;
+    graph_output_t *outputs;
+    uint32_t outputs_count;
+    uint32_t *successors; // plan indexes of nodes depending on this one
+    uint32_t successors_count;
+    int32_t deps_count;
+    int32_t pending; // deps not yet processed in the current cycle, atomic
+} graph_node_t;
+
+// Chase-Lev work-stealing deque, sized so it never wraps within a cycle
+typedef struct GRAPH_DEQUE_T {
+    int32_t top;    // stolen from by other threads, atomic
+    int32_t bottom; // pushed and popped by the owner, atomic
+    uint32_t *items;
+} graph_deque_t;
+
+typedef struct GRAPH_PLAN_T {
+    graph_node_t *nodes; // topologically sorted
+    uint32_t nodes_count;
+    bool parallel; // false if there are feedback loops
+    graph_deque_t *deques; // one per running thread, the audio thread being the first
+    uint32_t deques_count; // limited to the plan width, workers past it stay parked
+    int32_t remaining; // nodes not yet processed in the current cycle, atomic
+} graph_plan_t;
+
+typedef struct GRAPH_WORKER_T {
+    pthread_t thread;
+    sem_t sem;
+    uint32_t index;
+    uint64_t busy_ns;
+} graph_worker_t;
+
+typedef struct PARAM_HANDLE_T {
+    int effect_id; // -1 if unused
+    uint32_t generation;
+    port_t *port;
+} param_handle_t;
+
+// shared by the threads of effects_add_multi, each takes the next instance until none are left
+typedef struct MULTI_ADD_JOB_T {
+    const char *const *uris;
+    const int *effects;
+    int *results;
+    int num_effects;
+    int activate;
+    int next; // atomic
+} multi_add_job_t;
 
 
 /*
@@ -753,6 +995,14 @@ typedef struct CACHED_EFFECT_FLUSH_T {
 /* used to indicate if a parameter change was initiated from us */
 #define MAGIC_PARAMETER_SEQ_NUMBER -1337
 
+/* param handles keep the table index in the low bits and the slot generation above it */
+#define PARAM_HANDLE_INDEX_BITS     16
+#define PARAM_HANDLE_INDEX_MASK     ((1 << PARAM_HANDLE_INDEX_BITS) - 1)
+#define PARAM_HANDLE_GENERATION_MAX ((uint32_t)(INT_MAX >> PARAM_HANDLE_INDEX_BITS))
+
+/* number of 32-bit words in a feedback dirty bitmap */
+#define FEEDBACK_DIRTY_WORDS(count) (((count) + 31) / 32)
+
 /*
 ************************************************************************************************************************
 *           LOCAL GLOBAL VARIABLES
@@ -768,12 +1018,39 @@ static cc_client_t *g_cc_client = NULL;
 static assignment_t g_assignments_list[CC_MAX_DEVICES][CC_MAX_ASSIGNMENTS];
 #endif
 
-static struct list_head g_rtsafe_list;
+static rtsafe_queue_t   g_rtsafe_queue;
 static RtMemPool_Handle g_rtsafe_mem_pool;
-static pthread_mutex_t  g_rtsafe_mutex;
+static pthread_mutex_t  g_rtsafe_mutex; // serializes consumers, never taken by producers
+static uint32_t         g_rtsafe_drops, g_rtsafe_contention;
+
+// effects with dirty feedback slots, atomic
+static uint32_t g_feedback_dirty_effects[FEEDBACK_DIRTY_WORDS(MAX_INSTANCES)];
+
+// bounded multi-producer log queue, read by the feedback thread
+static log_ring_slot_t g_log_ring[LOG_RING_SIZE];
+static uint32_t g_log_ring_head, g_log_ring_tail;
+// effects that used some of their log budget, atomic
+static uint32_t g_log_active_effects[FEEDBACK_DIRTY_WORDS(MAX_INSTANCES)];
+static volatile bool g_log_suppressed_pending;
+static time_t g_log_refill_time;
 
 static volatile int  g_postevents_running; // 0: stopped, 1: running, -1: stopped & about to close mod-host
 static volatile bool g_postevents_ready;
+
+// feedback transport, only switched by the feedback thread in between runs
+static enum FeedbackMode g_feedback_mode;
+static binary_feedback_symbol_t *g_binary_feedback_symbols; // open addressing, ids given to symbols and URIs
+static uint32_t g_binary_feedback_symbols_size, g_binary_feedback_symbols_count;
+
+#ifdef WITH_FEEDBACK_SHM
+// created on request, then handed over to the feedback thread
+static feedback_shm_data *g_feedback_shm_requested;
+static int g_feedback_shm_requested_fd;
+static feedback_shm_data *g_feedback_shm;
+static int g_feedback_shmfd;
+static uint32_t *g_feedback_shm_symbols; // bitmap of the symbol ids defined on the current ring
+static uint32_t g_feedback_shm_symbols_words;
+#endif
 static sem_t         g_postevents_semaphore;
 static ZixThread     g_postevents_thread;
 
@@ -808,8 +1085,11 @@ static volatile enum TransportSyncMode g_transport_sync_mode;
 static bool g_aggregated_midi_enabled;
 static bool g_verbose_debug;
 static bool g_cpu_load_enabled;
+static bool g_plugin_load_enabled;
 static volatile bool g_processing_enabled;
+static volatile bool g_zero_copy_enabled;
 static volatile bool g_cpu_load_trigger;
+static volatile bool g_plugin_load_trigger;
 
 // Wall clock time since program startup
 static uint64_t g_monotonic_frame_count = 0;
@@ -874,16 +1154,45 @@ static pthread_mutex_t g_midi_learning_mutex;
 static bool g_monitored_midi_controls[16];
 static bool g_monitored_midi_programs[16];
 
-/* Postponed port updates */
-static sync_scheduled_param_t g_sync_scheduled_params[MAX_SYNC_SCHEDULED_PARAMS];
-static pthread_mutex_t g_sync_scheduled_params_mutex;
-static unsigned int g_sync_scheduled_param_count;
+/* Postponed port updates, all values of a batch are applied at the start of the same cycle */
+static sync_scheduled_batch_t g_sync_scheduled_batches[2];
+static sync_scheduled_batch_t *g_sync_scheduled_staging; // protected by g_sync_scheduled_lock
+static sync_scheduled_batch_t *g_sync_scheduled_pending;
+static int32_t g_sync_scheduled_state; // atomic
+static pthread_mutex_t g_sync_scheduled_lock; // recursive, slow commands stage values from the background executor
+static sync_scheduled_txn_t g_txns[MAX_TRANSACTIONS]; // protected by g_sync_scheduled_lock
+static uint32_t g_txns_open; // atomic, changed under g_sync_scheduled_lock
+
+/* Pre-resolved parameters, only used from the socket thread */
+static param_handle_t *g_param_handles;
+static uint32_t g_param_handles_count, g_param_handles_size;
 
 #ifdef HAVE_HYLIA
 static hylia_t* g_hylia_instance;
 static hylia_time_info_t g_hylia_timeinfo;
 #endif
 
+/* In-process graph engine */
+static bool g_graph_engine_enabled;
+static graph_plan_t *g_graph_plan; // atomic, the audio thread never locks
+static graph_plan_t *g_graph_plan_in_use; // atomic, set by the audio thread while running a plan
+static uint32_t g_graph_cycles_done; // atomic
+static bool g_graph_paused; // atomic, outputs are silenced while set
+static pthread_mutex_t g_graph_mutex; // serializes plan changes and readers on non-audio threads
+static pthread_mutex_t g_lilv_mutex; // lilv world and graph plan changes while effects_add runs in parallel
+static plugin_descriptor_t *g_plugin_descriptors; // protected by g_lilv_mutex
+static graph_edge_t *g_graph_edges;
+static uint32_t g_graph_edges_count;
+static float *g_graph_silence;
+static graph_worker_t g_graph_workers[MAX_GRAPH_WORKERS];
+static uint32_t g_graph_workers_count;
+static volatile bool g_graph_workers_running;
+static graph_plan_t *volatile g_graph_cycle_plan;
+static volatile jack_nframes_t g_graph_cycle_nframes;
+static int32_t g_graph_cycle_checked_out; // atomic
+static uint64_t g_graph_stats_cycles, g_graph_stats_busy_ns, g_graph_stats_wall_ns; // atomic
+static float g_graph_stats_max_parallelism; // atomic
+
 #ifdef MOD_HMI_CONTROL_ENABLED
 /* HMI integration */
 static int g_hmi_shmfd;
@@ -920,6 +1229,8 @@ static const char* const g_rolling_port_symbol = ROLLING_PORT_SYMBOL;
 static void InstanceDelete(int effect_id);
 static int InstanceExist(int effect_id);
 static void AllocatePortBuffers(effect_t* effect, int in_size, int out_size);
+static bool AllocateAudioPortBuffers(effect_t* effect, uint32_t nframes);
+static void FreeAudioPortBuffers(effect_t* effect);
 static int BufferSize(jack_nframes_t nframes, void* data);
 static void FreeWheelMode(int starting, void* data);
 static void PortRegistration(jack_port_id_t port_id, int reg, void* data);
@@ -931,6 +1242,7 @@ static void* HMIClientThread(void* arg);
 #endif
 static void PreRunPlugin(effect_t *effect);
 static int ProcessPlugin(jack_nframes_t nframes, void *arg);
+static int ProcessPluginCycle(jack_nframes_t nframes, effect_t *effect);
 static bool SetPortValue(port_t *port, float value, int effect_id, bool is_bypass, bool from_ui);
 static float UpdateValueFromMidi(midi_cc_t* mcc, uint16_t mvalue, bool highres);
 static bool UpdateGlobalJackPosition(enum UpdatePositionFlag flag, bool do_post);
@@ -940,12 +1252,29 @@ static void JackTimebase(jack_transport_state_t state, jack_nframes_t nframes,
 static void JackThreadInit(void *arg);
 static void GetFeatures(effect_t *effect);
 static void TriggerJackTimebase(bool reset_to_zero);
+static jack_port_t *RegisterEffectJackPort(effect_t *effect, const char *symbol, const char *type, unsigned long flags);
+static void SetJackPortRanges(jack_client_t *jack_client, jack_port_t *jack_port, const port_t *port);
+static void GraphRebuild(void);
+static void GraphSync(void);
+static void RunGraph(jack_nframes_t nframes);
+static void GraphStartWorkers(void);
+static void GraphStopWorkers(void);
+static port_t *GraphFindPort(const char *name, effect_t **effect_ptr);
+static jack_port_t *GraphEnsureJackPort(effect_t *effect, port_t *port);
+static void GraphReleaseUnusedJackPorts(void);
+static int GraphAddEdge(effect_t *effectA, port_t *portA, effect_t *effectB, port_t *portB);
+static bool GraphRemoveEdge(const port_t *portA, const port_t *portB);
+static void GraphReleaseEffectPorts(effect_t *effect);
 
 static property_t *FindEffectPropertyByURI(effect_t *effect, const char *uri);
 static port_t *FindEffectInputPortBySymbol(effect_t *effect, const char *control_symbol);
 static port_t *FindEffectOutputPortBySymbol(effect_t *effect, const char *control_symbol);
 static const void *GetPortValueForState(const char* symbol, void* user_data, uint32_t* size, uint32_t* type);
-static void LoadPresets(effect_t *effect);
+static void LoadPresets(plugin_descriptor_t *descriptor);
+static plugin_descriptor_t *PluginDescriptorGet(const char *uri, const LilvPlugin *plugin);
+static void PluginDescriptorRelease(plugin_descriptor_t *descriptor);
+static void PluginDescriptorsInvalidate(void);
+static bool InstanceArenaAllocate(effect_t *effect, const pthread_mutexattr_t *mutex_atts);
 static void FreeFeatures(effect_t *effect);
 static void FreePluginString(void* handle, char *str);
 static void ConnectToAllHardwareMIDIPorts(void);
@@ -1007,6 +1336,7 @@ static void ExternalControllerWriteFunction(LV2UI_Controller controller,
 
 static void* effects_activate_thread(void* arg);
 static void* effects_deactivate_thread(void* arg);
+static void* effects_add_thread(void* arg);
 
 /*
 ************************************************************************************************************************
@@ -1059,4929 +1389,7368 @@ static char* _realpath(const char *name, char *resolved)
 #define realpath _realpath
 #endif
 
-static void InstanceDelete(int effect_id)
+static postponed_event_list_data *RtSafeEventAllocate(void)
 {
-    if (INSTANCE_IS_VALID(effect_id))
-        memset(&g_effects[effect_id], 0, sizeof(effect_t));
+    postponed_event_list_data *const eventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+
+    if (eventptr == NULL)
+        __atomic_fetch_add(&g_rtsafe_drops, 1, __ATOMIC_RELAXED);
+
+    return eventptr;
 }
 
-static int InstanceExist(int effect_id)
+static postponed_event_list_data *RtSafeQueuePushNode(postponed_event_list_data *node)
 {
-    if (INSTANCE_IS_VALID(effect_id))
-    {
-        return (int)(g_effects[effect_id].jack_client != NULL);
-    }
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
 
-    return 0;
+    postponed_event_list_data *const prev = __atomic_exchange_n(&g_rtsafe_queue.head, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+
+    return prev;
 }
 
-static void AllocatePortBuffers(effect_t* effect, int in_size, int out_size)
+static void RtSafeQueuePush(postponed_event_list_data *eventptr)
 {
-    uint32_t i;
-
-    for (i = 0; i < effect->event_ports_count; i++)
-    {
-        const int size = effect->event_ports[i]->flow == FLOW_INPUT ? in_size : out_size;
-        if (size == 0)
-            continue;
-        lv2_evbuf_free(effect->event_ports[i]->evbuf);
-        effect->event_ports[i]->evbuf = lv2_evbuf_new(
-            size,
-            (effect->event_ports[i]->hints & HINT_OLD_EVENT_API) ? LV2_EVBUF_EVENT : LV2_EVBUF_ATOM,
-            g_urid_map.map(g_urid_map.handle, LV2_ATOM__Chunk),
-            g_urid_map.map(g_urid_map.handle, LV2_ATOM__Sequence));
+    postponed_event_list_data *const expected = __atomic_load_n(&g_rtsafe_queue.head, __ATOMIC_RELAXED);
 
-        LV2_Atom_Sequence *buf;
-        buf = lv2_evbuf_get_buffer(effect->event_ports[i]->evbuf);
-        lilv_instance_connect_port(effect->lilv_instance, effect->event_ports[i]->index, buf);
-    }
+    // another producer got in between, only used for statistics
+    if (RtSafeQueuePushNode(eventptr) != expected)
+        __atomic_fetch_add(&g_rtsafe_contention, 1, __ATOMIC_RELAXED);
 }
 
-static int BufferSize(jack_nframes_t nframes, void* data)
+static postponed_event_list_data *RtSafeQueuePop(void)
 {
-    g_block_length = nframes;
-    g_midi_buffer_size = jack_port_type_get_buffer_size(g_jack_global_client, JACK_DEFAULT_MIDI_TYPE);
+    rtsafe_queue_t *const queue = &g_rtsafe_queue;
+    postponed_event_list_data *tail = queue->tail;
+    postponed_event_list_data *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
 
-    if (data)
+    if (tail == &queue->stub)
     {
-        effect_t *effect = data;
+        if (next == NULL)
+            return NULL;
 
-        // if ringbuffers exist, keep their existing size
-        const int in_size = effect->events_in_buffer ? 0 : (g_midi_buffer_size * 16);
-        const int out_size = effect->events_out_buffer ? 0 : (g_midi_buffer_size * 16);
-        AllocatePortBuffers(effect, in_size, out_size);
+        queue->tail = tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
 
-        // notify plugin of the change
-        if (effect->options_interface != NULL) {
-            LV2_Options_Option options[5];
+    if (next != NULL)
+    {
+        queue->tail = next;
+        return tail;
+    }
 
-            options[0].context = LV2_OPTIONS_INSTANCE;
-            options[0].subject = 0;
-            options[0].key = g_urids.bufsz_nomimalBlockLength;
-            options[0].size = sizeof(int32_t);
-            options[0].type = g_urids.atom_Int;
-            options[0].value = &g_block_length;
+    // a producer has not linked its node yet, it will post the semaphore once done
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+        return NULL;
 
-            options[1].context = LV2_OPTIONS_INSTANCE;
-            options[1].subject = 0;
-            options[1].key = g_urids.bufsz_minBlockLength;
-            options[1].size = sizeof(int32_t);
-            options[1].type = g_urids.atom_Int;
-            options[1].value = &g_block_length;
+    // tail is the last node, push the stub behind it so it can be taken
+    RtSafeQueuePushNode(&queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
 
-            options[2].context = LV2_OPTIONS_INSTANCE;
-            options[2].subject = 0;
-            options[2].key = g_urids.bufsz_maxBlockLength;
-            options[2].size = sizeof(int32_t);
-            options[2].type = g_urids.atom_Int;
-            options[2].value = &g_block_length;
+    if (next != NULL)
+    {
+        queue->tail = next;
+        return tail;
+    }
 
-            options[3].context = LV2_OPTIONS_INSTANCE;
-            options[3].subject = 0;
-            options[3].key = g_urids.bufsz_sequenceSize;
-            options[3].size = sizeof(int32_t);
-            options[3].type = g_urids.atom_Int;
-            options[3].value = &g_midi_buffer_size;
+    return NULL;
+}
 
-            options[4].context = LV2_OPTIONS_INSTANCE;
-            options[4].subject = 0;
-            options[4].key = 0;
-            options[4].size = 0;
-            options[4].type = 0;
-            options[4].value = NULL;
+static void RtSafeQueueDrain(struct list_head *queue)
+{
+    postponed_event_list_data *eventptr;
 
-            if (effect->lv2_activated)
-                lilv_instance_deactivate(effect->lilv_instance);
+    pthread_mutex_lock(&g_rtsafe_mutex);
 
-            effect->options_interface->set(effect->lilv_instance->lv2_handle, options);
+    while ((eventptr = RtSafeQueuePop()) != NULL)
+        list_add_tail(&eventptr->siblings, queue);
 
-            if (effect->lv2_activated)
-                lilv_instance_activate(effect->lilv_instance);
-        }
-    }
-#ifdef HAVE_HYLIA
-    else if (g_hylia_instance)
+    pthread_mutex_unlock(&g_rtsafe_mutex);
+}
+
+static bool FeedbackSlotsAllocate(effect_t *effect)
+{
+    const uint32_t slots_count = effect->ports_count + 2;
+
+    effect->feedback_values = (float *) mod_calloc(FEEDBACK_SLOT_KINDS * slots_count, sizeof(float));
+    effect->feedback_dirty = (uint32_t *) mod_calloc(FEEDBACK_SLOT_KINDS * FEEDBACK_DIRTY_WORDS(slots_count),
+                                                     sizeof(uint32_t));
+
+    if (effect->feedback_values == NULL || effect->feedback_dirty == NULL)
     {
-        hylia_set_output_latency(g_hylia_instance, GetHyliaOutputLatency());
+        free(effect->feedback_values);
+        free(effect->feedback_dirty);
+        effect->feedback_values = NULL;
+        effect->feedback_dirty = NULL;
+        return false;
     }
-#endif
 
-    return SUCCESS;
+    effect->feedback_slots_count = slots_count;
+    return true;
 }
 
-static void FreeWheelMode(int starting, void* data)
+static void FeedbackSlotsFree(effect_t *effect)
 {
-    effect_t *effect = data;
-    if (effect->freewheel_index >= 0)
-    {
-        *(effect->ports[effect->freewheel_index]->buffer) = starting ? 1.0f : 0.0f;
-    }
+    free(effect->feedback_values);
+    free(effect->feedback_dirty);
+    effect->feedback_values = NULL;
+    effect->feedback_dirty = NULL;
+    effect->feedback_slots_count = 0;
 }
 
-static void PortRegistration(jack_port_id_t port_id, int reg, void* data)
+static void PortIndexInsert(effect_t *effect, port_t *port)
 {
-    if (g_aggregated_midi_enabled || reg == 0)
-        return;
+    const uint32_t hash = str_hash(port->symbol);
+    uint32_t i = hash;
 
-    /* port flags to connect to */
-    static const int target_port_flags = JackPortIsTerminal|JackPortIsPhysical|JackPortIsOutput;
+    while (effect->port_index[i & effect->port_index_mask].port != NULL)
+        i++;
 
-    const jack_port_t* const port = jack_port_by_id(g_jack_global_client, port_id);
+    effect->port_index[i & effect->port_index_mask].hash = hash;
+    effect->port_index[i & effect->port_index_mask].port = port;
+}
 
-    if ((jack_port_flags(port) & target_port_flags) != target_port_flags)
-        return;
-    if (strcmp(jack_port_type(port), JACK_DEFAULT_MIDI_TYPE) != 0)
-        return;
+static bool PortIndexBuild(effect_t *effect)
+{
+    // keep the table at most half full, so probe sequences stay short
+    uint32_t size = 8;
+    while (size < (effect->control_ports_count + 2) * 2)
+        size *= 2;
 
-    postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+    effect->port_index = (port_index_entry_t *) mod_calloc(size, sizeof(port_index_entry_t));
 
-    if (posteventptr == NULL)
-        return;
+    if (effect->port_index == NULL)
+        return false;
 
-    posteventptr->event.type = POSTPONED_JACK_MIDI_CONNECT;
-    posteventptr->event.jack_midi_connect.port = port_id;
+    effect->port_index_mask = size - 1;
 
-    pthread_mutex_lock(&g_rtsafe_mutex);
-    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-    pthread_mutex_unlock(&g_rtsafe_mutex);
+    for (uint32_t i = 0; i < effect->control_ports_count; i++)
+        PortIndexInsert(effect, effect->control_ports[i]);
 
-    sem_post(&g_postevents_semaphore);
-    return;
+    // the rest of these virtual ports is set up later
+    effect->bypass_port.symbol = g_bypass_port_symbol;
+    effect->presets_port.symbol = g_presets_port_symbol;
+    PortIndexInsert(effect, &effect->bypass_port);
+    PortIndexInsert(effect, &effect->presets_port);
 
-    UNUSED_PARAM(data);
+    return true;
 }
 
-static int XRun(void *data)
+static void PortIndexFree(effect_t *effect)
 {
-    ++g_jack_xruns;
-
-    return 0;
-
-    UNUSED_PARAM(data);
+    free(effect->port_index);
+    effect->port_index = NULL;
+    effect->port_index_mask = 0;
 }
 
-static bool ShouldIgnorePostPonedEffectEvent(int effect_id, postponed_cached_effect_events* cached_events)
+static port_t *PortIndexLookup(const effect_t *effect, const char *symbol)
 {
-    if (effect_id == cached_events->last_effect_id)
-    {
-        // already received this event, like just now
-        return true;
-    }
+    if (effect->port_index == NULL)
+        return NULL;
 
-    // we received some events, but last one was different
-    // we might be getting interleaved events, so let's check if it's there
-    struct list_head *it;
-    list_for_each(it, &cached_events->effects.siblings)
+    const uint32_t hash = str_hash(symbol);
+    const port_index_entry_t *entry;
+
+    for (uint32_t i = hash;; i++)
     {
-        postponed_cached_effect_list_data* const peffect = list_entry(it, postponed_cached_effect_list_data, siblings);
+        entry = &effect->port_index[i & effect->port_index_mask];
 
-        if (effect_id == peffect->effect_id)
-        {
-            // haha! found you little bastard!
-            return true;
-        }
+        if (entry->port == NULL)
+            return NULL;
+        if (entry->hash == hash && strcmp(entry->port->symbol, symbol) == 0)
+            return entry->port;
     }
+}
 
-    // we'll process this event because it's the "last" of its type
-    // also add it to the list of received events
-    postponed_cached_effect_list_data* const peffect = malloc(sizeof(postponed_cached_effect_list_data));
+static void SyncScheduledApply(sync_scheduled_batch_t *batch)
+{
+    port_t *port;
 
-    if (peffect)
+    for (uint32_t i = 0; i < batch->count; i++)
     {
-        peffect->effect_id = effect_id;
-        list_add_tail(&peffect->siblings, &cached_events->effects.siblings);
+        port = batch->params[i].port;
+        port->prev_value = *port->buffer = batch->params[i].value;
+#ifdef WITH_EXTERNAL_UI_SUPPORT
+        port->hints |= HINT_SHOULD_UPDATE;
+#endif
     }
 
-    return false;
+    batch->count = 0;
 }
 
-static bool ShouldIgnorePostPonedSymbolEvent(int effect_id,
-                                             const char* symbol,
-                                             postponed_cached_symbol_events* cached_events)
+static bool SyncScheduledReserve(sync_scheduled_batch_t *batch, uint32_t count)
 {
-    // symbol must not be null
-    if (symbol == NULL)
+    if (batch->count + count <= batch->size)
+        return true;
+
+    uint32_t size = batch->size != 0 ? batch->size : 64;
+    while (size < batch->count + count)
+        size *= 2;
+
+    sync_scheduled_param_t *params = realloc(batch->params, sizeof(sync_scheduled_param_t) * size);
+
+    if (params == NULL)
         return false;
 
-    if (effect_id == cached_events->last_effect_id &&
-        strncmp(symbol, cached_events->last_symbol, MAX_CHAR_BUF_SIZE) == 0)
-    {
-        // already received this event, like just now
-        return true;
-    }
+    batch->params = params;
+    batch->size = size;
+    return true;
+}
 
-    // we received some events, but last one was different
-    // we might be getting interleaved events, so let's check if it's there
-    struct list_head *it;
-    list_for_each(it, &cached_events->symbols.siblings)
+// returns false if out of memory and the value must be set right away, the caller must hold g_sync_scheduled_lock
+static bool SyncScheduledStage(sync_scheduled_batch_t *batch, int effect_id, port_t *port, float value)
+{
+    if (! SyncScheduledReserve(batch, 1))
+        return false;
+
+    batch->params[batch->count].port = port;
+    batch->params[batch->count].value = value;
+    batch->params[batch->count].effect_id = effect_id;
+    batch->count++;
+    return true;
+}
+
+static void SyncScheduledDropFrom(sync_scheduled_batch_t *batch, int effect_id)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < batch->count; i++)
     {
-        postponed_cached_symbol_list_data* const psymbol = list_entry(it, postponed_cached_symbol_list_data, siblings);
+        if (effect_id == REMOVE_ALL || batch->params[i].effect_id == effect_id)
+            continue;
 
-        if (effect_id == psymbol->effect_id &&
-            strncmp(symbol, psymbol->symbol, MAX_CHAR_BUF_SIZE) == 0)
-        {
-            // haha! found you little bastard!
-            return true;
-        }
+        batch->params[count++] = batch->params[i];
     }
 
-    // we'll process this event because it's the "last" of its type
-    // also add it to the list of received events
-    postponed_cached_symbol_list_data* const psymbol = malloc(sizeof(postponed_cached_symbol_list_data));
+    batch->count = count;
+}
 
-    if (psymbol)
+// the open transaction of the client running the current command, the caller must hold g_sync_scheduled_lock
+static sync_scheduled_txn_t *TxnFind(int client)
+{
+    if (client < 0 || __atomic_load_n(&g_txns_open, __ATOMIC_RELAXED) == 0)
+        return NULL;
+
+    for (int i = 0; i < MAX_TRANSACTIONS; i++)
     {
-        psymbol->effect_id = effect_id;
-        strncpy(psymbol->symbol, symbol, MAX_CHAR_BUF_SIZE);
-        psymbol->symbol[MAX_CHAR_BUF_SIZE] = '\0';
-        list_add_tail(&psymbol->siblings, &cached_events->symbols.siblings);
+        if (g_txns[i].client == client)
+            return &g_txns[i];
     }
 
-    return false;
+    return NULL;
 }
 
-static int socket_send_feedback_debug(const char *buffer)
+// where values of the current command go, its client's transaction or the batch applied on the next commit
+static sync_scheduled_batch_t *TxnBatch(void)
 {
-    if (g_verbose_debug) {
-        printf("DEBUG: RunPostPonedEvents() Sending '%s'\n", buffer);
-        fflush(stdout);
-    }
-    return socket_send_feedback(buffer);
+    sync_scheduled_txn_t *const txn = TxnFind(protocol_current_sender());
+
+    return txn != NULL ? &txn->batch : g_sync_scheduled_staging;
 }
 
-static void RunPostPonedEvents(int ignored_effect_id)
+// stages a value while the current client has a transaction open, returns false if it should be set right away
+static bool TxnStage(int effect_id, port_t *port, float value)
 {
-    if (g_verbose_debug) {
-        puts("DEBUG: RunPostPonedEvents() START");
-        fflush(stdout);
-    }
+    // the common case, nobody has a transaction open
+    if (__atomic_load_n(&g_txns_open, __ATOMIC_ACQUIRE) == 0)
+        return false;
 
-    // local queue to where we'll save rtsafe list
-    struct list_head queue;
-    INIT_LIST_HEAD(&queue);
+    pthread_mutex_lock(&g_sync_scheduled_lock);
 
-    // move rtsafe list to our local queue, and clear it
-    pthread_mutex_lock(&g_rtsafe_mutex);
-    list_splice_init(&g_rtsafe_list, &queue);
-    pthread_mutex_unlock(&g_rtsafe_mutex);
+    sync_scheduled_txn_t *const txn = TxnFind(protocol_current_sender());
+    const bool staged = txn != NULL && SyncScheduledStage(&txn->batch, effect_id, port, value);
 
-    // fetch this value only once per run
-    const bool cpu_load_trigger = g_jack_global_client != NULL && g_cpu_load_trigger;
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
+    return staged;
+}
 
-    if (cpu_load_trigger)
-    {
-        g_cpu_load_trigger = false;
-    }
-    else if (list_empty(&queue))
+static void TxnClose(sync_scheduled_txn_t *txn)
+{
+    free(txn->batch.params);
+    memset(&txn->batch, 0, sizeof(txn->batch));
+    txn->client = -1;
+    __atomic_sub_fetch(&g_txns_open, 1, __ATOMIC_RELEASE);
+}
+
+// values of removed instances are dropped from everything not yet handed to the audio thread
+static void SyncScheduledDrop(int effect_id)
+{
+    pthread_mutex_lock(&g_sync_scheduled_lock);
+
+    SyncScheduledDropFrom(g_sync_scheduled_staging, effect_id);
+
+    for (int i = 0; i < MAX_TRANSACTIONS; i++)
     {
-        // nothing to do
-        if (g_verbose_debug) {
-            puts("DEBUG: RunPostPonedEvents() Queue is empty");
-            fflush(stdout);
-        }
-        return;
+        if (g_txns[i].client >= 0)
+            SyncScheduledDropFrom(&g_txns[i].batch, effect_id);
     }
 
-    // local buffer
-    #define FEEDBACK_BUF_SIZE (MAX_CHAR_BUF_SIZE * 2)
-    char buf[FEEDBACK_BUF_SIZE+1];
-    buf[FEEDBACK_BUF_SIZE] = '\0';
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
+}
 
-    // cached data, to make sure we only handle similar events once
-    bool got_midi_program = false;
-    bool got_transport = false;
-    postponed_cached_effect_events cached_audio_monitor, cached_process_out_buf;
-    postponed_cached_symbol_events cached_param_set, cached_param_state, cached_output_mon;
+// hands the staged values over to the audio thread
+static void SyncScheduledCommit(void)
+{
+    pthread_mutex_lock(&g_sync_scheduled_lock);
 
-    cached_audio_monitor.last_effect_id = -1;
-    cached_process_out_buf.last_effect_id = -1;
-    cached_param_set.last_effect_id = -1;
-    cached_param_set.last_symbol[0] = '\0';
-    cached_param_set.last_symbol[MAX_CHAR_BUF_SIZE] = '\0';
-    cached_param_state.last_effect_id = -1;
-    cached_param_state.last_symbol[0] = '\0';
-    cached_param_state.last_symbol[MAX_CHAR_BUF_SIZE] = '\0';
-    cached_output_mon.last_effect_id = -1;
-    cached_output_mon.last_symbol[0] = '\0';
-    cached_output_mon.last_symbol[MAX_CHAR_BUF_SIZE] = '\0';
-    INIT_LIST_HEAD(&cached_audio_monitor.effects.siblings);
-    INIT_LIST_HEAD(&cached_process_out_buf.effects.siblings);
-    INIT_LIST_HEAD(&cached_param_set.symbols.siblings);
-    INIT_LIST_HEAD(&cached_param_state.symbols.siblings);
-    INIT_LIST_HEAD(&cached_output_mon.symbols.siblings);
+    sync_scheduled_batch_t *staging = g_sync_scheduled_staging;
 
-    // if all we have are jack_midi_connect requests, do not send feedback to server
-    bool got_only_jack_midi_requests = !cpu_load_trigger;
+    if (staging->count == 0)
+        goto end;
 
-    if (g_verbose_debug) {
-        puts("DEBUG: RunPostPonedEvents() Before the queue iteration");
-        fflush(stdout);
+    int32_t state = SYNC_SCHEDULED_PENDING;
+
+    if (__atomic_compare_exchange_n(&g_sync_scheduled_state, &state, SYNC_SCHEDULED_IDLE, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        // the audio thread has not picked up the previous batch yet, append to it so neither side waits
+        sync_scheduled_batch_t *pending = g_sync_scheduled_pending;
+
+        if (SyncScheduledReserve(pending, staging->count))
+        {
+            memcpy(pending->params + pending->count, staging->params, sizeof(sync_scheduled_param_t) * staging->count);
+            pending->count += staging->count;
+            staging->count = 0;
+            __atomic_store_n(&g_sync_scheduled_state, SYNC_SCHEDULED_PENDING, __ATOMIC_RELEASE);
+            goto end;
+        }
+
+        // out of memory, the previous batch is applied now so values still land in order
+        SyncScheduledApply(pending);
+    }
+    else
+    {
+        // the audio thread is applying the previous batch, which only takes a moment
+        while (__atomic_load_n(&g_sync_scheduled_state, __ATOMIC_ACQUIRE) != SYNC_SCHEDULED_IDLE)
+            sched_yield();
     }
 
-    // itenerate backwards
-    struct list_head *it, *it2;
-    postponed_event_list_data* eventptr;
+    g_sync_scheduled_pending = staging;
+    g_sync_scheduled_staging = staging == &g_sync_scheduled_batches[0] ? &g_sync_scheduled_batches[1]
+                                                                        : &g_sync_scheduled_batches[0];
+    g_sync_scheduled_staging->count = 0;
+    __atomic_store_n(&g_sync_scheduled_state, SYNC_SCHEDULED_PENDING, __ATOMIC_RELEASE);
 
-    list_for_each_prev(it, &queue)
+end:
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
+}
+
+static void ParamHandlesRelease(effect_t *effect)
+{
+    if (! effect->has_param_handles)
+        return;
+
+    for (uint32_t i = 0; i < g_param_handles_count; i++)
     {
-        eventptr = list_entry(it, postponed_event_list_data, siblings);
+        if (g_param_handles[i].effect_id != effect->instance)
+            continue;
 
-#ifdef DEBUG
-        if (g_verbose_debug) {
-            printf("DEBUG: RunPostPonedEvents() ptr %p type %i\n", eventptr, eventptr->event.type);
-            fflush(stdout);
-        }
-#endif
+        // bump the generation so old handles to this slot stay invalid once it is reused
+        g_param_handles[i].effect_id = -1;
+        g_param_handles[i].port = NULL;
+        if (++g_param_handles[i].generation > PARAM_HANDLE_GENERATION_MAX)
+            g_param_handles[i].generation = 0;
+    }
 
-        if (got_only_jack_midi_requests && eventptr->event.type != POSTPONED_JACK_MIDI_CONNECT)
-            got_only_jack_midi_requests = false;
+    effect->has_param_handles = false;
+}
 
-        switch (eventptr->event.type)
-        {
-        case POSTPONED_PARAM_SET:
-            if (eventptr->event.parameter.effect_id == ignored_effect_id)
-                continue;
-            if (ShouldIgnorePostPonedSymbolEvent(eventptr->event.parameter.effect_id,
-                                                 eventptr->event.parameter.symbol,
-                                                 &cached_param_set))
-                continue;
+static uint32_t FeedbackSlotIndex(const effect_t *effect, const port_t *port)
+{
+    if (port == &effect->bypass_port)
+        return effect->ports_count;
+    if (port == &effect->presets_port)
+        return effect->ports_count + 1;
 
-            snprintf(buf, FEEDBACK_BUF_SIZE, "param_set %i %s %f", eventptr->event.parameter.effect_id,
-                                                                   eventptr->event.parameter.symbol,
-                                                                   eventptr->event.parameter.value);
-            socket_send_feedback_debug(buf);
+    return port->index;
+}
 
-            // save for fast checkup next time
-            cached_param_set.last_effect_id = eventptr->event.parameter.effect_id;
-            strncpy(cached_param_set.last_symbol, eventptr->event.parameter.symbol, MAX_CHAR_BUF_SIZE);
-            break;
+static const port_t *FeedbackSlotPort(const effect_t *effect, uint32_t slot)
+{
+    if (slot < effect->ports_count)
+        return effect->ports[slot];
+    if (slot == effect->ports_count)
+        return &effect->bypass_port;
 
-        case POSTPONED_PARAM_STATE:
-            if (eventptr->event.state.effect_id == ignored_effect_id)
-                continue;
-            if (ShouldIgnorePostPonedSymbolEvent(eventptr->event.state.effect_id,
-                                                 eventptr->event.state.symbol,
-                                                 &cached_param_state))
-                continue;
+    return &effect->presets_port;
+}
 
-            snprintf(buf, FEEDBACK_BUF_SIZE, "param_state %i %s %i", eventptr->event.state.effect_id,
-                                                                     eventptr->event.state.symbol,
-                                                                     eventptr->event.state.state);
-            socket_send_feedback_debug(buf);
+// rt-safe, overwrites any value not reported yet so the feedback thread only sees the latest one
+static bool FeedbackSlotSet(effect_t *effect, const port_t *port, enum FeedbackSlotKind kind, float value)
+{
+    if (effect->feedback_dirty == NULL)
+        return false;
 
-            // save for fast checkup next time
-            cached_param_state.last_effect_id = eventptr->event.state.effect_id;
-            strncpy(cached_param_state.last_symbol, eventptr->event.state.symbol, MAX_CHAR_BUF_SIZE);
-            break;
+    const uint32_t slot = FeedbackSlotIndex(effect, port);
 
-        case POSTPONED_AUDIO_MONITOR:
-            if (ShouldIgnorePostPonedEffectEvent(eventptr->event.audio_monitor.index, &cached_audio_monitor))
-                continue;
+    if (slot >= effect->feedback_slots_count)
+        return false;
 
-            pthread_mutex_lock(&g_audio_monitor_mutex);
-            if (eventptr->event.audio_monitor.index < g_audio_monitor_count)
-                g_audio_monitors[eventptr->event.audio_monitor.index].value = 0.f;
-            pthread_mutex_unlock(&g_audio_monitor_mutex);
+    uint32_t *const dirty = effect->feedback_dirty + kind * FEEDBACK_DIRTY_WORDS(effect->feedback_slots_count);
+    const int instance = effect->instance;
 
-            snprintf(buf, FEEDBACK_BUF_SIZE, "audio_monitor %i %f", eventptr->event.audio_monitor.index,
-                                                                    eventptr->event.audio_monitor.value);
-            socket_send_feedback_debug(buf);
+    __atomic_store(&effect->feedback_values[kind * effect->feedback_slots_count + slot], &value, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&dirty[slot / 32], 1u << (slot % 32), __ATOMIC_RELEASE);
+    __atomic_fetch_or(&g_feedback_dirty_effects[instance / 32], 1u << (instance % 32), __ATOMIC_RELEASE);
 
-            // save for fast checkup next time
-            cached_audio_monitor.last_effect_id = eventptr->event.audio_monitor.index;
-            break;
+    return true;
+}
 
-        case POSTPONED_OUTPUT_MONITOR:
-            if (eventptr->event.parameter.effect_id == ignored_effect_id)
-                continue;
-            if (ShouldIgnorePostPonedSymbolEvent(eventptr->event.parameter.effect_id,
-                                                 eventptr->event.parameter.symbol,
-                                                 &cached_output_mon))
-                continue;
+static bool FeedbackSlotsPending(void)
+{
+    for (uint32_t w = 0; w < FEEDBACK_DIRTY_WORDS(MAX_INSTANCES); w++)
+    {
+        if (__atomic_load_n(&g_feedback_dirty_effects[w], __ATOMIC_RELAXED) != 0)
+            return true;
+    }
 
-            snprintf(buf, FEEDBACK_BUF_SIZE, "output_set %i %s %f", eventptr->event.parameter.effect_id,
-                                                                    eventptr->event.parameter.symbol,
-                                                                    eventptr->event.parameter.value);
-            socket_send_feedback_debug(buf);
+    return false;
+}
 
-            // save for fast checkup next time
-            cached_output_mon.last_effect_id = eventptr->event.parameter.effect_id;
-            strncpy(cached_output_mon.last_symbol, eventptr->event.parameter.symbol, MAX_CHAR_BUF_SIZE);
-            break;
+static void LogRingReset(void)
+{
+    for (uint32_t i = 0; i < LOG_RING_SIZE; i++)
+        __atomic_store_n(&g_log_ring[i].sequence, i, __ATOMIC_RELAXED);
 
-        case POSTPONED_MIDI_MAP:
-            if (eventptr->event.midi_map.effect_id == ignored_effect_id)
-                continue;
-            snprintf(buf, FEEDBACK_BUF_SIZE, "midi_mapped %i %s %i %i %f %f %f", eventptr->event.midi_map.effect_id,
-                                                                                 eventptr->event.midi_map.symbol,
-                                                                                 eventptr->event.midi_map.channel,
-                                                                                 eventptr->event.midi_map.controller,
-                                                                                 eventptr->event.midi_map.value,
-                                                                                 eventptr->event.midi_map.minimum,
-                                                                                 eventptr->event.midi_map.maximum);
-            socket_send_feedback_debug(buf);
-            break;
+    g_log_ring_head = g_log_ring_tail = 0;
+}
 
-        case POSTPONED_MIDI_CONTROL_CHANGE:
-            snprintf(buf, FEEDBACK_BUF_SIZE, "midi_control_change %i %i %i",
-                     eventptr->event.control_change.channel,
-                     eventptr->event.control_change.control,
-                     eventptr->event.control_change.value);
-            socket_send_feedback_debug(buf);
-            break;
+// rt-safe, returns NULL if full, the slot must be published with LogRingPublish
+static log_ring_slot_t *LogRingReserve(uint32_t *pos_ptr)
+{
+    uint32_t pos = __atomic_load_n(&g_log_ring_head, __ATOMIC_RELAXED);
 
-        case POSTPONED_MIDI_PROGRAM_CHANGE:
-            if (got_midi_program)
+    for (;;)
+    {
+        log_ring_slot_t *const slot = &g_log_ring[pos & (LOG_RING_SIZE - 1)];
+        const int32_t diff = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&g_log_ring_head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
             {
-                if (g_verbose_debug) {
-                    puts("DEBUG: RunPostPonedEvents() Ignoring old midi program change event");
-                    fflush(stdout);
-                }
-                continue;
+                *pos_ptr = pos;
+                return slot;
             }
+        }
+        else if (diff < 0)
+        {
+            return NULL;
+        }
+        else
+        {
+            pos = __atomic_load_n(&g_log_ring_head, __ATOMIC_RELAXED);
+        }
+    }
+}
 
-            snprintf(buf, FEEDBACK_BUF_SIZE, "midi_program_change %i %i",
-                     eventptr->event.program_change.program,
-                     eventptr->event.program_change.channel);
-            socket_send_feedback_debug(buf);
+static void LogRingPublish(log_ring_slot_t *slot, uint32_t pos)
+{
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+}
 
-            // ignore older midi program changes
-            got_midi_program = true;
-            break;
+// feedback thread only
+static log_ring_slot_t *LogRingFront(void)
+{
+    log_ring_slot_t *const slot = &g_log_ring[g_log_ring_tail & (LOG_RING_SIZE - 1)];
 
-        case POSTPONED_TRANSPORT:
-            if (got_transport)
-                continue;
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != g_log_ring_tail + 1)
+        return NULL;
 
-            snprintf(buf, FEEDBACK_BUF_SIZE, "transport %i %f %f", eventptr->event.transport.rolling ? 1 : 0,
-                                                                   eventptr->event.transport.bpb,
-                                                                   eventptr->event.transport.bpm);
-            socket_send_feedback_debug(buf);
+    return slot;
+}
 
-            // ignore older transport changes
-            got_transport = true;
-            break;
+static void LogRingPop(log_ring_slot_t *slot)
+{
+    __atomic_store_n(&slot->sequence, g_log_ring_tail + LOG_RING_SIZE, __ATOMIC_RELEASE);
+    ++g_log_ring_tail;
+}
 
-        case POSTPONED_JACK_MIDI_CONNECT:
-            if (g_jack_global_client != NULL) {
-                const jack_port_id_t port_id = eventptr->event.jack_midi_connect.port;
-                const jack_port_t *const port = jack_port_by_id(g_jack_global_client, port_id);
+static bool LogMessagesPending(void)
+{
+    return g_log_suppressed_pending || LogRingFront() != NULL;
+}
 
-                if (port != NULL) {
-                    if (g_midi_in_port != NULL)
-                        jack_connect(g_jack_global_client, jack_port_name(port), jack_port_name(g_midi_in_port));
+static void InstanceDelete(int effect_id)
+{
+    if (INSTANCE_IS_VALID(effect_id))
+        memset(&g_effects[effect_id], 0, sizeof(effect_t));
+}
 
-                    struct list_head *it3;
-                    pthread_mutex_lock(&g_raw_midi_port_mutex);
-                    list_for_each(it3, &g_raw_midi_port_list)
-                    {
-                        raw_midi_port_item* const portitemptr = list_entry(it3, raw_midi_port_item, siblings);
+static int InstanceExist(int effect_id)
+{
+    if (INSTANCE_IS_VALID(effect_id))
+    {
+        const effect_t *effect = &g_effects[effect_id];
 
-                        jack_connect(g_jack_global_client,
-                                      jack_port_name(port),
-                                      jack_port_name(portitemptr->jack_port));
-                    }
-                    pthread_mutex_unlock(&g_raw_midi_port_mutex);
-                }
-            }
-            break;
+        return (int)(__atomic_load_n(&effect->jack_client, __ATOMIC_ACQUIRE) != NULL &&
+                     ! __atomic_load_n(&effect->adding, __ATOMIC_ACQUIRE));
+    }
 
-        case POSTPONED_PROCESS_OUTPUT_BUFFER:
-            if (eventptr->event.process_out_buf.effect_id == ignored_effect_id)
-                continue;
-            if (ShouldIgnorePostPonedEffectEvent(eventptr->event.process_out_buf.effect_id, &cached_process_out_buf))
-                continue;
+    return 0;
+}
 
-            if (INSTANCE_IS_VALID(eventptr->event.process_out_buf.effect_id))
-            {
-                effect_t *effect = &g_effects[eventptr->event.process_out_buf.effect_id];
-                const size_t space = jack_ringbuffer_read_space(effect->events_out_buffer);
+static inline bool IsInProcessEffect(const effect_t *effect)
+{
+    return effect->instance != GLOBAL_EFFECT_ID && effect->jack_client == g_jack_global_client;
+}
 
-                uint32_t key;
-                LV2_Atom atom;
-                bool supported;
+static inline uint64_t GetTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
 
-                for (size_t j = 0; j < space; j += sizeof(uint32_t) + sizeof(LV2_Atom) + atom.size)
-                {
-                    jack_ringbuffer_read(effect->events_out_buffer, (char*)&key, sizeof(uint32_t));
-                    jack_ringbuffer_read(effect->events_out_buffer, (char*)&atom, sizeof(LV2_Atom));
+static inline float *GetAudioPortBuffer(port_t *port, jack_nframes_t nframes)
+{
+    if (port->graph_data != NULL)
+        return port->graph_data;
 
-                    char *body = mod_calloc(1, atom.size);
-                    jack_ringbuffer_read(effect->events_out_buffer, body, atom.size);
+    return (float*)jack_port_get_buffer(port->jack_port, nframes);
+}
 
-                    supported = true;
-                    int wrtn = snprintf(buf, FEEDBACK_BUF_SIZE, "patch_set %i %s ", effect->instance,
-                                                                                    id_to_urid(g_symap, key));
-                    if (atom.type == g_urids.atom_Bool)
-                    {
-                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "b %i", *(int32_t*)body != 0 ? 1 : 0);
-                    }
-                    else if (atom.type == g_urids.atom_Int)
-                    {
-                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "i %i", *(int32_t*)body);
-                    }
-                    else if (atom.type == g_urids.atom_Long)
-                    {
-                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "l %" PRId64, *(int64_t*)body);
-                    }
-                    else if (atom.type == g_urids.atom_Float)
-                    {
-                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "f %f", *(float*)body);
-                    }
-                    else if (atom.type == g_urids.atom_Double)
-                    {
-                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "g %f", *(double*)body);
-                    }
-                    else if (atom.type == g_urids.atom_String)
-                    {
-                        if (atom.size + 2 > FEEDBACK_BUF_SIZE - (uint)wrtn)
-                        {
-                            char* rbuf = malloc(wrtn + atom.size + 3);
-                            strcpy(rbuf, buf);
-                            strcpy(rbuf + wrtn, "s ");
-                            strncpy(rbuf + (wrtn + 2), body, atom.size);
-                            rbuf[wrtn + atom.size + 2] = '\0';
+static inline void BindPortBuffer(effect_t *effect, port_t *port, float *buffer)
+{
+    float *const bound_buffer = buffer != port->buffer ? buffer : NULL;
 
-                            supported = false;
-                            socket_send_feedback_debug(rbuf);
-                            free(rbuf);
-                        }
-                        else
-                        {
-                            snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "s %s", body);
-                        }
-                    }
-                    else if (atom.type == g_urids.atom_Path)
-                    {
-                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "p %s", body);
-                    }
-                    else if (atom.type == g_urids.atom_URI)
-                    {
-                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "u %s", body);
-                    }
-                    else if (atom.type == g_urids.atom_Vector)
-                    {
-                        LV2_Atom_Vector_Body *vbody = (LV2_Atom_Vector_Body*)body;
-                        uint32_t n_elems = (atom.size - sizeof(LV2_Atom_Vector_Body)) / vbody->child_size;
+    // jack buffers rarely move, so this is normally a no-op
+    if (port->bound_buffer != bound_buffer)
+    {
+        lilv_instance_connect_port(effect->lilv_instance, port->index, buffer);
+        port->bound_buffer = bound_buffer;
+    }
+}
 
-                        wrtn += snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "v %u-", n_elems);
+static void UnbindPortBuffers(effect_t *effect)
+{
+    for (uint32_t i = 0; i < effect->audio_ports_count; i++)
+        BindPortBuffer(effect, effect->audio_ports[i], effect->audio_ports[i]->buffer);
 
-                        char* rbuf;
-                        if (n_elems <= 8)
-                        {
-                            rbuf = buf;
-                        }
-                        else
-                        {
-                            rbuf = malloc(wrtn + (n_elems * 16 + 1) + 3);
-                            strcpy(rbuf, buf);
-                        }
+    for (uint32_t i = 0; i < effect->cv_ports_count; i++)
+        BindPortBuffer(effect, effect->cv_ports[i], effect->cv_ports[i]->buffer);
+}
 
-                        /**/ if (vbody->child_type == g_urids.atom_Bool)
-                        {
-                            rbuf[wrtn++] = 'b';
-                            rbuf[wrtn++] = '-';
-                            int32_t *vcontent = (int32_t*)(vbody + 1);
-                            for (uint32_t v = 0; v < n_elems; ++v)
-                                wrtn += snprintf(rbuf + wrtn, 16, "%i:", *(vcontent + v) != 0 ? 1 : 0);
-                        }
-                        else if (vbody->child_type == g_urids.atom_Int)
-                        {
-                            rbuf[wrtn++] = 'i';
-                            rbuf[wrtn++] = '-';
-                            int32_t *vcontent = (int32_t*)(vbody + 1);
-                            for (uint32_t v = 0; v < n_elems; ++v)
-                                wrtn += snprintf(rbuf + wrtn, 16, "%i:", *(vcontent + v));
-                        }
-                        else if (vbody->child_type == g_urids.atom_Long)
-                        {
-                            rbuf[wrtn++] = 'l';
-                            rbuf[wrtn++] = '-';
-                            int64_t *vcontent = (int64_t*)(vbody + 1);
-                            for (uint32_t v = 0; v < n_elems; ++v)
-                                wrtn += snprintf(rbuf + wrtn, 16, "%" PRIi64 ":", *(vcontent + v));
-                        }
-                        else if (vbody->child_type == g_urids.atom_Float)
-                        {
-                            rbuf[wrtn++] = 'f';
-                            rbuf[wrtn++] = '-';
-                            float *vcontent = (float*)(vbody + 1);
-                            for (uint32_t v = 0; v < n_elems; ++v)
-                                wrtn += snprintf(rbuf + wrtn, 16, "%f:", *(vcontent + v));
-                        }
-                        else if (vbody->child_type == g_urids.atom_Double)
-                        {
-                            rbuf[wrtn++] = 'g';
-                            rbuf[wrtn++] = '-';
-                            double *vcontent = (double*)(vbody + 1);
-                            for (uint32_t v = 0; v < n_elems; ++v)
-                                wrtn += snprintf(rbuf + wrtn, 16, "%f:", *(vcontent + v));
-                        }
-                        else
-                        {
-                            supported = false;
-                        }
+static void AllocatePortBuffers(effect_t* effect, int in_size, int out_size)
+{
+    uint32_t i;
 
-                        rbuf[wrtn-1] = '\0';
+    for (i = 0; i < effect->event_ports_count; i++)
+    {
+        const int size = effect->event_ports[i]->flow == FLOW_INPUT ? in_size : out_size;
+        if (size == 0)
+            continue;
+        lv2_evbuf_free(effect->event_ports[i]->evbuf);
+        effect->event_ports[i]->evbuf = lv2_evbuf_new(
+            size,
+            (effect->event_ports[i]->hints & HINT_OLD_EVENT_API) ? LV2_EVBUF_EVENT : LV2_EVBUF_ATOM,
+            g_urid_map.map(g_urid_map.handle, LV2_ATOM__Chunk),
+            g_urid_map.map(g_urid_map.handle, LV2_ATOM__Sequence));
 
-                        if (rbuf != buf)
-                        {
-                            supported = false;
-                            socket_send_feedback_debug(rbuf);
-                            free(rbuf);
-                        }
-                    }
-                    /*
-                    else if (atom.type == g_urids.atom_Tuple)
-                    {
-                        // LV2_Atom_Tuple *tuple = (LV2_Atom_Tuple*)body;
-                        // TODO
-                    }
-                    */
-                    else
-                    {
-                        supported = false;
-                    }
+        LV2_Atom_Sequence *buf;
+        buf = lv2_evbuf_get_buffer(effect->event_ports[i]->evbuf);
+        lilv_instance_connect_port(effect->lilv_instance, effect->event_ports[i]->index, buf);
+    }
+}
 
-                    if (supported)
-                        socket_send_feedback_debug(buf);
+static void FreeAudioPortBuffers(effect_t* effect)
+{
+    if (effect->ports_arena == NULL)
+        return;
 
-                    free(body);
-                }
-            }
+#ifdef _WIN32
+    _aligned_free(effect->ports_arena);
+#else
+    munlock(effect->ports_arena, effect->ports_arena_size);
+    free(effect->ports_arena);
+#endif
 
-            // save for fast checkup next time
-            cached_process_out_buf.last_effect_id = eventptr->event.process_out_buf.effect_id;
-            break;
+    effect->ports_arena = NULL;
+    effect->ports_arena_size = 0;
+    effect->ports_arena_frames = 0;
+}
 
-        // these are handled later, during "cleanup"
-        case POSTPONED_LOG_TRACE:
-        case POSTPONED_LOG_MESSAGE:
-            break;
-        }
-    }
+static bool AllocateAudioPortBuffers(effect_t* effect, uint32_t nframes)
+{
+    if (effect->ports_arena != NULL && effect->ports_arena_frames == nframes)
+        return true;
 
-    if (cpu_load_trigger)
-    {
-        snprintf(buf, FEEDBACK_BUF_SIZE, "cpu_load %f %f %d", jack_cpu_load(g_jack_global_client),
-                                                             #ifdef HAVE_JACK2_1_9_23
-                                                              jack_max_cpu_load(g_jack_global_client),
-                                                             #else
-                                                              0.f,
-                                                             #endif
-                                                              g_jack_xruns);
-        socket_send_feedback_debug(buf);
-    }
+    // in-process effects also need host-side storage for the graph
+    const uint32_t buffers_per_port = IsInProcessEffect(effect) ? 2 : 1;
+    const uint32_t buffers_count = (effect->audio_ports_count + effect->cv_ports_count) * buffers_per_port;
+    const size_t stride = (nframes * sizeof(float) + PORT_BUFFER_ALIGNMENT - 1) & ~(size_t)(PORT_BUFFER_ALIGNMENT - 1);
+    const size_t size = stride * buffers_count;
+    void *arena;
 
-    if (g_verbose_debug) {
-        puts("DEBUG: RunPostPonedEvents() After the queue iteration");
-        fflush(stdout);
-    }
+    if (size == 0)
+        return true;
 
-    // cleanup memory
-    postponed_cached_effect_list_data *peffect;
-    postponed_cached_symbol_list_data *psymbol;
+#ifdef _WIN32
+    arena = _aligned_malloc(size, PORT_BUFFER_ALIGNMENT);
+#else
+    if (posix_memalign(&arena, PORT_BUFFER_ALIGNMENT, size) != 0)
+        arena = NULL;
+#endif
+    if (arena == NULL)
+        return false;
 
-    list_for_each_safe(it, it2, &cached_audio_monitor.effects.siblings)
-    {
-        peffect = list_entry(it, postponed_cached_effect_list_data, siblings);
-        free(peffect);
-    }
-    list_for_each_safe(it, it2, &cached_process_out_buf.effects.siblings)
-    {
-        peffect = list_entry(it, postponed_cached_effect_list_data, siblings);
-        free(peffect);
-    }
-    list_for_each_safe(it, it2, &cached_param_set.symbols.siblings)
-    {
-        psymbol = list_entry(it, postponed_cached_symbol_list_data, siblings);
-        free(psymbol);
-    }
-    list_for_each_safe(it, it2, &cached_param_state.symbols.siblings)
-    {
-        psymbol = list_entry(it, postponed_cached_symbol_list_data, siblings);
-        free(psymbol);
-    }
-    list_for_each_safe(it, it2, &cached_output_mon.symbols.siblings)
-    {
-        psymbol = list_entry(it, postponed_cached_symbol_list_data, siblings);
-        free(psymbol);
-    }
+    mod_memset(arena, 0, size);
+#ifndef _WIN32
+    mlock(arena, size);
+#endif
 
-    // cleanup memory of rt queue, safely
-    // also take the chance to handle non-critical events that need to be in order
-    list_for_each_safe(it, it2, &queue)
-    {
-        eventptr = list_entry(it, postponed_event_list_data, siblings);
+    FreeAudioPortBuffers(effect);
+    effect->ports_arena = arena;
+    effect->ports_arena_size = size;
+    effect->ports_arena_frames = nframes;
 
-        switch (eventptr->event.type)
-        {
-        case POSTPONED_LOG_TRACE:
-            snprintf(buf, FEEDBACK_BUF_SIZE, "log %d %s", LOG_TRACE, eventptr->event.log_trace.msg);
-            socket_send_feedback_debug(buf);
-            break;
+    char *ptr = arena;
+    for (uint32_t i = 0; i < effect->audio_ports_count + effect->cv_ports_count; i++)
+    {
+        port_t *port = i < effect->audio_ports_count
+                     ? effect->audio_ports[i]
+                     : effect->cv_ports[i - effect->audio_ports_count];
 
-        case POSTPONED_LOG_MESSAGE: {
-            char *msg = eventptr->event.log_message.msg;
-            const int prefix_len = snprintf(buf, FEEDBACK_BUF_SIZE, "log %d ", eventptr->event.log_message.type);
-            const size_t msg_len = strlen(msg);
-
-            if (prefix_len > 0 && prefix_len < 8) {
-                char* msg2 = malloc(prefix_len + msg_len + 1);
-                if (msg2 != NULL) {
-                    memcpy(msg2, buf, prefix_len);
-                    memcpy(msg2+prefix_len, msg, msg_len + 1);
-                    socket_send_feedback_debug(msg2);
-                    free(msg2);
-                }
-            }
-            free(msg);
-            break;
-        }
+        port->buffer = (float*)ptr;
+        port->buffer_count = nframes;
+        port->bound_buffer = NULL;
+        lilv_instance_connect_port(effect->lilv_instance, port->index, port->buffer);
+        ptr += stride;
 
-        default:
-            break;
+        if (buffers_per_port == 2)
+        {
+            port->graph_buffer = (float*)ptr;
+            port->graph_data = port->flow == FLOW_OUTPUT ? port->graph_buffer : g_graph_silence;
+            ptr += stride;
         }
-
-        rtsafe_memory_pool_deallocate(g_rtsafe_mem_pool, eventptr);
-    }
-
-    if (g_postevents_ready && !got_only_jack_midi_requests)
-    {
-        // report data finished to server
-        g_postevents_ready = false;
-        socket_send_feedback_debug("data_finish");
     }
 
-    if (g_verbose_debug) {
-        puts("DEBUG: RunPostPonedEvents() END");
-        fflush(stdout);
-    }
+    return true;
 }
 
-static void* PostPonedEventsThread(void* arg)
+static int BufferSize(jack_nframes_t nframes, void* data)
 {
-#if defined(_MOD_DEVICE_RK358x)
-    setpriority(PRIO_PROCESS, gettid(), -18);
-#elif defined(_MOD_DEVICE_DUO) || defined(_MOD_DEVICE_DUOX) || defined(_MOD_DEVICE_DWARF)
-    const pid_t tid = syscall(SYS_gettid);
-    if (tid > 0)
-        setpriority(PRIO_PROCESS, tid, -18);
-#endif
+    g_block_length = nframes;
+    g_midi_buffer_size = jack_port_type_get_buffer_size(g_jack_global_client, JACK_DEFAULT_MIDI_TYPE);
 
-    while (g_postevents_running == 1)
+    if (data)
     {
-        if (sem_timedwait_secs(&g_postevents_semaphore, 1) != 0)
-            continue;
+        effect_t *effect = data;
 
-        if (g_postevents_running == 1 && g_postevents_ready)
-        {
-            RunPostPonedEvents(-3); // as all effects are valid we set ignored_effect_id to -3
-            if (g_verbose_debug) {
-                printf("DEBUG: PostPonedEventsThread() looping (code %d)\n", g_postevents_running);
-                fflush(stdout);
-            }
-        }
-    }
+        // if ringbuffers exist, keep their existing size
+        const int in_size = effect->events_in_buffer ? 0 : (g_midi_buffer_size * 16);
+        const int out_size = effect->events_out_buffer ? 0 : (g_midi_buffer_size * 16);
+        AllocatePortBuffers(effect, in_size, out_size);
 
-    if (g_verbose_debug) {
-        printf("DEBUG: PostPonedEventsThread() stopping (code %d)\n", g_postevents_running);
-        fflush(stdout);
-    }
+        if (!AllocateAudioPortBuffers(effect, nframes))
+            fprintf(stderr, "can't resize audio buffers of effect %i\n", effect->instance);
 
-    return NULL;
+        // notify plugin of the change
+        if (effect->options_interface != NULL) {
+            LV2_Options_Option options[5];
 
-    UNUSED_PARAM(arg);
-}
+            options[0].context = LV2_OPTIONS_INSTANCE;
+            options[0].subject = 0;
+            options[0].key = g_urids.bufsz_nomimalBlockLength;
+            options[0].size = sizeof(int32_t);
+            options[0].type = g_urids.atom_Int;
+            options[0].value = &g_block_length;
 
-#ifdef MOD_HMI_CONTROL_ENABLED
-static void* HMIClientThread(void* arg)
-{
-    sys_serial_shm_data_channel* const data = (sys_serial_shm_data_channel*)arg;
+            options[1].context = LV2_OPTIONS_INSTANCE;
+            options[1].subject = 0;
+            options[1].key = g_urids.bufsz_minBlockLength;
+            options[1].size = sizeof(int32_t);
+            options[1].type = g_urids.atom_Int;
+            options[1].value = &g_block_length;
 
-    sys_serial_event_type etype;
-    char msg[SYS_SERIAL_SHM_DATA_SIZE];
+            options[2].context = LV2_OPTIONS_INSTANCE;
+            options[2].subject = 0;
+            options[2].key = g_urids.bufsz_maxBlockLength;
+            options[2].size = sizeof(int32_t);
+            options[2].type = g_urids.atom_Int;
+            options[2].value = &g_block_length;
 
-    while (g_hmi_data != NULL && &g_hmi_data->client == data)
-    {
-        if (sem_timedwait_secs(&data->sem, 1) != 0)
-            continue;
+            options[3].context = LV2_OPTIONS_INSTANCE;
+            options[3].subject = 0;
+            options[3].key = g_urids.bufsz_sequenceSize;
+            options[3].size = sizeof(int32_t);
+            options[3].type = g_urids.atom_Int;
+            options[3].value = &g_midi_buffer_size;
 
-        if (g_hmi_data == NULL || &g_hmi_data->client != data)
-            break;
+            options[4].context = LV2_OPTIONS_INSTANCE;
+            options[4].subject = 0;
+            options[4].key = 0;
+            options[4].size = 0;
+            options[4].type = 0;
+            options[4].value = NULL;
 
-        while (data->head != data->tail)
+            if (effect->lv2_activated)
+                lilv_instance_deactivate(effect->lilv_instance);
+
+            effect->options_interface->set(effect->lilv_instance->lv2_handle, options);
+
+            if (effect->lv2_activated)
+                lilv_instance_activate(effect->lilv_instance);
+        }
+    }
+    else
+    {
+        // in-process effects have no client of their own, notify them from here
+        if (g_graph_engine_enabled)
         {
-            if (! sys_serial_read(data, &etype, msg))
-                continue;
+            pthread_mutex_lock(&g_graph_mutex);
 
-            if (g_verbose_debug) {
-                printf("DEBUG: HMIClientThread received event %x (%c)\n", etype, etype-0x80);
-                fflush(stdout);
-            }
+            // buffers are reallocated, keep the audio thread away from them
+            __atomic_store_n(&g_graph_paused, true, __ATOMIC_SEQ_CST);
+            GraphSync();
 
-            switch (etype)
+            // includes effects not yet part of the plan
+            for (int i = 0; i < MAX_PLUGIN_INSTANCES; i++)
             {
-            case sys_serial_event_type_compressor_mode:
-                g_compressor_mode = clamp(msg[0] - '0', 0, 4);
-                monitor_client_setup_compressor(g_compressor_mode, g_compressor_release);
-                break;
-            case sys_serial_event_type_compressor_release:
-                g_compressor_release = clampf(atof(msg), 50.0f, 500.0f);
-                monitor_client_setup_compressor(g_compressor_mode, g_compressor_release);
-                break;
-#ifdef MOD_IO_PROCESSING_ENABLED
-            case sys_serial_event_type_noisegate_channel:
-                g_noisegate_channel = clamp(msg[0] - '0', 0, 3);
-                break;
-            case sys_serial_event_type_noisegate_decay:
-                g_noisegate_decay = clampf(atof(msg), 1.0f, 500.0f);
-                gate_update(&g_noisegate, g_sample_rate, 10, 1,
-                            g_noisegate_decay, 1,
-                            g_noisegate_threshold, g_noisegate_threshold - 20);
-                break;
-            case sys_serial_event_type_noisegate_threshold:
-                g_noisegate_threshold = clampf(atof(msg), -70.0f, -10.0f);
-                gate_update(&g_noisegate, g_sample_rate, 10, 1,
-                            g_noisegate_decay, 1,
-                            g_noisegate_threshold, g_noisegate_threshold - 20);
-                break;
-#endif
-            case sys_serial_event_type_pedalboard_gain:
-                monitor_client_setup_volume(clampf(atof(msg), MOD_MONITOR_VOLUME_MUTE, 20.0f));
-                break;
-            default:
-                break;
+                if (InstanceExist(i) && IsInProcessEffect(&g_effects[i]))
+                    BufferSize(nframes, &g_effects[i]);
             }
+
+            __atomic_store_n(&g_graph_paused, false, __ATOMIC_RELEASE);
+
+            pthread_mutex_unlock(&g_graph_mutex);
         }
+
+#ifdef HAVE_HYLIA
+        if (g_hylia_instance)
+            hylia_set_output_latency(g_hylia_instance, GetHyliaOutputLatency());
+#endif
     }
 
-    return NULL;
+    return SUCCESS;
 }
-#endif
 
-static void PreRunPlugin(effect_t *effect)
+static void FreeWheelMode(int starting, void* data)
 {
-    if (effect->hints & HINT_STATE_UNSAFE)
-        pthread_mutex_lock(&effect->state_restore_mutex);
-
-    /* common variables */
-    port_t *port;
-    unsigned int i;
-    float value;
-    bool needs_post = false;
-
-    if (effect->hints & HINT_TRANSPORT)
-    {
-        effect->transport_rolling = g_jack_rolling;
-        // effect->transport_frame = pos.frame;
-        effect->transport_bpb = g_transport_bpb;
-        effect->transport_bpm = g_transport_bpm;
-    }
-    if (effect->bpb_index >= 0)
-    {
-        *(effect->ports[effect->bpb_index]->buffer) = g_transport_bpb;
-    }
-    if (effect->bpm_index >= 0)
-    {
-        *(effect->ports[effect->bpm_index]->buffer) = g_transport_bpm;
-    }
-    if (effect->speed_index >= 0)
-    {
-        *(effect->ports[effect->speed_index]->buffer) = g_jack_rolling ? 1.0f : 0.0f;
-    }
+    effect_t *effect = data;
 
-    /* Prepare midi/event ports */
-    for (i = 0; i < effect->input_event_ports_count; i++)
+    if (effect == NULL)
     {
-        port = effect->input_event_ports[i];
-        lv2_evbuf_reset(port->evbuf, true);
-    }
-
-    for (i = 0; i < effect->output_event_ports_count; i++)
-        lv2_evbuf_reset(effect->output_event_ports[i]->evbuf, false);
+        if (! g_graph_engine_enabled)
+            return;
 
-    /* Bypass */
-    if (effect->bypass > 0.5f && effect->enabled_index < 0)
-    {
-        lilv_instance_run(effect->lilv_instance, 0);
-    }
-    /* Effect process */
-    else
-    {
-        /* Run the effect */
-        lilv_instance_run(effect->lilv_instance, 0);
+        pthread_mutex_lock(&g_graph_mutex);
 
-        /* Notify the plugin the run() cycle is finished */
-        if (effect->worker.iface)
+        if (g_graph_plan != NULL)
         {
-            /* Process any replies from the worker. */
-            worker_emit_responses(&effect->worker);
-            if (effect->worker.iface->end_run)
-            {
-                effect->worker.iface->end_run(effect->lilv_instance->lv2_handle);
-            }
+            for (uint32_t i = 0; i < g_graph_plan->nodes_count; i++)
+                FreeWheelMode(starting, g_graph_plan->nodes[i].effect);
         }
+
+        pthread_mutex_unlock(&g_graph_mutex);
+        return;
     }
 
-    if (effect->hints & HINT_TRIGGERS)
+    if (effect->freewheel_index >= 0)
     {
-        for (i = 0; i < effect->input_control_ports_count; i++)
-        {
-            port = effect->input_control_ports[i];
+        *(effect->ports[effect->freewheel_index]->buffer) = starting ? 1.0f : 0.0f;
+    }
+}
 
-            if ((port->hints & HINT_TRIGGER) && floats_differ_enough(port->prev_value, port->def_value))
-                port->prev_value = *(port->buffer) = port->def_value;
-        }
-    }
+static void PortRegistration(jack_port_id_t port_id, int reg, void* data)
+{
+    if (g_aggregated_midi_enabled || reg == 0)
+        return;
 
-    if (effect->hints & HINT_OUTPUT_MONITORS)
-    {
-        for (i = 0; i < effect->output_control_ports_count; i++)
-        {
-            port = effect->output_control_ports[i];
+    /* port flags to connect to */
+    static const int target_port_flags = JackPortIsTerminal|JackPortIsPhysical|JackPortIsOutput;
 
-            if ((port->hints & HINT_MONITORED) == 0)
-                continue;
+    const jack_port_t* const port = jack_port_by_id(g_jack_global_client, port_id);
 
-            value = *(port->buffer);
+    if ((jack_port_flags(port) & target_port_flags) != target_port_flags)
+        return;
+    if (strcmp(jack_port_type(port), JACK_DEFAULT_MIDI_TYPE) != 0)
+        return;
 
-            if (! floats_differ_enough(port->prev_value, value))
-                continue;
+    postponed_event_list_data* const posteventptr = RtSafeEventAllocate();
 
-            postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+    if (posteventptr == NULL)
+        return;
 
-            if (posteventptr == NULL)
-                continue;
+    posteventptr->event.type = POSTPONED_JACK_MIDI_CONNECT;
+    posteventptr->event.jack_midi_connect.port = port_id;
 
-            port->prev_value = value;
+    RtSafeQueuePush(posteventptr);
 
-            posteventptr->event.type = POSTPONED_OUTPUT_MONITOR;
-            posteventptr->event.parameter.effect_id = effect->instance;
-            posteventptr->event.parameter.symbol    = port->symbol;
-            posteventptr->event.parameter.value     = value;
+    sem_post(&g_postevents_semaphore);
+    return;
 
-            pthread_mutex_lock(&g_rtsafe_mutex);
-            list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-            pthread_mutex_unlock(&g_rtsafe_mutex);
+    UNUSED_PARAM(data);
+}
 
-            needs_post = true;
-        }
-    }
+static int XRun(void *data)
+{
+    ++g_jack_xruns;
 
-    if (effect->hints & HINT_STATE_UNSAFE)
-        pthread_mutex_unlock(&effect->state_restore_mutex);
+    return 0;
 
-    if (needs_post)
-        sem_post(&g_postevents_semaphore);
+    UNUSED_PARAM(data);
 }
 
-static int ProcessPlugin(jack_nframes_t nframes, void *arg)
+static bool ShouldIgnorePostPonedEffectEvent(int effect_id, postponed_cached_effect_events* cached_events)
 {
-    effect_t *effect;
-    port_t *port;
-    unsigned int i;
-
-    if (arg == NULL) return 0;
-    effect = arg;
+    if (effect_id == cached_events->last_effect_id)
+    {
+        // already received this event, like just now
+        return true;
+    }
 
-    if ((effect->hints & HINT_IS_LIVE) == 0 &&
-        (!g_processing_enabled || (
-         (effect->hints & HINT_STATE_UNSAFE) && pthread_mutex_trylock(&effect->state_restore_mutex) != 0)))
+    // we received some events, but last one was different
+    // we might be getting interleaved events, so let's check if it's there
+    struct list_head *it;
+    list_for_each(it, &cached_events->effects.siblings)
     {
-        for (i = 0; i < effect->output_audio_ports_count; i++)
-        {
-            memset(jack_port_get_buffer(effect->output_audio_ports[i]->jack_port, nframes),
-                   0, (sizeof(float) * nframes));
-        }
-        for (i = 0; i < effect->output_cv_ports_count; i++)
-        {
-            memset(jack_port_get_buffer(effect->output_cv_ports[i]->jack_port, nframes),
-                   0, (sizeof(float) * nframes));
-        }
-        for (i = 0; i < effect->output_event_ports_count; i++)
+        postponed_cached_effect_list_data* const peffect = list_entry(it, postponed_cached_effect_list_data, siblings);
+
+        if (effect_id == peffect->effect_id)
         {
-            port = effect->output_event_ports[i];
-            if (port->jack_port && port->flow == FLOW_OUTPUT && port->type == TYPE_EVENT)
-                jack_midi_clear_buffer(jack_port_get_buffer(port->jack_port, nframes));
+            // haha! found you little bastard!
+            return true;
         }
-        return 0;
     }
 
-    /* common variables */
-    bool needs_post = false;
-    const float *buffer_in;
-    float *buffer_out;
-    float value;
+    // we'll process this event because it's the "last" of its type
+    // also add it to the list of received events
+    postponed_cached_effect_list_data* const peffect = malloc(sizeof(postponed_cached_effect_list_data));
 
-    /* transport */
-    uint8_t stack_buf[MAX_CHAR_BUF_SIZE+1];
-    memset(stack_buf, 0, sizeof(stack_buf));
-    LV2_Atom* lv2_pos = (LV2_Atom*)stack_buf;
+    if (peffect)
+    {
+        peffect->effect_id = effect_id;
+        list_add_tail(&peffect->siblings, &cached_events->effects.siblings);
+    }
 
-    if (effect->hints & HINT_TRANSPORT)
+    return false;
+}
+
+static bool ShouldIgnorePostPonedSymbolEvent(int effect_id,
+                                             const char* symbol,
+                                             postponed_cached_symbol_events* cached_events)
+{
+    // symbol must not be null
+    if (symbol == NULL)
+        return false;
+
+    if (effect_id == cached_events->last_effect_id &&
+        strncmp(symbol, cached_events->last_symbol, MAX_CHAR_BUF_SIZE) == 0)
     {
-        jack_position_t pos;
-        const bool rolling = (jack_transport_query(effect->jack_client, &pos) == JackTransportRolling);
+        // already received this event, like just now
+        return true;
+    }
 
-        if ((pos.valid & JackPositionBBT) == 0)
+    // we received some events, but last one was different
+    // we might be getting interleaved events, so let's check if it's there
+    struct list_head *it;
+    list_for_each(it, &cached_events->symbols.siblings)
+    {
+        postponed_cached_symbol_list_data* const psymbol = list_entry(it, postponed_cached_symbol_list_data, siblings);
+
+        if (effect_id == psymbol->effect_id &&
+            strncmp(symbol, psymbol->symbol, MAX_CHAR_BUF_SIZE) == 0)
         {
-            pos.beats_per_bar    = g_transport_bpb;
-            pos.beats_per_minute = g_transport_bpm;
+            // haha! found you little bastard!
+            return true;
         }
+    }
 
-        if (effect->transport_rolling != rolling ||
-            effect->transport_frame != pos.frame ||
-            doubles_differ_enough(effect->transport_bpb, pos.beats_per_bar) ||
-            doubles_differ_enough(effect->transport_bpm, pos.beats_per_minute) ||
-            (effect->bypass < 0.5f && effect->was_bypassed))
-        {
-            effect->transport_rolling = rolling;
-            effect->transport_frame = pos.frame;
-            effect->transport_bpb = pos.beats_per_bar;
-            effect->transport_bpm = pos.beats_per_minute;
+    // we'll process this event because it's the "last" of its type
+    // also add it to the list of received events
+    postponed_cached_symbol_list_data* const psymbol = malloc(sizeof(postponed_cached_symbol_list_data));
 
-            LV2_Atom_Forge forge = g_lv2_atom_forge;
-            lv2_atom_forge_set_buffer(&forge, stack_buf, sizeof(stack_buf));
+    if (psymbol)
+    {
+        psymbol->effect_id = effect_id;
+        strncpy(psymbol->symbol, symbol, MAX_CHAR_BUF_SIZE);
+        psymbol->symbol[MAX_CHAR_BUF_SIZE] = '\0';
+        list_add_tail(&psymbol->siblings, &cached_events->symbols.siblings);
+    }
 
-            LV2_Atom_Forge_Frame frame;
-            lv2_atom_forge_object(&forge, &frame, 0, g_urids.time_Position);
+    return false;
+}
 
-            lv2_atom_forge_key(&forge, g_urids.time_speed);
-            lv2_atom_forge_float(&forge, rolling ? 1.0f : 0.0f);
+#ifdef WITH_FEEDBACK_SHM
+// an id only counts as defined once its definition made it into the ring, a full ring drops records
+static bool FeedbackShmDefineSymbol(uint32_t id, const char *symbol)
+{
+    const uint32_t word = id / 32;
+    const uint32_t bit = 1u << (id % 32);
 
-            lv2_atom_forge_key(&forge, g_urids.time_frame);
-            lv2_atom_forge_long(&forge, pos.frame);
+    if (word < g_feedback_shm_symbols_words && (g_feedback_shm_symbols[word] & bit) != 0)
+        return true;
 
-            if (pos.valid & JackPositionBBT)
-            {
-                lv2_atom_forge_key(&forge, g_urids.time_bar);
-                lv2_atom_forge_long(&forge, pos.bar - 1);
+    if (word >= g_feedback_shm_symbols_words)
+    {
+        uint32_t words = g_feedback_shm_symbols_words != 0 ? g_feedback_shm_symbols_words : 8;
+        while (words <= word)
+            words *= 2;
 
-                lv2_atom_forge_key(&forge, g_urids.time_barBeat);
+        uint32_t *symbols = realloc(g_feedback_shm_symbols, sizeof(uint32_t) * words);
+        if (symbols == NULL)
+            return false;
 
-                if (pos.valid & JackTickDouble)
-                    lv2_atom_forge_float(&forge, pos.beat - 1 + (pos.tick_double / pos.ticks_per_beat));
-                else
-                    lv2_atom_forge_float(&forge, pos.beat - 1 + (pos.tick / pos.ticks_per_beat));
+        memset(symbols + g_feedback_shm_symbols_words, 0, sizeof(uint32_t) * (words - g_feedback_shm_symbols_words));
+        g_feedback_shm_symbols = symbols;
+        g_feedback_shm_symbols_words = words;
+    }
 
-                lv2_atom_forge_key(&forge, g_urids.time_beat);
-                lv2_atom_forge_double(&forge, pos.beat - 1);
+    binary_feedback_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.type = BINARY_FEEDBACK_SYMBOL;
+    record.symbol = id;
+    record.size = (uint32_t)strlen(symbol);
 
-                lv2_atom_forge_key(&forge, g_urids.time_beatUnit);
-                lv2_atom_forge_int(&forge, pos.beat_type);
+    if (! feedback_shm_write(g_feedback_shm, &record, symbol))
+        return false;
 
-                lv2_atom_forge_key(&forge, g_urids.time_beatsPerBar);
-                lv2_atom_forge_float(&forge, pos.beats_per_bar);
+    g_feedback_shm_symbols[word] |= bit;
+    return true;
+}
 
-                lv2_atom_forge_key(&forge, g_urids.time_beatsPerMinute);
-                lv2_atom_forge_float(&forge, pos.beats_per_minute);
+static void FeedbackShmSymbolsReset(void)
+{
+    free(g_feedback_shm_symbols);
+    g_feedback_shm_symbols = NULL;
+    g_feedback_shm_symbols_words = 0;
+}
+#endif
 
-                lv2_atom_forge_key(&forge, g_urids.time_ticksPerBeat);
-                lv2_atom_forge_double(&forge, pos.ticks_per_beat);
-            }
+// name is the text message name used for subscriptions, symbol is the string of record->symbol,
+// readers get it defined on their first use
+static void BinaryFeedbackSend(binary_feedback_record_t *record, const void *payload, uint32_t size,
+                               const char *name, const char *symbol)
+{
+    record->size = size;
 
-            lv2_atom_forge_pop(&forge, &frame);
-        }
-    }
-    if (effect->bpb_index >= 0)
-    {
-        *(effect->ports[effect->bpb_index]->buffer) = g_transport_bpb;
-    }
-    if (effect->bpm_index >= 0)
-    {
-        *(effect->ports[effect->bpm_index]->buffer) = g_transport_bpm;
-    }
-    if (effect->speed_index >= 0)
+#ifdef WITH_FEEDBACK_SHM
+    if (g_feedback_mode == FEEDBACK_MODE_SHM)
     {
-        *(effect->ports[effect->speed_index]->buffer) = g_jack_rolling ? 1.0f : 0.0f;
+        // never write a record whose symbol the reader does not know
+        if (record->symbol == 0 || FeedbackShmDefineSymbol(record->symbol, symbol))
+            feedback_shm_write(g_feedback_shm, record, payload);
     }
+#endif
 
-    /* Prepare midi/event ports */
-    for (i = 0; i < effect->input_event_ports_count; i++)
+    // binary socket clients keep getting records while the ring is in use
+    if (socket_feedback_formats() & SOCKET_FEEDBACK_BINARY)
+        socket_send_feedback_record(record, payload, name, symbol);
+}
+
+static void BinaryFeedbackReset(void)
+{
+    socket_feedback_symbols_reset();
+#ifdef WITH_FEEDBACK_SHM
+    FeedbackShmSymbolsReset();
+#endif
+
+    for (uint32_t i = 0; i < g_binary_feedback_symbols_size; i++)
+        free(g_binary_feedback_symbols[i].symbol);
+
+    free(g_binary_feedback_symbols);
+    g_binary_feedback_symbols = NULL;
+    g_binary_feedback_symbols_size = g_binary_feedback_symbols_count = 0;
+}
+
+// returns the id of a symbol or URI, 0 on failure; ids are shared by all connections, which learn them on first use
+static uint32_t BinaryFeedbackSymbol(const char *symbol)
+{
+    const uint32_t hash = str_hash(symbol);
+
+    // keep the table at most half full
+    if (g_binary_feedback_symbols_count * 2 >= g_binary_feedback_symbols_size)
     {
-        port = effect->input_event_ports[i];
-        lv2_evbuf_reset(port->evbuf, true);
+        const uint32_t new_size = g_binary_feedback_symbols_size != 0 ? g_binary_feedback_symbols_size * 2 : 256;
+        binary_feedback_symbol_t *const new_symbols = calloc(new_size, sizeof(binary_feedback_symbol_t));
 
-        if (effect->bypass > 0.5f && effect->enabled_index < 0)
+        if (new_symbols == NULL)
+            return 0;
+
+        for (uint32_t i = 0; i < g_binary_feedback_symbols_size; i++)
         {
-            // effect is now bypassed, but wasn't before
-            if (!effect->was_bypassed && (port->hints & HINT_MIDI_EVENT) != 0)
-            {
-                LV2_Evbuf_Iterator iter = lv2_evbuf_begin(port->evbuf);
+            const binary_feedback_symbol_t *const old = &g_binary_feedback_symbols[i];
 
-                uint8_t bufNotesOff[3] = {
-                    0xB0, // CC
-                    0x7B, // all-notes-off
-                    0
-                };
-                uint8_t bufSoundOff[3] = {
-                    0xB0, // CC
-                    0x78, // all-sound-off
-                    0
-                };
+            if (old->symbol == NULL)
+                continue;
 
-                int j=0;
+            uint32_t j = old->hash & (new_size - 1);
+            while (new_symbols[j].symbol != NULL)
+                j = (j + 1) & (new_size - 1);
 
-                do {
-                    if (!lv2_evbuf_write(&iter, 0, 0, g_urids.midi_MidiEvent, 3, bufNotesOff))
-                        break;
-                    if (!lv2_evbuf_write(&iter, 0, 0, g_urids.midi_MidiEvent, 3, bufSoundOff))
-                        break;
-                    bufNotesOff[0] += 1;
-                    bufSoundOff[0] += 1;
-                } while (++j < 16);
-            }
+            new_symbols[j] = *old;
         }
-        else
-        {
-            // non-bypassed, processing
-            LV2_Evbuf_Iterator iter = lv2_evbuf_begin(port->evbuf);
 
-            /* Write time position */
-            if (lv2_pos->size > 0 && (port->hints & HINT_TRANSPORT) != 0)
-            {
-                lv2_evbuf_write(&iter, 0, 0, lv2_pos->type, lv2_pos->size, LV2_ATOM_BODY_CONST(lv2_pos));
-            }
-
-            /* Write Jack MIDI input */
-            void* buf = jack_port_get_buffer(port->jack_port, nframes);
-            uint32_t j;
-            for (j = 0; j < jack_midi_get_event_count(buf); ++j)
-            {
-                jack_midi_event_t ev;
-                jack_midi_event_get(&ev, buf, j);
-                if (!lv2_evbuf_write(&iter, ev.time, 0, g_urids.midi_MidiEvent, ev.size, ev.buffer))
-                {
-                    fprintf(stderr, "lv2 evbuf write failed\n");
-                }
-            }
-        }
+        free(g_binary_feedback_symbols);
+        g_binary_feedback_symbols = new_symbols;
+        g_binary_feedback_symbols_size = new_size;
     }
 
-    for (i = 0; i < effect->output_event_ports_count; i++)
-        lv2_evbuf_reset(effect->output_event_ports[i]->evbuf, false);
+    const uint32_t mask = g_binary_feedback_symbols_size - 1;
+    binary_feedback_symbol_t *entry;
 
-    /* control in events */
-    if (effect->events_in_buffer && effect->events_in_buffer_helper && effect->control_index >= 0)
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
     {
-        const size_t space = jack_ringbuffer_read_space(effect->events_in_buffer);
-        LV2_Atom *atom = (LV2_Atom*)effect->events_in_buffer_helper;
-        port = effect->ports[effect->control_index];
-
-        for (size_t j = 0; j < space; j += sizeof(LV2_Atom) + atom->size)
-        {
-            jack_ringbuffer_read(effect->events_in_buffer, (char*)atom, sizeof(LV2_Atom));
-            jack_ringbuffer_read(effect->events_in_buffer, (char*)(atom + 1), atom->size);
+        entry = &g_binary_feedback_symbols[i];
 
-            LV2_Evbuf_Iterator e = lv2_evbuf_end(port->evbuf);
-            lv2_evbuf_write(&e, nframes - 1, 0, atom->type, atom->size, (uint8_t*)(atom + 1));
-        }
+        if (entry->symbol == NULL)
+            break;
+        if (entry->hash == hash && strcmp(entry->symbol, symbol) == 0)
+            return entry->id;
     }
 
-    for (i = 0; i < effect->input_control_ports_count; i++)
-    {
-        port = effect->input_control_ports[i];
+    if ((entry->symbol = strdup(symbol)) == NULL)
+        return 0;
 
-        if (port->cv_source)
-        {
-            if (pthread_mutex_trylock(&port->cv_source_mutex) != 0)
-                continue;
-            if (!port->cv_source) {
-                pthread_mutex_unlock(&port->cv_source_mutex);
-                continue;
-            }
+    entry->hash = hash;
+    entry->id = ++g_binary_feedback_symbols_count;
 
-            cv_source_t *cv_source = port->cv_source;
+    return entry->id;
+}
 
-            value = ((float*)jack_port_get_buffer(cv_source->jack_port, 1))[0];
+// SOCKET_FEEDBACK_* formats wanted right now, the shared memory channel takes binary records on top of the sockets
+static int FeedbackFormats(void)
+{
+    const int formats = socket_feedback_formats();
 
-            // convert value from source port into something relevant for this parameter
-            if (value <= cv_source->source_min_value) {
-                value = cv_source->min_value;
+    if (g_feedback_mode == FEEDBACK_MODE_SHM)
+        return formats | SOCKET_FEEDBACK_BINARY;
 
-            } else if (value >= cv_source->source_max_value) {
-                value = cv_source->max_value;
+    return formats;
+}
 
-            } else {
-                // normalize value to 0-1
-                value = (value - cv_source->source_min_value) / cv_source->source_diff_value;
+// for messages that have a binary record of their own, only the text clients get them as text
+static int socket_send_feedback_text(const char *buffer)
+{
+    if (g_verbose_debug) {
+        printf("DEBUG: RunPostPonedEvents() Sending '%s'\n", buffer);
+        fflush(stdout);
+    }
 
-                if (port->hints & HINT_TOGGLE) {
-                    // use min|max values if toggle
-                    value = value > 0.5f ? cv_source->max_value : cv_source->min_value;
+    return socket_send_feedback(buffer);
+}
 
-                } else {
-                    // otherwise unnormalize value to full scale
-                    value = cv_source->min_value + (value * cv_source->diff_value);
+static int socket_send_feedback_debug(const char *buffer)
+{
+    const int formats = FeedbackFormats();
+    int ret = -1;
 
-                    // and round to integer if needed
-                    if (port->hints & HINT_INTEGER) {
-                        value = roundf(value);
-                    }
-                }
-            }
+    if (formats & SOCKET_FEEDBACK_TEXT)
+        ret = socket_send_feedback_text(buffer);
 
-            // ignore requests for same value
-            if (! floats_differ_enough(cv_source->prev_value, value)) {
-                pthread_mutex_unlock(&port->cv_source_mutex);
-                continue;
-            }
+    // messages without a binary record of their own are sent to binary clients wrapped in a text record
+    if (formats & SOCKET_FEEDBACK_BINARY)
+    {
+        binary_feedback_record_t record;
+        memset(&record, 0, sizeof(record));
+        record.type = BINARY_FEEDBACK_TEXT;
+        BinaryFeedbackSend(&record, buffer, strlen(buffer), buffer, NULL);
+        ret = 0;
+    }
 
-            if (SetPortValue(port, value, effect->instance, false, false)) {
-                needs_post = true;
-                cv_source->prev_value = value;
-            }
+    return ret;
+}
 
-            pthread_mutex_unlock(&port->cv_source_mutex);
-        }
-    }
+static void BinaryFeedbackEvent(BinaryFeedbackType type, const char *name)
+{
+    binary_feedback_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    BinaryFeedbackSend(&record, NULL, 0, name, NULL);
+}
 
-    // handle bypass as CV addressing
-    {
-        port = &effect->bypass_port;
+static void BinaryFeedbackValue(BinaryFeedbackType type, const char *name, int instance, const char *symbol,
+                                float value)
+{
+    binary_feedback_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.value_type = BINARY_FEEDBACK_VALUE_FLOAT;
+    record.instance = instance;
+    record.symbol = symbol != NULL ? BinaryFeedbackSymbol(symbol) : 0;
+    record.value.f = value;
+    BinaryFeedbackSend(&record, NULL, 0, name, symbol);
+}
 
-        if (port->cv_source && pthread_mutex_trylock(&port->cv_source_mutex) == 0)
-        {
-            cv_source_t *cv_source = port->cv_source;
+static BinaryFeedbackValueType BinaryFeedbackAtomValueType(LV2_URID type)
+{
+    if (type == g_urids.atom_Bool)
+        return BINARY_FEEDBACK_VALUE_BOOL;
+    if (type == g_urids.atom_Int)
+        return BINARY_FEEDBACK_VALUE_INT;
+    if (type == g_urids.atom_Long)
+        return BINARY_FEEDBACK_VALUE_LONG;
+    if (type == g_urids.atom_Float)
+        return BINARY_FEEDBACK_VALUE_FLOAT;
+    if (type == g_urids.atom_Double)
+        return BINARY_FEEDBACK_VALUE_DOUBLE;
+    if (type == g_urids.atom_String)
+        return BINARY_FEEDBACK_VALUE_STRING;
+    if (type == g_urids.atom_Path)
+        return BINARY_FEEDBACK_VALUE_PATH;
+    if (type == g_urids.atom_URI)
+        return BINARY_FEEDBACK_VALUE_URI;
+    if (type == g_urids.atom_Vector)
+        return BINARY_FEEDBACK_VALUE_VECTOR;
+
+    return BINARY_FEEDBACK_VALUE_NONE;
+}
 
-            value = ((float*)jack_port_get_buffer(cv_source->jack_port, 1))[0];
+// binary variant of "patch_set", atoms not supported by the text variant are skipped too
+static void BinaryFeedbackPatchSet(int instance, const char *uri, const LV2_Atom *atom, const void *body)
+{
+    binary_feedback_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.type = BINARY_FEEDBACK_PATCH_SET;
+    record.value_type = BinaryFeedbackAtomValueType(atom->type);
+    record.instance = instance;
 
-            // NOTE: values are reversed as this is bypass special behaviour
-            if (value <= cv_source->source_min_value) {
-                value = cv_source->max_value;
+    const void *payload = NULL;
+    uint32_t size = 0;
 
-            } else if (value >= cv_source->source_max_value) {
-                value = cv_source->min_value;
+    switch (record.value_type)
+    {
+    case BINARY_FEEDBACK_VALUE_NONE:
+        return;
+    case BINARY_FEEDBACK_VALUE_BOOL:
+        record.value.i = *(const int32_t*)body != 0 ? 1 : 0;
+        break;
+    case BINARY_FEEDBACK_VALUE_INT:
+        record.value.i = *(const int32_t*)body;
+        break;
+    case BINARY_FEEDBACK_VALUE_LONG:
+        record.value.l = *(const int64_t*)body;
+        break;
+    case BINARY_FEEDBACK_VALUE_FLOAT:
+        record.value.f = *(const float*)body;
+        break;
+    case BINARY_FEEDBACK_VALUE_DOUBLE:
+        record.value.d = *(const double*)body;
+        break;
+    case BINARY_FEEDBACK_VALUE_STRING:
+    case BINARY_FEEDBACK_VALUE_PATH:
+    case BINARY_FEEDBACK_VALUE_URI:
+        payload = body;
+        size = atom->size;
+        break;
+    case BINARY_FEEDBACK_VALUE_VECTOR: {
+        if (atom->size < sizeof(LV2_Atom_Vector_Body))
+            return;
 
-            } else {
-                value = ((value - cv_source->source_min_value) / cv_source->source_diff_value) > 0.5f
-                        ? cv_source->min_value
-                        : cv_source->max_value;
-            }
+        const LV2_Atom_Vector_Body *const vbody = (const LV2_Atom_Vector_Body*)body;
+        record.child_type = BinaryFeedbackAtomValueType(vbody->child_type);
 
-            // ignore requests for same value
-            if (floats_differ_enough(cv_source->prev_value, value)) {
-                if (SetPortValue(port, value, effect->instance, true, false)) {
-                    needs_post = true;
-                    cv_source->prev_value = value;
-                }
-            }
+        if (record.child_type == BINARY_FEEDBACK_VALUE_NONE ||
+            record.child_type >= BINARY_FEEDBACK_VALUE_STRING ||
+            vbody->child_size == 0)
+            return;
 
-            pthread_mutex_unlock(&port->cv_source_mutex);
-        }
+        payload = vbody + 1;
+        size = atom->size - sizeof(LV2_Atom_Vector_Body);
+        record.value.i = (int32_t)(size / vbody->child_size);
+        break;
+    }
     }
 
-    /* Bypass */
-    if (effect->bypass > 0.5f && effect->enabled_index < 0)
-    {
-        /* Plugins with audio inputs */
-        if (effect->input_audio_ports_count > 0)
-        {
-            /* prepare jack buffers (bypass copy) */
-            for (i = 0; i < effect->output_audio_ports_count; i++)
-            {
-                if (i < effect->input_audio_ports_count)
-                {
-                    buffer_in = jack_port_get_buffer(effect->input_audio_ports[i]->jack_port, nframes);
-                    memset(effect->input_audio_ports[i]->buffer, 0, (sizeof(float) * nframes));
-                }
-                else
-                {
-                    buffer_in = jack_port_get_buffer(effect->input_audio_ports[effect->input_audio_ports_count - 1]->jack_port, nframes);
-                }
-                buffer_out = jack_port_get_buffer(effect->output_audio_ports[i]->jack_port, nframes);
-                memcpy(buffer_out, buffer_in, (sizeof(float) * nframes));
-            }
+    record.symbol = BinaryFeedbackSymbol(uri);
+    BinaryFeedbackSend(&record, payload, size, "patch_set", uri);
+}
 
-            /* silence any remaining audio inputs */
-            for (; i < effect->input_audio_ports_count; i++)
-                memset(effect->input_audio_ports[i]->buffer, 0, (sizeof(float) * nframes));
+static enum FeedbackMode FeedbackModeRequested(void)
+{
+#ifdef WITH_FEEDBACK_SHM
+    if (__atomic_load_n(&g_feedback_shm_requested, __ATOMIC_ACQUIRE) != NULL)
+        return FEEDBACK_MODE_SHM;
+#endif
 
-            /* reset cv inputs */
-            for (i = 0; i < effect->input_cv_ports_count; i++)
-                memset(effect->input_cv_ports[i]->buffer, 0, (sizeof(float) * nframes));
+    return FEEDBACK_MODE_SOCKET;
+}
 
-            /* Run the plugin with zero buffer to avoid 'pause behavior' in delay plugins */
-            lilv_instance_run(effect->lilv_instance, nframes);
+// switches feedback transport, clients are told on the feedback port
+static void FeedbackModeSwitch(enum FeedbackMode mode)
+{
+#ifdef WITH_FEEDBACK_SHM
+    // end the shared memory stream, socket clients are not affected
+    if (g_feedback_mode == FEEDBACK_MODE_SHM)
+    {
+        binary_feedback_record_t record;
+        memset(&record, 0, sizeof(record));
+        record.type = BINARY_FEEDBACK_END;
+        feedback_shm_write(g_feedback_shm, &record, NULL);
+        sem_post(&g_feedback_shm->sem);
+        feedback_shm_close(g_feedback_shmfd, g_feedback_shm, true);
+        __atomic_store_n(&g_feedback_shm, NULL, __ATOMIC_RELEASE);
+    }
+#endif
 
-            /* no need to silence plugin audio or cv, they are unused during bypass */
-        }
-        /* Plugins without audio inputs */
-        else
-        {
-            /* prepare jack buffers (silent) */
-            for (i = 0; i < effect->output_audio_ports_count; i++)
-            {
-                buffer_out = jack_port_get_buffer(effect->output_audio_ports[i]->jack_port, nframes);
-                memset(buffer_out, 0, (sizeof(float) * nframes));
-            }
-            for (i = 0; i < effect->output_cv_ports_count; i++)
-            {
-                buffer_out = jack_port_get_buffer(effect->output_cv_ports[i]->jack_port, nframes);
-                memset(buffer_out, 0, (sizeof(float) * nframes));
-            }
+    g_feedback_mode = FEEDBACK_MODE_SOCKET;
 
-            /* reset cv inputs */
-            for (i = 0; i < effect->input_cv_ports_count; i++)
-                memset(effect->input_cv_ports[i]->buffer, 0, (sizeof(float) * nframes));
+    switch (mode)
+    {
+    case FEEDBACK_MODE_SOCKET:
+        break;
+    case FEEDBACK_MODE_SHM:
+#ifdef WITH_FEEDBACK_SHM
+        // a new reader, it learns every symbol again
+        FeedbackShmSymbolsReset();
+        g_feedback_shmfd = g_feedback_shm_requested_fd;
+        __atomic_store_n(&g_feedback_shm, g_feedback_shm_requested, __ATOMIC_RELEASE);
+        socket_send_feedback_debug("feedback_shm 1");
+#endif
+        break;
+    }
 
-            /* Run the plugin with default cv buffers and without midi events */
-            lilv_instance_run(effect->lilv_instance, nframes);
+    g_feedback_mode = mode;
+}
 
-            /* no need to silence plugin audio or cv, they are unused during bypass */
-        }
-    }
-    /* Effect process */
-    else
+// only the latest value of each dirty slot is reported, returns true if anything was sent
+static bool RunFeedbackSlots(int ignored_effect_id, char *buf, size_t buf_size)
+{
+    static const char* const commands[FEEDBACK_SLOT_KINDS] = {
+        "param_set",
+        "output_set",
+    };
+    static const BinaryFeedbackType binary_types[FEEDBACK_SLOT_KINDS] = {
+        BINARY_FEEDBACK_PARAM_SET,
+        BINARY_FEEDBACK_OUTPUT_SET,
+    };
+    const int formats = FeedbackFormats();
+    bool sent = false;
+
+    for (uint32_t w = 0; w < FEEDBACK_DIRTY_WORDS(MAX_INSTANCES); w++)
     {
-        /* Copy the input buffers audio */
-        for (i = 0; i < effect->input_audio_ports_count; i++)
-        {
-            buffer_in = jack_port_get_buffer(effect->input_audio_ports[i]->jack_port, nframes);
-            memcpy(effect->input_audio_ports[i]->buffer, buffer_in, (sizeof(float) * nframes));
-        }
+        uint32_t effects_bits = __atomic_exchange_n(&g_feedback_dirty_effects[w], 0, __ATOMIC_ACQUIRE);
 
-        /* Copy the input buffers cv */
-        for (i = 0; i < effect->input_cv_ports_count; i++)
+        while (effects_bits != 0)
         {
-            buffer_in = jack_port_get_buffer(effect->input_cv_ports[i]->jack_port, nframes);
-            memcpy(effect->input_cv_ports[i]->buffer, buffer_in, (sizeof(float) * nframes));
-        }
+            const int effect_id = (int)(w * 32 + __builtin_ctz(effects_bits));
+            effects_bits &= effects_bits - 1;
 
-        /* Run the effect */
-        lilv_instance_run(effect->lilv_instance, nframes);
+            effect_t *effect = &g_effects[effect_id];
 
-        /* Notify the plugin the run() cycle is finished */
-        if (effect->worker.iface)
-        {
-            /* Process any replies from the worker. */
-            worker_emit_responses(&effect->worker);
-            if (effect->worker.iface->end_run)
+            if (effect->feedback_dirty == NULL)
+                continue;
+
+            const uint32_t slots_count = effect->feedback_slots_count;
+            const uint32_t words_count = FEEDBACK_DIRTY_WORDS(slots_count);
+
+            for (int kind = 0; kind < FEEDBACK_SLOT_KINDS; kind++)
             {
-                effect->worker.iface->end_run(effect->lilv_instance->lv2_handle);
-            }
-        }
+                uint32_t *const dirty = effect->feedback_dirty + kind * words_count;
 
-        /* Copy the output buffers audio */
-        for (i = 0; i < effect->output_audio_ports_count; i++)
-        {
-            buffer_out = jack_port_get_buffer(effect->output_audio_ports[i]->jack_port, nframes);
-            memcpy(buffer_out, effect->output_audio_ports[i]->buffer, (sizeof(float) * nframes));
-        }
+                for (uint32_t sw = 0; sw < words_count; sw++)
+                {
+                    uint32_t slots_bits = __atomic_exchange_n(&dirty[sw], 0, __ATOMIC_ACQUIRE);
 
-        /* Copy the output buffers cv */
-        for (i = 0; i < effect->output_cv_ports_count; i++)
-        {
-            buffer_out = jack_port_get_buffer(effect->output_cv_ports[i]->jack_port, nframes);
-            memcpy(buffer_out, effect->output_cv_ports[i]->buffer, (sizeof(float) * nframes));
-        }
+                    // still clear the bits of ignored effects, so nothing stale is reported later
+                    if (effect_id == ignored_effect_id)
+                        continue;
 
-        for (i = 0; i < effect->monitors_count; i++)
-        {
-            int port_id = effect->monitors[i]->port_id;
-            value = *(effect->ports[port_id]->buffer);
-            if (monitor_check_condition(effect->monitors[i]->op, effect->monitors[i]->value, value) &&
-                floats_differ_enough(value, effect->monitors[i]->last_notified_value)) {
-                if (monitor_send(effect->instance, effect->ports[port_id]->symbol, value) >= 0)
-                    effect->monitors[i]->last_notified_value = value;
+                    while (slots_bits != 0)
+                    {
+                        const uint32_t slot = sw * 32 + __builtin_ctz(slots_bits);
+                        slots_bits &= slots_bits - 1;
+
+                        float value;
+                        __atomic_load(&effect->feedback_values[kind * slots_count + slot], &value, __ATOMIC_RELAXED);
+
+                        if (formats & SOCKET_FEEDBACK_BINARY)
+                        {
+                            BinaryFeedbackValue(binary_types[kind], commands[kind], effect_id,
+                                                FeedbackSlotPort(effect, slot)->symbol, value);
+                        }
+                        if (formats & SOCKET_FEEDBACK_TEXT)
+                        {
+                            snprintf(buf, buf_size, "%s %i %s %f", commands[kind], effect_id,
+                                     FeedbackSlotPort(effect, slot)->symbol, value);
+                            socket_send_feedback_text(buf);
+                        }
+                        sent = true;
+                    }
+                }
             }
         }
     }
 
-    /* MIDI out events */
-    for (i = 0; i < effect->output_event_ports_count; i++)
-    {
-        port = effect->output_event_ports[i];
-
-        if (port->flow == FLOW_OUTPUT && port->type == TYPE_EVENT)
-        {
-            void *buf = port->jack_port ? jack_port_get_buffer(port->jack_port, nframes) : NULL;
-
-            if (buf != NULL)
-                jack_midi_clear_buffer(buf);
-
-            if (effect->bypass > 0.5f && effect->enabled_index < 0)
-            {
-                // effect is now bypassed, but wasn't before
-                if (buf != NULL)
-                {
-                    if (!effect->was_bypassed)
-                    {
-                        jack_midi_data_t bufNotesOff[3] = {
-                            0xB0, // CC
-                            0x7B, // all-notes-off
-                            0
-                        };
-
-                        int j=0;
-
-                        do {
-                            if (jack_midi_event_write(buf, 0, bufNotesOff, 3) != 0)
-                                break;
-                            bufNotesOff[0] += 1;
-                        } while (++j < 16);
-                    }
+    return sent;
+}
 
-                    if (effect->input_audio_ports_count == 0 &&
-                        effect->output_audio_ports_count == 0 &&
-                        effect->input_event_ports_count == effect->output_event_ports_count)
-                    {
-                        void* bufIn = jack_port_get_buffer(effect->input_event_ports[i]->jack_port, nframes);
-                        jack_midi_event_t ev;
+static void LogMessageSend(LogType type, const char *msg, char *buf, size_t buf_size)
+{
+    switch (type)
+    {
+    case LOG_ERROR:
+        fprintf(stderr, "\x1b[31m%s\x1b[0m\n", msg);
+        fflush(stderr);
+        break;
+    case LOG_WARNING:
+        fputs(msg, stderr);
+        fflush(stderr);
+        break;
+    case LOG_NOTE:
+        fputs(msg, stdout);
+        fflush(stdout);
+        break;
+    case LOG_TRACE:
+        if (g_verbose_debug) {
+            fprintf(stdout, "\x1b[30;1m%s\x1b[0m\n", msg);
+            fflush(stdout);
+        }
+        break;
+    }
 
-                        for (i = 0; i < jack_midi_get_event_count(bufIn); ++i)
-                        {
-                            if (jack_midi_event_get(&ev, bufIn, i) == 0)
-                            {
-                                if (jack_midi_event_write(buf, ev.time, ev.buffer, ev.size) != 0)
-                                    break;
-                            }
-                        }
-                    }
-                }
-            }
-            else
-            {
-                LV2_Evbuf_Iterator it;
-                bool can_write_midi = true;
+    snprintf(buf, buf_size, "log %d %s", type, msg);
+    socket_send_feedback_debug(buf);
+}
 
-                for (it = lv2_evbuf_begin(port->evbuf); lv2_evbuf_is_valid(it); it = lv2_evbuf_next(it))
-                {
-                    uint32_t frames, subframes, type, size;
-                    uint8_t* body;
+// writes out queued plugin log messages, and once per second refills the budgets of plugins that used them
+static bool RunLogMessages(char *buf, size_t buf_size)
+{
+    bool sent = false;
 
-                    if (! lv2_evbuf_get(it, &frames, &subframes, &type, &size, &body))
-                        continue;
+    for (log_ring_slot_t *slot; (slot = LogRingFront()) != NULL;)
+    {
+        LogMessageSend(slot->type, slot->msg, buf, buf_size);
+        LogRingPop(slot);
+        sent = true;
+    }
 
-                    if (buf != NULL && type == g_urids.midi_MidiEvent)
-                    {
-                        if (can_write_midi && jack_midi_event_write(buf, frames, body, size) == ENOBUFS)
-                            can_write_midi = false;
-                    }
-                    else if (effect->events_out_buffer && type == g_urids.atom_Object)
-                    {
-                        const LV2_Atom_Object_Body *objbody = (const LV2_Atom_Object_Body*)body;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-                        if (objbody->otype == g_urids.patch_Set)
-                        {
-                            const LV2_Atom_Int  *sequence = NULL;
-                            const LV2_Atom_URID *property = NULL;
-                            const LV2_Atom      *lv2value = NULL;
+    if (ts.tv_sec == g_log_refill_time)
+        return sent;
 
-                            lv2_atom_object_body_get(size, objbody,
-                                                     g_urids.patch_sequence, (const LV2_Atom**)&sequence,
-                                                     g_urids.patch_property, (const LV2_Atom**)&property,
-                                                     g_urids.patch_value,    &lv2value,
-                                                     0);
+    g_log_refill_time = ts.tv_sec;
+    g_log_suppressed_pending = false;
 
-                            if (sequence != NULL && sequence->body == MAGIC_PARAMETER_SEQ_NUMBER)
-                                continue;
+    char msg[64];
 
-                            if (jack_ringbuffer_write_space(effect->events_out_buffer) < sizeof(uint32_t) + sizeof(LV2_Atom) + lv2value->size)
-                                continue;
+    for (uint32_t w = 0; w < FEEDBACK_DIRTY_WORDS(MAX_INSTANCES); w++)
+    {
+        uint32_t effects_bits = __atomic_exchange_n(&g_log_active_effects[w], 0, __ATOMIC_ACQUIRE);
 
-                            jack_ringbuffer_write(effect->events_out_buffer, (const char*)&property->body, sizeof(uint32_t));
-                            jack_ringbuffer_write(effect->events_out_buffer, (const char*)lv2value, lv2_atom_total_size(lv2value));
+        while (effects_bits != 0)
+        {
+            const int effect_id = (int)(w * 32 + __builtin_ctz(effects_bits));
+            effects_bits &= effects_bits - 1;
 
-                            postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+            effect_t *effect = &g_effects[effect_id];
 
-                            if (posteventptr == NULL)
-                                continue;
+            __atomic_store_n(&effect->log_budget, LOG_RATE_LIMIT, __ATOMIC_RELAXED);
 
-                            posteventptr->event.type = POSTPONED_PROCESS_OUTPUT_BUFFER;
-                            posteventptr->event.process_out_buf.effect_id = effect->instance;
+            const uint32_t suppressed = __atomic_exchange_n(&effect->log_suppressed, 0, __ATOMIC_RELAXED);
 
-                            pthread_mutex_lock(&g_rtsafe_mutex);
-                            list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-                            pthread_mutex_unlock(&g_rtsafe_mutex);
+            if (suppressed == 0)
+                continue;
 
-                            needs_post = true;
-                        }
-                    }
-                }
-            }
+            snprintf(msg, sizeof(msg), "instance %d: suppressed %u log messages\n", effect_id, suppressed);
+            LogMessageSend(LOG_WARNING, msg, buf, buf_size);
+            sent = true;
         }
     }
 
-    if (effect->hints & HINT_TRIGGERS)
-    {
-        for (i = 0; i < effect->input_control_ports_count; i++)
-        {
-            port = effect->input_control_ports[i];
+    return sent;
+}
 
-            if ((port->hints & HINT_TRIGGER) && floats_differ_enough(port->prev_value, port->def_value))
-                port->prev_value = *(port->buffer) = port->def_value;
-        }
+static void RunPostPonedEvents(int ignored_effect_id)
+{
+    if (g_verbose_debug) {
+        puts("DEBUG: RunPostPonedEvents() START");
+        fflush(stdout);
     }
 
-    if (effect->hints & HINT_OUTPUT_MONITORS)
-    {
-        for (i = 0; i < effect->output_control_ports_count; i++)
-        {
-            port = effect->output_control_ports[i];
-
-            if ((port->hints & HINT_MONITORED) == 0)
-                continue;
-
-            value = *(port->buffer);
+    // local queue to where we'll save rtsafe list
+    struct list_head queue;
+    INIT_LIST_HEAD(&queue);
 
-            if (! floats_differ_enough(port->prev_value, value))
-                continue;
+    // move rtsafe list to our local queue, and clear it
+    RtSafeQueueDrain(&queue);
 
-            postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+    // give the audio threads more room before they run out
+    rtsafe_memory_pool_grow_if_needed(g_rtsafe_mem_pool);
 
-            if (posteventptr == NULL)
-                continue;
+    // fetch this value only once per run
+    const bool cpu_load_trigger = g_jack_global_client != NULL && g_cpu_load_trigger;
+    const bool plugin_load_trigger = g_jack_global_client != NULL && g_plugin_load_trigger;
 
-            port->prev_value = value;
+    if (cpu_load_trigger)
+        g_cpu_load_trigger = false;
+    if (plugin_load_trigger)
+        g_plugin_load_trigger = false;
 
-            posteventptr->event.type = POSTPONED_OUTPUT_MONITOR;
-            posteventptr->event.parameter.effect_id = effect->instance;
-            posteventptr->event.parameter.symbol    = port->symbol;
-            posteventptr->event.parameter.value     = value;
+    const bool feedback_pending = FeedbackSlotsPending();
 
-            pthread_mutex_lock(&g_rtsafe_mutex);
-            list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-            pthread_mutex_unlock(&g_rtsafe_mutex);
+    const enum FeedbackMode feedback_mode = FeedbackModeRequested();
+    const bool log_pending = LogMessagesPending();
 
-            needs_post = true;
+    if (!cpu_load_trigger && !plugin_load_trigger && !feedback_pending && !log_pending && feedback_mode == g_feedback_mode && list_empty(&queue))
+    {
+        // nothing to do
+        if (g_verbose_debug) {
+            puts("DEBUG: RunPostPonedEvents() Queue is empty");
+            fflush(stdout);
         }
+        return;
     }
 
-    effect->was_bypassed = effect->bypass > 0.5f;
-
-    if (effect->hints & HINT_STATE_UNSAFE)
-        pthread_mutex_unlock(&effect->state_restore_mutex);
+    // local buffer
+    #define FEEDBACK_BUF_SIZE (MAX_CHAR_BUF_SIZE * 2)
+    char buf[FEEDBACK_BUF_SIZE+1];
+    buf[FEEDBACK_BUF_SIZE] = '\0';
 
-    if (needs_post)
-        sem_post(&g_postevents_semaphore);
+    // everything below is written out in as few socket writes as possible
+    socket_feedback_begin();
 
-    return 0;
-}
+    // switch feedback format in between runs, so the client sees a clean boundary
+    if (feedback_mode != g_feedback_mode)
+        FeedbackModeSwitch(feedback_mode);
 
-static bool SetPortValue(port_t *port, float value, int effect_id, bool is_bypass, bool from_ui)
-{
-    bool update_transport = false;
+    // clients switching format in the middle of a run get the other one from the next run on
+    const int feedback_formats = FeedbackFormats();
 
-    if (is_bypass)
-    {
-        effect_t *effect = &g_effects[effect_id];
-        if (effect->enabled_index >= 0)
-            *(effect->ports[effect->enabled_index]->buffer) = (value > 0.5f) ? 0.0f : 1.0f;
-    }
-    else if (effect_id == GLOBAL_EFFECT_ID)
-    {
-        if (!strcmp(port->symbol, g_bpb_port_symbol))
-        {
-            g_transport_bpb = value;
-            update_transport = true;
-        }
-        else if (!strcmp(port->symbol, g_bpm_port_symbol))
-        {
-            g_transport_bpm = value;
-            update_transport = true;
-        }
-        else if (!strcmp(port->symbol, g_rolling_port_symbol))
-        {
-            if (value > 0.5f)
-            {
-                jack_transport_start(g_jack_global_client);
-            }
-            else
-            {
-                jack_transport_stop(g_jack_global_client);
-                jack_transport_locate(g_jack_global_client, 0);
-            }
-            g_transport_reset = true;
-            update_transport = true;
-        }
-    }
-    else if (!from_ui)
-    {
-#ifdef WITH_EXTERNAL_UI_SUPPORT
-        port->hints |= HINT_SHOULD_UPDATE;
+#ifdef WITH_FEEDBACK_SHM
+    const uint32_t feedback_shm_head = g_feedback_shm != NULL ? g_feedback_shm->head : 0;
 #endif
-    }
-
-    port->prev_value = *(port->buffer) = value;
-
-    postponed_event_list_data* const posteventptr =
-        rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
 
-    if (posteventptr == NULL)
-        return false;
+    // cached data, to make sure we only handle similar events once
+    bool got_midi_program = false;
+    bool got_transport = false;
+    postponed_cached_effect_events cached_audio_monitor, cached_process_out_buf;
+    postponed_cached_symbol_events cached_param_state;
 
-    posteventptr->event.type = POSTPONED_PARAM_SET;
-    posteventptr->event.parameter.effect_id = effect_id;
-    posteventptr->event.parameter.symbol    = port->symbol;
-    posteventptr->event.parameter.value     = value;
+    cached_audio_monitor.last_effect_id = -1;
+    cached_process_out_buf.last_effect_id = -1;
+    cached_param_state.last_effect_id = -1;
+    cached_param_state.last_symbol[0] = '\0';
+    cached_param_state.last_symbol[MAX_CHAR_BUF_SIZE] = '\0';
+    INIT_LIST_HEAD(&cached_audio_monitor.effects.siblings);
+    INIT_LIST_HEAD(&cached_process_out_buf.effects.siblings);
+    INIT_LIST_HEAD(&cached_param_state.symbols.siblings);
 
-    pthread_mutex_lock(&g_rtsafe_mutex);
-    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-    pthread_mutex_unlock(&g_rtsafe_mutex);
+    // parameter and output values are coalesced in the slot tables, report them first
+    const bool got_feedback_slots = feedback_pending && RunFeedbackSlots(ignored_effect_id, buf, FEEDBACK_BUF_SIZE);
 
-    if (update_transport)
-        return UpdateGlobalJackPosition(UPDATE_POSITION_FORCED, false);
+    // if all we have are jack_midi_connect requests, do not send feedback to server
+    bool got_only_jack_midi_requests = !cpu_load_trigger && !plugin_load_trigger && !got_feedback_slots;
 
-    return true;
-}
+    if (g_verbose_debug) {
+        puts("DEBUG: RunPostPonedEvents() Before the queue iteration");
+        fflush(stdout);
+    }
 
-// FIXME merge most of this with SetPortValue
-static float UpdateValueFromMidi(midi_cc_t* mcc, uint16_t mvalue, bool highres)
-{
-    const uint16_t mvaluediv = highres ? 8192 : 64;
+    // itenerate backwards
+    struct list_head *it, *it2;
+    postponed_event_list_data* eventptr;
 
-    if (!strcmp(mcc->symbol, g_bypass_port_symbol))
+    list_for_each_prev(it, &queue)
     {
-        effect_t *effect = &g_effects[mcc->effect_id];
+        eventptr = list_entry(it, postponed_event_list_data, siblings);
 
-        const bool bypassed = mvalue < mvaluediv;
-        effect->bypass = bypassed ? 1.0f : 0.0f;
+#ifdef DEBUG
+        if (g_verbose_debug) {
+            printf("DEBUG: RunPostPonedEvents() ptr %p type %i\n", eventptr, eventptr->event.type);
+            fflush(stdout);
+        }
+#endif
 
-        if (effect->enabled_index >= 0)
-            *(effect->ports[effect->enabled_index]->buffer) = bypassed ? 0.0f : 1.0f;
+        if (got_only_jack_midi_requests && eventptr->event.type != POSTPONED_JACK_MIDI_CONNECT)
+            got_only_jack_midi_requests = false;
 
-        return bypassed ? 1.0f : 0.0f;
-    }
+        switch (eventptr->event.type)
+        {
+        case POSTPONED_PARAM_STATE:
+            if (eventptr->event.state.effect_id == ignored_effect_id)
+                continue;
+            if (ShouldIgnorePostPonedSymbolEvent(eventptr->event.state.effect_id,
+                                                 eventptr->event.state.symbol,
+                                                 &cached_param_state))
+                continue;
 
-    port_t* port = mcc->port;
-    float value;
+            snprintf(buf, FEEDBACK_BUF_SIZE, "param_state %i %s %i", eventptr->event.state.effect_id,
+                                                                     eventptr->event.state.symbol,
+                                                                     eventptr->event.state.state);
+            socket_send_feedback_debug(buf);
 
-    if (port->hints & HINT_TRIGGER)
-    {
-        // now triggered, always maximum
-        value = port->max_value;
-    }
-    else if (port->hints & HINT_TOGGLE)
-    {
-        // toggle, always min or max
-        value = mvalue >= mvaluediv ? port->max_value : port->min_value;
+            // save for fast checkup next time
+            cached_param_state.last_effect_id = eventptr->event.state.effect_id;
+            strncpy(cached_param_state.last_symbol, eventptr->event.state.symbol, MAX_CHAR_BUF_SIZE);
+            break;
 
-        if (mcc->effect_id == GLOBAL_EFFECT_ID && !strcmp(mcc->symbol, g_rolling_port_symbol))
-        {
-            if (mvalue >= mvaluediv)
-            {
-                jack_transport_start(g_jack_global_client);
-            }
-            else
-            {
-                jack_transport_stop(g_jack_global_client);
-                jack_transport_locate(g_jack_global_client, 0);
-            }
-            g_transport_reset = true;
-        }
-    }
-    else
-    {
-        // get percentage by dividing by max MIDI value
-        value = (float)mvalue;
+        case POSTPONED_AUDIO_MONITOR:
+            if (ShouldIgnorePostPonedEffectEvent(eventptr->event.audio_monitor.index, &cached_audio_monitor))
+                continue;
 
-        if (highres)
-            value /= 16383.0f;
-        else
-            value /= 127.0f;
+            pthread_mutex_lock(&g_audio_monitor_mutex);
+            if (eventptr->event.audio_monitor.index < g_audio_monitor_count)
+                g_audio_monitors[eventptr->event.audio_monitor.index].value = 0.f;
+            pthread_mutex_unlock(&g_audio_monitor_mutex);
 
-        // make sure bounds are correct
-        if (value <= 0.0f)
-        {
-            value = mcc->minimum;
-        }
-        else if (value >= 1.0f)
-        {
-            value = mcc->maximum;
-        }
-        else
-        {
-            if (port->hints & HINT_LOGARITHMIC)
+            if (feedback_formats & SOCKET_FEEDBACK_BINARY)
             {
-                // FIXME: calculate value properly (don't do log on custom scale, use port min/max then adjust)
-                value = mcc->minimum * powf(mcc->maximum/mcc->minimum, value);
+                BinaryFeedbackValue(BINARY_FEEDBACK_AUDIO_MONITOR, "audio_monitor", eventptr->event.audio_monitor.index,
+                                    NULL, eventptr->event.audio_monitor.value);
             }
-            else
+            if (feedback_formats & SOCKET_FEEDBACK_TEXT)
             {
-                value = mcc->minimum + (mcc->maximum - mcc->minimum) * value;
+                snprintf(buf, FEEDBACK_BUF_SIZE, "audio_monitor %i %f", eventptr->event.audio_monitor.index,
+                                                                        eventptr->event.audio_monitor.value);
+                socket_send_feedback_text(buf);
             }
 
-            if (port->hints & HINT_INTEGER)
-                value = rintf(value);
-        }
-
-        if (mcc->effect_id == GLOBAL_EFFECT_ID)
-        {
-            if (!strcmp(mcc->symbol, g_bpb_port_symbol))
-                g_transport_bpb = value;
-            else if (!strcmp(mcc->symbol, g_bpm_port_symbol))
-                g_transport_bpm = value;
-        }
-    }
-
-    // set param value
-    port->prev_value = *(port->buffer) = value;
-    return value;
-}
+            // save for fast checkup next time
+            cached_audio_monitor.last_effect_id = eventptr->event.audio_monitor.index;
+            break;
 
+        case POSTPONED_MIDI_MAP:
+            if (eventptr->event.midi_map.effect_id == ignored_effect_id)
+                continue;
+            snprintf(buf, FEEDBACK_BUF_SIZE, "midi_mapped %i %s %i %i %f %f %f", eventptr->event.midi_map.effect_id,
+                                                                                 eventptr->event.midi_map.symbol,
+                                                                                 eventptr->event.midi_map.channel,
+                                                                                 eventptr->event.midi_map.controller,
+                                                                                 eventptr->event.midi_map.value,
+                                                                                 eventptr->event.midi_map.minimum,
+                                                                                 eventptr->event.midi_map.maximum);
+            socket_send_feedback_debug(buf);
+            break;
 
-static bool UpdateGlobalJackPosition(enum UpdatePositionFlag flag, bool do_post)
-{
-    bool old_rolling;
-    double old_bpb, old_bpm;
+        case POSTPONED_MIDI_CONTROL_CHANGE:
+            snprintf(buf, FEEDBACK_BUF_SIZE, "midi_control_change %i %i %i",
+                     eventptr->event.control_change.channel,
+                     eventptr->event.control_change.control,
+                     eventptr->event.control_change.value);
+            socket_send_feedback_debug(buf);
+            break;
 
-    if (flag != UPDATE_POSITION_SKIP)
-    {
-        old_rolling = g_jack_rolling;
-        old_bpb = g_transport_bpb;
-        old_bpm = g_transport_bpm;
-    }
+        case POSTPONED_MIDI_PROGRAM_CHANGE:
+            if (got_midi_program)
+            {
+                if (g_verbose_debug) {
+                    puts("DEBUG: RunPostPonedEvents() Ignoring old midi program change event");
+                    fflush(stdout);
+                }
+                continue;
+            }
 
-    g_jack_rolling = (jack_transport_query(g_jack_global_client, &g_jack_pos) == JackTransportRolling);
+            snprintf(buf, FEEDBACK_BUF_SIZE, "midi_program_change %i %i",
+                     eventptr->event.program_change.program,
+                     eventptr->event.program_change.channel);
+            socket_send_feedback_debug(buf);
 
-    if ((g_jack_pos.valid & JackPositionBBT) == 0x0)
-    {
-        g_jack_pos.beats_per_bar    = g_transport_bpb;
-        g_jack_pos.beats_per_minute = g_transport_bpm;
-    }
+            // ignore older midi program changes
+            got_midi_program = true;
+            break;
 
-    if (flag == UPDATE_POSITION_SKIP)
-        return false;
-    if (flag == UPDATE_POSITION_IF_CHANGED &&
-        old_rolling == g_jack_rolling &&
-        !doubles_differ_enough(old_bpb, g_transport_bpb) &&
-        !doubles_differ_enough(old_bpm, g_transport_bpm))
-        return false;
+        case POSTPONED_TRANSPORT:
+            if (got_transport)
+                continue;
 
-    postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+            snprintf(buf, FEEDBACK_BUF_SIZE, "transport %i %f %f", eventptr->event.transport.rolling ? 1 : 0,
+                                                                   eventptr->event.transport.bpb,
+                                                                   eventptr->event.transport.bpm);
+            socket_send_feedback_debug(buf);
 
-    if (!posteventptr)
-        return false;
+            // ignore older transport changes
+            got_transport = true;
+            break;
 
-    posteventptr->event.type = POSTPONED_TRANSPORT;
-    posteventptr->event.transport.rolling = g_jack_rolling;
-    posteventptr->event.transport.bpb     = g_transport_bpb;
-    posteventptr->event.transport.bpm     = g_transport_bpm;
+        case POSTPONED_JACK_MIDI_CONNECT:
+            if (g_jack_global_client != NULL) {
+                const jack_port_id_t port_id = eventptr->event.jack_midi_connect.port;
+                const jack_port_t *const port = jack_port_by_id(g_jack_global_client, port_id);
 
-    pthread_mutex_lock(&g_rtsafe_mutex);
-    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-    pthread_mutex_unlock(&g_rtsafe_mutex);
+                if (port != NULL) {
+                    if (g_midi_in_port != NULL)
+                        jack_connect(g_jack_global_client, jack_port_name(port), jack_port_name(g_midi_in_port));
 
-    if (do_post)
-        sem_post(&g_postevents_semaphore);
+                    struct list_head *it3;
+                    pthread_mutex_lock(&g_raw_midi_port_mutex);
+                    list_for_each(it3, &g_raw_midi_port_list)
+                    {
+                        raw_midi_port_item* const portitemptr = list_entry(it3, raw_midi_port_item, siblings);
 
-    return true;
-}
+                        jack_connect(g_jack_global_client,
+                                      jack_port_name(port),
+                                      jack_port_name(portitemptr->jack_port));
+                    }
+                    pthread_mutex_unlock(&g_raw_midi_port_mutex);
+                }
+            }
+            break;
 
-static int ProcessGlobalClient(jack_nframes_t nframes, void *arg)
-{
-    jack_midi_event_t event;
-    uint8_t channel, controller;
-    uint8_t status_nibble;
-    uint16_t mvalue;
-    float value;
-    double dvalue;
-    bool handled, highres, needs_post = false;
-    enum UpdatePositionFlag pos_flag = UPDATE_POSITION_IF_CHANGED;
+        case POSTPONED_PROCESS_OUTPUT_BUFFER:
+            if (eventptr->event.process_out_buf.effect_id == ignored_effect_id)
+                continue;
+            if (ShouldIgnorePostPonedEffectEvent(eventptr->event.process_out_buf.effect_id, &cached_process_out_buf))
+                continue;
 
-#ifdef HAVE_HYLIA
-    if (g_transport_sync_mode == TRANSPORT_SYNC_ABLETON_LINK)
-    {
-        hylia_process(g_hylia_instance, nframes, &g_hylia_timeinfo);
+            if (INSTANCE_IS_VALID(eventptr->event.process_out_buf.effect_id))
+            {
+                effect_t *effect = &g_effects[eventptr->event.process_out_buf.effect_id];
+                const size_t space = jack_ringbuffer_read_space(effect->events_out_buffer);
 
-        // check for updated beats per bar
-        dvalue = g_hylia_timeinfo.beatsPerBar;
+                uint32_t key;
+                LV2_Atom atom;
+                bool supported;
 
-        if (dvalue > 0.0 && doubles_differ_enough(g_transport_bpb, dvalue))
-        {
-            g_transport_bpb = dvalue;
-            pos_flag = UPDATE_POSITION_FORCED;
-        }
+                for (size_t j = 0; j < space; j += sizeof(uint32_t) + sizeof(LV2_Atom) + atom.size)
+                {
+                    jack_ringbuffer_read(effect->events_out_buffer, (char*)&key, sizeof(uint32_t));
+                    jack_ringbuffer_read(effect->events_out_buffer, (char*)&atom, sizeof(LV2_Atom));
 
-        // check for updated beats per minute
-        dvalue = g_hylia_timeinfo.beatsPerMinute;
+                    char *body = mod_calloc(1, atom.size);
+                    jack_ringbuffer_read(effect->events_out_buffer, body, atom.size);
 
-        if (dvalue > 0.0 && doubles_differ_enough(g_transport_bpm, dvalue))
-        {
-            g_transport_bpm = dvalue;
-            pos_flag = UPDATE_POSITION_FORCED;
-        }
-    }
-#endif
+                    if (feedback_formats & SOCKET_FEEDBACK_BINARY)
+                        BinaryFeedbackPatchSet(effect->instance, id_to_urid(g_symap, key), &atom, body);
 
-    // Handle input MIDI events
-    void *const port_buf = jack_port_get_buffer(g_midi_in_port, nframes);
-    const jack_nframes_t event_count = jack_midi_get_event_count(port_buf);
+                    if (! (feedback_formats & SOCKET_FEEDBACK_TEXT))
+                    {
+                        free(body);
+                        continue;
+                    }
 
-    for (jack_nframes_t i = 0 ; i < event_count; i++)
-    {
-        if (jack_midi_event_get(&event, port_buf, i) != 0)
-            break;
-
-        // Handle MIDI Beat Clock
-        if (g_transport_sync_mode == TRANSPORT_SYNC_MIDI)
-        {
-            switch (event.buffer[0])
-            {
-            case 0xF8: { // Clock tick
-                // Calculate the timestamp difference to the previous MBC event
-                const uint64_t current = g_monotonic_frame_count + event.time;
-
-                if (g_previous_midi_event_time != 0)
-                {
-                    const uint64_t delta = current - g_previous_midi_event_time;
+                    supported = true;
+                    int wrtn = snprintf(buf, FEEDBACK_BUF_SIZE, "patch_set %i %s ", effect->instance,
+                                                                                    id_to_urid(g_symap, key));
+                    if (atom.type == g_urids.atom_Bool)
+                    {
+                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "b %i", *(int32_t*)body != 0 ? 1 : 0);
+                    }
+                    else if (atom.type == g_urids.atom_Int)
+                    {
+                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "i %i", *(int32_t*)body);
+                    }
+                    else if (atom.type == g_urids.atom_Long)
+                    {
+                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "l %" PRId64, *(int64_t*)body);
+                    }
+                    else if (atom.type == g_urids.atom_Float)
+                    {
+                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "f %f", *(float*)body);
+                    }
+                    else if (atom.type == g_urids.atom_Double)
+                    {
+                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "g %f", *(double*)body);
+                    }
+                    else if (atom.type == g_urids.atom_String)
+                    {
+                        if (atom.size + 2 > FEEDBACK_BUF_SIZE - (uint)wrtn)
+                        {
+                            char* rbuf = malloc(wrtn + atom.size + 3);
+                            strcpy(rbuf, buf);
+                            strcpy(rbuf + wrtn, "s ");
+                            strncpy(rbuf + (wrtn + 2), body, atom.size);
+                            rbuf[wrtn + atom.size + 2] = '\0';
 
-                    if (delta < g_max_allowed_midi_delta)
+                            supported = false;
+                            socket_send_feedback_text(rbuf);
+                            free(rbuf);
+                        }
+                        else
+                        {
+                            snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "s %s", body);
+                        }
+                    }
+                    else if (atom.type == g_urids.atom_Path)
                     {
-                        const double filtered_delta = beat_clock_tick_filter(delta);
+                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "p %s", body);
+                    }
+                    else if (atom.type == g_urids.atom_URI)
+                    {
+                        snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "u %s", body);
+                    }
+                    else if (atom.type == g_urids.atom_Vector)
+                    {
+                        LV2_Atom_Vector_Body *vbody = (LV2_Atom_Vector_Body*)body;
+                        uint32_t n_elems = (atom.size - sizeof(LV2_Atom_Vector_Body)) / vbody->child_size;
 
-                        // rounded to 2 decimal points
-                        dvalue = rint(beats_per_minute(filtered_delta, g_sample_rate) * 100.0) / 100.0;
+                        wrtn += snprintf(buf + wrtn, FEEDBACK_BUF_SIZE - wrtn, "v %u-", n_elems);
 
-                        if (dvalue > 0.0 && doubles_differ_enough(g_transport_bpm, dvalue))
+                        char* rbuf;
+                        if (n_elems <= 8)
                         {
-                            // set a sane low limit
-                            if (dvalue <= 20.0)
-                                g_transport_bpm = 20;
-                            // >300 BPM over MIDI is unreasonable
-                            else if (dvalue >= 300.0)
-                                g_transport_bpm = 300.0;
-                            // we are good!
-                            else
-                                g_transport_bpm = dvalue;
+                            rbuf = buf;
+                        }
+                        else
+                        {
+                            rbuf = malloc(wrtn + (n_elems * 16 + 1) + 3);
+                            strcpy(rbuf, buf);
+                        }
 
-                            pos_flag = UPDATE_POSITION_FORCED;
+                        /**/ if (vbody->child_type == g_urids.atom_Bool)
+                        {
+                            rbuf[wrtn++] = 'b';
+                            rbuf[wrtn++] = '-';
+                            int32_t *vcontent = (int32_t*)(vbody + 1);
+                            for (uint32_t v = 0; v < n_elems; ++v)
+                                wrtn += snprintf(rbuf + wrtn, 16, "%i:", *(vcontent + v) != 0 ? 1 : 0);
+                        }
+                        else if (vbody->child_type == g_urids.atom_Int)
+                        {
+                            rbuf[wrtn++] = 'i';
+                            rbuf[wrtn++] = '-';
+                            int32_t *vcontent = (int32_t*)(vbody + 1);
+                            for (uint32_t v = 0; v < n_elems; ++v)
+                                wrtn += snprintf(rbuf + wrtn, 16, "%i:", *(vcontent + v));
+                        }
+                        else if (vbody->child_type == g_urids.atom_Long)
+                        {
+                            rbuf[wrtn++] = 'l';
+                            rbuf[wrtn++] = '-';
+                            int64_t *vcontent = (int64_t*)(vbody + 1);
+                            for (uint32_t v = 0; v < n_elems; ++v)
+                                wrtn += snprintf(rbuf + wrtn, 16, "%" PRIi64 ":", *(vcontent + v));
+                        }
+                        else if (vbody->child_type == g_urids.atom_Float)
+                        {
+                            rbuf[wrtn++] = 'f';
+                            rbuf[wrtn++] = '-';
+                            float *vcontent = (float*)(vbody + 1);
+                            for (uint32_t v = 0; v < n_elems; ++v)
+                                wrtn += snprintf(rbuf + wrtn, 16, "%f:", *(vcontent + v));
+                        }
+                        else if (vbody->child_type == g_urids.atom_Double)
+                        {
+                            rbuf[wrtn++] = 'g';
+                            rbuf[wrtn++] = '-';
+                            double *vcontent = (double*)(vbody + 1);
+                            for (uint32_t v = 0; v < n_elems; ++v)
+                                wrtn += snprintf(rbuf + wrtn, 16, "%f:", *(vcontent + v));
+                        }
+                        else
+                        {
+                            supported = false;
                         }
-                    } else {
-                        reset_filter();
-                    }
-                } else {
-                    reset_filter();
-                }
 
-                g_previous_midi_event_time = current;
-                break;
-            }
+                        rbuf[wrtn-1] = '\0';
 
-            case 0xFA: // Start
-            case 0xFB: // Continue
-                g_previous_midi_event_time = 0;
-                jack_transport_start(g_jack_global_client);
-                break;
+                        if (rbuf != buf)
+                        {
+                            supported = false;
+                            socket_send_feedback_text(rbuf);
+                            free(rbuf);
+                        }
+                    }
+                    /*
+                    else if (atom.type == g_urids.atom_Tuple)
+                    {
+                        // LV2_Atom_Tuple *tuple = (LV2_Atom_Tuple*)body;
+                        // TODO
+                    }
+                    */
+                    else
+                    {
+                        supported = false;
+                    }
 
-            case 0xFC: // Stop
-                jack_transport_stop(g_jack_global_client);
-                jack_transport_locate(g_jack_global_client, 0);
-                break;
+                    if (supported)
+                        socket_send_feedback_text(buf);
 
-            default:
-                // TODO: Handle MIDI Song Position Pointer
-                break;
+                    free(body);
+                }
             }
+
+            // save for fast checkup next time
+            cached_process_out_buf.last_effect_id = eventptr->event.process_out_buf.effect_id;
+            break;
+
         }
+    }
 
-        status_nibble = event.buffer[0] & 0xF0;
+    if (cpu_load_trigger)
+    {
+        snprintf(buf, FEEDBACK_BUF_SIZE, "cpu_load %f %f %d", jack_cpu_load(g_jack_global_client),
+                                                             #ifdef HAVE_JACK2_1_9_23
+                                                              jack_max_cpu_load(g_jack_global_client),
+                                                             #else
+                                                              0.f,
+                                                             #endif
+                                                              g_jack_xruns);
+        socket_send_feedback_debug(buf);
+    }
 
-        // Handle MIDI program change
-        if (status_nibble == 0xC0)
+    if (plugin_load_trigger)
+    {
+        for (int i = 0; i < MAX_PLUGIN_INSTANCES; i++)
         {
-            channel = (event.buffer[0] & 0x0F);
+            if (!InstanceExist(i))
+                continue;
 
-            if (g_monitored_midi_programs[channel] && event.size == 2)
-            {
-#ifdef _DARKGLASS_PABLITO
-                if (event.buffer[1] == 0 || event.buffer[1] == 127)
-                    continue;
-#endif
-                // Append to the queue
-                postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+            snprintf(buf, FEEDBACK_BUF_SIZE, "plugin_load %i %f %f", i, g_effects[i].load_average,
+                                                                        g_effects[i].load_maximum);
+            socket_send_feedback_debug(buf);
+        }
+    }
 
-                  if (posteventptr)
-                  {
-                      posteventptr->event.type = POSTPONED_MIDI_PROGRAM_CHANGE;
-                      posteventptr->event.program_change.program = event.buffer[1];
-                      posteventptr->event.program_change.channel = channel;
+    if (g_verbose_debug) {
+        puts("DEBUG: RunPostPonedEvents() After the queue iteration");
+        fflush(stdout);
+    }
 
-                      pthread_mutex_lock(&g_rtsafe_mutex);
-                      list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-                      pthread_mutex_unlock(&g_rtsafe_mutex);
+    // cleanup memory
+    postponed_cached_effect_list_data *peffect;
+    postponed_cached_symbol_list_data *psymbol;
 
-                      needs_post = true;
-                }
-            }
-            else
-            {
-                // Wrong channel or size. Discard.
-                continue;
-            }
-        } // endif MIDI program change
+    list_for_each_safe(it, it2, &cached_audio_monitor.effects.siblings)
+    {
+        peffect = list_entry(it, postponed_cached_effect_list_data, siblings);
+        free(peffect);
+    }
+    list_for_each_safe(it, it2, &cached_process_out_buf.effects.siblings)
+    {
+        peffect = list_entry(it, postponed_cached_effect_list_data, siblings);
+        free(peffect);
+    }
+    list_for_each_safe(it, it2, &cached_param_state.symbols.siblings)
+    {
+        psymbol = list_entry(it, postponed_cached_symbol_list_data, siblings);
+        free(psymbol);
+    }
 
-        if (event.size != 3)
-            continue;
+    // cleanup memory of rt queue, safely
+    list_for_each_safe(it, it2, &queue)
+    {
+        eventptr = list_entry(it, postponed_event_list_data, siblings);
+        rtsafe_memory_pool_deallocate(g_rtsafe_mem_pool, eventptr);
+    }
 
-        // check if it's a CC or Pitchbend event
-        if (status_nibble == 0xB0)
-        {
-            controller = event.buffer[1];
-            mvalue     = event.buffer[2];
-            highres    = false;
-#ifdef _DARKGLASS_PABLITO
-            channel    = (event.buffer[0] & 0x0F);
-            switch (controller)
-            {
-            // these can be assigned to parameters, handle them first
-            case 17 ... 32:
-            case 89:
-                if (! g_monitored_midi_programs[channel])
-                    continue;
+    // plugin log messages are written after everything else
+    if (log_pending && RunLogMessages(buf, FEEDBACK_BUF_SIZE))
+        got_only_jack_midi_requests = false;
 
-                for (int j = 0; j < MAX_MIDI_CC_ASSIGN; j++)
-                {
-                    if (g_midi_cc_list[j].effect_id == ASSIGNMENT_NULL)
-                        break;
-                    if (g_midi_cc_list[j].effect_id == ASSIGNMENT_UNUSED)
-                        continue;
+    if (g_postevents_ready && !got_only_jack_midi_requests)
+    {
+        // report data finished to server
+        g_postevents_ready = false;
 
-                    if (g_midi_cc_list[j].controller == controller)
-                    {
-                        handled = true;
-                        value = UpdateValueFromMidi(&g_midi_cc_list[j], mvalue, highres);
+        if (feedback_formats & SOCKET_FEEDBACK_BINARY)
+            BinaryFeedbackEvent(BINARY_FEEDBACK_DATA_FINISH, "data_finish");
+        if (feedback_formats & SOCKET_FEEDBACK_TEXT)
+            socket_send_feedback_text("data_finish");
+    }
 
-                        postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+    socket_feedback_flush();
 
-                        if (posteventptr)
-                        {
-                            posteventptr->event.type = POSTPONED_PARAM_SET;
-                            posteventptr->event.parameter.effect_id = g_midi_cc_list[j].effect_id;
-                            posteventptr->event.parameter.symbol    = g_midi_cc_list[j].symbol;
-                            posteventptr->event.parameter.value     = value;
+#ifdef WITH_FEEDBACK_SHM
+    // wake up the reader once per run
+    if (g_feedback_shm != NULL && g_feedback_shm->head != feedback_shm_head)
+        sem_post(&g_feedback_shm->sem);
+#endif
 
-                            pthread_mutex_lock(&g_rtsafe_mutex);
-                            list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-                            pthread_mutex_unlock(&g_rtsafe_mutex);
+    if (g_verbose_debug) {
+        puts("DEBUG: RunPostPonedEvents() END");
+        fflush(stdout);
+    }
+}
 
-                            needs_post = true;
-                        }
+static void* PostPonedEventsThread(void* arg)
+{
+#if defined(_MOD_DEVICE_RK358x)
+    setpriority(PRIO_PROCESS, gettid(), -18);
+#elif defined(_MOD_DEVICE_DUO) || defined(_MOD_DEVICE_DUOX) || defined(_MOD_DEVICE_DWARF)
+    const pid_t tid = syscall(SYS_gettid);
+    if (tid > 0)
+        setpriority(PRIO_PROCESS, tid, -18);
+#endif
 
-                        break;
-                    }
-                }
+    while (g_postevents_running == 1)
+    {
+        // also wake up once per second while plugin log messages are being suppressed, to report them
+        if (sem_timedwait_secs(&g_postevents_semaphore, 1) != 0 && !g_log_suppressed_pending)
+            continue;
 
-                if (needs_post)
-                    continue;
+        if (g_postevents_running == 1 && g_postevents_ready)
+        {
+            RunPostPonedEvents(-3); // as all effects are valid we set ignored_effect_id to -3
+            if (g_verbose_debug) {
+                printf("DEBUG: PostPonedEventsThread() looping (code %d)\n", g_postevents_running);
+                fflush(stdout);
+            }
+        }
+    }
 
-            // fall-through
-            // if the special parameter CCs are not handled, report up as regular MIDI CC
-            case 0:
-            case 7:
-            case 14 ... 16:
-            case 85 ... 87:
-            case 102 ... 119:
-                if (g_monitored_midi_programs[channel])
-                {
-                    postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+    if (g_verbose_debug) {
+        printf("DEBUG: PostPonedEventsThread() stopping (code %d)\n", g_postevents_running);
+        fflush(stdout);
+    }
 
-                    if (posteventptr)
-                    {
-                        posteventptr->event.type = POSTPONED_MIDI_CONTROL_CHANGE;
-                        posteventptr->event.control_change.channel = channel;
-                        posteventptr->event.control_change.control = controller;
-                        posteventptr->event.control_change.value = mvalue;
+    return NULL;
 
-                        pthread_mutex_lock(&g_rtsafe_mutex);
-                        list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-                        pthread_mutex_unlock(&g_rtsafe_mutex);
+    UNUSED_PARAM(arg);
+}
 
-                        needs_post = true;
-                    }
-                }
-                continue;
-            }
-#else
-        }
-        else if (status_nibble == 0xE0)
-        {
-            controller = MIDI_PITCHBEND_AS_CC;
-            mvalue     = (event.buffer[2] << 7) | event.buffer[1];
-            highres    = true;
-#endif
-        }
-        else
-        {
+#ifdef MOD_HMI_CONTROL_ENABLED
+static void* HMIClientThread(void* arg)
+{
+    sys_serial_shm_data_channel* const data = (sys_serial_shm_data_channel*)arg;
+
+    sys_serial_event_type etype;
+    char msg[SYS_SERIAL_SHM_DATA_SIZE];
+
+    while (g_hmi_data != NULL && &g_hmi_data->client == data)
+    {
+        if (sem_timedwait_secs(&data->sem, 1) != 0)
             continue;
-        }
 
-        handled = false;
-        channel = (event.buffer[0] & 0x0F);
+        if (g_hmi_data == NULL || &g_hmi_data->client != data)
+            break;
 
-        for (int j = 0; j < MAX_MIDI_CC_ASSIGN; j++)
+        while (data->head != data->tail)
         {
-            if (g_midi_cc_list[j].effect_id == ASSIGNMENT_NULL)
-                break;
-            if (g_midi_cc_list[j].effect_id == ASSIGNMENT_UNUSED)
+            if (! sys_serial_read(data, &etype, msg))
                 continue;
 
-#ifdef _DARKGLASS_PABLITO
-            if (! g_monitored_midi_programs[channel])
-                continue;
-#else
-            if (g_midi_cc_list[j].channel != channel)
-                continue;
-#endif
+            if (g_verbose_debug) {
+                printf("DEBUG: HMIClientThread received event %x (%c)\n", etype, etype-0x80);
+                fflush(stdout);
+            }
 
-            // TODO: avoid race condition against effects_midi_unmap
-            if (g_midi_cc_list[j].controller == controller)
+            switch (etype)
             {
-                handled = true;
-                value = UpdateValueFromMidi(&g_midi_cc_list[j], mvalue, highres);
-
-                postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
-
-                if (posteventptr)
-                {
-                    posteventptr->event.type = POSTPONED_PARAM_SET;
-                    posteventptr->event.parameter.effect_id = g_midi_cc_list[j].effect_id;
-                    posteventptr->event.parameter.symbol    = g_midi_cc_list[j].symbol;
-                    posteventptr->event.parameter.value     = value;
-
-                    pthread_mutex_lock(&g_rtsafe_mutex);
-                    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-                    pthread_mutex_unlock(&g_rtsafe_mutex);
-
-                    needs_post = true;
-                }
-
+            case sys_serial_event_type_compressor_mode:
+                g_compressor_mode = clamp(msg[0] - '0', 0, 4);
+                monitor_client_setup_compressor(g_compressor_mode, g_compressor_release);
+                break;
+            case sys_serial_event_type_compressor_release:
+                g_compressor_release = clampf(atof(msg), 50.0f, 500.0f);
+                monitor_client_setup_compressor(g_compressor_mode, g_compressor_release);
+                break;
+#ifdef MOD_IO_PROCESSING_ENABLED
+            case sys_serial_event_type_noisegate_channel:
+                g_noisegate_channel = clamp(msg[0] - '0', 0, 3);
+                break;
+            case sys_serial_event_type_noisegate_decay:
+                g_noisegate_decay = clampf(atof(msg), 1.0f, 500.0f);
+                gate_update(&g_noisegate, g_sample_rate, 10, 1,
+                            g_noisegate_decay, 1,
+                            g_noisegate_threshold, g_noisegate_threshold - 20);
+                break;
+            case sys_serial_event_type_noisegate_threshold:
+                g_noisegate_threshold = clampf(atof(msg), -70.0f, -10.0f);
+                gate_update(&g_noisegate, g_sample_rate, 10, 1,
+                            g_noisegate_decay, 1,
+                            g_noisegate_threshold, g_noisegate_threshold - 20);
+                break;
+#endif
+            case sys_serial_event_type_pedalboard_gain:
+                monitor_client_setup_volume(clampf(atof(msg), MOD_MONITOR_VOLUME_MUTE, 20.0f));
+                break;
+            default:
                 break;
             }
         }
+    }
 
-        if (! handled)
-        {
-            int effect_id;
-            const char* symbol;
-            float minimum, maximum;
+    return NULL;
+}
+#endif
 
-            pthread_mutex_lock(&g_midi_learning_mutex);
-            if (g_midi_learning != NULL)
-            {
-                effect_id = g_midi_learning->effect_id;
-                symbol    = g_midi_learning->symbol;
-                minimum   = g_midi_learning->minimum;
-                maximum   = g_midi_learning->maximum;
-                value     = UpdateValueFromMidi(g_midi_learning, mvalue, highres);
-                g_midi_learning->channel    = channel;
-                g_midi_learning->controller = controller;
-                g_midi_learning = NULL;
-            }
-            else
-            {
-                effect_id = -1;
-            }
-            pthread_mutex_unlock(&g_midi_learning_mutex);
+static void PreRunPlugin(effect_t *effect)
+{
+    if (effect->hints & HINT_STATE_UNSAFE)
+        pthread_mutex_lock(&effect->state_restore_mutex);
 
-            if (effect_id != -1)
-            {
-                postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+    /* common variables */
+    port_t *port;
+    unsigned int i;
+    float value;
+    bool needs_post = false;
 
-                if (posteventptr)
-                {
-                    posteventptr->event.type = POSTPONED_MIDI_MAP;
-                    posteventptr->event.midi_map.effect_id  = effect_id;
-                    posteventptr->event.midi_map.symbol     = symbol;
-                    posteventptr->event.midi_map.channel    = channel;
-                    posteventptr->event.midi_map.controller = controller;
-                    posteventptr->event.midi_map.value      = value;
-                    posteventptr->event.midi_map.minimum    = minimum;
-                    posteventptr->event.midi_map.maximum    = maximum;
+    if (effect->hints & HINT_TRANSPORT)
+    {
+        effect->transport_rolling = g_jack_rolling;
+        // effect->transport_frame = pos.frame;
+        effect->transport_bpb = g_transport_bpb;
+        effect->transport_bpm = g_transport_bpm;
+    }
+    if (effect->bpb_index >= 0)
+    {
+        *(effect->ports[effect->bpb_index]->buffer) = g_transport_bpb;
+    }
+    if (effect->bpm_index >= 0)
+    {
+        *(effect->ports[effect->bpm_index]->buffer) = g_transport_bpm;
+    }
+    if (effect->speed_index >= 0)
+    {
+        *(effect->ports[effect->speed_index]->buffer) = g_jack_rolling ? 1.0f : 0.0f;
+    }
 
-                    pthread_mutex_lock(&g_rtsafe_mutex);
-                    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-                    pthread_mutex_unlock(&g_rtsafe_mutex);
+    /* Prepare midi/event ports */
+    for (i = 0; i < effect->input_event_ports_count; i++)
+    {
+        port = effect->input_event_ports[i];
+        lv2_evbuf_reset(port->evbuf, true);
+    }
 
-                    needs_post = true;
-                }
-            }
-            else if (g_monitored_midi_programs[channel])
-            {
-                postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+    for (i = 0; i < effect->output_event_ports_count; i++)
+        lv2_evbuf_reset(effect->output_event_ports[i]->evbuf, false);
 
-                if (posteventptr)
-                {
-                    posteventptr->event.type = POSTPONED_MIDI_CONTROL_CHANGE;
-                    posteventptr->event.control_change.channel = channel;
-                    posteventptr->event.control_change.control = controller;
-                    posteventptr->event.control_change.value = mvalue;
-
-                    pthread_mutex_lock(&g_rtsafe_mutex);
-                    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-                    pthread_mutex_unlock(&g_rtsafe_mutex);
+    /* Bypass */
+    if (effect->bypass > 0.5f && effect->enabled_index < 0)
+    {
+        lilv_instance_run(effect->lilv_instance, 0);
+    }
+    /* Effect process */
+    else
+    {
+        /* Run the effect */
+        lilv_instance_run(effect->lilv_instance, 0);
 
-                    needs_post = true;
-                }
+        /* Notify the plugin the run() cycle is finished */
+        if (effect->worker.iface)
+        {
+            /* Process any replies from the worker. */
+            worker_emit_responses(&effect->worker);
+            if (effect->worker.iface->end_run)
+            {
+                effect->worker.iface->end_run(effect->lilv_instance->lv2_handle);
             }
         }
     }
 
-#ifdef MOD_IO_PROCESSING_ENABLED
-    // Handle audio
-    const float *const audio_in1_buf = (float*)jack_port_get_buffer(g_audio_in1_port, nframes);
-    const float *const audio_in2_buf = (float*)jack_port_get_buffer(g_audio_in2_port, nframes);
-    /* */ float *const audio_out1_buf = (float*)jack_port_get_buffer(g_audio_out1_port, nframes);
-    /* */ float *const audio_out2_buf = (float*)jack_port_get_buffer(g_audio_out2_port, nframes);
-
-    switch (g_noisegate_channel)
+    if (effect->hints & HINT_TRIGGERS)
     {
-    case 0: // no gate
-        if (audio_out1_buf != audio_in1_buf)
-            memcpy(audio_out1_buf, audio_in1_buf, sizeof(float)*nframes);
-        if (audio_out2_buf != audio_in2_buf)
-            memcpy(audio_out2_buf, audio_in2_buf, sizeof(float)*nframes);
-        break;
-    case 1: // left channel only
-        if (audio_out2_buf != audio_in2_buf)
-            memcpy(audio_out2_buf, audio_in2_buf, sizeof(float)*nframes);
-        for (uint32_t i=0; i<nframes; ++i)
-            audio_out1_buf[i] = gate_push_sample_and_apply(&g_noisegate, audio_in1_buf[i]);
-        break;
-    case 2: // right channel only
-        if (audio_out1_buf != audio_in1_buf)
-            memcpy(audio_out1_buf, audio_in1_buf, sizeof(float)*nframes);
-        for (uint32_t i=0; i<nframes; ++i)
-            audio_out2_buf[i] = gate_push_sample_and_apply(&g_noisegate, audio_in2_buf[i]);
-        break;
-    case 3: // left & right channels
-        for (uint32_t i=0; i<nframes; ++i)
+        for (i = 0; i < effect->input_control_ports_count; i++)
         {
-            gate_push_samples_and_run(&g_noisegate, audio_in1_buf[i], audio_in2_buf[i]);
-            audio_out1_buf[i] = gate_apply(&g_noisegate, audio_in1_buf[i]);
-            audio_out2_buf[i] = gate_apply(&g_noisegate, audio_in2_buf[i]);
+            port = effect->input_control_ports[i];
+
+            if ((port->hints & HINT_TRIGGER) && floats_differ_enough(port->prev_value, port->def_value))
+                port->prev_value = *(port->buffer) = port->def_value;
         }
-        break;
     }
-#endif
 
-    // Handle audio monitors
-    if (pthread_mutex_trylock(&g_audio_monitor_mutex) == 0)
+    if (effect->hints & HINT_OUTPUT_MONITORS)
     {
-        float *monitorbuf;
-        float absvalue, oldvalue;
-
-        for (int i = 0; i < g_audio_monitor_count; ++i)
+        for (i = 0; i < effect->output_control_ports_count; i++)
         {
-            monitorbuf = (float*)jack_port_get_buffer(g_audio_monitors[i].port, nframes);
-            oldvalue = value = g_audio_monitors[i].value;
+            port = effect->output_control_ports[i];
 
-            for (jack_nframes_t i = 0 ; i < nframes; i++)
-            {
-                absvalue = fabsf(monitorbuf[i]);
+            if ((port->hints & HINT_MONITORED) == 0)
+                continue;
 
-                if (absvalue > value)
-                    value = absvalue;
-            }
+            value = *(port->buffer);
 
-            if (oldvalue < value)
-            {
-                g_audio_monitors[i].value = value;
+            if (! floats_differ_enough(port->prev_value, value))
+                continue;
 
-                postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+            if (! FeedbackSlotSet(effect, port, FEEDBACK_SLOT_OUTPUT_SET, value))
+                continue;
 
-                if (posteventptr)
-                {
-                    posteventptr->event.type = POSTPONED_AUDIO_MONITOR;
-                    posteventptr->event.audio_monitor.index = i;
-                    posteventptr->event.audio_monitor.value = value;
+            port->prev_value = value;
+            needs_post = true;
+        }
+    }
 
-                    pthread_mutex_lock(&g_rtsafe_mutex);
-                    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-                    pthread_mutex_unlock(&g_rtsafe_mutex);
+    if (effect->hints & HINT_STATE_UNSAFE)
+        pthread_mutex_unlock(&effect->state_restore_mutex);
 
-                    needs_post = true;
-                }
-            }
-        }
+    if (needs_post)
+        sem_post(&g_postevents_semaphore);
+}
 
-        pthread_mutex_unlock(&g_audio_monitor_mutex);
-    }
+static bool IsBufferSilent(const float *buffer, jack_nframes_t nframes)
+{
+    jack_nframes_t i = 0;
 
-    if (UpdateGlobalJackPosition(pos_flag, false))
-        needs_post = true;
+    if (buffer == g_graph_silence)
+        return true;
 
-    if (g_cpu_load_enabled)
+    // branch-free peak over blocks of 16 frames, so that the compiler can vectorize it
+    for (; i + 16 <= nframes; i += 16)
     {
-        const uint32_t cpu_update_rate = g_sample_rate / 2;
-        const uint32_t frame_check = g_monotonic_frame_count % cpu_update_rate;
+        float peak = 0.f;
 
-        if (frame_check + nframes >= cpu_update_rate)
+        for (jack_nframes_t j = i; j < i + 16; j++)
         {
-            g_cpu_load_trigger = true;
-            needs_post = true;
+            const float value = fabsf(buffer[j]);
+            peak = value > peak ? value : peak;
         }
-    }
-
-    if (needs_post)
-        sem_post(&g_postevents_semaphore);
 
-    // Increase by one period
-    g_monotonic_frame_count += nframes;
+        if (peak >= SILENCE_THRESHOLD)
+            return false;
+    }
 
-    return 0;
+    for (; i < nframes; i++)
+    {
+        if (fabsf(buffer[i]) >= SILENCE_THRESHOLD)
+            return false;
+    }
 
-    UNUSED_PARAM(arg);
+    return true;
 }
 
-/**
- * If the transport is rolling and if we are the Jack Timebase Master
- * then this callback acts once per cycle and effects the following
- * cycle.
- *
- * This realtime function must not wait.
- *
- * Read: http://jackaudio.org/files/docs/html/transport-design.html
- */
-static void JackTimebase(jack_transport_state_t state, jack_nframes_t nframes,
-                         jack_position_t *pos, int new_pos, void *arg)
+static bool PluginShouldSleep(effect_t *effect, jack_nframes_t nframes)
 {
-    double tick;
-
-    // Who sets these global variables?
+    uint32_t i;
+    bool silent = true;
 
-    // g_transport_bpb, g_transport_bpm, g_transport_reset are static
-    // volatile and meant to be set from anywhere.
+    if (effect->sleep_tail_frames < 0)
+        return false;
 
-    // g_transport_bpm is only set on lines 1352
-    // (UpdateValueFromMIDI), 1427 (ProcessGlobalClient), 2016 (CCDataUpdate)
-    // and 4451 (effects_transport).
+    // generators have nothing to listen to, they never sleep
+    if (effect->input_audio_ports_count + effect->input_cv_ports_count + effect->input_event_ports_count == 0)
+        return false;
 
-    // Update the extended position information.
-    pos->beats_per_bar = g_transport_bpb;
-    pos->beats_per_minute = g_transport_bpm;
+    __atomic_add_fetch(&effect->sleep_total_cycles, 1, __ATOMIC_RELAXED);
 
-    // Is this a hacky way to express rounding? Better use nearbyint()?
-    const int32_t beats_per_bar_int = (int32_t)(pos->beats_per_bar + 0.5f);
+    // pending messages from the host always wake up the plugin, so this runs before draining them
+    if (effect->events_in_buffer && jack_ringbuffer_read_space(effect->events_in_buffer) != 0)
+        silent = false;
 
-    if (new_pos || g_transport_reset) // Is caching involved? No.
+    for (i = 0; silent && i < effect->input_event_ports_count; i++)
     {
-        // Do we have to set every "constant" data field every time?
-        pos->valid = JackPositionBBT | JackTickDouble;
-        pos->beat_type = 4.0f;
-        pos->ticks_per_beat = TRANSPORT_TICKS_PER_BEAT;
+        port_t *port = effect->input_event_ports[i];
+        if (port->jack_port && jack_midi_get_event_count(jack_port_get_buffer(port->jack_port, nframes)) != 0)
+            silent = false;
+    }
 
-        double abs_beat, abs_tick;
+    for (i = 0; silent && i < effect->input_audio_ports_count; i++)
+        silent = IsBufferSilent(GetAudioPortBuffer(effect->input_audio_ports[i], nframes), nframes);
 
-#ifdef HAVE_HYLIA
-        if (g_transport_sync_mode == TRANSPORT_SYNC_ABLETON_LINK)
+    for (i = 0; silent && i < effect->input_cv_ports_count; i++)
+        silent = IsBufferSilent(GetAudioPortBuffer(effect->input_cv_ports[i], nframes), nframes);
+
+    if (!silent)
+    {
+        if (effect->sleeping)
         {
-            if (g_hylia_timeinfo.beat >= 0.0)
-            {
-                abs_beat = g_hylia_timeinfo.beat;
-                abs_tick = abs_beat * TRANSPORT_TICKS_PER_BEAT;
-            }
-            else
-            {
-                abs_beat = 0.0;
-                abs_tick = 0.0;
-                g_jack_rolling = false;
-            }
+            effect->sleeping = false;
+            __atomic_add_fetch(&effect->sleep_wakeups, 1, __ATOMIC_RELAXED);
         }
-        else
-#endif
-        {
-            /// ????
-            // 1. analyse frame position. 2. calculate ticks. 3. derive values for everything else???
+        effect->silent_frames = 0;
+        return false;
+    }
 
-            // What is min? why 60?
-            const double min = (double)pos->frame / (double)(g_sample_rate * 60);
-            abs_beat = min * pos->beats_per_minute;
-            abs_tick = abs_beat * TRANSPORT_TICKS_PER_BEAT;
-            g_transport_reset = false;
-        }
+    if (!effect->sleeping)
+    {
+        effect->silent_frames += nframes;
 
-        const double bar  = floor(abs_beat / pos->beats_per_bar);
-        const double beat = floor(fmod(abs_beat, pos->beats_per_bar));
+        // the plugin keeps running until its tail has been produced
+        if (effect->silent_frames <= (uint32_t)effect->sleep_tail_frames)
+            return false;
 
-        pos->bar  = (int32_t)(bar) + 1;
-        pos->beat = (int32_t)(beat) + 1;
-        pos->bar_start_tick = ((bar * pos->beats_per_bar) + beat) * TRANSPORT_TICKS_PER_BEAT;
+        effect->sleeping = true;
+    }
 
-        tick = abs_tick - (abs_beat * pos->ticks_per_beat);
+    __atomic_add_fetch(&effect->sleep_cycles, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+static void RunBypassedPlugin(effect_t *effect, jack_nframes_t nframes)
+{
+    // the first bypassed cycle always runs, so all-notes-off events reach the plugin
+    switch (effect->bypass_policy)
+    {
+    case BYPASS_POLICY_RUN_SILENT:
+        break;
+    case BYPASS_POLICY_SKIP:
+        if (effect->was_bypassed)
+            return;
+        break;
+    case BYPASS_POLICY_SKIP_AFTER_TAIL:
+        if (effect->bypass_tail_done)
+            return;
+        break;
     }
-    else // not new_pos nor g_transport_reset
+
+    lilv_instance_run(effect->lilv_instance, nframes);
+
+    if (effect->bypass_policy != BYPASS_POLICY_SKIP_AFTER_TAIL || !effect->was_bypassed)
+        return;
+
+    // plugin runs on its own buffers during bypass, check if its output has decayed
+    for (uint32_t i = 0; i < effect->output_audio_ports_count; i++)
     {
-        // update the current tick with the beat.
-        tick = pos->tick_double +
-              (nframes * TRANSPORT_TICKS_PER_BEAT * pos->beats_per_minute / (double)(g_sample_rate * 60));
+        const float *buffer = effect->output_audio_ports[i]->buffer;
 
-        // why adjust? why can overflow happen?
-        while (tick >= TRANSPORT_TICKS_PER_BEAT)
+        for (jack_nframes_t j = 0; j < nframes; j++)
         {
-            tick -= TRANSPORT_TICKS_PER_BEAT;
-
-            if (++pos->beat > beats_per_bar_int)
-            {
-                pos->beat = 1;
-                pos->bar_start_tick += pos->beats_per_bar * TRANSPORT_TICKS_PER_BEAT;
-                ++pos->bar;
-            }
+            if (fabsf(buffer[j]) >= BYPASS_TAIL_THRESHOLD)
+                return;
         }
     }
 
-    pos->tick = (int32_t)(tick + 0.5);
-    pos->tick_double = tick;
-    return;
+    effect->bypass_tail_done = true;
+}
 
-    UNUSED_PARAM(state);
-    UNUSED_PARAM(arg);
+static void UpdatePluginLoad(effect_t *effect, uint64_t dsp_ns, jack_nframes_t nframes)
+{
+    // upper bounds of each histogram bucket, the last one has no limit
+    static const float histogram_limits[PLUGIN_LOAD_HISTOGRAM_SIZE - 1] = {
+        1.f, 2.f, 5.f, 10.f, 20.f, 50.f, 100.f
+    };
+
+    if (nframes == 0)
+        return;
+
+    const float load = (float)(100.0 * (double)dsp_ns * g_sample_rate / (1e9 * nframes));
+    uint32_t bucket = 0;
+
+    // requested by a reader, which can't safely write these itself
+    if (effect->load_reset)
+    {
+        effect->load_maximum = 0.f;
+        for (uint32_t i = 0; i < PLUGIN_LOAD_HISTOGRAM_SIZE; i++)
+            effect->load_histogram[i] = 0;
+        effect->load_reset = false;
+    }
+
+    effect->load_average += PLUGIN_LOAD_EWMA_ALPHA * (load - effect->load_average);
+
+    if (effect->load_maximum < load)
+        effect->load_maximum = load;
+
+    while (bucket < PLUGIN_LOAD_HISTOGRAM_SIZE - 1 && load >= histogram_limits[bucket])
+        ++bucket;
+
+    ++effect->load_histogram[bucket];
 }
 
-static void JackThreadInit(void* arg)
+static int ProcessPlugin(jack_nframes_t nframes, void *arg)
 {
-/* Disable denormal numbers in floating point calculation.
- * Denormal numbers happen often in IIR filters, and it can be very slow.
- */
-/* Taken from cras/src/dsp/dsp_util.c in Chromium OS code.
- * Copyright (c) 2013 The Chromium OS Authors. */
-#if defined(__i386__) || defined(__x86_64__)
-        unsigned int mxcsr;
-        mxcsr = __builtin_ia32_stmxcsr();
-        __builtin_ia32_ldmxcsr(mxcsr | 0x8040);
-#elif defined(__aarch64__)
-        uint64_t cw;
-        __asm__ __volatile__ (
-                "mrs    %0, fpcr                            \n"
-                "orr    %0, %0, #0x1000000                  \n"
-                "msr    fpcr, %0                            \n"
-                "isb                                        \n"
-                : "=r"(cw) :: "memory");
-#elif defined(__arm__)
-        uint32_t cw;
-        __asm__ __volatile__ (
-                "vmrs   %0, fpscr                           \n"
-                "orr    %0, %0, #0x1000000                  \n"
-                "vmsr   fpscr, %0                           \n"
-                : "=r"(cw) :: "memory");
-#else
-#warning "Don't know how to disable denormals. Performace may suffer."
-#endif
-    return;
+    if (arg == NULL) return 0;
 
-    UNUSED_PARAM(arg);
+    effect_t *effect = arg;
+    const uint64_t start = GetTimeNs();
+    const int ret = ProcessPluginCycle(nframes, effect);
+
+    UpdatePluginLoad(effect, GetTimeNs() - start, nframes);
+    return ret;
 }
 
-static void GetFeatures(effect_t *effect)
+static int ProcessPluginCycle(jack_nframes_t nframes, effect_t *effect)
 {
-    const LV2_Feature **features = (const LV2_Feature**) mod_calloc(FEATURE_TERMINATOR+1, sizeof(LV2_Feature*));
-
-    /* URI and URID Features are the same for all instances (global declaration) */
-
-    /* Options Feature is the same for all instances (global declaration) */
-
-    /* State path features, includes custom pointer */
-    LV2_State_Make_Path *makePath = (LV2_State_Make_Path*) malloc(sizeof(LV2_State_Make_Path));
-    makePath->handle = effect;
-    makePath->path = MakePluginStatePathFromSratchDir;
+    port_t *port;
+    unsigned int i;
 
-    LV2_Feature *state_make_path_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
-    state_make_path_feature->URI = LV2_STATE__makePath;
-    state_make_path_feature->data = makePath;
+    if ((effect->hints & HINT_IS_LIVE) == 0 &&
+        (!g_processing_enabled || (
+         (effect->hints & HINT_STATE_UNSAFE) && pthread_mutex_trylock(&effect->state_restore_mutex) != 0)))
+    {
+        for (i = 0; i < effect->output_audio_ports_count; i++)
+        {
+            memset(GetAudioPortBuffer(effect->output_audio_ports[i], nframes),
+                   0, (sizeof(float) * nframes));
+        }
+        for (i = 0; i < effect->output_cv_ports_count; i++)
+        {
+            memset(GetAudioPortBuffer(effect->output_cv_ports[i], nframes),
+                   0, (sizeof(float) * nframes));
+        }
+        for (i = 0; i < effect->output_event_ports_count; i++)
+        {
+            port = effect->output_event_ports[i];
+            if (port->jack_port && port->flow == FLOW_OUTPUT && port->type == TYPE_EVENT)
+                jack_midi_clear_buffer(jack_port_get_buffer(port->jack_port, nframes));
+        }
+        effect->zero_copy_bytes = 0;
+        return 0;
+    }
 
-    /* ControlInputPort change request feature, includes custom pointer */
-    LV2_ControlInputPort_Change_Request *ctrlportReqChange
-        = (LV2_ControlInputPort_Change_Request*) malloc(sizeof(LV2_ControlInputPort_Change_Request));
-    ctrlportReqChange->handle = effect;
-    ctrlportReqChange->request_change = RequestControlPortChange;
+    /* common variables */
+    bool needs_post = false;
+    const float *buffer_in;
+    float *buffer_out;
+    float value;
 
-    LV2_Feature *ctrlportReqChange_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
-    ctrlportReqChange_feature->URI = LV2_CONTROL_INPUT_PORT_CHANGE_REQUEST_URI;
-    ctrlportReqChange_feature->data = ctrlportReqChange;
+    /* transport */
+    uint8_t stack_buf[MAX_CHAR_BUF_SIZE+1];
+    memset(stack_buf, 0, sizeof(stack_buf));
+    LV2_Atom* lv2_pos = (LV2_Atom*)stack_buf;
 
-    /* Control Port state update feature, includes custom pointer */
-    LV2_Control_Port_State_Update *ctrlportStateUpdate
-        = (LV2_Control_Port_State_Update*) malloc(sizeof(LV2_Control_Port_State_Update));
-    ctrlportStateUpdate->handle = effect;
-    ctrlportStateUpdate->update_state = UpdateControlPortState;
+    if (effect->hints & HINT_TRANSPORT)
+    {
+        jack_position_t pos;
+        const bool rolling = (jack_transport_query(effect->jack_client, &pos) == JackTransportRolling);
 
-    LV2_Feature *ctrlportStateUpdate_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
-    ctrlportStateUpdate_feature->URI = LV2_CONTROL_PORT_STATE_UPDATE_URI;
-    ctrlportStateUpdate_feature->data = ctrlportStateUpdate;
+        if ((pos.valid & JackPositionBBT) == 0)
+        {
+            pos.beats_per_bar    = g_transport_bpb;
+            pos.beats_per_minute = g_transport_bpm;
+        }
 
-    /* Worker Feature, must be last as it can be null */
-    LV2_Feature *work_schedule_feature = NULL;
+        if (effect->transport_rolling != rolling ||
+            effect->transport_frame != pos.frame ||
+            doubles_differ_enough(effect->transport_bpb, pos.beats_per_bar) ||
+            doubles_differ_enough(effect->transport_bpm, pos.beats_per_minute) ||
+            (effect->bypass < 0.5f && effect->was_bypassed))
+        {
+            effect->transport_rolling = rolling;
+            effect->transport_frame = pos.frame;
+            effect->transport_bpb = pos.beats_per_bar;
+            effect->transport_bpm = pos.beats_per_minute;
 
-    if (lilv_plugin_has_extension_data(effect->lilv_plugin, g_lilv_nodes.worker_interface))
-    {
-        LV2_Worker_Schedule *schedule = (LV2_Worker_Schedule*) malloc(sizeof(LV2_Worker_Schedule));
-        schedule->handle = &effect->worker;
-        schedule->schedule_work = worker_schedule;
+            LV2_Atom_Forge forge = g_lv2_atom_forge;
+            lv2_atom_forge_set_buffer(&forge, stack_buf, sizeof(stack_buf));
 
-        work_schedule_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
-        work_schedule_feature->URI = LV2_WORKER__schedule;
-        work_schedule_feature->data = schedule;
-    }
+            LV2_Atom_Forge_Frame frame;
+            lv2_atom_forge_object(&forge, &frame, 0, g_urids.time_Position);
 
-    /* Buf-size Feature is the same for all instances (global declaration) */
+            lv2_atom_forge_key(&forge, g_urids.time_speed);
+            lv2_atom_forge_float(&forge, rolling ? 1.0f : 0.0f);
 
-    /* Features array */
-    features[URI_MAP_FEATURE]           = &g_uri_map_feature;
-    features[URID_MAP_FEATURE]          = &g_urid_map_feature;
-    features[URID_UNMAP_FEATURE]        = &g_urid_unmap_feature;
-    features[OPTIONS_FEATURE]           = &g_options_feature;
-#ifdef MOD_HMI_CONTROL_ENABLED
-    features[HMI_WC_FEATURE]            = &g_hmi_wc_feature;
-#endif
-    features[LICENSE_FEATURE]           = &g_license_feature;
-    features[BUF_SIZE_POWER2_FEATURE]   = &g_buf_size_features[0];
-    features[BUF_SIZE_FIXED_FEATURE]    = &g_buf_size_features[1];
-    features[BUF_SIZE_BOUNDED_FEATURE]  = &g_buf_size_features[2];
-    features[LOG_FEATURE]               = &g_lv2_log_feature;
-    features[STATE_FREE_PATH_FEATURE]   = &g_state_freePath_feature;
-    features[STATE_MAKE_PATH_FEATURE]   = state_make_path_feature;
-    features[CTRLPORT_REQUEST_FEATURE]  = ctrlportReqChange_feature;
-    features[CTRLPORT_STATE_FEATURE]    = ctrlportStateUpdate_feature;
-    features[WORKER_FEATURE]            = work_schedule_feature;
-#ifdef WITH_EXTERNAL_UI_SUPPORT
-    features[UI_DATA_ACCESS]            = NULL;
-    features[UI_INSTANCE_ACCESS]        = NULL;
-#endif
-    features[FEATURE_TERMINATOR]        = NULL;
+            lv2_atom_forge_key(&forge, g_urids.time_frame);
+            lv2_atom_forge_long(&forge, pos.frame);
 
-    effect->features = features;
+            if (pos.valid & JackPositionBBT)
+            {
+                lv2_atom_forge_key(&forge, g_urids.time_bar);
+                lv2_atom_forge_long(&forge, pos.bar - 1);
 
-    /* also update jack client option value */
-    g_options[7].value = effect->jack_client;
-}
+                lv2_atom_forge_key(&forge, g_urids.time_barBeat);
 
-/**
-* If transport is stopped, ensure jack invokes the timebase master by
-* invoking a jack reposition on the current position.
- */
-static void TriggerJackTimebase(bool reset_to_zero)
-{
-    jack_position_t pos;
-    if (jack_transport_query(g_jack_global_client, &pos) == JackTransportStopped) {
-        if (reset_to_zero) {
-            pos.frame = 0;
-        }
-        int res = jack_transport_reposition(g_jack_global_client, &pos);
-        if (res < 0) {
-            fprintf(stderr, "Failed to trigger timebase master.  Call "
-                            "will occur when transport starts or a client updates "
-                            "position.\n");
-        }
-    }
-}
+                if (pos.valid & JackTickDouble)
+                    lv2_atom_forge_float(&forge, pos.beat - 1 + (pos.tick_double / pos.ticks_per_beat));
+                else
+                    lv2_atom_forge_float(&forge, pos.beat - 1 + (pos.tick / pos.ticks_per_beat));
 
-static property_t *FindEffectPropertyByURI(effect_t *effect, const char *uri)
-{
-    for (uint32_t i = 0; i < effect->properties_count; i++)
-    {
-        if (strcmp(uri, lilv_node_as_uri(effect->properties[i]->uri)) == 0)
-            return effect->properties[i];
-    }
-    return NULL;
-}
+                lv2_atom_forge_key(&forge, g_urids.time_beat);
+                lv2_atom_forge_double(&forge, pos.beat - 1);
 
-static port_t *FindEffectInputPortBySymbol(effect_t *effect, const char *control_symbol)
-{
-    if (!strcmp(control_symbol, g_bypass_port_symbol))
-        return &effect->bypass_port;
-    if (!strcmp(control_symbol, g_presets_port_symbol))
-        return &effect->presets_port;
+                lv2_atom_forge_key(&forge, g_urids.time_beatUnit);
+                lv2_atom_forge_int(&forge, pos.beat_type);
 
-    for (uint32_t i = 0; i < effect->input_control_ports_count; i++)
-    {
-        if (strcmp(effect->input_control_ports[i]->symbol, control_symbol) == 0)
-            return effect->input_control_ports[i];
-    }
-    return NULL;
-}
+                lv2_atom_forge_key(&forge, g_urids.time_beatsPerBar);
+                lv2_atom_forge_float(&forge, pos.beats_per_bar);
 
-static port_t *FindEffectOutputPortBySymbol(effect_t *effect, const char *control_symbol)
-{
-    for (uint32_t i = 0; i < effect->output_control_ports_count; i++)
-    {
-        if (strcmp(effect->output_control_ports[i]->symbol, control_symbol) == 0)
-            return effect->output_control_ports[i];
-    }
-    return NULL;
-}
+                lv2_atom_forge_key(&forge, g_urids.time_beatsPerMinute);
+                lv2_atom_forge_float(&forge, pos.beats_per_minute);
 
-static void SetParameterFromState(const char* symbol, void* user_data,
-                                  const void* value, uint32_t size,
-                                  uint32_t type)
-{
-    effect_t *effect = (effect_t*)user_data;
-    float realvalue;
+                lv2_atom_forge_key(&forge, g_urids.time_ticksPerBeat);
+                lv2_atom_forge_double(&forge, pos.ticks_per_beat);
+            }
 
-    if (type == g_urids.atom_Float)
-    {
-        if (size != sizeof(float))
-            return;
-        realvalue = *((const float*)value);
+            lv2_atom_forge_pop(&forge, &frame);
+        }
     }
-    else if (type == g_urids.atom_Double)
+    if (effect->bpb_index >= 0)
     {
-        if (size != sizeof(double))
-            return;
-        realvalue = *((const double*)value);
+        *(effect->ports[effect->bpb_index]->buffer) = g_transport_bpb;
     }
-    else if (type == g_urids.atom_Int || type == g_urids.atom_Bool)
+    if (effect->bpm_index >= 0)
     {
-        if (size != sizeof(int32_t))
-            return;
-        realvalue = *((const int32_t*)value);
+        *(effect->ports[effect->bpm_index]->buffer) = g_transport_bpm;
     }
-    else if (type == g_urids.atom_Long)
+    if (effect->speed_index >= 0)
     {
-        if (size != sizeof(int64_t))
-            return;
-        realvalue = *((const int64_t*)value);
+        *(effect->ports[effect->speed_index]->buffer) = g_jack_rolling ? 1.0f : 0.0f;
     }
-    else
+
+    /* Prepare midi/event ports */
+    for (i = 0; i < effect->input_event_ports_count; i++)
     {
-        fprintf(stderr, "SetParameterFromState called with unknown type: %u %u\n", type, size);
-        return;
-    }
+        port = effect->input_event_ports[i];
+        lv2_evbuf_reset(port->evbuf, true);
 
-    effects_set_parameter(effect->instance, symbol, realvalue);
-}
-
-static const void* GetPortValueForState(const char* symbol, void* user_data, uint32_t* size, uint32_t* type)
-{
-    effect_t *effect = (effect_t*)user_data;
-    port_t *port = FindEffectInputPortBySymbol(effect, symbol);
-    if (port)
-    {
-        *size = sizeof(float);
-        *type = g_urids.atom_Float;
-        return port->buffer;
-    }
-    return NULL;
-}
-
-static void LoadPresets(effect_t *effect)
-{
-    LilvNodes* presets = lilv_plugin_get_related(effect->lilv_plugin, g_lilv_nodes.preset);
-    uint32_t presets_count = lilv_nodes_size(presets);
-    effect->presets_count = presets_count;
-    // allocate for presets
-    effect->presets = (preset_t **) mod_calloc(presets_count, sizeof(preset_t *));
-    uint32_t j = 0;
-    LILV_FOREACH(nodes, i, presets)
-    {
-        const LilvNode* preset = lilv_nodes_get(presets, i);
-        effect->presets[j] = (preset_t *) malloc(sizeof(preset_t));
-        effect->presets[j]->uri = lilv_node_duplicate(preset);
-        j++;
-    }
-    lilv_nodes_free(presets);
-}
+        if (effect->bypass > 0.5f && effect->enabled_index < 0)
+        {
+            // effect is now bypassed, but wasn't before
+            if (!effect->was_bypassed && (port->hints & HINT_MIDI_EVENT) != 0)
+            {
+                LV2_Evbuf_Iterator iter = lv2_evbuf_begin(port->evbuf);
 
-// ignore const cast for this function, need to free const features array
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-qual"
+                uint8_t bufNotesOff[3] = {
+                    0xB0, // CC
+                    0x7B, // all-notes-off
+                    0
+                };
+                uint8_t bufSoundOff[3] = {
+                    0xB0, // CC
+                    0x78, // all-sound-off
+                    0
+                };
 
-static void FreeFeatures(effect_t *effect)
-{
-    worker_finish(&effect->worker);
+                int j=0;
 
-    if (effect->features)
-    {
-        if (effect->features[STATE_MAKE_PATH_FEATURE])
-        {
-            free(effect->features[STATE_MAKE_PATH_FEATURE]->data);
-            free((void*)effect->features[STATE_MAKE_PATH_FEATURE]);
-        }
-        /*
-        if (effect->features[STATE_MAP_PATH_FEATURE])
-        {
-            free(effect->features[STATE_MAP_PATH_FEATURE]->data);
-            free((void*)effect->features[STATE_MAP_PATH_FEATURE]);
-        }
-        */
-        if (effect->features[CTRLPORT_REQUEST_FEATURE])
-        {
-            free(effect->features[CTRLPORT_REQUEST_FEATURE]->data);
-            free((void*)effect->features[CTRLPORT_REQUEST_FEATURE]);
-        }
-        if (effect->features[CTRLPORT_STATE_FEATURE])
-        {
-            free(effect->features[CTRLPORT_STATE_FEATURE]->data);
-            free((void*)effect->features[CTRLPORT_STATE_FEATURE]);
+                do {
+                    if (!lv2_evbuf_write(&iter, 0, 0, g_urids.midi_MidiEvent, 3, bufNotesOff))
+                        break;
+                    if (!lv2_evbuf_write(&iter, 0, 0, g_urids.midi_MidiEvent, 3, bufSoundOff))
+                        break;
+                    bufNotesOff[0] += 1;
+                    bufSoundOff[0] += 1;
+                } while (++j < 16);
+            }
         }
-        if (effect->features[WORKER_FEATURE])
+        else
         {
-            free(effect->features[WORKER_FEATURE]->data);
-            free((void*)effect->features[WORKER_FEATURE]);
-        }
-        free(effect->features);
-    }
-}
+            // non-bypassed, processing
+            LV2_Evbuf_Iterator iter = lv2_evbuf_begin(port->evbuf);
 
-// back to normal
-#pragma GCC diagnostic pop
+            /* Write time position */
+            if (lv2_pos->size > 0 && (port->hints & HINT_TRANSPORT) != 0)
+            {
+                lv2_evbuf_write(&iter, 0, 0, lv2_pos->type, lv2_pos->size, LV2_ATOM_BODY_CONST(lv2_pos));
+            }
 
-static void FreePluginString(void* handle, char *str)
-{
-    return free(str);
+            /* Write Jack MIDI input */
+            void* buf = jack_port_get_buffer(port->jack_port, nframes);
+            uint32_t j;
+            for (j = 0; j < jack_midi_get_event_count(buf); ++j)
+            {
+                jack_midi_event_t ev;
+                jack_midi_event_get(&ev, buf, j);
+                if (!lv2_evbuf_write(&iter, ev.time, 0, g_urids.midi_MidiEvent, ev.size, ev.buffer))
+                {
+                    fprintf(stderr, "lv2 evbuf write failed\n");
+                }
+            }
+        }
+    }
 
-    UNUSED_PARAM(handle);
-}
+    for (i = 0; i < effect->output_event_ports_count; i++)
+        lv2_evbuf_reset(effect->output_event_ports[i]->evbuf, false);
 
-static void ConnectToAllHardwareMIDIPorts(void)
-{
-    if (g_jack_global_client == NULL)
-        return;
+    /* Decide on sleeping before draining host events, these stay queued until the plugin runs */
+    const bool asleep = !(effect->bypass > 0.5f && effect->enabled_index < 0) && PluginShouldSleep(effect, nframes);
 
-    const char** const midihwports = jack_get_ports(g_jack_global_client, "",
-                                                    JACK_DEFAULT_MIDI_TYPE,
-                                                    JackPortIsTerminal|JackPortIsPhysical|JackPortIsOutput);
-    if (midihwports != NULL)
+    /* control in events */
+    if (!asleep && effect->events_in_buffer && effect->events_in_buffer_helper && effect->control_index >= 0)
     {
-        const char *ourportname = jack_port_name(g_midi_in_port);
-
-        for (int i=0; midihwports[i] != NULL; ++i)
-            jack_connect(g_jack_global_client, midihwports[i], ourportname);
+        const size_t space = jack_ringbuffer_read_space(effect->events_in_buffer);
+        LV2_Atom *atom = (LV2_Atom*)effect->events_in_buffer_helper;
+        port = effect->ports[effect->control_index];
 
-        struct list_head *it;
-        pthread_mutex_lock(&g_raw_midi_port_mutex);
-        list_for_each(it, &g_raw_midi_port_list)
+        for (size_t j = 0; j < space; j += sizeof(LV2_Atom) + atom->size)
         {
-            raw_midi_port_item* const portitemptr = list_entry(it, raw_midi_port_item, siblings);
+            jack_ringbuffer_read(effect->events_in_buffer, (char*)atom, sizeof(LV2_Atom));
+            jack_ringbuffer_read(effect->events_in_buffer, (char*)(atom + 1), atom->size);
 
-            for (int i=0; midihwports[i] != NULL; ++i)
-                jack_connect(g_jack_global_client,
-                             midihwports[i],
-                             jack_port_name(portitemptr->jack_port));
+            LV2_Evbuf_Iterator e = lv2_evbuf_end(port->evbuf);
+            lv2_evbuf_write(&e, nframes - 1, 0, atom->type, atom->size, (uint8_t*)(atom + 1));
         }
-        pthread_mutex_unlock(&g_raw_midi_port_mutex);
-
-        jack_free(midihwports);
     }
-}
 
-static void ConnectToMIDIThroughPorts(void)
-{
-    if (g_jack_global_client == NULL)
-        return;
-
-    const char** const midihwports = jack_get_ports(g_jack_global_client, "system:midi_capture_",
-                                                    JACK_DEFAULT_MIDI_TYPE,
-                                                    JackPortIsTerminal|JackPortIsPhysical|JackPortIsOutput);
-    if (midihwports != NULL)
+    for (i = 0; i < effect->input_control_ports_count; i++)
     {
-        char  aliases[2][320];
-        char* aliasesptr[2] = {
-            aliases[0],
-            aliases[1]
-        };
-
-        const char *ourportname = jack_port_name(g_midi_in_port);
+        port = effect->input_control_ports[i];
 
-        for (int i=0; midihwports[i] != NULL; ++i)
+        if (port->cv_source)
         {
-            jack_port_t* const port = jack_port_by_name(g_jack_global_client, midihwports[i]);
-
-            if (port == NULL)
-                continue;
-            if (jack_port_get_aliases(port, aliasesptr) <= 0)
+            if (pthread_mutex_trylock(&port->cv_source_mutex) != 0)
                 continue;
-            if (strncmp(aliases[0], "alsa_pcm:Midi-Through/", 22))
+            if (!port->cv_source) {
+                pthread_mutex_unlock(&port->cv_source_mutex);
                 continue;
-            jack_connect(g_jack_global_client, midihwports[i], ourportname);
-        }
+            }
 
-        jack_free(midihwports);
-    }
-}
+            cv_source_t *cv_source = port->cv_source;
 
-#ifdef MOD_HMI_CONTROL_ENABLED
-static void HMIWidgetsSetLedWithBlink(LV2_HMI_WidgetControl_Handle handle,
-                                      LV2_HMI_Addressing addressing_ptr,
-                                      LV2_HMI_LED_Colour led_color,
-                                      int on_blink_time,
-                                      int off_blink_time)
-{
-    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
-        return;
-    }
+            value = ((float*)jack_port_get_buffer(cv_source->jack_port, 1))[0];
 
-    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+            // convert value from source port into something relevant for this parameter
+            if (value <= cv_source->source_min_value) {
+                value = cv_source->min_value;
 
-    const int assignment_id = addressing->actuator_id;
-    const uint8_t page = addressing->page;
-    const uint8_t subpage = addressing->subpage;
+            } else if (value >= cv_source->source_max_value) {
+                value = cv_source->max_value;
 
-    if (g_verbose_debug) {
-        printf("DEBUG: HMIWidgetsSetLedWithBlink %i: %i %i %i\n",
-               assignment_id, led_color, on_blink_time, off_blink_time);
-        fflush(stdout);
-    }
+            } else {
+                // normalize value to 0-1
+                value = (value - cv_source->source_min_value) / cv_source->source_diff_value;
 
-    if (on_blink_time < 0)
-    {
-        if (on_blink_time < LV2_HMI_LED_Blink_Fast)
-            on_blink_time = LV2_HMI_LED_Blink_Fast;
-        off_blink_time = 0;
-    }
-    else
-    {
-        if (on_blink_time > 5000)
-            on_blink_time = 5000;
+                if (port->hints & HINT_TOGGLE) {
+                    // use min|max values if toggle
+                    value = value > 0.5f ? cv_source->max_value : cv_source->min_value;
 
-        if (off_blink_time < 0)
-            off_blink_time = 0;
-        else if (off_blink_time > 5000)
-            off_blink_time = 5000;
-    }
+                } else {
+                    // otherwise unnormalize value to full scale
+                    value = cv_source->min_value + (value * cv_source->diff_value);
 
-    char msg[32];
-    snprintf(msg, sizeof(msg), "%i %i %i %i", assignment_id, led_color, on_blink_time, off_blink_time);
-    msg[sizeof(msg)-1] = '\0';
+                    // and round to integer if needed
+                    if (port->hints & HINT_INTEGER) {
+                        value = roundf(value);
+                    }
+                }
+            }
 
-    pthread_mutex_lock(&g_hmi_mutex);
-    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_led_blink, page, subpage, msg);
-    pthread_mutex_unlock(&g_hmi_mutex);
-}
+            // ignore requests for same value
+            if (! floats_differ_enough(cv_source->prev_value, value)) {
+                pthread_mutex_unlock(&port->cv_source_mutex);
+                continue;
+            }
 
-static void HMIWidgetsSetLedWithBrightness(LV2_HMI_WidgetControl_Handle handle,
-                                           LV2_HMI_Addressing addressing_ptr,
-                                           LV2_HMI_LED_Colour led_color,
-                                           int brightness)
-{
-    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
-        return;
-    }
-
-    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
-
-    const int assignment_id = addressing->actuator_id;
-    const uint8_t page = addressing->page;
-    const uint8_t subpage = addressing->subpage;
+            if (SetPortValue(port, value, effect->instance, false, false)) {
+                needs_post = true;
+                cv_source->prev_value = value;
+            }
 
-    if (g_verbose_debug) {
-        printf("DEBUG: HMIWidgetsSetLedWithBrightness %i: %i %i\n",
-               assignment_id, led_color, brightness);
-        fflush(stdout);
+            pthread_mutex_unlock(&port->cv_source_mutex);
+        }
     }
 
-    if (brightness < LV2_HMI_LED_Brightness_Normal)
-        brightness = LV2_HMI_LED_Brightness_Normal;
-    else if (brightness > 100)
-        brightness = 100;
+    // handle bypass as CV addressing
+    {
+        port = &effect->bypass_port;
 
-    char msg[32];
-    snprintf(msg, sizeof(msg), "%i %i %i", assignment_id, led_color, brightness);
-    msg[sizeof(msg)-1] = '\0';
+        if (port->cv_source && pthread_mutex_trylock(&port->cv_source_mutex) == 0)
+        {
+            cv_source_t *cv_source = port->cv_source;
 
-    pthread_mutex_lock(&g_hmi_mutex);
-    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_led_brightness, page, subpage, msg);
-    pthread_mutex_unlock(&g_hmi_mutex);
-}
+            value = ((float*)jack_port_get_buffer(cv_source->jack_port, 1))[0];
 
-static void HMIWidgetsSetLabel(LV2_HMI_WidgetControl_Handle handle,
-                               LV2_HMI_Addressing addressing_ptr,
-                               const char* label)
-{
-    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
-        return;
-    }
+            // NOTE: values are reversed as this is bypass special behaviour
+            if (value <= cv_source->source_min_value) {
+                value = cv_source->max_value;
 
-    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+            } else if (value >= cv_source->source_max_value) {
+                value = cv_source->min_value;
 
-    const int assignment_id = addressing->actuator_id;
-    const uint8_t page = addressing->page;
-    const uint8_t subpage = addressing->subpage;
+            } else {
+                value = ((value - cv_source->source_min_value) / cv_source->source_diff_value) > 0.5f
+                        ? cv_source->min_value
+                        : cv_source->max_value;
+            }
 
-    if (g_verbose_debug) {
-        printf("DEBUG: HMIWidgetsSetLabel %i: '%s'\n", assignment_id, label);
-        fflush(stdout);
+            // ignore requests for same value
+            if (floats_differ_enough(cv_source->prev_value, value)) {
+                if (SetPortValue(port, value, effect->instance, true, false)) {
+                    needs_post = true;
+                    cv_source->prev_value = value;
+                }
+            }
+
+            pthread_mutex_unlock(&port->cv_source_mutex);
+        }
     }
 
-    char msg[24];
-    snprintf(msg, sizeof(msg), "%i %s", assignment_id, label);
-    msg[sizeof(msg)-1] = '\0';
+    /* Bypass */
+    if (effect->bypass > 0.5f && effect->enabled_index < 0)
+    {
+        /* the plugin runs on its own buffers during bypass */
+        UnbindPortBuffers(effect);
+        effect->zero_copy_bytes = 0;
 
-    pthread_mutex_lock(&g_hmi_mutex);
-    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_name, page, subpage, msg);
-    pthread_mutex_unlock(&g_hmi_mutex);
-}
+        /* Plugins with audio inputs */
+        if (effect->input_audio_ports_count > 0)
+        {
+            /* prepare jack buffers (bypass copy) */
+            for (i = 0; i < effect->output_audio_ports_count; i++)
+            {
+                if (i < effect->input_audio_ports_count)
+                {
+                    buffer_in = GetAudioPortBuffer(effect->input_audio_ports[i], nframes);
+                    memset(effect->input_audio_ports[i]->buffer, 0, (sizeof(float) * nframes));
+                }
+                else
+                {
+                    buffer_in = GetAudioPortBuffer(effect->input_audio_ports[effect->input_audio_ports_count - 1], nframes);
+                }
+                buffer_out = GetAudioPortBuffer(effect->output_audio_ports[i], nframes);
+                memcpy(buffer_out, buffer_in, (sizeof(float) * nframes));
+            }
 
-static void HMIWidgetsSetValue(LV2_HMI_WidgetControl_Handle handle,
-                               LV2_HMI_Addressing addressing_ptr,
-                               const char* value)
-{
-    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
-        return;
-    }
+            /* silence any remaining audio inputs */
+            for (; i < effect->input_audio_ports_count; i++)
+                memset(effect->input_audio_ports[i]->buffer, 0, (sizeof(float) * nframes));
 
-    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+            /* reset cv inputs */
+            for (i = 0; i < effect->input_cv_ports_count; i++)
+                memset(effect->input_cv_ports[i]->buffer, 0, (sizeof(float) * nframes));
 
-    const int assignment_id = addressing->actuator_id;
-    const uint8_t page = addressing->page;
-    const uint8_t subpage = addressing->subpage;
+            /* Run the plugin with zero buffer to avoid 'pause behavior' in delay plugins */
+            RunBypassedPlugin(effect, nframes);
 
-    if (g_verbose_debug) {
-        printf("DEBUG: HMIWidgetsSetValue %i: '%s'\n", assignment_id, value);
-        fflush(stdout);
-    }
+            /* no need to silence plugin audio or cv, they are unused during bypass */
+        }
+        /* Plugins without audio inputs */
+        else
+        {
+            /* prepare jack buffers (silent) */
+            for (i = 0; i < effect->output_audio_ports_count; i++)
+            {
+                buffer_out = GetAudioPortBuffer(effect->output_audio_ports[i], nframes);
+                memset(buffer_out, 0, (sizeof(float) * nframes));
+            }
+            for (i = 0; i < effect->output_cv_ports_count; i++)
+            {
+                buffer_out = GetAudioPortBuffer(effect->output_cv_ports[i], nframes);
+                memset(buffer_out, 0, (sizeof(float) * nframes));
+            }
 
-    char msg[24];
-    snprintf(msg, sizeof(msg), "%i %s", assignment_id, value);
-    msg[sizeof(msg)-1] = '\0';
+            /* reset cv inputs */
+            for (i = 0; i < effect->input_cv_ports_count; i++)
+                memset(effect->input_cv_ports[i]->buffer, 0, (sizeof(float) * nframes));
 
-    pthread_mutex_lock(&g_hmi_mutex);
-    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_value, page, subpage, msg);
-    pthread_mutex_unlock(&g_hmi_mutex);
-}
+            /* Run the plugin with default cv buffers and without midi events */
+            RunBypassedPlugin(effect, nframes);
 
-static void HMIWidgetsSetUnit(LV2_HMI_WidgetControl_Handle handle,
-                              LV2_HMI_Addressing addressing_ptr,
-                              const char* unit)
-{
-    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
-        return;
+            /* no need to silence plugin audio or cv, they are unused during bypass */
+        }
     }
+    /* Effect asleep, all inputs are silent */
+    else if (asleep)
+    {
+        for (i = 0; i < effect->output_audio_ports_count; i++)
+        {
+            buffer_out = GetAudioPortBuffer(effect->output_audio_ports[i], nframes);
+            memset(buffer_out, 0, (sizeof(float) * nframes));
+        }
+        for (i = 0; i < effect->output_cv_ports_count; i++)
+        {
+            buffer_out = GetAudioPortBuffer(effect->output_cv_ports[i], nframes);
+            memset(buffer_out, 0, (sizeof(float) * nframes));
+        }
 
-    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
-
-    const int assignment_id = addressing->actuator_id;
-    const uint8_t page = addressing->page;
-    const uint8_t subpage = addressing->subpage;
-
-    if (g_verbose_debug) {
-        printf("DEBUG: HMIWidgetsSetUnit %i: '%s'\n", assignment_id, unit);
-        fflush(stdout);
+        effect->zero_copy_bytes = 0;
+        effect->bypass_tail_done = false;
     }
+    /* Effect process */
+    else
+    {
+        /* Connect the plugin directly to jack buffers when possible, copying otherwise */
+        const bool zero_copy = g_zero_copy_enabled && (effect->hints & HINT_IN_PLACE_BROKEN) == 0;
+        float *buffer;
 
-    char msg[24];
-    snprintf(msg, sizeof(msg), "%i %s", assignment_id, unit);
-    msg[sizeof(msg)-1] = '\0';
+        effect->bypass_tail_done = false;
 
-    pthread_mutex_lock(&g_hmi_mutex);
-    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_unit, page, subpage, msg);
-    pthread_mutex_unlock(&g_hmi_mutex);
-}
+        /* Copy the input buffers audio */
+        for (i = 0; i < effect->input_audio_ports_count; i++)
+        {
+            port = effect->input_audio_ports[i];
+            buffer = GetAudioPortBuffer(port, nframes);
 
-static void HMIWidgetsSetIndicator(LV2_HMI_WidgetControl_Handle handle,
-                                   LV2_HMI_Addressing addressing_ptr,
-                                   float indicator_poss)
-{
-    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
-        return;
-    }
+            if (zero_copy)
+            {
+                BindPortBuffer(effect, port, buffer);
+            }
+            else
+            {
+                BindPortBuffer(effect, port, port->buffer);
+                memcpy(port->buffer, buffer, (sizeof(float) * nframes));
+            }
+        }
 
-    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+        /* Copy the input buffers cv */
+        for (i = 0; i < effect->input_cv_ports_count; i++)
+        {
+            port = effect->input_cv_ports[i];
+            buffer = GetAudioPortBuffer(port, nframes);
 
-    const int assignment_id = addressing->actuator_id;
-    const uint8_t page = addressing->page;
-    const uint8_t subpage = addressing->subpage;
+            if (zero_copy)
+            {
+                BindPortBuffer(effect, port, buffer);
+            }
+            else
+            {
+                BindPortBuffer(effect, port, port->buffer);
+                memcpy(port->buffer, buffer, (sizeof(float) * nframes));
+            }
+        }
 
-    if (g_verbose_debug) {
-        printf("DEBUG: HMIWidgetsSetIndicator %i: %f\n", assignment_id, indicator_poss);
-        fflush(stdout);
-    }
+        /* Output buffers */
+        for (i = 0; i < effect->output_audio_ports_count; i++)
+        {
+            port = effect->output_audio_ports[i];
+            BindPortBuffer(effect, port, zero_copy ? GetAudioPortBuffer(port, nframes) : port->buffer);
+        }
+        for (i = 0; i < effect->output_cv_ports_count; i++)
+        {
+            port = effect->output_cv_ports[i];
+            BindPortBuffer(effect, port, zero_copy ? GetAudioPortBuffer(port, nframes) : port->buffer);
+        }
 
-    if (indicator_poss < 0.0f)
-        indicator_poss = 0.0f;
-    else if (indicator_poss > 1.0f)
-        indicator_poss = 1.0f;
+        effect->zero_copy_bytes = zero_copy
+                                ? (effect->audio_ports_count + effect->cv_ports_count) * sizeof(float) * nframes
+                                : 0;
 
-    char msg[32];
-    snprintf(msg, sizeof(msg), "%i %f", assignment_id, indicator_poss);
-    msg[31] = '\0';
+        /* Run the effect */
+        lilv_instance_run(effect->lilv_instance, nframes);
 
-    pthread_mutex_lock(&g_hmi_mutex);
-    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_widget_indicator, page, subpage, msg);
-    pthread_mutex_unlock(&g_hmi_mutex);
-}
+        /* Notify the plugin the run() cycle is finished */
+        if (effect->worker.iface)
+        {
+            /* Process any replies from the worker. */
+            worker_emit_responses(&effect->worker);
+            if (effect->worker.iface->end_run)
+            {
+                effect->worker.iface->end_run(effect->lilv_instance->lv2_handle);
+            }
+        }
 
-static void HMIWidgetsPopupMessage(LV2_HMI_WidgetControl_Handle handle,
-                                   LV2_HMI_Addressing addressing_ptr,
-                                   LV2_HMI_Popup_Style style,
-                                   const char* title,
-                                   const char* text)
-{
-    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
-        return;
-    }
+        if (! zero_copy)
+        {
+            /* Copy the output buffers audio */
+            for (i = 0; i < effect->output_audio_ports_count; i++)
+            {
+                buffer_out = GetAudioPortBuffer(effect->output_audio_ports[i], nframes);
+                memcpy(buffer_out, effect->output_audio_ports[i]->buffer, (sizeof(float) * nframes));
+            }
 
-    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
-
-    const int assignment_id = addressing->actuator_id;
-    const uint8_t page = addressing->page;
-    const uint8_t subpage = addressing->subpage;
+            /* Copy the output buffers cv */
+            for (i = 0; i < effect->output_cv_ports_count; i++)
+            {
+                buffer_out = GetAudioPortBuffer(effect->output_cv_ports[i], nframes);
+                memcpy(buffer_out, effect->output_cv_ports[i]->buffer, (sizeof(float) * nframes));
+            }
+        }
 
-    if (g_verbose_debug) {
-        printf("DEBUG: HMIWidgetsPopupMessage %i: %i '%s' '%s'\n", assignment_id, style, title, text);
-        fflush(stdout);
+        for (i = 0; i < effect->monitors_count; i++)
+        {
+            int port_id = effect->monitors[i]->port_id;
+            value = *(effect->ports[port_id]->buffer);
+            if (monitor_check_condition(effect->monitors[i]->op, effect->monitors[i]->value, value) &&
+                floats_differ_enough(value, effect->monitors[i]->last_notified_value)) {
+                if (monitor_send(effect->instance, effect->ports[port_id]->symbol, value) >= 0)
+                    effect->monitors[i]->last_notified_value = value;
+            }
+        }
     }
 
-    char msg[256];
-    snprintf(msg, sizeof(msg), "%i %i \"%s\" \"%s\"", assignment_id, style, title, text);
-    msg[sizeof(msg)-1] = '\0';
-
-    pthread_mutex_lock(&g_hmi_mutex);
-    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_popup, page, subpage, msg);
-    pthread_mutex_unlock(&g_hmi_mutex);
-}
-
-#endif
-
-static char* GetLicenseFile(MOD_License_Handle handle, const char *license_uri)
-{
-    if (!license_uri || *license_uri == '\0')
-        return NULL;
+    /* MIDI out events */
+    for (i = 0; i < effect->output_event_ports_count; i++)
+    {
+        port = effect->output_event_ports[i];
 
-    // get keys path. note: assumes trailing separator
-    const char* const keyspath = getenv("MOD_KEYS_PATH");
-    if (!keyspath || *keyspath == '\0')
-        return NULL;
+        if (port->flow == FLOW_OUTPUT && port->type == TYPE_EVENT)
+        {
+            void *buf = port->jack_port ? jack_port_get_buffer(port->jack_port, nframes) : NULL;
 
-    // get path length, check trailing separator
-    const size_t keyspathlen = strlen(keyspath);
-    if (keyspath[keyspathlen-1] != '/')
-        return NULL;
+            if (buf != NULL)
+                jack_midi_clear_buffer(buf);
 
-    // local vars
-    uint8_t* hashenc;
-    char hashdec[HASH_LENGTH*2+1];
-    FILE* file;
-    long filesize;
-    size_t filenamesize;
-    char* filename;
-    char* filebuffer = NULL;
-    sha1nfo sha1;
+            if (effect->bypass > 0.5f && effect->enabled_index < 0)
+            {
+                // effect is now bypassed, but wasn't before
+                if (buf != NULL)
+                {
+                    if (!effect->was_bypassed)
+                    {
+                        jack_midi_data_t bufNotesOff[3] = {
+                            0xB0, // CC
+                            0x7B, // all-notes-off
+                            0
+                        };
 
-    // hash the uri
-    sha1_init(&sha1);
-    sha1_write(&sha1, license_uri, strlen(license_uri));
-    hashenc = sha1_result(&sha1);
+                        int j=0;
 
-    for (int i=0; i<HASH_LENGTH; i++) {
-        sprintf(hashdec+(i*2), "%02x", hashenc[i]);
-    }
-    hashdec[HASH_LENGTH*2] = '\0';
+                        do {
+                            if (jack_midi_event_write(buf, 0, bufNotesOff, 3) != 0)
+                                break;
+                            bufNotesOff[0] += 1;
+                        } while (++j < 16);
+                    }
 
-    // join path
-    filenamesize = strlen(keyspath) + HASH_LENGTH*2;
-    filename = malloc(filenamesize+1);
+                    if (effect->input_audio_ports_count == 0 &&
+                        effect->output_audio_ports_count == 0 &&
+                        effect->input_event_ports_count == effect->output_event_ports_count)
+                    {
+                        void* bufIn = jack_port_get_buffer(effect->input_event_ports[i]->jack_port, nframes);
+                        jack_midi_event_t ev;
 
-    if (! filename)
-        return NULL;
+                        for (i = 0; i < jack_midi_get_event_count(bufIn); ++i)
+                        {
+                            if (jack_midi_event_get(&ev, bufIn, i) == 0)
+                            {
+                                if (jack_midi_event_write(buf, ev.time, ev.buffer, ev.size) != 0)
+                                    break;
+                            }
+                        }
+                    }
+                }
+            }
+            else
+            {
+                LV2_Evbuf_Iterator it;
+                bool can_write_midi = true;
 
-    memcpy(filename, keyspath, keyspathlen);
-    memcpy(filename+keyspathlen, hashdec, HASH_LENGTH*2);
-    filename[filenamesize] = '\0';
+                for (it = lv2_evbuf_begin(port->evbuf); lv2_evbuf_is_valid(it); it = lv2_evbuf_next(it))
+                {
+                    uint32_t frames, subframes, type, size;
+                    uint8_t* body;
 
-    // open file
-    file = fopen(filename, "r");
+                    if (! lv2_evbuf_get(it, &frames, &subframes, &type, &size, &body))
+                        continue;
 
-    // cleanup
-    free(filename);
+                    if (buf != NULL && type == g_urids.midi_MidiEvent)
+                    {
+                        if (can_write_midi && jack_midi_event_write(buf, frames, body, size) == ENOBUFS)
+                            can_write_midi = false;
+                    }
+                    else if (effect->events_out_buffer && type == g_urids.atom_Object)
+                    {
+                        const LV2_Atom_Object_Body *objbody = (const LV2_Atom_Object_Body*)body;
 
-    if (!file)
-        return NULL;
+                        if (objbody->otype == g_urids.patch_Set)
+                        {
+                            const LV2_Atom_Int  *sequence = NULL;
+                            const LV2_Atom_URID *property = NULL;
+                            const LV2_Atom      *lv2value = NULL;
 
-    // get size
-    fseek(file, 0, SEEK_END);
-    filesize = ftell(file);
-    if (filesize <= 0 || filesize > 5*1024*1024) // 5Mb
-        goto end;
+                            lv2_atom_object_body_get(size, objbody,
+                                                     g_urids.patch_sequence, (const LV2_Atom**)&sequence,
+                                                     g_urids.patch_property, (const LV2_Atom**)&property,
+                                                     g_urids.patch_value,    &lv2value,
+                                                     0);
 
-    // allocate file buffer
-    filebuffer = (char*)mod_calloc(1, filesize+1);
-    if (! filebuffer)
-        goto end;
+                            if (sequence != NULL && sequence->body == MAGIC_PARAMETER_SEQ_NUMBER)
+                                continue;
 
-    // read file
-    fseek(file, 0, SEEK_SET);
-    if (fread(filebuffer, 1, filesize, file) != (size_t)filesize)
-    {
-        free(filebuffer);
-        filebuffer = NULL;
-    }
+                            if (jack_ringbuffer_write_space(effect->events_out_buffer) < sizeof(uint32_t) + sizeof(LV2_Atom) + lv2value->size)
+                                continue;
 
-end:
-    fclose(file);
-    return filebuffer;
+                            jack_ringbuffer_write(effect->events_out_buffer, (const char*)&property->body, sizeof(uint32_t));
+                            jack_ringbuffer_write(effect->events_out_buffer, (const char*)lv2value, lv2_atom_total_size(lv2value));
 
-    UNUSED_PARAM(handle);
-}
+                            postponed_event_list_data* const posteventptr = RtSafeEventAllocate();
 
-static int LogPrintf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, ...)
-{
-    int ret;
-    va_list args;
-    va_start(args, fmt);
-    ret = LogVPrintf(handle, type, fmt, args);
-    va_end(args);
+                            if (posteventptr == NULL)
+                                continue;
 
-    return ret;
+                            posteventptr->event.type = POSTPONED_PROCESS_OUTPUT_BUFFER;
+                            posteventptr->event.process_out_buf.effect_id = effect->instance;
 
-    UNUSED_PARAM(handle);
-}
+                            RtSafeQueuePush(posteventptr);
 
-static int LogVPrintf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, va_list ap)
-{
-    int ret = -1;
-    char *strp = NULL;
+                            needs_post = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
 
-    // try to allocate message early, we can only format once so do it now
-    if (type == g_urids.log_Error || type == g_urids.log_Warning || type == g_urids.log_Note)
+    if (effect->hints & HINT_TRIGGERS)
     {
-        ret = vasprintf(&strp, fmt, ap);
-
-        if (ret < 0)
-            return ret;
-
-        if (strp == NULL)
+        for (i = 0; i < effect->input_control_ports_count; i++)
         {
-            errno = ENOMEM;
-            return -1;
-        }
+            port = effect->input_control_ports[i];
 
-        if (type == g_urids.log_Error)
-        {
-            fprintf(stderr, "\x1b[31m");
-            fputs(strp, stderr);
-            fprintf(stderr, "\x1b[0m\n");
-            fflush(stderr);
-        }
-        else if (type == g_urids.log_Warning)
-        {
-            fputs(strp, stderr);
-            fflush(stderr);
-        }
-        else
-        {
-            fputs(strp, stdout);
-            fflush(stdout);
+            if ((port->hints & HINT_TRIGGER) && floats_differ_enough(port->prev_value, port->def_value))
+                port->prev_value = *(port->buffer) = port->def_value;
         }
     }
-    else if (type == g_urids.log_Trace)
-    {
-        // handled later during event reserve
-        ret = 0;
-    }
-    else
+
+    if (effect->hints & HINT_OUTPUT_MONITORS)
     {
-        errno = EINVAL;
-        return -1;
-    }
+        for (i = 0; i < effect->output_control_ports_count; i++)
+        {
+            port = effect->output_control_ports[i];
 
-    postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+            if ((port->hints & HINT_MONITORED) == 0)
+                continue;
 
-    if (posteventptr == NULL)
-    {
-        free(strp);
-        return ret;
-    }
+            value = *(port->buffer);
 
-    if (type == g_urids.log_Trace)
-    {
-        posteventptr->event.type = POSTPONED_LOG_TRACE;
-        ret = vsnprintf(posteventptr->event.log_trace.msg, sizeof(posteventptr->event.log_trace.msg)-1, fmt, ap);
-        posteventptr->event.log_trace.msg[sizeof(posteventptr->event.log_trace.msg)-1] = '\0';
-        if (g_verbose_debug) {
-            fprintf(stdout, "\x1b[30;1m");
-            fputs(posteventptr->event.log_trace.msg, stdout);
-            fprintf(stdout, "\x1b[0m\n");
-            fflush(stdout);
-        }
-    }
-    else
-    {
-        posteventptr->event.type = POSTPONED_LOG_MESSAGE;
+            if (! floats_differ_enough(port->prev_value, value))
+                continue;
 
-        if (type == g_urids.log_Error)
-            posteventptr->event.log_message.type = LOG_ERROR;
-        else if (type == g_urids.log_Warning)
-            posteventptr->event.log_message.type = LOG_WARNING;
-        else
-            posteventptr->event.log_message.type = LOG_NOTE;
+            if (! FeedbackSlotSet(effect, port, FEEDBACK_SLOT_OUTPUT_SET, value))
+                continue;
 
-        posteventptr->event.log_message.msg = strp;
+            port->prev_value = value;
+            needs_post = true;
+        }
     }
 
-    pthread_mutex_lock(&g_rtsafe_mutex);
-    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-    pthread_mutex_unlock(&g_rtsafe_mutex);
+    effect->was_bypassed = effect->bypass > 0.5f;
 
-    sem_post(&g_postevents_semaphore);
-    return ret;
+    if (effect->hints & HINT_STATE_UNSAFE)
+        pthread_mutex_unlock(&effect->state_restore_mutex);
 
-    UNUSED_PARAM(handle);
+    if (needs_post)
+        sem_post(&g_postevents_semaphore);
+
+    return 0;
 }
 
-static LV2_ControlInputPort_Change_Status RequestControlPortChange(LV2_ControlInputPort_Change_Request_Handle handle,
-                                                                   uint32_t index,
-                                                                   float value)
+static jack_port_t *RegisterEffectJackPort(effect_t *effect, const char *symbol, const char *type, unsigned long flags)
 {
-    effect_t *effect = (effect_t*)handle;
+    if (! IsInProcessEffect(effect))
+        return jack_port_register(effect->jack_client, symbol, type, flags, 0);
 
-    if (index >= effect->ports_count)
-        return LV2_CONTROL_INPUT_PORT_CHANGE_ERR_INVALID_INDEX;
+    // in-process effects share the global client, so prefix their ports with the instance
+    char port_name[MAX_CHAR_BUF_SIZE+1];
+    snprintf(port_name, MAX_CHAR_BUF_SIZE, "effect_%i_%s", effect->instance, symbol);
+    port_name[MAX_CHAR_BUF_SIZE] = '\0';
 
-    port_t *port = effect->ports[index];
+    return jack_port_register(g_jack_global_client, port_name, type, flags, 0);
+}
 
-    if (port->type != TYPE_CONTROL || port->flow != FLOW_INPUT)
-        return LV2_CONTROL_INPUT_PORT_CHANGE_ERR_INVALID_INDEX;
+static void SetJackPortRanges(jack_client_t *jack_client, jack_port_t *jack_port, const port_t *port)
+{
+    if ((port->hints & HINT_CV_RANGES) == 0)
+        return;
 
-    // ignore requests for same value
-    if (!floats_differ_enough(port->prev_value, value))
-        return LV2_CONTROL_INPUT_PORT_CHANGE_SUCCESS;
+    jack_uuid_t uuid = jack_port_uuid(jack_port);
+    if (jack_uuid_empty(uuid))
+        return;
 
-    if (SetPortValue(port, value, effect->instance, false, false))
-        sem_post(&g_postevents_semaphore);
+    char str_value[32];
+    mod_memset(str_value, 0, sizeof(str_value));
 
-    return LV2_CONTROL_INPUT_PORT_CHANGE_SUCCESS;
+    snprintf(str_value, 31, "%f", port->min_value);
+    jack_set_property(jack_client, uuid, LV2_CORE__minimum, str_value, NULL);
+
+    snprintf(str_value, 31, "%f", port->max_value);
+    jack_set_property(jack_client, uuid, LV2_CORE__maximum, str_value, NULL);
 }
 
-static LV2_Control_Port_State_Update_Status UpdateControlPortState(LV2_Control_Port_State_Update_Handle handle,
-                                                                   uint32_t index,
-                                                                   LV2_Control_Port_State state)
+static void GraphFreePlan(graph_plan_t *plan)
 {
-    effect_t *effect = (effect_t*)handle;
+    if (plan == NULL)
+        return;
 
-    if (index >= effect->ports_count)
-        return LV2_CONTROL_PORT_STATE_UPDATE_ERR_INVALID_INDEX;
+    for (uint32_t i = 0; i < plan->nodes_count; i++)
+    {
+        graph_node_t *node = &plan->nodes[i];
 
-    port_t *port = effect->ports[index];
+        for (uint32_t j = 0; j < node->inputs_count; j++)
+            free(node->inputs[j].sources);
 
-    if (port->type != TYPE_CONTROL)
-        return LV2_CONTROL_PORT_STATE_UPDATE_ERR_INVALID_INDEX;
+        free(node->inputs);
+        free(node->outputs);
+        free(node->successors);
+    }
 
-    LV2_Control_Port_State curstate;
-    if (port->hints & HINT_STATE_BLOCKED)
-        curstate = LV2_CONTROL_PORT_STATE_BLOCKED;
-    else if (port->hints & HINT_STATE_INACTIVE)
-        curstate = LV2_CONTROL_PORT_STATE_INACTIVE;
-    else
-        curstate = LV2_CONTROL_PORT_STATE_NONE;
+    if (plan->deques != NULL)
+    {
+        for (uint32_t i = 0; i < plan->deques_count; i++)
+            free(plan->deques[i].items);
 
-    if (curstate == state)
-        return LV2_CONTROL_PORT_STATE_UPDATE_SUCCESS;
+        free(plan->deques);
+    }
 
-    postponed_event_list_data* const posteventptr =
-        rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
+    free(plan->nodes);
+    free(plan);
+}
 
-    if (posteventptr == NULL)
-        return LV2_CONTROL_PORT_STATE_UPDATE_ERR_UNKNOWN;
+static bool GraphSetupScheduling(graph_plan_t *plan, const int *node_index, const uint32_t *plan_index)
+{
+    plan->parallel = true;
 
-    switch (state)
+    for (uint32_t j = 0; j < g_graph_edges_count; j++)
     {
-    case LV2_CONTROL_PORT_STATE_NONE:
-        port->hints &= ~(HINT_STATE_INACTIVE|HINT_STATE_BLOCKED);
-        break;
-    case LV2_CONTROL_PORT_STATE_INACTIVE:
-        port->hints |= HINT_STATE_INACTIVE;
-        port->hints &= ~HINT_STATE_BLOCKED;
-        break;
-    case LV2_CONTROL_PORT_STATE_BLOCKED:
-        port->hints |= HINT_STATE_INACTIVE|HINT_STATE_BLOCKED;
-        break;
-    }
-
-    posteventptr->event.type = POSTPONED_PARAM_STATE;
-    posteventptr->event.state.effect_id = effect->instance;
-    posteventptr->event.state.symbol    = port->symbol;
-    posteventptr->event.state.state     = state;
+        const int source = node_index[g_graph_edges[j].source_id];
+        const int target = node_index[g_graph_edges[j].target_id];
 
-    pthread_mutex_lock(&g_rtsafe_mutex);
-    list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-    pthread_mutex_unlock(&g_rtsafe_mutex);
+        if (source < 0 || target < 0 || source == target)
+            continue;
 
-    sem_post(&g_postevents_semaphore);
+        // edges going backwards in the plan come from feedback loops, these must run in plan order
+        if (plan_index[source] > plan_index[target])
+        {
+            plan->parallel = false;
+            return true;
+        }
 
-    return LV2_CONTROL_PORT_STATE_UPDATE_SUCCESS;
-}
+        plan->nodes[plan_index[source]].successors_count++;
+    }
 
-static char* MakePluginStatePathFromSratchDir(LV2_State_Make_Path_Handle handle, const char *path)
-{
-    effect_t *effect = (effect_t*)handle;
-    return MakePluginStatePath(effect->instance, g_lv2_scratch_dir, path);
-}
+    for (uint32_t i = 0; i < plan->nodes_count; i++)
+    {
+        graph_node_t *node = &plan->nodes[i];
 
-static char* MakePluginStatePathDuringLoadSave(LV2_State_Make_Path_Handle handle, const char *path)
-{
-    effect_t *effect = (effect_t*)handle;
-    return MakePluginStatePath(effect->instance, effect->state_dir, path);
-}
+        if (node->successors_count == 0)
+            continue;
 
-#ifdef HAVE_CONTROLCHAIN
-static void CCDataUpdate(void* arg)
-{
-    cc_update_list_t *updates = arg;
+        node->successors = (uint32_t *) malloc(sizeof(uint32_t) * node->successors_count);
+        if (!node->successors)
+            return false;
 
-    bool is_bypass, needs_post = false;
-    const int device_id = updates->device_id;
+        node->successors_count = 0;
+    }
 
-    for (int i = 0; i < updates->count; i++)
+    for (uint32_t j = 0; j < g_graph_edges_count; j++)
     {
-        cc_update_data_t *data = &updates->list[i];
-        assignment_t *assignment =
-            &g_assignments_list[device_id][data->assignment_id];
+        const int source = node_index[g_graph_edges[j].source_id];
+        const int target = node_index[g_graph_edges[j].target_id];
 
-        if (!assignment->port)
+        if (source < 0 || target < 0 || source == target)
             continue;
 
-        if (g_verbose_debug) {
-            printf("DEBUG: CCDataUpdate received %f as value of portsymbol %s (with prev value as %f)\n",
-                   data->value, assignment->port->symbol, assignment->port->prev_value);
-            fflush(stdout);
-        }
-
-        // invert value if bypass
-        if ((is_bypass = !strcmp(assignment->port->symbol, g_bypass_port_symbol)))
-            data->value = 1.0f - data->value;
+        graph_node_t *node = &plan->nodes[plan_index[source]];
+        uint32_t k;
 
-        // ignore requests for same value
-        if (!floats_differ_enough(assignment->port->prev_value, data->value))
+        // several connections between the same 2 effects count as a single dependency
+        for (k = 0; k < node->successors_count; k++)
         {
-            if (g_verbose_debug) {
-                puts("DEBUG: CCDataUpdate ignoring value change (matches previous value)");
-                fflush(stdout);
-            }
-            continue;
+            if (node->successors[k] == plan_index[target])
+                break;
         }
 
-        if (SetPortValue(assignment->port, data->value, assignment->effect_id, is_bypass, false))
-            needs_post = true;
-    }
+        if (k != node->successors_count)
+            continue;
 
-    if (needs_post)
-        sem_post(&g_postevents_semaphore);
-}
+        node->successors[node->successors_count++] = plan_index[target];
+        plan->nodes[plan_index[target]].deps_count++;
+    }
 
-static void InitializeControlChainIfNeeded(void)
-{
-    if (g_cc_client != NULL)
-        return;
+    if (g_graph_workers_count == 0 || plan->nodes_count < 2)
+        return true;
 
-    if ((g_cc_client = cc_client_new("/tmp/control-chain.sock")) != NULL)
-        cc_client_data_update_cb(g_cc_client, CCDataUpdate);
-}
+    // nodes at the same depth can run at the same time, only wake as many workers as that allows
+    uint32_t *levels = (uint32_t *) calloc(plan->nodes_count * 2, sizeof(uint32_t));
+    if (!levels)
+        return false;
 
-static bool CheckCCDeviceProtocolVersion(int device_id, int major, int minor)
-{
-    char *descriptor = cc_client_device_descriptor(g_cc_client, device_id);
+    uint32_t *level_counts = levels + plan->nodes_count;
+    uint32_t width = 0;
 
-    if (!descriptor)
+    for (uint32_t i = 0; i < plan->nodes_count; i++)
     {
-        printf("CheckCCDeviceProtocolVersion error: failed to get device descriptor with id %i\n", device_id);
-        return false;
+        const graph_node_t *node = &plan->nodes[i];
+
+        if (width < ++level_counts[levels[i]])
+            width = level_counts[levels[i]];
+
+        for (uint32_t k = 0; k < node->successors_count; k++)
+        {
+            if (levels[node->successors[k]] < levels[i] + 1)
+                levels[node->successors[k]] = levels[i] + 1;
+        }
     }
 
-    // we quickly parse the json ourselves in order to prevent adding more dependencies into mod-host
-    const char *vsplit, *vstart, *vend;
+    free(levels);
 
-    vsplit = strstr(descriptor, "\"protocol\":");
-    if (!vsplit)
+    // a serial chain, workers would only spin
+    if (width < 2)
+        return true;
+
+    plan->deques_count = width < g_graph_workers_count + 1 ? width : g_graph_workers_count + 1;
+    plan->deques = (graph_deque_t *) calloc(plan->deques_count, sizeof(graph_deque_t));
+    if (!plan->deques)
+        return false;
+
+    for (uint32_t i = 0; i < plan->deques_count; i++)
     {
-        puts("CheckCCDeviceProtocolVersion error: failed to find protocol field");
-        goto free;
+        plan->deques[i].items = (uint32_t *) malloc(sizeof(uint32_t) * plan->nodes_count);
+        if (!plan->deques[i].items)
+            return false;
     }
 
-    vstart = strstr(vsplit+10, "\"");
-    if (!vstart)
+    return true;
+}
+
+static bool GraphFillNode(graph_node_t *node, const int *node_index)
+{
+    effect_t *effect = node->effect;
+
+    node->inputs_count = effect->input_audio_ports_count + effect->input_cv_ports_count;
+    node->outputs_count = effect->output_audio_ports_count + effect->output_cv_ports_count;
+
+    if (node->inputs_count != 0)
     {
-        puts("CheckCCDeviceProtocolVersion error: failed to find protocol field start");
-        goto free;
+        node->inputs = (graph_input_t *) calloc(node->inputs_count, sizeof(graph_input_t));
+        if (!node->inputs)
+            return false;
     }
-    ++vstart;
 
-    vend = strstr(vstart, "\"");
-    if (!vend)
+    if (node->outputs_count != 0)
     {
-        puts("CheckCCDeviceProtocolVersion error: failed to find protocol field end");
-        goto free;
+        node->outputs = (graph_output_t *) calloc(node->outputs_count, sizeof(graph_output_t));
+        if (!node->outputs)
+            return false;
     }
 
-    char buf_major[8] = {0};
-    char buf_minor[8] = {0};
-    char *buf = buf_major;
-
-    for (int i=0; i<7; ++vstart)
+    for (uint32_t i = 0; i < node->inputs_count; i++)
     {
-        if (*vstart >= '0' && *vstart <= '9')
+        graph_input_t *input = &node->inputs[i];
+        port_t *port = i < effect->input_audio_ports_count
+                     ? effect->input_audio_ports[i]
+                     : effect->input_cv_ports[i - effect->input_audio_ports_count];
+
+        input->port = port;
+        input->jack_port = port->jack_port;
+
+        uint32_t sources_count = 0;
+        for (uint32_t j = 0; j < g_graph_edges_count; j++)
         {
-            buf[i++] = *vstart;
-            continue;
+            if (g_graph_edges[j].target == port && node_index[g_graph_edges[j].source_id] >= 0)
+                sources_count++;
         }
 
-        if (*vstart == '.' && buf == buf_major)
-        {
-            i = 0;
-            buf = buf_minor;
+        if (sources_count == 0)
             continue;
-        }
 
-        break;
+        input->sources = (port_t **) malloc(sizeof(port_t *) * sources_count);
+        if (!input->sources)
+            return false;
+
+        for (uint32_t j = 0; j < g_graph_edges_count; j++)
+        {
+            if (g_graph_edges[j].target == port && node_index[g_graph_edges[j].source_id] >= 0)
+                input->sources[input->sources_count++] = g_graph_edges[j].source;
+        }
     }
 
-    const int device_major = atoi(buf_major);
-    const int device_minor = atoi(buf_minor);
+    for (uint32_t i = 0; i < node->outputs_count; i++)
+    {
+        graph_output_t *output = &node->outputs[i];
+        port_t *port = i < effect->output_audio_ports_count
+                     ? effect->output_audio_ports[i]
+                     : effect->output_cv_ports[i - effect->output_audio_ports_count];
 
-    free(descriptor);
-    return device_major >= major && device_minor >= minor;
+        output->port = port;
+        output->jack_port = port->jack_port;
+    }
 
-free:
-    free(descriptor);
-    return false;
+    return true;
 }
-#endif
 
-#ifdef HAVE_HYLIA
-static uint32_t GetHyliaOutputLatency(void)
+static graph_plan_t *GraphCreatePlan(void)
 {
-    const long long int latency = llround(1.0e6 * g_block_length / g_sample_rate);
-
-    if (latency >= 0 && latency < UINT32_MAX)
-        return (uint32_t)latency;
-
-    return 0;
-}
-#endif
+    graph_plan_t *plan = (graph_plan_t *) calloc(1, sizeof(graph_plan_t));
+    if (!plan)
+        return NULL;
 
-#ifdef WITH_EXTERNAL_UI_SUPPORT
-static void ExternalControllerWriteFunction(LV2UI_Controller controller,
-                                            uint32_t port_index,
-                                            uint32_t buffer_size,
-                                            uint32_t port_protocol,
-                                            const void *buffer)
-{
-    if (port_protocol != 0)
+    uint32_t count = 0;
+    for (int i = 0; i < MAX_INSTANCES; i++)
     {
-        printf("ExternalControllerWriteFunction %p %u %u %u %p\n", controller, port_index, buffer_size, port_protocol, buffer);
-        return;
+        if (g_effects[i].in_graph)
+            count++;
     }
 
-    effect_t *effect = (effect_t*)controller;
+    if (count == 0)
+        return plan;
 
-    if (port_index >= effect->ports_count)
-        return;
+    int *node_index = (int *) malloc(sizeof(int) * MAX_INSTANCES);
+    effect_t **effects = (effect_t **) malloc(sizeof(effect_t *) * count);
+    uint32_t *indegree = (uint32_t *) calloc(count, sizeof(uint32_t));
+    uint32_t *plan_index = (uint32_t *) calloc(count, sizeof(uint32_t));
+    bool *placed = (bool *) calloc(count, sizeof(bool));
+    plan->nodes = (graph_node_t *) calloc(count, sizeof(graph_node_t));
 
-    port_t *port = effect->ports[port_index];
-    const float value = *((const float*)buffer);
+    if (!node_index || !effects || !indegree || !plan_index || !placed || !plan->nodes)
+        goto error;
 
-    if (port->type != TYPE_CONTROL || port->flow != FLOW_INPUT)
-        return;
+    for (int i = 0, k = 0; i < MAX_INSTANCES; i++)
+    {
+        if (g_effects[i].in_graph)
+        {
+            node_index[i] = k;
+            effects[k++] = &g_effects[i];
+        }
+        else
+        {
+            node_index[i] = -1;
+        }
+    }
 
-    // ignore requests for same value
-    if (!floats_differ_enough(port->prev_value, value))
-        return;
+    for (uint32_t j = 0; j < g_graph_edges_count; j++)
+    {
+        const int source = node_index[g_graph_edges[j].source_id];
+        const int target = node_index[g_graph_edges[j].target_id];
 
-    if (SetPortValue(port, value, effect->instance, false, true))
-        sem_post(&g_postevents_semaphore);
-}
-#endif
+        if (source >= 0 && target >= 0 && source != target)
+            indegree[target]++;
+    }
 
-/*
-************************************************************************************************************************
-*           GLOBAL FUNCTIONS
-************************************************************************************************************************
-*/
-
-int effects_init(void* client)
-{
-    /* This global client is for connections / disconnections and midi-learn */
-    if (client != NULL)
+    // topological sort, effects left in a feedback loop are run in instance order
+    while (plan->nodes_count < count)
     {
-        g_jack_global_client = (jack_client_t*)client;
+        int next = -1;
+
+        for (uint32_t k = 0; k < count; k++)
+        {
+            if (!placed[k] && indegree[k] == 0)
+            {
+                next = k;
+                break;
+            }
+        }
+
+        if (next < 0)
+        {
+            for (uint32_t k = 0; k < count; k++)
+            {
+                if (!placed[k])
+                {
+                    next = k;
+                    break;
+                }
+            }
+        }
+
+        placed[next] = true;
+        plan_index[next] = plan->nodes_count;
+        plan->nodes[plan->nodes_count++].effect = effects[next];
+
+        for (uint32_t j = 0; j < g_graph_edges_count; j++)
+        {
+            const int target = node_index[g_graph_edges[j].target_id];
+
+            if (node_index[g_graph_edges[j].source_id] == next && target >= 0 && target != next && indegree[target] != 0)
+                indegree[target]--;
+        }
     }
-    else
+
+    for (uint32_t i = 0; i < plan->nodes_count; i++)
     {
-        g_jack_global_client = jack_client_open("mod-host", JackNoStartServer, NULL);
+        if (!GraphFillNode(&plan->nodes[i], node_index))
+            goto error;
     }
 
-    if (g_jack_global_client == NULL)
+    if (!GraphSetupScheduling(plan, node_index, plan_index))
+        goto error;
+
+    free(node_index);
+    free(effects);
+    free(indegree);
+    free(plan_index);
+    free(placed);
+    return plan;
+
+error:
+    free(node_index);
+    free(effects);
+    free(indegree);
+    free(plan_index);
+    free(placed);
+    GraphFreePlan(plan);
+    return NULL;
+}
+
+static void GraphRebuild(void)
+{
+    graph_plan_t *plan = NULL;
+
+    if (g_graph_engine_enabled)
     {
-        return ERR_JACK_CLIENT_CREATION;
+        plan = GraphCreatePlan();
+
+        // an outdated plan might point to removed ports, so run nothing instead
+        if (plan == NULL)
+            fprintf(stderr, "can't create graph plan, in-process effects are stopped\n");
     }
 
-    /* Register jack ports */
-    g_midi_in_port = jack_port_register(g_jack_global_client, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    pthread_mutex_lock(&g_graph_mutex);
+    graph_plan_t *old_plan = __atomic_exchange_n(&g_graph_plan, plan, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&g_graph_mutex);
 
-    if (! g_midi_in_port)
+    // the audio thread might still be running the old plan
+    if (old_plan != NULL)
     {
-        fprintf(stderr, "can't register global jack midi-in port\n");
-        if (client == NULL)
-            jack_client_close(g_jack_global_client);
-        return ERR_JACK_PORT_REGISTER;
+        while (__atomic_load_n(&g_graph_plan_in_use, __ATOMIC_SEQ_CST) == old_plan)
+            sched_yield();
     }
 
-#ifdef MOD_IO_PROCESSING_ENABLED
-    g_audio_in1_port = jack_port_register(g_jack_global_client, "in1", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
-    g_audio_in2_port = jack_port_register(g_jack_global_client, "in2", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
-    g_audio_out1_port = jack_port_register(g_jack_global_client, "out1", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
-    g_audio_out2_port = jack_port_register(g_jack_global_client, "out2", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    GraphFreePlan(old_plan);
+}
 
-    if (! (g_audio_in1_port && g_audio_in2_port && g_audio_out1_port && g_audio_out2_port))
+// waits for the current cycle to finish, later cycles see all changes made before calling this
+static void GraphSync(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    const uint32_t cycles_done = __atomic_load_n(&g_graph_cycles_done, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&g_graph_plan_in_use, __ATOMIC_SEQ_CST) == NULL)
+        return;
+
+    while (__atomic_load_n(&g_graph_cycles_done, __ATOMIC_ACQUIRE) == cycles_done)
+        sched_yield();
+}
+
+// writes silence to the outputs connected outside the graph
+static void GraphSilenceOutputs(const graph_plan_t *plan, jack_nframes_t nframes)
+{
+    for (uint32_t i = 0; i < plan->nodes_count; i++)
     {
-        fprintf(stderr, "can't register global jack audio ports\n");
-        if (client == NULL)
-            jack_client_close(g_jack_global_client);
-        return ERR_JACK_PORT_REGISTER;
+        const graph_node_t *node = &plan->nodes[i];
+        const effect_t *effect = node->effect;
+
+        for (uint32_t j = 0; j < node->outputs_count; j++)
+        {
+            if (node->outputs[j].jack_port != NULL)
+                memset(jack_port_get_buffer(node->outputs[j].jack_port, nframes), 0, sizeof(float) * nframes);
+        }
+
+        for (uint32_t j = 0; j < effect->output_event_ports_count; j++)
+        {
+            const port_t *port = effect->output_event_ports[j];
+            if (port->jack_port)
+                jack_midi_clear_buffer(jack_port_get_buffer(port->jack_port, nframes));
+        }
     }
+}
 
-    jack_port_tie(g_audio_in1_port, g_audio_out1_port);
-    jack_port_tie(g_audio_in2_port, g_audio_out2_port);
-#endif
+static void RunGraphNode(graph_node_t *node, jack_nframes_t nframes)
+{
+    effect_t *effect = node->effect;
+    uint32_t i;
 
-    if (g_jack_global_client != NULL && strcmp(jack_get_client_name(g_jack_global_client), "mod-host") == 0 && ! monitor_client_init())
+    if (effect->jack_activated)
     {
-        return ERR_JACK_CLIENT_CREATION;
-    }
+        /* Gather inputs, mixing only when needed */
+        for (i = 0; i < node->inputs_count; i++)
+        {
+            graph_input_t *input = &node->inputs[i];
+            port_t *port = input->port;
+            float *external = input->jack_port != NULL
+                            ? (float*)jack_port_get_buffer(input->jack_port, nframes)
+                            : NULL;
 
-    memset(g_effects, 0, sizeof(g_effects));
+            switch (input->sources_count + (external != NULL ? 1 : 0))
+            {
+            case 0:
+                port->graph_data = g_graph_silence;
+                break;
+            case 1:
+                port->graph_data = external != NULL ? external : input->sources[0]->graph_buffer;
+                break;
+            default:
+            {
+                float *mix = port->graph_buffer;
+                uint32_t j = 0;
 
-    INIT_LIST_HEAD(&g_rtsafe_list);
-    INIT_LIST_HEAD(&g_raw_midi_port_list);
+                if (external != NULL)
+                    memcpy(mix, external, sizeof(float) * nframes);
+                else
+                    memcpy(mix, input->sources[j++]->graph_buffer, sizeof(float) * nframes);
 
-    if (!rtsafe_memory_pool_create(&g_rtsafe_mem_pool, sizeof(postponed_event_list_data), MAX_POSTPONED_EVENTS))
+                for (; j < input->sources_count; j++)
+                {
+                    const float *source = input->sources[j]->graph_buffer;
+
+                    for (jack_nframes_t k = 0; k < nframes; k++)
+                        mix[k] += source[k];
+                }
+
+                port->graph_data = mix;
+                break;
+            }
+            }
+        }
+
+        ProcessPlugin(nframes, effect);
+    }
+    else
     {
-        fprintf(stderr, "can't allocate realtime-safe memory pool\n");
-        if (client == NULL)
-            jack_client_close(g_jack_global_client);
-        return ERR_MEMORY_ALLOCATION;
+        for (i = 0; i < node->outputs_count; i++)
+            memset(node->outputs[i].port->graph_buffer, 0, sizeof(float) * nframes);
+
+        for (i = 0; i < effect->output_event_ports_count; i++)
+        {
+            port_t *port = effect->output_event_ports[i];
+            if (port->jack_port)
+                jack_midi_clear_buffer(jack_port_get_buffer(port->jack_port, nframes));
+        }
     }
 
-    pthread_mutexattr_t mutex_atts;
-    pthread_mutexattr_init(&mutex_atts);
-#ifdef __MOD_DEVICES__
-    pthread_mutexattr_setprotocol(&mutex_atts, PTHREAD_PRIO_INHERIT);
-#endif
+    /* Copy outputs connected outside the graph */
+    for (i = 0; i < node->outputs_count; i++)
+    {
+        graph_output_t *output = &node->outputs[i];
 
-    pthread_mutex_init(&g_rtsafe_mutex, &mutex_atts);
-    pthread_mutex_init(&g_raw_midi_port_mutex, &mutex_atts);
-    pthread_mutex_init(&g_audio_monitor_mutex, &mutex_atts);
-    pthread_mutex_init(&g_midi_learning_mutex, &mutex_atts);
-    pthread_mutex_init(&g_sync_scheduled_params_mutex, &mutex_atts);
-#ifdef MOD_HMI_CONTROL_ENABLED
-    pthread_mutex_init(&g_hmi_mutex, &mutex_atts);
+        if (output->jack_port != NULL)
+            memcpy(jack_port_get_buffer(output->jack_port, nframes),
+                   output->port->graph_buffer, sizeof(float) * nframes);
+    }
+}
+
+static inline void GraphCpuRelax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__ ("yield" ::: "memory");
 #endif
+}
 
-    sem_init(&g_postevents_semaphore, 0, 0);
+static inline void GraphDequePush(graph_deque_t *deque, uint32_t item)
+{
+    const int32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    deque->items[bottom] = item;
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+}
 
-    /* Get the system ports */
-    g_capture_ports = jack_get_ports(g_jack_global_client, "system", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput);
-    g_playback_ports = jack_get_ports(g_jack_global_client, "system", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput);
+static inline int32_t GraphDequePop(graph_deque_t *deque)
+{
+    const int32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_SEQ_CST);
+    int32_t top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
 
-    /* Get buffers size */
-    g_block_length = jack_get_buffer_size(g_jack_global_client);
-    g_sample_rate = jack_get_sample_rate(g_jack_global_client);
-    g_sample_rate_f = g_sample_rate;
-    g_midi_buffer_size = jack_port_type_get_buffer_size(g_jack_global_client, JACK_DEFAULT_MIDI_TYPE);
-    g_max_allowed_midi_delta = (jack_nframes_t)(g_sample_rate * 0.2); // max 200ms of allowed delta
+    if (top > bottom)
+    {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return -1;
+    }
 
-    /* Get RT thread information */
-    const char* const mod_plugthreadprio = getenv("MOD_PLUGIN_THREAD_PRIORITY");
-    if (mod_plugthreadprio != NULL)
+    int32_t item = (int32_t)deque->items[bottom];
+
+    // last item, race against thieves
+    if (top == bottom)
     {
-        g_thread_priority = atoi(mod_plugthreadprio);
-        g_thread_policy = SCHED_FIFO;
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            item = -1;
+
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
     }
-    else
+
+    return item;
+}
+
+static inline int32_t GraphDequeSteal(graph_deque_t *deque)
+{
+    int32_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const int32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom)
+        return -1;
+
+    const int32_t item = (int32_t)deque->items[top];
+
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return -1;
+
+    return item;
+}
+
+// process ready nodes until the whole plan is done, returns the time spent running plugins
+static uint64_t GraphRunNodes(graph_plan_t *plan, uint32_t self, jack_nframes_t nframes)
+{
+    graph_deque_t *own = &plan->deques[self];
+    uint64_t busy_ns = 0;
+
+    while (__atomic_load_n(&plan->remaining, __ATOMIC_ACQUIRE) > 0)
     {
-        const int prio = jack_is_realtime(g_jack_global_client)
-                       ? jack_client_real_time_priority(g_jack_global_client)
-                       : -1;
-        if (prio > 1)
+        int32_t index = GraphDequePop(own);
+
+        for (uint32_t k = 1; index < 0 && k < plan->deques_count; k++)
+            index = GraphDequeSteal(&plan->deques[(self + k) % plan->deques_count]);
+
+        if (index < 0)
         {
-            g_thread_priority = prio - 1;
-            g_thread_policy = SCHED_FIFO;
+            GraphCpuRelax();
+            continue;
         }
-        else
+
+        graph_node_t *node = &plan->nodes[index];
+
+        const uint64_t start = GetTimeNs();
+        RunGraphNode(node, nframes);
+        busy_ns += GetTimeNs() - start;
+
+        for (uint32_t i = 0; i < node->successors_count; i++)
         {
-            g_thread_priority = 0;
-            g_thread_policy = SCHED_OTHER;
+            if (__atomic_sub_fetch(&plan->nodes[node->successors[i]].pending, 1, __ATOMIC_ACQ_REL) == 0)
+                GraphDequePush(own, node->successors[i]);
         }
+
+        __atomic_sub_fetch(&plan->remaining, 1, __ATOMIC_RELEASE);
     }
 
-    /* initial transport state */
-    g_transport_reset = true;
-    g_transport_bpb = 4.0;
-    g_transport_bpm = 120.0;
-    g_transport_sync_mode = TRANSPORT_SYNC_NONE;
+    return busy_ns;
+}
 
-    /* check verbose mode */
-    const char* const mod_log = getenv("MOD_LOG");
-    g_verbose_debug = mod_log != NULL && atoi(mod_log) != 0;
+static void* GraphWorkerThread(void* arg)
+{
+    graph_worker_t *worker = arg;
 
-    /* this fails to build if GLOBAL_EFFECT_ID >= MAX_INSTANCES */
-    char global_effect_id_static_check1[GLOBAL_EFFECT_ID >= MAX_PLUGIN_INSTANCES?1:-1];
-    char global_effect_id_static_check2[GLOBAL_EFFECT_ID < MAX_INSTANCES?1:-1];
+    JackThreadInit(NULL);
 
-    /* global ports */
+    for (;;)
     {
-        port_t **ports = (port_t **) calloc(3, sizeof(port_t *));
+        sem_wait(&worker->sem);
 
-        port_t *port_bpb = ports[0] = calloc(1, sizeof(port_t));
-        port_bpb->buffer = &port_bpb->prev_value;
-        port_bpb->buffer_count = 1;
-        port_bpb->min_value = 0.0f;
-        port_bpb->max_value = 1.0f;
-        port_bpb->def_value = 0.0f;
-        port_bpb->type = TYPE_CONTROL;
-        port_bpb->flow = FLOW_INPUT;
-        port_bpb->hints = 0x0;
-        port_bpb->symbol = g_bpb_port_symbol;
-        pthread_mutex_init(&port_bpb->cv_source_mutex, &mutex_atts);
+        if (!g_graph_workers_running)
+            break;
 
-        port_t *port_bpm = ports[1] = calloc(1, sizeof(port_t));
-        port_bpm->buffer = &port_bpm->prev_value;
-        port_bpm->buffer_count = 1;
-        port_bpm->min_value = 0.0f;
-        port_bpm->max_value = 1.0f;
-        port_bpm->def_value = 0.0f;
-        port_bpm->type = TYPE_CONTROL;
-        port_bpm->flow = FLOW_INPUT;
-        port_bpm->hints = 0x0;
-        port_bpm->symbol = g_bpm_port_symbol;
-        pthread_mutex_init(&port_bpm->cv_source_mutex, &mutex_atts);
+        worker->busy_ns = GraphRunNodes(g_graph_cycle_plan, worker->index, g_graph_cycle_nframes);
 
-        port_t *port_rolling = ports[2] = calloc(1, sizeof(port_t));
-        port_rolling->buffer = &port_rolling->prev_value;
-        port_rolling->buffer_count = 1;
-        port_rolling->min_value = 0.0f;
-        port_rolling->max_value = 1.0f;
-        port_rolling->def_value = 0.0f;
-        port_rolling->type = TYPE_CONTROL;
-        port_rolling->flow = FLOW_INPUT;
-        port_rolling->hints = HINT_TOGGLE;
-        port_rolling->symbol = g_rolling_port_symbol;
-        pthread_mutex_init(&port_rolling->cv_source_mutex, &mutex_atts);
+        __atomic_add_fetch(&g_graph_cycle_checked_out, 1, __ATOMIC_RELEASE);
+    }
 
-        effect_t *effect = &g_effects[GLOBAL_EFFECT_ID];
+    return NULL;
+}
 
-        effect->instance = GLOBAL_EFFECT_ID;
-        effect->jack_client = g_jack_global_client;
+static void GraphStartWorkers(void)
+{
+    int count = 0;
 
-        effect->ports = effect->control_ports = effect->input_control_ports = ports;
-        effect->ports_count = effect->control_ports_count = effect->input_control_ports_count = 3;
+#ifndef _WIN32
+    const char* const mod_graph_workers = getenv("MOD_GRAPH_WORKERS");
+    if (mod_graph_workers != NULL)
+        count = atoi(mod_graph_workers);
+    else
+        count = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+#endif
 
-        effect->control_index = -1;
-        effect->enabled_index = -1;
-        effect->freewheel_index = -1;
-        effect->reset_index = -1;
-        effect->bpb_index = -1;
-        effect->bpm_index = -1;
-        effect->speed_index = -1;
+    if (count <= 0)
+        return;
+    if (count > MAX_GRAPH_WORKERS)
+        count = MAX_GRAPH_WORKERS;
+
+    // same priority as the jack process thread, which also takes part in the work
+    const int priority = jack_is_realtime(g_jack_global_client)
+                       ? jack_client_real_time_priority(g_jack_global_client)
+                       : -1;
+#ifdef __linux__
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    g_graph_workers_running = true;
+
+    for (int i = 0; i < count; i++)
+    {
+        graph_worker_t *worker = &g_graph_workers[g_graph_workers_count];
+        worker->index = g_graph_workers_count + 1;
+        worker->busy_ns = 0;
+        sem_init(&worker->sem, 0, 0);
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+
+        if (priority > 0)
+        {
+            struct sched_param param;
+            param.sched_priority = priority;
+
+            pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+            pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+            pthread_attr_setschedparam(&attr, &param);
+        }
+
+#ifdef __linux__
+        // keep away from the first core, where the jack process thread usually runs
+        if (cpus > 1)
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET((i + 1) % cpus, &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+#endif
+
+        const int ret = pthread_create(&worker->thread, &attr, GraphWorkerThread, worker);
+        pthread_attr_destroy(&attr);
+
+        // a regular thread would make the realtime audio thread spin on the nodes it took, run serially instead
+        if (ret != 0)
+        {
+            if (priority > 0)
+                fprintf(stderr, "can't create realtime graph worker thread, running %u of %i workers\n",
+                        g_graph_workers_count, count);
+            else
+                fprintf(stderr, "can't create graph worker thread\n");
+            sem_destroy(&worker->sem);
+            break;
+        }
+
+        g_graph_workers_count++;
+    }
+}
+
+static void GraphStopWorkers(void)
+{
+    g_graph_workers_running = false;
+
+    for (uint32_t i = 0; i < g_graph_workers_count; i++)
+        sem_post(&g_graph_workers[i].sem);
+
+    for (uint32_t i = 0; i < g_graph_workers_count; i++)
+    {
+        pthread_join(g_graph_workers[i].thread, NULL);
+        sem_destroy(&g_graph_workers[i].sem);
+    }
+
+    g_graph_workers_count = 0;
+}
+
+static void RunGraph(jack_nframes_t nframes)
+{
+    graph_plan_t *plan;
+
+    // announce the plan in use, then check it was not replaced meanwhile
+    do {
+        plan = __atomic_load_n(&g_graph_plan, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&g_graph_plan_in_use, plan, __ATOMIC_SEQ_CST);
+    } while (plan != __atomic_load_n(&g_graph_plan, __ATOMIC_SEQ_CST));
+
+    if (plan == NULL || plan->nodes_count == 0)
+    {
+        __atomic_store_n(&g_graph_plan_in_use, NULL, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&g_graph_cycles_done, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    if (__atomic_load_n(&g_graph_paused, __ATOMIC_SEQ_CST))
+    {
+        GraphSilenceOutputs(plan, nframes);
+        __atomic_store_n(&g_graph_plan_in_use, NULL, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&g_graph_cycles_done, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    const uint64_t start = GetTimeNs();
+    uint64_t busy_ns;
+
+    if (plan->parallel && plan->deques != NULL)
+    {
+        const uint32_t workers_count = plan->deques_count - 1;
+
+        for (uint32_t i = 0; i < plan->deques_count; i++)
+            plan->deques[i].top = plan->deques[i].bottom = 0;
+
+        // spread the nodes without dependencies over all threads
+        for (uint32_t i = 0, k = 0; i < plan->nodes_count; i++)
+        {
+            plan->nodes[i].pending = plan->nodes[i].deps_count;
+
+            if (plan->nodes[i].deps_count == 0)
+                GraphDequePush(&plan->deques[k++ % plan->deques_count], i);
+        }
+
+        plan->remaining = plan->nodes_count;
+        g_graph_cycle_plan = plan;
+        g_graph_cycle_nframes = nframes;
+        __atomic_store_n(&g_graph_cycle_checked_out, 0, __ATOMIC_RELEASE);
+
+        for (uint32_t i = 0; i < workers_count; i++)
+            sem_post(&g_graph_workers[i].sem);
+
+        busy_ns = GraphRunNodes(plan, 0, nframes);
+
+        // workers must be done with the plan before it can change
+        while (__atomic_load_n(&g_graph_cycle_checked_out, __ATOMIC_ACQUIRE) < (int32_t)workers_count)
+            GraphCpuRelax();
+
+        for (uint32_t i = 0; i < workers_count; i++)
+            busy_ns += g_graph_workers[i].busy_ns;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < plan->nodes_count; i++)
+            RunGraphNode(&plan->nodes[i], nframes);
+
+        busy_ns = GetTimeNs() - start;
+    }
+
+    __atomic_store_n(&g_graph_plan_in_use, NULL, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&g_graph_cycles_done, 1, __ATOMIC_RELEASE);
+
+    const uint64_t wall_ns = GetTimeNs() - start;
+
+    if (wall_ns != 0)
+    {
+        float parallelism = (float)busy_ns / (float)wall_ns;
+        float maximum;
+        __atomic_load(&g_graph_stats_max_parallelism, &maximum, __ATOMIC_RELAXED);
+
+        while (maximum < parallelism &&
+               !__atomic_compare_exchange(&g_graph_stats_max_parallelism, &maximum, &parallelism,
+                                          true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+    }
+
+    __atomic_add_fetch(&g_graph_stats_busy_ns, busy_ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_graph_stats_wall_ns, wall_ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_graph_stats_cycles, 1, __ATOMIC_RELAXED);
+}
+
+static port_t *GraphFindPort(const char *name, effect_t **effect_ptr)
+{
+    if (strncmp(name, "effect_", 7) != 0)
+        return NULL;
+
+    char *symbol;
+    const long effect_id = strtol(name + 7, &symbol, 10);
+
+    if (symbol == name + 7 || *symbol != ':' || !INSTANCE_IS_VALID(effect_id))
+        return NULL;
+
+    effect_t *effect = &g_effects[effect_id];
+
+    if (!effect->in_graph)
+        return NULL;
+
+    ++symbol;
+
+    for (uint32_t i = 0; i < effect->ports_count; i++)
+    {
+        port_t *port = effect->ports[i];
+
+        if (port->type != TYPE_AUDIO && port->type != TYPE_CV && port->type != TYPE_EVENT)
+            continue;
+
+        if (strcmp(port->symbol, symbol) == 0)
+        {
+            *effect_ptr = effect;
+            return port;
+        }
+    }
+
+    return NULL;
+}
+
+static jack_port_t *GraphEnsureJackPort(effect_t *effect, port_t *port)
+{
+    if (port->jack_port != NULL)
+        return port->jack_port;
+
+    unsigned long jack_flags = port->flow == FLOW_INPUT ? JackPortIsInput : JackPortIsOutput;
+    if (port->type == TYPE_CV)
+        jack_flags |= JackPortIsControlVoltage;
+
+    jack_port_t *jack_port = RegisterEffectJackPort(effect, port->symbol, JACK_DEFAULT_AUDIO_TYPE, jack_flags);
+    if (jack_port == NULL)
+        return NULL;
+
+    if (port->type == TYPE_CV)
+        SetJackPortRanges(g_jack_global_client, jack_port, port);
+
+    port->jack_port = jack_port;
+    GraphRebuild();
+
+    return jack_port;
+}
+
+static void GraphReleaseUnusedJackPorts(void)
+{
+    for (int i = 0; i < MAX_INSTANCES; i++)
+    {
+        effect_t *effect = &g_effects[i];
+
+        if (!effect->in_graph)
+            continue;
+
+        for (uint32_t j = 0; j < effect->ports_count; j++)
+        {
+            port_t *port = effect->ports[j];
+
+            if (port->type != TYPE_AUDIO && port->type != TYPE_CV)
+                continue;
+            if (port->jack_port == NULL || jack_port_connected(port->jack_port) != 0)
+                continue;
+
+            jack_port_t *jack_port = port->jack_port;
+
+            // make sure the audio thread no longer uses it before unregistering
+            port->jack_port = NULL;
+            GraphRebuild();
+
+            jack_port_unregister(g_jack_global_client, jack_port);
+        }
+    }
+}
+
+static int GraphAddEdge(effect_t *effectA, port_t *portA, effect_t *effectB, port_t *portB)
+{
+    // edges always go from output to input
+    if (portA->flow == FLOW_INPUT)
+    {
+        effect_t *effect = effectA;
+        port_t *port = portA;
+        effectA = effectB;
+        portA = portB;
+        effectB = effect;
+        portB = port;
+    }
+
+    if (portA->flow != FLOW_OUTPUT || portB->flow != FLOW_INPUT)
+        return ERR_JACK_PORT_CONNECTION;
+    if ((portA->type == TYPE_EVENT) != (portB->type == TYPE_EVENT))
+        return ERR_JACK_PORT_CONNECTION;
+
+    for (uint32_t i = 0; i < g_graph_edges_count; i++)
+    {
+        if (g_graph_edges[i].source == portA && g_graph_edges[i].target == portB)
+            return SUCCESS;
+    }
+
+    // midi still goes through jack, the edge only keeps the processing order
+    if (portA->type == TYPE_EVENT)
+    {
+        const int ret = jack_connect(g_jack_global_client, jack_port_name(portA->jack_port), jack_port_name(portB->jack_port));
+        if (ret != 0 && ret != EEXIST)
+            return ERR_JACK_PORT_CONNECTION;
+    }
+
+    graph_edge_t *edges = (graph_edge_t *) realloc(g_graph_edges, sizeof(graph_edge_t) * (g_graph_edges_count + 1));
+    if (!edges)
+        return ERR_MEMORY_ALLOCATION;
+
+    edges[g_graph_edges_count].source_id = effectA->instance;
+    edges[g_graph_edges_count].target_id = effectB->instance;
+    edges[g_graph_edges_count].source = portA;
+    edges[g_graph_edges_count].target = portB;
+
+    g_graph_edges = edges;
+    g_graph_edges_count++;
+
+    GraphRebuild();
+    return SUCCESS;
+}
+
+static bool GraphRemoveEdge(const port_t *portA, const port_t *portB)
+{
+    bool removed = false;
+
+    for (uint32_t i = 0; i < g_graph_edges_count;)
+    {
+        graph_edge_t *edge = &g_graph_edges[i];
+
+        if ((edge->source == portA && (edge->target == portB || portB == NULL)) ||
+            (edge->target == portA && (edge->source == portB || portB == NULL)))
+        {
+            if (edge->source->type == TYPE_EVENT)
+                jack_disconnect(g_jack_global_client, jack_port_name(edge->source->jack_port), jack_port_name(edge->target->jack_port));
+
+            *edge = g_graph_edges[--g_graph_edges_count];
+            removed = true;
+            continue;
+        }
+
+        i++;
+    }
+
+    if (removed)
+        GraphRebuild();
+
+    return removed;
+}
+
+static void GraphRemoveEdgesOfEffect(int effect_id)
+{
+    for (uint32_t i = 0; i < g_graph_edges_count;)
+    {
+        if (g_graph_edges[i].source_id == effect_id || g_graph_edges[i].target_id == effect_id)
+            g_graph_edges[i] = g_graph_edges[--g_graph_edges_count];
+        else
+            i++;
+    }
+}
+
+static void GraphReleaseEffectPorts(effect_t *effect)
+{
+    GraphRemoveEdgesOfEffect(effect->instance);
+
+    for (uint32_t i = 0; i < effect->ports_count + 2; i++)
+    {
+        port_t *port;
+
+        if (i < effect->ports_count)
+            port = effect->ports[i];
+        else if (i == effect->ports_count)
+            port = &effect->bypass_port;
+        else
+            port = &effect->presets_port;
+
+        if (port == NULL)
+            continue;
+
+        if (port->jack_port != NULL)
+        {
+            jack_port_unregister(g_jack_global_client, port->jack_port);
+            port->jack_port = NULL;
+        }
+
+        if (port->cv_source != NULL)
+        {
+            if (port->cv_source->jack_port != NULL)
+                jack_port_unregister(g_jack_global_client, port->cv_source->jack_port);
+
+            free(port->cv_source);
+            port->cv_source = NULL;
+        }
+
+        // storage is part of the effect ports arena
+        port->graph_buffer = port->graph_data = NULL;
+    }
+}
+
+static bool SetPortValue(port_t *port, float value, int effect_id, bool is_bypass, bool from_ui)
+{
+    bool update_transport = false;
+
+    if (is_bypass)
+    {
+        effect_t *effect = &g_effects[effect_id];
+        if (effect->enabled_index >= 0)
+            *(effect->ports[effect->enabled_index]->buffer) = (value > 0.5f) ? 0.0f : 1.0f;
+    }
+    else if (effect_id == GLOBAL_EFFECT_ID)
+    {
+        if (!strcmp(port->symbol, g_bpb_port_symbol))
+        {
+            g_transport_bpb = value;
+            update_transport = true;
+        }
+        else if (!strcmp(port->symbol, g_bpm_port_symbol))
+        {
+            g_transport_bpm = value;
+            update_transport = true;
+        }
+        else if (!strcmp(port->symbol, g_rolling_port_symbol))
+        {
+            if (value > 0.5f)
+            {
+                jack_transport_start(g_jack_global_client);
+            }
+            else
+            {
+                jack_transport_stop(g_jack_global_client);
+                jack_transport_locate(g_jack_global_client, 0);
+            }
+            g_transport_reset = true;
+            update_transport = true;
+        }
+    }
+    else if (!from_ui)
+    {
+#ifdef WITH_EXTERNAL_UI_SUPPORT
+        port->hints |= HINT_SHOULD_UPDATE;
+#endif
+    }
+
+    port->prev_value = *(port->buffer) = value;
+
+    if (! FeedbackSlotSet(&g_effects[effect_id], port, FEEDBACK_SLOT_PARAM_SET, value))
+        return false;
+
+    if (update_transport)
+        return UpdateGlobalJackPosition(UPDATE_POSITION_FORCED, false);
+
+    return true;
+}
+
+// FIXME merge most of this with SetPortValue
+static float UpdateValueFromMidi(midi_cc_t* mcc, uint16_t mvalue, bool highres)
+{
+    const uint16_t mvaluediv = highres ? 8192 : 64;
+
+    if (!strcmp(mcc->symbol, g_bypass_port_symbol))
+    {
+        effect_t *effect = &g_effects[mcc->effect_id];
+
+        const bool bypassed = mvalue < mvaluediv;
+        effect->bypass = bypassed ? 1.0f : 0.0f;
+
+        if (effect->enabled_index >= 0)
+            *(effect->ports[effect->enabled_index]->buffer) = bypassed ? 0.0f : 1.0f;
+
+        return bypassed ? 1.0f : 0.0f;
+    }
+
+    port_t* port = mcc->port;
+    float value;
+
+    if (port->hints & HINT_TRIGGER)
+    {
+        // now triggered, always maximum
+        value = port->max_value;
+    }
+    else if (port->hints & HINT_TOGGLE)
+    {
+        // toggle, always min or max
+        value = mvalue >= mvaluediv ? port->max_value : port->min_value;
+
+        if (mcc->effect_id == GLOBAL_EFFECT_ID && !strcmp(mcc->symbol, g_rolling_port_symbol))
+        {
+            if (mvalue >= mvaluediv)
+            {
+                jack_transport_start(g_jack_global_client);
+            }
+            else
+            {
+                jack_transport_stop(g_jack_global_client);
+                jack_transport_locate(g_jack_global_client, 0);
+            }
+            g_transport_reset = true;
+        }
+    }
+    else
+    {
+        // get percentage by dividing by max MIDI value
+        value = (float)mvalue;
+
+        if (highres)
+            value /= 16383.0f;
+        else
+            value /= 127.0f;
+
+        // make sure bounds are correct
+        if (value <= 0.0f)
+        {
+            value = mcc->minimum;
+        }
+        else if (value >= 1.0f)
+        {
+            value = mcc->maximum;
+        }
+        else
+        {
+            if (port->hints & HINT_LOGARITHMIC)
+            {
+                // FIXME: calculate value properly (don't do log on custom scale, use port min/max then adjust)
+                value = mcc->minimum * powf(mcc->maximum/mcc->minimum, value);
+            }
+            else
+            {
+                value = mcc->minimum + (mcc->maximum - mcc->minimum) * value;
+            }
+
+            if (port->hints & HINT_INTEGER)
+                value = rintf(value);
+        }
+
+        if (mcc->effect_id == GLOBAL_EFFECT_ID)
+        {
+            if (!strcmp(mcc->symbol, g_bpb_port_symbol))
+                g_transport_bpb = value;
+            else if (!strcmp(mcc->symbol, g_bpm_port_symbol))
+                g_transport_bpm = value;
+        }
+    }
+
+    // set param value
+    port->prev_value = *(port->buffer) = value;
+    return value;
+}
+
+static bool MidiCCFeedbackSet(const midi_cc_t* mcc, float value)
+{
+    effect_t *effect = &g_effects[mcc->effect_id];
+    const port_t *port = mcc->port != NULL ? mcc->port : &effect->bypass_port;
+
+    return FeedbackSlotSet(effect, port, FEEDBACK_SLOT_PARAM_SET, value);
+}
+
+
+static bool UpdateGlobalJackPosition(enum UpdatePositionFlag flag, bool do_post)
+{
+    bool old_rolling;
+    double old_bpb, old_bpm;
+
+    if (flag != UPDATE_POSITION_SKIP)
+    {
+        old_rolling = g_jack_rolling;
+        old_bpb = g_transport_bpb;
+        old_bpm = g_transport_bpm;
+    }
+
+    g_jack_rolling = (jack_transport_query(g_jack_global_client, &g_jack_pos) == JackTransportRolling);
+
+    if ((g_jack_pos.valid & JackPositionBBT) == 0x0)
+    {
+        g_jack_pos.beats_per_bar    = g_transport_bpb;
+        g_jack_pos.beats_per_minute = g_transport_bpm;
+    }
+
+    if (flag == UPDATE_POSITION_SKIP)
+        return false;
+    if (flag == UPDATE_POSITION_IF_CHANGED &&
+        old_rolling == g_jack_rolling &&
+        !doubles_differ_enough(old_bpb, g_transport_bpb) &&
+        !doubles_differ_enough(old_bpm, g_transport_bpm))
+        return false;
+
+    postponed_event_list_data* const posteventptr = RtSafeEventAllocate();
+
+    if (!posteventptr)
+        return false;
+
+    posteventptr->event.type = POSTPONED_TRANSPORT;
+    posteventptr->event.transport.rolling = g_jack_rolling;
+    posteventptr->event.transport.bpb     = g_transport_bpb;
+    posteventptr->event.transport.bpm     = g_transport_bpm;
+
+    RtSafeQueuePush(posteventptr);
+
+    if (do_post)
+        sem_post(&g_postevents_semaphore);
+
+    return true;
+}
+
+static int ProcessGlobalClient(jack_nframes_t nframes, void *arg)
+{
+    jack_midi_event_t event;
+    uint8_t channel, controller;
+    uint8_t status_nibble;
+    uint16_t mvalue;
+    float value;
+    double dvalue;
+    bool handled, highres, needs_post = false;
+    enum UpdatePositionFlag pos_flag = UPDATE_POSITION_IF_CHANGED;
+
+    // committed parameter batches, before any plugin runs in this cycle
+    effect_sync_scheduled_params(true);
+
+#ifdef HAVE_HYLIA
+    if (g_transport_sync_mode == TRANSPORT_SYNC_ABLETON_LINK)
+    {
+        hylia_process(g_hylia_instance, nframes, &g_hylia_timeinfo);
+
+        // check for updated beats per bar
+        dvalue = g_hylia_timeinfo.beatsPerBar;
+
+        if (dvalue > 0.0 && doubles_differ_enough(g_transport_bpb, dvalue))
+        {
+            g_transport_bpb = dvalue;
+            pos_flag = UPDATE_POSITION_FORCED;
+        }
+
+        // check for updated beats per minute
+        dvalue = g_hylia_timeinfo.beatsPerMinute;
+
+        if (dvalue > 0.0 && doubles_differ_enough(g_transport_bpm, dvalue))
+        {
+            g_transport_bpm = dvalue;
+            pos_flag = UPDATE_POSITION_FORCED;
+        }
+    }
+#endif
+
+    // Handle input MIDI events
+    void *const port_buf = jack_port_get_buffer(g_midi_in_port, nframes);
+    const jack_nframes_t event_count = jack_midi_get_event_count(port_buf);
+
+    for (jack_nframes_t i = 0 ; i < event_count; i++)
+    {
+        if (jack_midi_event_get(&event, port_buf, i) != 0)
+            break;
+
+        // Handle MIDI Beat Clock
+        if (g_transport_sync_mode == TRANSPORT_SYNC_MIDI)
+        {
+            switch (event.buffer[0])
+            {
+            case 0xF8: { // Clock tick
+                // Calculate the timestamp difference to the previous MBC event
+                const uint64_t current = g_monotonic_frame_count + event.time;
+
+                if (g_previous_midi_event_time != 0)
+                {
+                    const uint64_t delta = current - g_previous_midi_event_time;
+
+                    if (delta < g_max_allowed_midi_delta)
+                    {
+                        const double filtered_delta = beat_clock_tick_filter(delta);
+
+                        // rounded to 2 decimal points
+                        dvalue = rint(beats_per_minute(filtered_delta, g_sample_rate) * 100.0) / 100.0;
+
+                        if (dvalue > 0.0 && doubles_differ_enough(g_transport_bpm, dvalue))
+                        {
+                            // set a sane low limit
+                            if (dvalue <= 20.0)
+                                g_transport_bpm = 20;
+                            // >300 BPM over MIDI is unreasonable
+                            else if (dvalue >= 300.0)
+                                g_transport_bpm = 300.0;
+                            // we are good!
+                            else
+                                g_transport_bpm = dvalue;
+
+                            pos_flag = UPDATE_POSITION_FORCED;
+                        }
+                    } else {
+                        reset_filter();
+                    }
+                } else {
+                    reset_filter();
+                }
+
+                g_previous_midi_event_time = current;
+                break;
+            }
+
+            case 0xFA: // Start
+            case 0xFB: // Continue
+                g_previous_midi_event_time = 0;
+                jack_transport_start(g_jack_global_client);
+                break;
+
+            case 0xFC: // Stop
+                jack_transport_stop(g_jack_global_client);
+                jack_transport_locate(g_jack_global_client, 0);
+                break;
+
+            default:
+                // TODO: Handle MIDI Song Position Pointer
+                break;
+            }
+        }
+
+        status_nibble = event.buffer[0] & 0xF0;
+
+        // Handle MIDI program change
+        if (status_nibble == 0xC0)
+        {
+            channel = (event.buffer[0] & 0x0F);
+
+            if (g_monitored_midi_programs[channel] && event.size == 2)
+            {
+#ifdef _DARKGLASS_PABLITO
+                if (event.buffer[1] == 0 || event.buffer[1] == 127)
+                    continue;
+#endif
+                // Append to the queue
+                postponed_event_list_data* const posteventptr = RtSafeEventAllocate();
+
+                  if (posteventptr)
+                  {
+                      posteventptr->event.type = POSTPONED_MIDI_PROGRAM_CHANGE;
+                      posteventptr->event.program_change.program = event.buffer[1];
+                      posteventptr->event.program_change.channel = channel;
+
+                      RtSafeQueuePush(posteventptr);
+
+                      needs_post = true;
+                }
+            }
+            else
+            {
+                // Wrong channel or size. Discard.
+                continue;
+            }
+        } // endif MIDI program change
+
+        if (event.size != 3)
+            continue;
+
+        // check if it's a CC or Pitchbend event
+        if (status_nibble == 0xB0)
+        {
+            controller = event.buffer[1];
+            mvalue     = event.buffer[2];
+            highres    = false;
+#ifdef _DARKGLASS_PABLITO
+            channel    = (event.buffer[0] & 0x0F);
+            switch (controller)
+            {
+            // these can be assigned to parameters, handle them first
+            case 17 ... 32:
+            case 89:
+                if (! g_monitored_midi_programs[channel])
+                    continue;
+
+                for (int j = 0; j < MAX_MIDI_CC_ASSIGN; j++)
+                {
+                    if (g_midi_cc_list[j].effect_id == ASSIGNMENT_NULL)
+                        break;
+                    if (g_midi_cc_list[j].effect_id == ASSIGNMENT_UNUSED)
+                        continue;
+
+                    if (g_midi_cc_list[j].controller == controller)
+                    {
+                        handled = true;
+                        value = UpdateValueFromMidi(&g_midi_cc_list[j], mvalue, highres);
+
+                        if (MidiCCFeedbackSet(&g_midi_cc_list[j], value))
+                            needs_post = true;
+
+                        break;
+                    }
+                }
+
+                if (needs_post)
+                    continue;
+
+            // fall-through
+            // if the special parameter CCs are not handled, report up as regular MIDI CC
+            case 0:
+            case 7:
+            case 14 ... 16:
+            case 85 ... 87:
+            case 102 ... 119:
+                if (g_monitored_midi_programs[channel])
+                {
+                    postponed_event_list_data* const posteventptr = RtSafeEventAllocate();
+
+                    if (posteventptr)
+                    {
+                        posteventptr->event.type = POSTPONED_MIDI_CONTROL_CHANGE;
+                        posteventptr->event.control_change.channel = channel;
+                        posteventptr->event.control_change.control = controller;
+                        posteventptr->event.control_change.value = mvalue;
+
+                        RtSafeQueuePush(posteventptr);
+
+                        needs_post = true;
+                    }
+                }
+                continue;
+            }
+#else
+        }
+        else if (status_nibble == 0xE0)
+        {
+            controller = MIDI_PITCHBEND_AS_CC;
+            mvalue     = (event.buffer[2] << 7) | event.buffer[1];
+            highres    = true;
+#endif
+        }
+        else
+        {
+            continue;
+        }
+
+        handled = false;
+        channel = (event.buffer[0] & 0x0F);
+
+        for (int j = 0; j < MAX_MIDI_CC_ASSIGN; j++)
+        {
+            if (g_midi_cc_list[j].effect_id == ASSIGNMENT_NULL)
+                break;
+            if (g_midi_cc_list[j].effect_id == ASSIGNMENT_UNUSED)
+                continue;
+
+#ifdef _DARKGLASS_PABLITO
+            if (! g_monitored_midi_programs[channel])
+                continue;
+#else
+            if (g_midi_cc_list[j].channel != channel)
+                continue;
+#endif
+
+            // TODO: avoid race condition against effects_midi_unmap
+            if (g_midi_cc_list[j].controller == controller)
+            {
+                handled = true;
+                value = UpdateValueFromMidi(&g_midi_cc_list[j], mvalue, highres);
+
+                if (MidiCCFeedbackSet(&g_midi_cc_list[j], value))
+                    needs_post = true;
+
+                break;
+            }
+        }
+
+        if (! handled)
+        {
+            int effect_id;
+            const char* symbol;
+            float minimum, maximum;
+
+            pthread_mutex_lock(&g_midi_learning_mutex);
+            if (g_midi_learning != NULL)
+            {
+                effect_id = g_midi_learning->effect_id;
+                symbol    = g_midi_learning->symbol;
+                minimum   = g_midi_learning->minimum;
+                maximum   = g_midi_learning->maximum;
+                value     = UpdateValueFromMidi(g_midi_learning, mvalue, highres);
+                g_midi_learning->channel    = channel;
+                g_midi_learning->controller = controller;
+                g_midi_learning = NULL;
+            }
+            else
+            {
+                effect_id = -1;
+            }
+            pthread_mutex_unlock(&g_midi_learning_mutex);
+
+            if (effect_id != -1)
+            {
+                postponed_event_list_data* const posteventptr = RtSafeEventAllocate();
+
+                if (posteventptr)
+                {
+                    posteventptr->event.type = POSTPONED_MIDI_MAP;
+                    posteventptr->event.midi_map.effect_id  = effect_id;
+                    posteventptr->event.midi_map.symbol     = symbol;
+                    posteventptr->event.midi_map.channel    = channel;
+                    posteventptr->event.midi_map.controller = controller;
+                    posteventptr->event.midi_map.value      = value;
+                    posteventptr->event.midi_map.minimum    = minimum;
+                    posteventptr->event.midi_map.maximum    = maximum;
+
+                    RtSafeQueuePush(posteventptr);
+
+                    needs_post = true;
+                }
+            }
+            else if (g_monitored_midi_programs[channel])
+            {
+                postponed_event_list_data* const posteventptr = RtSafeEventAllocate();
+
+                if (posteventptr)
+                {
+                    posteventptr->event.type = POSTPONED_MIDI_CONTROL_CHANGE;
+                    posteventptr->event.control_change.channel = channel;
+                    posteventptr->event.control_change.control = controller;
+                    posteventptr->event.control_change.value = mvalue;
+
+                    RtSafeQueuePush(posteventptr);
+
+                    needs_post = true;
+                }
+            }
+        }
+    }
+
+#ifdef MOD_IO_PROCESSING_ENABLED
+    // Handle audio
+    const float *const audio_in1_buf = (float*)jack_port_get_buffer(g_audio_in1_port, nframes);
+    const float *const audio_in2_buf = (float*)jack_port_get_buffer(g_audio_in2_port, nframes);
+    /* */ float *const audio_out1_buf = (float*)jack_port_get_buffer(g_audio_out1_port, nframes);
+    /* */ float *const audio_out2_buf = (float*)jack_port_get_buffer(g_audio_out2_port, nframes);
+
+    switch (g_noisegate_channel)
+    {
+    case 0: // no gate
+        if (audio_out1_buf != audio_in1_buf)
+            memcpy(audio_out1_buf, audio_in1_buf, sizeof(float)*nframes);
+        if (audio_out2_buf != audio_in2_buf)
+            memcpy(audio_out2_buf, audio_in2_buf, sizeof(float)*nframes);
+        break;
+    case 1: // left channel only
+        if (audio_out2_buf != audio_in2_buf)
+            memcpy(audio_out2_buf, audio_in2_buf, sizeof(float)*nframes);
+        for (uint32_t i=0; i<nframes; ++i)
+            audio_out1_buf[i] = gate_push_sample_and_apply(&g_noisegate, audio_in1_buf[i]);
+        break;
+    case 2: // right channel only
+        if (audio_out1_buf != audio_in1_buf)
+            memcpy(audio_out1_buf, audio_in1_buf, sizeof(float)*nframes);
+        for (uint32_t i=0; i<nframes; ++i)
+            audio_out2_buf[i] = gate_push_sample_and_apply(&g_noisegate, audio_in2_buf[i]);
+        break;
+    case 3: // left & right channels
+        for (uint32_t i=0; i<nframes; ++i)
+        {
+            gate_push_samples_and_run(&g_noisegate, audio_in1_buf[i], audio_in2_buf[i]);
+            audio_out1_buf[i] = gate_apply(&g_noisegate, audio_in1_buf[i]);
+            audio_out2_buf[i] = gate_apply(&g_noisegate, audio_in2_buf[i]);
+        }
+        break;
+    }
+#endif
+
+    // Run in-process effects
+    if (g_graph_engine_enabled)
+        RunGraph(nframes);
+
+    // Handle audio monitors
+    if (pthread_mutex_trylock(&g_audio_monitor_mutex) == 0)
+    {
+        float *monitorbuf;
+        float absvalue, oldvalue;
+
+        for (int i = 0; i < g_audio_monitor_count; ++i)
+        {
+            monitorbuf = (float*)jack_port_get_buffer(g_audio_monitors[i].port, nframes);
+            oldvalue = value = g_audio_monitors[i].value;
+
+            for (jack_nframes_t i = 0 ; i < nframes; i++)
+            {
+                absvalue = fabsf(monitorbuf[i]);
+
+                if (absvalue > value)
+                    value = absvalue;
+            }
+
+            if (oldvalue < value)
+            {
+                g_audio_monitors[i].value = value;
+
+                postponed_event_list_data* const posteventptr = RtSafeEventAllocate();
+
+                if (posteventptr)
+                {
+                    posteventptr->event.type = POSTPONED_AUDIO_MONITOR;
+                    posteventptr->event.audio_monitor.index = i;
+                    posteventptr->event.audio_monitor.value = value;
+
+                    RtSafeQueuePush(posteventptr);
+
+                    needs_post = true;
+                }
+            }
+        }
+
+        pthread_mutex_unlock(&g_audio_monitor_mutex);
+    }
+
+    if (UpdateGlobalJackPosition(pos_flag, false))
+        needs_post = true;
+
+    if (g_cpu_load_enabled || g_plugin_load_enabled)
+    {
+        const uint32_t cpu_update_rate = g_sample_rate / 2;
+        const uint32_t frame_check = g_monotonic_frame_count % cpu_update_rate;
+
+        if (frame_check + nframes >= cpu_update_rate)
+        {
+            if (g_cpu_load_enabled)
+                g_cpu_load_trigger = true;
+            if (g_plugin_load_enabled)
+                g_plugin_load_trigger = true;
+            needs_post = true;
+        }
+    }
+
+    if (needs_post)
+        sem_post(&g_postevents_semaphore);
+
+    // Increase by one period
+    g_monotonic_frame_count += nframes;
+
+    return 0;
+
+    UNUSED_PARAM(arg);
+}
+
+/**
+ * If the transport is rolling and if we are the Jack Timebase Master
+ * then this callback acts once per cycle and effects the following
+ * cycle.
+ *
+ * This realtime function must not wait.
+ *
+ * Read: http://jackaudio.org/files/docs/html/transport-design.html
+ */
+static void JackTimebase(jack_transport_state_t state, jack_nframes_t nframes,
+                         jack_position_t *pos, int new_pos, void *arg)
+{
+    double tick;
+
+    // Who sets these global variables?
+
+    // g_transport_bpb, g_transport_bpm, g_transport_reset are static
+    // volatile and meant to be set from anywhere.
+
+    // g_transport_bpm is only set on lines 1352
+    // (UpdateValueFromMIDI), 1427 (ProcessGlobalClient), 2016 (CCDataUpdate)
+    // and 4451 (effects_transport).
+
+    // Update the extended position information.
+    pos->beats_per_bar = g_transport_bpb;
+    pos->beats_per_minute = g_transport_bpm;
+
+    // Is this a hacky way to express rounding? Better use nearbyint()?
+    const int32_t beats_per_bar_int = (int32_t)(pos->beats_per_bar + 0.5f);
+
+    if (new_pos || g_transport_reset) // Is caching involved? No.
+    {
+        // Do we have to set every "constant" data field every time?
+        pos->valid = JackPositionBBT | JackTickDouble;
+        pos->beat_type = 4.0f;
+        pos->ticks_per_beat = TRANSPORT_TICKS_PER_BEAT;
+
+        double abs_beat, abs_tick;
+
+#ifdef HAVE_HYLIA
+        if (g_transport_sync_mode == TRANSPORT_SYNC_ABLETON_LINK)
+        {
+            if (g_hylia_timeinfo.beat >= 0.0)
+            {
+                abs_beat = g_hylia_timeinfo.beat;
+                abs_tick = abs_beat * TRANSPORT_TICKS_PER_BEAT;
+            }
+            else
+            {
+                abs_beat = 0.0;
+                abs_tick = 0.0;
+                g_jack_rolling = false;
+            }
+        }
+        else
+#endif
+        {
+            /// ????
+            // 1. analyse frame position. 2. calculate ticks. 3. derive values for everything else???
+
+            // What is min? why 60?
+            const double min = (double)pos->frame / (double)(g_sample_rate * 60);
+            abs_beat = min * pos->beats_per_minute;
+            abs_tick = abs_beat * TRANSPORT_TICKS_PER_BEAT;
+            g_transport_reset = false;
+        }
+
+        const double bar  = floor(abs_beat / pos->beats_per_bar);
+        const double beat = floor(fmod(abs_beat, pos->beats_per_bar));
+
+        pos->bar  = (int32_t)(bar) + 1;
+        pos->beat = (int32_t)(beat) + 1;
+        pos->bar_start_tick = ((bar * pos->beats_per_bar) + beat) * TRANSPORT_TICKS_PER_BEAT;
+
+        tick = abs_tick - (abs_beat * pos->ticks_per_beat);
+    }
+    else // not new_pos nor g_transport_reset
+    {
+        // update the current tick with the beat.
+        tick = pos->tick_double +
+              (nframes * TRANSPORT_TICKS_PER_BEAT * pos->beats_per_minute / (double)(g_sample_rate * 60));
+
+        // why adjust? why can overflow happen?
+        while (tick >= TRANSPORT_TICKS_PER_BEAT)
+        {
+            tick -= TRANSPORT_TICKS_PER_BEAT;
+
+            if (++pos->beat > beats_per_bar_int)
+            {
+                pos->beat = 1;
+                pos->bar_start_tick += pos->beats_per_bar * TRANSPORT_TICKS_PER_BEAT;
+                ++pos->bar;
+            }
+        }
+    }
+
+    pos->tick = (int32_t)(tick + 0.5);
+    pos->tick_double = tick;
+    return;
+
+    UNUSED_PARAM(state);
+    UNUSED_PARAM(arg);
+}
+
+static void JackThreadInit(void* arg)
+{
+/* Disable denormal numbers in floating point calculation.
+ * Denormal numbers happen often in IIR filters, and it can be very slow.
+ */
+/* Taken from cras/src/dsp/dsp_util.c in Chromium OS code.
+ * Copyright (c) 2013 The Chromium OS Authors. */
+#if defined(__i386__) || defined(__x86_64__)
+        unsigned int mxcsr;
+        mxcsr = __builtin_ia32_stmxcsr();
+        __builtin_ia32_ldmxcsr(mxcsr | 0x8040);
+#elif defined(__aarch64__)
+        uint64_t cw;
+        __asm__ __volatile__ (
+                "mrs    %0, fpcr                            \n"
+                "orr    %0, %0, #0x1000000                  \n"
+                "msr    fpcr, %0                            \n"
+                "isb                                        \n"
+                : "=r"(cw) :: "memory");
+#elif defined(__arm__)
+        uint32_t cw;
+        __asm__ __volatile__ (
+                "vmrs   %0, fpscr                           \n"
+                "orr    %0, %0, #0x1000000                  \n"
+                "vmsr   fpscr, %0                           \n"
+                : "=r"(cw) :: "memory");
+#else
+#warning "Don't know how to disable denormals. Performace may suffer."
+#endif
+    return;
+
+    UNUSED_PARAM(arg);
+}
+
+static void GetFeatures(effect_t *effect)
+{
+    const LV2_Feature **features = (const LV2_Feature**) mod_calloc(FEATURE_TERMINATOR+1, sizeof(LV2_Feature*));
+
+    /* URI and URID Features are the same for all instances (global declaration) */
+
+    /* Options Feature is the same for all instances (global declaration) */
+
+    /* State path features, includes custom pointer */
+    LV2_State_Make_Path *makePath = (LV2_State_Make_Path*) malloc(sizeof(LV2_State_Make_Path));
+    makePath->handle = effect;
+    makePath->path = MakePluginStatePathFromSratchDir;
+
+    LV2_Feature *state_make_path_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
+    state_make_path_feature->URI = LV2_STATE__makePath;
+    state_make_path_feature->data = makePath;
+
+    /* Log feature, includes custom pointer for per-plugin rate limiting */
+    LV2_Log_Log *log = (LV2_Log_Log*) malloc(sizeof(LV2_Log_Log));
+    log->handle = effect;
+    log->printf = LogPrintf;
+    log->vprintf = LogVPrintf;
+
+    LV2_Feature *log_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
+    log_feature->URI = LV2_LOG__log;
+    log_feature->data = log;
+
+    /* ControlInputPort change request feature, includes custom pointer */
+    LV2_ControlInputPort_Change_Request *ctrlportReqChange
+        = (LV2_ControlInputPort_Change_Request*) malloc(sizeof(LV2_ControlInputPort_Change_Request));
+    ctrlportReqChange->handle = effect;
+    ctrlportReqChange->request_change = RequestControlPortChange;
+
+    LV2_Feature *ctrlportReqChange_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
+    ctrlportReqChange_feature->URI = LV2_CONTROL_INPUT_PORT_CHANGE_REQUEST_URI;
+    ctrlportReqChange_feature->data = ctrlportReqChange;
+
+    /* Control Port state update feature, includes custom pointer */
+    LV2_Control_Port_State_Update *ctrlportStateUpdate
+        = (LV2_Control_Port_State_Update*) malloc(sizeof(LV2_Control_Port_State_Update));
+    ctrlportStateUpdate->handle = effect;
+    ctrlportStateUpdate->update_state = UpdateControlPortState;
+
+    LV2_Feature *ctrlportStateUpdate_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
+    ctrlportStateUpdate_feature->URI = LV2_CONTROL_PORT_STATE_UPDATE_URI;
+    ctrlportStateUpdate_feature->data = ctrlportStateUpdate;
+
+    /* Worker Feature, must be last as it can be null */
+    LV2_Feature *work_schedule_feature = NULL;
+
+    if (lilv_plugin_has_extension_data(effect->lilv_plugin, g_lilv_nodes.worker_interface))
+    {
+        LV2_Worker_Schedule *schedule = (LV2_Worker_Schedule*) malloc(sizeof(LV2_Worker_Schedule));
+        schedule->handle = &effect->worker;
+        schedule->schedule_work = worker_schedule;
+
+        work_schedule_feature = (LV2_Feature*) malloc(sizeof(LV2_Feature));
+        work_schedule_feature->URI = LV2_WORKER__schedule;
+        work_schedule_feature->data = schedule;
+    }
+
+    /* Buf-size Feature is the same for all instances (global declaration) */
+
+    /* Features array */
+    features[URI_MAP_FEATURE]           = &g_uri_map_feature;
+    features[URID_MAP_FEATURE]          = &g_urid_map_feature;
+    features[URID_UNMAP_FEATURE]        = &g_urid_unmap_feature;
+    features[OPTIONS_FEATURE]           = &g_options_feature;
+#ifdef MOD_HMI_CONTROL_ENABLED
+    features[HMI_WC_FEATURE]            = &g_hmi_wc_feature;
+#endif
+    features[LICENSE_FEATURE]           = &g_license_feature;
+    features[BUF_SIZE_POWER2_FEATURE]   = &g_buf_size_features[0];
+    features[BUF_SIZE_FIXED_FEATURE]    = &g_buf_size_features[1];
+    features[BUF_SIZE_BOUNDED_FEATURE]  = &g_buf_size_features[2];
+    features[LOG_FEATURE]               = log_feature;
+    features[STATE_FREE_PATH_FEATURE]   = &g_state_freePath_feature;
+    features[STATE_MAKE_PATH_FEATURE]   = state_make_path_feature;
+    features[CTRLPORT_REQUEST_FEATURE]  = ctrlportReqChange_feature;
+    features[CTRLPORT_STATE_FEATURE]    = ctrlportStateUpdate_feature;
+    features[WORKER_FEATURE]            = work_schedule_feature;
+#ifdef WITH_EXTERNAL_UI_SUPPORT
+    features[UI_DATA_ACCESS]            = NULL;
+    features[UI_INSTANCE_ACCESS]        = NULL;
+#endif
+    features[FEATURE_TERMINATOR]        = NULL;
+
+    effect->features = features;
+
+    /* also update jack client option value */
+    g_options[7].value = effect->jack_client;
+}
+
+/**
+* If transport is stopped, ensure jack invokes the timebase master by
+* invoking a jack reposition on the current position.
+ */
+static void TriggerJackTimebase(bool reset_to_zero)
+{
+    jack_position_t pos;
+    if (jack_transport_query(g_jack_global_client, &pos) == JackTransportStopped) {
+        if (reset_to_zero) {
+            pos.frame = 0;
+        }
+        int res = jack_transport_reposition(g_jack_global_client, &pos);
+        if (res < 0) {
+            fprintf(stderr, "Failed to trigger timebase master.  Call "
+                            "will occur when transport starts or a client updates "
+                            "position.\n");
+        }
+    }
+}
+
+static property_t *FindEffectPropertyByURI(effect_t *effect, const char *uri)
+{
+    for (uint32_t i = 0; i < effect->properties_count; i++)
+    {
+        if (strcmp(uri, lilv_node_as_uri(effect->properties[i]->uri)) == 0)
+            return effect->properties[i];
+    }
+    return NULL;
+}
+
+static port_t *FindEffectInputPortBySymbol(effect_t *effect, const char *control_symbol)
+{
+    port_t *port = PortIndexLookup(effect, control_symbol);
+
+    return (port != NULL && port->flow == FLOW_INPUT) ? port : NULL;
+}
+
+static port_t *FindEffectOutputPortBySymbol(effect_t *effect, const char *control_symbol)
+{
+    port_t *port = PortIndexLookup(effect, control_symbol);
+
+    return (port != NULL && port->flow == FLOW_OUTPUT) ? port : NULL;
+}
+
+static void SetParameterFromState(const char* symbol, void* user_data,
+                                  const void* value, uint32_t size,
+                                  uint32_t type)
+{
+    effect_t *effect = (effect_t*)user_data;
+    float realvalue;
+
+    if (type == g_urids.atom_Float)
+    {
+        if (size != sizeof(float))
+            return;
+        realvalue = *((const float*)value);
+    }
+    else if (type == g_urids.atom_Double)
+    {
+        if (size != sizeof(double))
+            return;
+        realvalue = *((const double*)value);
+    }
+    else if (type == g_urids.atom_Int || type == g_urids.atom_Bool)
+    {
+        if (size != sizeof(int32_t))
+            return;
+        realvalue = *((const int32_t*)value);
+    }
+    else if (type == g_urids.atom_Long)
+    {
+        if (size != sizeof(int64_t))
+            return;
+        realvalue = *((const int64_t*)value);
+    }
+    else
+    {
+        fprintf(stderr, "SetParameterFromState called with unknown type: %u %u\n", type, size);
+        return;
+    }
+
+    effects_set_parameter(effect->instance, symbol, realvalue);
+}
+
+static const void* GetPortValueForState(const char* symbol, void* user_data, uint32_t* size, uint32_t* type)
+{
+    effect_t *effect = (effect_t*)user_data;
+    port_t *port = FindEffectInputPortBySymbol(effect, symbol);
+    if (port)
+    {
+        *size = sizeof(float);
+        *type = g_urids.atom_Float;
+        return port->buffer;
+    }
+    return NULL;
+}
+
+static void LoadPresets(plugin_descriptor_t *descriptor)
+{
+    LilvNodes* presets = lilv_plugin_get_related(descriptor->lilv_plugin, g_lilv_nodes.preset);
+    uint32_t presets_count = lilv_nodes_size(presets);
+    descriptor->presets_count = presets_count;
+    // allocate for presets
+    descriptor->presets = (preset_t **) mod_calloc(presets_count, sizeof(preset_t *));
+    uint32_t j = 0;
+    LILV_FOREACH(nodes, i, presets)
+    {
+        const LilvNode* preset = lilv_nodes_get(presets, i);
+        descriptor->presets[j] = (preset_t *) malloc(sizeof(preset_t));
+        descriptor->presets[j]->uri = lilv_node_duplicate(preset);
+        j++;
+    }
+    lilv_nodes_free(presets);
+}
+
+static int32_t GetDesignatedPortIndex(const LilvPlugin *plugin, const LilvNode *designation)
+{
+    const LilvPort *port = lilv_plugin_get_port_by_designation(plugin, g_lilv_nodes.input, designation);
+
+    return port != NULL ? (int32_t)lilv_port_get_index(plugin, port) : -1;
+}
+
+static void PluginDescriptorFree(plugin_descriptor_t *descriptor)
+{
+    if (descriptor->ports)
+    {
+        for (uint32_t i = 0; i < descriptor->ports_count; i++)
+            lilv_scale_points_free(descriptor->ports[i].scale_points);
+        free(descriptor->ports);
+    }
+
+    if (descriptor->properties)
+    {
+        for (uint32_t i = 0; i < descriptor->properties_count; i++)
+        {
+            lilv_node_free(descriptor->properties[i].uri);
+            lilv_node_free(descriptor->properties[i].type);
+        }
+        free(descriptor->properties);
+    }
+
+    if (descriptor->presets)
+    {
+        for (uint32_t i = 0; i < descriptor->presets_count; i++)
+        {
+            if (descriptor->presets[i])
+                lilv_node_free(descriptor->presets[i]->uri);
+            free(descriptor->presets[i]);
+        }
+        free(descriptor->presets);
+    }
+
+    free(descriptor->uri);
+    free(descriptor);
+}
+
+static plugin_descriptor_t *PluginDescriptorBuild(const char *uri, const LilvPlugin *plugin)
+{
+    plugin_descriptor_t *descriptor = (plugin_descriptor_t *) mod_calloc(1, sizeof(plugin_descriptor_t));
+
+    if (descriptor == NULL)
+        return NULL;
+
+    descriptor->uri = strdup(uri);
+    descriptor->lilv_plugin = plugin;
+    descriptor->refcount = 1;
+    descriptor->ports_count = lilv_plugin_get_num_ports(plugin);
+    descriptor->ports = (port_descriptor_t *) mod_calloc(descriptor->ports_count + 1, sizeof(port_descriptor_t));
+
+    if (descriptor->uri == NULL || descriptor->ports == NULL)
+    {
+        PluginDescriptorFree(descriptor);
+        return NULL;
+    }
+
+    /* Query plugin features */
+    if (lilv_plugin_has_feature(plugin, g_lilv_nodes.is_live))
+        descriptor->hints |= HINT_IS_LIVE;
+
+    if (lilv_plugin_has_feature(plugin, g_lilv_nodes.noPreRun))
+        descriptor->hints |= HINT_NO_PRE_RUN;
+
+    if (lilv_plugin_has_feature(plugin, g_lilv_nodes.inPlaceBroken))
+        descriptor->hints |= HINT_IN_PLACE_BROKEN;
+
+    /* Query plugin extensions/interfaces */
+    descriptor->has_worker_interface = lilv_plugin_has_extension_data(plugin, g_lilv_nodes.worker_interface);
+    descriptor->has_options_interface = lilv_plugin_has_extension_data(plugin, g_lilv_nodes.options_interface);
+    descriptor->has_license_interface = lilv_plugin_has_extension_data(plugin, g_lilv_nodes.license_interface);
+#ifdef __MOD_DEVICES__
+    descriptor->has_hmi_interface = lilv_plugin_has_extension_data(plugin, g_lilv_nodes.hmi_interface);
+#endif
+
+    if (lilv_plugin_has_extension_data(plugin, g_lilv_nodes.state_interface))
+    {
+        descriptor->hints |= HINT_HAS_STATE;
+
+        if (! lilv_plugin_has_feature(plugin, g_lilv_nodes.state_thread_safe_restore))
+            descriptor->hints |= HINT_STATE_UNSAFE;
+
+        descriptor->load_default_state = lilv_plugin_has_feature(plugin, g_lilv_nodes.state_load_default_state);
+    }
+
+    /* query control_in port and its minimum size */
+    descriptor->worker_buf_size = 4096;
+    descriptor->control_index = GetDesignatedPortIndex(plugin, g_lilv_nodes.control_in);
+
+    if (descriptor->control_index >= 0)
+    {
+        const LilvPort *control_in_port = lilv_plugin_get_port_by_index(plugin, descriptor->control_index);
+        LilvNodes *lilvminsize = lilv_port_get_value(plugin, control_in_port, g_lilv_nodes.minimumSize);
+        if (lilvminsize != NULL)
+        {
+            const int minsize = lilv_node_as_int(lilv_nodes_get_first(lilvminsize));
+            if (minsize > 0 && (uint)minsize > descriptor->worker_buf_size)
+                descriptor->worker_buf_size = minsize;
+            lilv_nodes_free(lilvminsize);
+        }
+    }
+
+    for (uint32_t i = 0; i < descriptor->ports_count; i++)
+    {
+        port_descriptor_t *port = &descriptor->ports[i];
+        const LilvPort *lilv_port = lilv_plugin_get_port_by_index(plugin, i);
+
+        port->symbol = lilv_node_as_string(lilv_port_get_symbol(plugin, lilv_port));
+
+        /* Port flow */
+        port->flow = FLOW_UNKNOWN;
+        if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input))
+            port->flow = FLOW_INPUT;
+        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output))
+            port->flow = FLOW_OUTPUT;
+
+        port->type = TYPE_UNKNOWN;
+        port->hints = 0x0;
+
+        if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.audio))
+        {
+            port->type = TYPE_AUDIO;
+        }
+        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.control))
+        {
+            port->type = TYPE_CONTROL;
+            port->scale_points = lilv_port_get_scale_points(plugin, lilv_port);
+
+            /* Set the minimum value of control */
+            float min_value;
+            LilvNodes* lilvvalue_minimum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_minimum);
+            if (lilvvalue_minimum == NULL)
+                lilvvalue_minimum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.minimum);
+
+            if (lilvvalue_minimum != NULL)
+                min_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_minimum));
+            else
+                min_value = 0.0f;
+
+            /* Set the maximum value of control */
+            float max_value;
+            LilvNodes* lilvvalue_maximum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_maximum);
+            if (lilvvalue_maximum == NULL)
+                lilvvalue_maximum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.maximum);
+
+            if (lilvvalue_maximum != NULL)
+                max_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_maximum));
+            else
+                max_value = 1.0f;
+
+            /* Ensure min < max */
+            if (min_value >= max_value)
+                max_value = min_value + 0.1f;
+
+            /* multiply ranges by sample rate if requested */
+            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.sample_rate))
+            {
+                min_value *= g_sample_rate;
+                max_value *= g_sample_rate;
+            }
+
+            /* Set the default value of control */
+            float def_value;
+
+            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.preferMomentaryOff))
+            {
+                def_value = max_value;
+            }
+            else if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.preferMomentaryOn))
+            {
+                def_value = min_value;
+            }
+            else
+            {
+                LilvNodes* lilvvalue_default = g_lilv_nodes.mod_default_custom != NULL
+                                             ? lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_default_custom)
+                                             : NULL;
+                if (lilvvalue_default == NULL)
+                    lilvvalue_default = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_default);
+                if (lilvvalue_default == NULL)
+                    lilvvalue_default = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.default_);
+
+                if (lilvvalue_default != NULL)
+                    def_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_default));
+                else
+                    def_value = min_value;
+
+                lilv_nodes_free(lilvvalue_default);
+            }
+
+            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.enumeration))
+            {
+                port->hints |= HINT_ENUMERATION;
+
+                // make 2 scalepoint enumeration work as toggle
+                if (lilv_scale_points_size(port->scale_points) == 2)
+                    port->hints |= HINT_TOGGLE;
+            }
+            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.integer))
+            {
+                port->hints |= HINT_INTEGER;
+            }
+            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.toggled))
+            {
+                port->hints |= HINT_TOGGLE;
+            }
+            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.trigger))
+            {
+                port->hints |= HINT_TRIGGER;
+                descriptor->hints |= HINT_TRIGGERS;
+            }
+            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.logarithmic))
+            {
+                port->hints |= HINT_LOGARITHMIC;
+            }
+
+            port->def_value = def_value;
+            port->min_value = min_value;
+            port->max_value = max_value;
+
+            lilv_nodes_free(lilvvalue_maximum);
+            lilv_nodes_free(lilvvalue_minimum);
+        }
+        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.cv) || lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.mod_cvport))
+        {
+            port->type = TYPE_CV;
+
+            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.mod_cvport))
+                port->hints |= HINT_CV_MOD;
+
+            /* Set the minimum value of control */
+            float min_value;
+            LilvNodes* lilvvalue_minimum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_minimum);
+            if (lilvvalue_minimum == NULL)
+                lilvvalue_minimum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.minimum);
+
+            if (lilvvalue_minimum != NULL)
+                min_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_minimum));
+            else
+                min_value = -5.0f;
+
+            /* Set the maximum value of control */
+            float max_value;
+            LilvNodes* lilvvalue_maximum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_maximum);
+            if (lilvvalue_maximum == NULL)
+                lilvvalue_maximum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.maximum);
+
+            if (lilvvalue_maximum != NULL)
+                max_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_maximum));
+            else
+                max_value = 5.0f;
+
+            /* Ensure min < max */
+            if (min_value >= max_value)
+            {
+                max_value = min_value + 0.1f;
+            }
+            else if (lilvvalue_minimum != NULL && lilvvalue_maximum != NULL)
+            {
+                // if range is valid, set metadata
+                port->hints |= HINT_CV_RANGES;
+            }
+
+            port->min_value = min_value;
+            port->max_value = max_value;
+
+            lilv_nodes_free(lilvvalue_maximum);
+            lilv_nodes_free(lilvvalue_minimum);
+        }
+        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.event) ||
+                    lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.atom_port))
+        {
+            port->type = TYPE_EVENT;
+            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.event))
+            {
+                port->hints |= HINT_OLD_EVENT_API;
+                port->hints |= HINT_MIDI_EVENT;
+                descriptor->hints |= HINT_HAS_MIDI_INPUT;
+            }
+            else
+            {
+                if (lilv_port_supports_event(plugin, lilv_port, g_lilv_nodes.midiEvent))
+                {
+                    port->hints |= HINT_MIDI_EVENT;
+                    descriptor->hints |= HINT_HAS_MIDI_INPUT;
+                }
+                if (lilv_port_supports_event(plugin, lilv_port, g_lilv_nodes.timePosition))
+                {
+                    port->hints |= HINT_TRANSPORT;
+                    descriptor->hints |= HINT_TRANSPORT;
+                }
+            }
+
+            LilvNodes *lilvminsize = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.minimumSize);
+            if (lilvminsize != NULL)
+            {
+                const int iminsize = lilv_node_as_int(lilv_nodes_get_first(lilvminsize));
+                if (iminsize > 0)
+                    port->minimum_size = (uint)iminsize;
+                lilv_nodes_free(lilvminsize);
+            }
+
+            port->raw_midi_clock = lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.rawMIDIClockAccess);
+        }
+    }
+
+    // special ports
+    descriptor->enabled_index = GetDesignatedPortIndex(plugin, g_lilv_nodes.enabled);
+    descriptor->freewheel_index = GetDesignatedPortIndex(plugin, g_lilv_nodes.freeWheeling);
+    descriptor->reset_index = GetDesignatedPortIndex(plugin, g_lilv_nodes.reset);
+    descriptor->bpb_index = GetDesignatedPortIndex(plugin, g_lilv_nodes.timeBeatsPerBar);
+    descriptor->bpm_index = GetDesignatedPortIndex(plugin, g_lilv_nodes.timeBeatsPerMinute);
+    descriptor->speed_index = GetDesignatedPortIndex(plugin, g_lilv_nodes.timeSpeed);
+
+    {
+        // Index readable and writable properties
+        LilvNodes *writable_properties = lilv_world_find_nodes(
+            g_lv2_data,
+            lilv_plugin_get_uri(plugin),
+            g_lilv_nodes.patch_writable,
+            NULL);
+        LilvNodes *readable_properties = lilv_world_find_nodes(
+            g_lv2_data,
+            lilv_plugin_get_uri(plugin),
+            g_lilv_nodes.patch_readable,
+            NULL);
+        descriptor->properties_count = lilv_nodes_size(writable_properties) + lilv_nodes_size(readable_properties);
+        descriptor->properties = (property_t *) mod_calloc(descriptor->properties_count + 1, sizeof(property_t));
+
+        // TODO mix readable and writable
+        uint32_t j = 0;
+        LILV_FOREACH(nodes, p, writable_properties)
+        {
+            if (descriptor->properties == NULL)
+                break;
+            const LilvNode* property = lilv_nodes_get(writable_properties, p);
+            descriptor->properties[j].uri = lilv_node_duplicate(property);
+            descriptor->properties[j].type = lilv_world_get(g_lv2_data, property, g_lilv_nodes.rdfs_range, NULL);
+            descriptor->properties[j].monitored = true; // always true for writable properties
+            j++;
+        }
+        LILV_FOREACH(nodes, p, readable_properties)
+        {
+            if (descriptor->properties == NULL)
+                break;
+            const LilvNode* property = lilv_nodes_get(readable_properties, p);
+            descriptor->properties[j].uri = lilv_node_duplicate(property);
+            descriptor->properties[j].type = lilv_world_get(g_lv2_data, property, g_lilv_nodes.rdfs_range, NULL);
+            descriptor->properties[j].monitored = false; // optional
+            j++;
+        }
+
+        lilv_nodes_free(writable_properties);
+        lilv_nodes_free(readable_properties);
+
+        if (descriptor->properties == NULL)
+        {
+            PluginDescriptorFree(descriptor);
+            return NULL;
+        }
+    }
+
+    LoadPresets(descriptor);
+
+    return descriptor;
+}
+
+// returns a referenced descriptor, the caller must hold g_lilv_mutex
+static plugin_descriptor_t *PluginDescriptorGet(const char *uri, const LilvPlugin *plugin)
+{
+    plugin_descriptor_t **prev = &g_plugin_descriptors;
+    plugin_descriptor_t *descriptor;
+
+    for (descriptor = g_plugin_descriptors; descriptor != NULL; prev = &descriptor->next, descriptor = descriptor->next)
+    {
+        if (strcmp(descriptor->uri, uri) != 0)
+            continue;
+
+        if (descriptor->lilv_plugin == plugin)
+        {
+            __atomic_add_fetch(&descriptor->refcount, 1, __ATOMIC_RELAXED);
+            return descriptor;
+        }
+
+        // the plugin was reloaded since
+        *prev = descriptor->next;
+        PluginDescriptorRelease(descriptor);
+        break;
+    }
+
+    descriptor = PluginDescriptorBuild(uri, plugin);
+
+    if (descriptor == NULL)
+        return NULL;
+
+    descriptor->refcount++;
+    descriptor->next = g_plugin_descriptors;
+    g_plugin_descriptors = descriptor;
+    return descriptor;
+}
+
+static void PluginDescriptorRelease(plugin_descriptor_t *descriptor)
+{
+    if (descriptor != NULL && __atomic_sub_fetch(&descriptor->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+        PluginDescriptorFree(descriptor);
+}
+
+// drops all descriptors from the list, instances keep theirs until removed; the caller must hold g_lilv_mutex
+static void PluginDescriptorsInvalidate(void)
+{
+    plugin_descriptor_t *descriptor = g_plugin_descriptors;
+    g_plugin_descriptors = NULL;
+
+    while (descriptor != NULL)
+    {
+        plugin_descriptor_t *next = descriptor->next;
+        PluginDescriptorRelease(descriptor);
+        descriptor = next;
+    }
+}
+
+static port_t **TakePortList(port_t ***lists, uint32_t count)
+{
+    port_t **list = count != 0 ? *lists : NULL;
+    *lists += count;
+    return list;
+}
+
+// ports, control buffers, the per-type port lists and properties of an instance share a single allocation
+static bool InstanceArenaAllocate(effect_t *effect, const pthread_mutexattr_t *mutex_atts)
+{
+    const plugin_descriptor_t *descriptor = effect->descriptor;
+    const uint32_t ports_count = descriptor->ports_count;
+    const uint32_t properties_count = descriptor->properties_count;
+
+    for (uint32_t i = 0; i < ports_count; i++)
+    {
+        const port_descriptor_t *port = &descriptor->ports[i];
+        const bool input = port->flow == FLOW_INPUT;
+        const bool output = port->flow == FLOW_OUTPUT;
+
+        if (port->type == TYPE_AUDIO)
+        {
+            effect->audio_ports_count++;
+            effect->input_audio_ports_count += input;
+            effect->output_audio_ports_count += output;
+        }
+        else if (port->type == TYPE_CONTROL)
+        {
+            effect->control_ports_count++;
+            effect->input_control_ports_count += input;
+            effect->output_control_ports_count += output;
+        }
+        else if (port->type == TYPE_CV)
+        {
+            effect->cv_ports_count++;
+            effect->input_cv_ports_count += input;
+            effect->output_cv_ports_count += output;
+        }
+        else if (port->type == TYPE_EVENT)
+        {
+            effect->event_ports_count++;
+            effect->input_event_ports_count += input;
+            effect->output_event_ports_count += output;
+        }
+    }
+
+    const size_t lists_count = ports_count
+        + effect->audio_ports_count + effect->input_audio_ports_count + effect->output_audio_ports_count
+        + effect->control_ports_count + effect->input_control_ports_count + effect->output_control_ports_count
+        + effect->cv_ports_count + effect->input_cv_ports_count + effect->output_cv_ports_count
+        + effect->event_ports_count + effect->input_event_ports_count + effect->output_event_ports_count;
+
+    // largest alignment first
+    const size_t size = ports_count * sizeof(port_t)
+                      + properties_count * sizeof(property_t)
+                      + lists_count * sizeof(port_t *)
+                      + properties_count * sizeof(property_t *)
+                      + effect->control_ports_count * sizeof(float)
+                      + 1;
+
+    char *ptr = (char *) mod_calloc(1, size);
+
+    if (ptr == NULL)
+        return false;
+
+    effect->instance_arena = ptr;
+
+    port_t *ports = (port_t *) ptr;
+    ptr += ports_count * sizeof(port_t);
+    property_t *properties = (property_t *) ptr;
+    ptr += properties_count * sizeof(property_t);
+    port_t **lists = (port_t **) ptr;
+    ptr += lists_count * sizeof(port_t *);
+    effect->properties = (property_t **) ptr;
+    ptr += properties_count * sizeof(property_t *);
+    float *control_buffers = (float *) ptr;
+
+    effect->ports_count = ports_count;
+    effect->ports = TakePortList(&lists, ports_count);
+    effect->audio_ports = TakePortList(&lists, effect->audio_ports_count);
+    effect->input_audio_ports = TakePortList(&lists, effect->input_audio_ports_count);
+    effect->output_audio_ports = TakePortList(&lists, effect->output_audio_ports_count);
+    effect->control_ports = TakePortList(&lists, effect->control_ports_count);
+    effect->input_control_ports = TakePortList(&lists, effect->input_control_ports_count);
+    effect->output_control_ports = TakePortList(&lists, effect->output_control_ports_count);
+    effect->cv_ports = TakePortList(&lists, effect->cv_ports_count);
+    effect->input_cv_ports = TakePortList(&lists, effect->input_cv_ports_count);
+    effect->output_cv_ports = TakePortList(&lists, effect->output_cv_ports_count);
+    effect->event_ports = TakePortList(&lists, effect->event_ports_count);
+    effect->input_event_ports = TakePortList(&lists, effect->input_event_ports_count);
+    effect->output_event_ports = TakePortList(&lists, effect->output_event_ports_count);
+
+    /* Index the audio, control and event ports */
+    uint32_t audio_ports_count = 0, input_audio_ports_count = 0, output_audio_ports_count = 0;
+    uint32_t control_ports_count = 0, input_control_ports_count = 0, output_control_ports_count = 0;
+    uint32_t cv_ports_count = 0, input_cv_ports_count = 0, output_cv_ports_count = 0;
+    uint32_t event_ports_count = 0, input_event_ports_count = 0, output_event_ports_count = 0;
+
+    for (uint32_t i = 0; i < ports_count; i++)
+    {
+        const port_descriptor_t *port_desc = &descriptor->ports[i];
+        port_t *port = effect->ports[i] = &ports[i];
+
+        pthread_mutex_init(&port->cv_source_mutex, mutex_atts);
+
+        port->index = i;
+        port->symbol = port_desc->symbol;
+        port->type = port_desc->type;
+        port->flow = port_desc->flow;
+        port->hints = port_desc->hints;
+        port->min_value = port_desc->min_value;
+        port->max_value = port_desc->max_value;
+        port->def_value = port_desc->def_value;
+        port->prev_value = port_desc->def_value;
+        port->scale_points = port_desc->scale_points;
+
+        /* Audio ports, buffer is allocated later together with all other audio/cv ports */
+        if (port->type == TYPE_AUDIO)
+        {
+            effect->audio_ports[audio_ports_count++] = port;
+
+            if (port->flow == FLOW_INPUT)
+                effect->input_audio_ports[input_audio_ports_count++] = port;
+            else if (port->flow == FLOW_OUTPUT)
+                effect->output_audio_ports[output_audio_ports_count++] = port;
+        }
+        /* Control ports */
+        else if (port->type == TYPE_CONTROL)
+        {
+            port->buffer = &control_buffers[control_ports_count];
+            port->buffer_count = 1;
+            *port->buffer = port_desc->def_value;
+
+            effect->control_ports[control_ports_count++] = port;
+
+            if (port->flow == FLOW_INPUT)
+                effect->input_control_ports[input_control_ports_count++] = port;
+            else if (port->flow == FLOW_OUTPUT)
+                effect->output_control_ports[output_control_ports_count++] = port;
+        }
+        /* CV ports */
+        else if (port->type == TYPE_CV)
+        {
+            effect->cv_ports[cv_ports_count++] = port;
+
+            if (port->flow == FLOW_INPUT)
+                effect->input_cv_ports[input_cv_ports_count++] = port;
+            else if (port->flow == FLOW_OUTPUT)
+                effect->output_cv_ports[output_cv_ports_count++] = port;
+        }
+        /* Event ports */
+        else if (port->type == TYPE_EVENT)
+        {
+            effect->event_ports[event_ports_count++] = port;
+
+            if (port->flow == FLOW_INPUT)
+                effect->input_event_ports[input_event_ports_count++] = port;
+            else if (port->flow == FLOW_OUTPUT)
+                effect->output_event_ports[output_event_ports_count++] = port;
+        }
+    }
+
+    effect->properties_count = properties_count;
+
+    for (uint32_t i = 0; i < properties_count; i++)
+    {
+        properties[i] = descriptor->properties[i];
+        effect->properties[i] = &properties[i];
+    }
+
+    return true;
+}
+
+// ignore const cast for this function, need to free const features array
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-qual"
+
+static void FreeFeatures(effect_t *effect)
+{
+    worker_finish(&effect->worker);
+
+    if (effect->features)
+    {
+        if (effect->features[STATE_MAKE_PATH_FEATURE])
+        {
+            free(effect->features[STATE_MAKE_PATH_FEATURE]->data);
+            free((void*)effect->features[STATE_MAKE_PATH_FEATURE]);
+        }
+        if (effect->features[LOG_FEATURE])
+        {
+            free(effect->features[LOG_FEATURE]->data);
+            free((void*)effect->features[LOG_FEATURE]);
+        }
+        /*
+        if (effect->features[STATE_MAP_PATH_FEATURE])
+        {
+            free(effect->features[STATE_MAP_PATH_FEATURE]->data);
+            free((void*)effect->features[STATE_MAP_PATH_FEATURE]);
+        }
+        */
+        if (effect->features[CTRLPORT_REQUEST_FEATURE])
+        {
+            free(effect->features[CTRLPORT_REQUEST_FEATURE]->data);
+            free((void*)effect->features[CTRLPORT_REQUEST_FEATURE]);
+        }
+        if (effect->features[CTRLPORT_STATE_FEATURE])
+        {
+            free(effect->features[CTRLPORT_STATE_FEATURE]->data);
+            free((void*)effect->features[CTRLPORT_STATE_FEATURE]);
+        }
+        if (effect->features[WORKER_FEATURE])
+        {
+            free(effect->features[WORKER_FEATURE]->data);
+            free((void*)effect->features[WORKER_FEATURE]);
+        }
+        free(effect->features);
+    }
+}
+
+// back to normal
+#pragma GCC diagnostic pop
+
+static void FreePluginString(void* handle, char *str)
+{
+    return free(str);
+
+    UNUSED_PARAM(handle);
+}
+
+static void ConnectToAllHardwareMIDIPorts(void)
+{
+    if (g_jack_global_client == NULL)
+        return;
+
+    const char** const midihwports = jack_get_ports(g_jack_global_client, "",
+                                                    JACK_DEFAULT_MIDI_TYPE,
+                                                    JackPortIsTerminal|JackPortIsPhysical|JackPortIsOutput);
+    if (midihwports != NULL)
+    {
+        const char *ourportname = jack_port_name(g_midi_in_port);
+
+        for (int i=0; midihwports[i] != NULL; ++i)
+            jack_connect(g_jack_global_client, midihwports[i], ourportname);
+
+        struct list_head *it;
+        pthread_mutex_lock(&g_raw_midi_port_mutex);
+        list_for_each(it, &g_raw_midi_port_list)
+        {
+            raw_midi_port_item* const portitemptr = list_entry(it, raw_midi_port_item, siblings);
+
+            for (int i=0; midihwports[i] != NULL; ++i)
+                jack_connect(g_jack_global_client,
+                             midihwports[i],
+                             jack_port_name(portitemptr->jack_port));
+        }
+        pthread_mutex_unlock(&g_raw_midi_port_mutex);
+
+        jack_free(midihwports);
+    }
+}
+
+static void ConnectToMIDIThroughPorts(void)
+{
+    if (g_jack_global_client == NULL)
+        return;
+
+    const char** const midihwports = jack_get_ports(g_jack_global_client, "system:midi_capture_",
+                                                    JACK_DEFAULT_MIDI_TYPE,
+                                                    JackPortIsTerminal|JackPortIsPhysical|JackPortIsOutput);
+    if (midihwports != NULL)
+    {
+        char  aliases[2][320];
+        char* aliasesptr[2] = {
+            aliases[0],
+            aliases[1]
+        };
+
+        const char *ourportname = jack_port_name(g_midi_in_port);
+
+        for (int i=0; midihwports[i] != NULL; ++i)
+        {
+            jack_port_t* const port = jack_port_by_name(g_jack_global_client, midihwports[i]);
+
+            if (port == NULL)
+                continue;
+            if (jack_port_get_aliases(port, aliasesptr) <= 0)
+                continue;
+            if (strncmp(aliases[0], "alsa_pcm:Midi-Through/", 22))
+                continue;
+            jack_connect(g_jack_global_client, midihwports[i], ourportname);
+        }
+
+        jack_free(midihwports);
+    }
+}
+
+#ifdef MOD_HMI_CONTROL_ENABLED
+static void HMIWidgetsSetLedWithBlink(LV2_HMI_WidgetControl_Handle handle,
+                                      LV2_HMI_Addressing addressing_ptr,
+                                      LV2_HMI_LED_Colour led_color,
+                                      int on_blink_time,
+                                      int off_blink_time)
+{
+    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
+        return;
+    }
+
+    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+
+    const int assignment_id = addressing->actuator_id;
+    const uint8_t page = addressing->page;
+    const uint8_t subpage = addressing->subpage;
+
+    if (g_verbose_debug) {
+        printf("DEBUG: HMIWidgetsSetLedWithBlink %i: %i %i %i\n",
+               assignment_id, led_color, on_blink_time, off_blink_time);
+        fflush(stdout);
+    }
+
+    if (on_blink_time < 0)
+    {
+        if (on_blink_time < LV2_HMI_LED_Blink_Fast)
+            on_blink_time = LV2_HMI_LED_Blink_Fast;
+        off_blink_time = 0;
+    }
+    else
+    {
+        if (on_blink_time > 5000)
+            on_blink_time = 5000;
+
+        if (off_blink_time < 0)
+            off_blink_time = 0;
+        else if (off_blink_time > 5000)
+            off_blink_time = 5000;
+    }
+
+    char msg[32];
+    snprintf(msg, sizeof(msg), "%i %i %i %i", assignment_id, led_color, on_blink_time, off_blink_time);
+    msg[sizeof(msg)-1] = '\0';
+
+    pthread_mutex_lock(&g_hmi_mutex);
+    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_led_blink, page, subpage, msg);
+    pthread_mutex_unlock(&g_hmi_mutex);
+}
+
+static void HMIWidgetsSetLedWithBrightness(LV2_HMI_WidgetControl_Handle handle,
+                                           LV2_HMI_Addressing addressing_ptr,
+                                           LV2_HMI_LED_Colour led_color,
+                                           int brightness)
+{
+    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
+        return;
+    }
+
+    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+
+    const int assignment_id = addressing->actuator_id;
+    const uint8_t page = addressing->page;
+    const uint8_t subpage = addressing->subpage;
+
+    if (g_verbose_debug) {
+        printf("DEBUG: HMIWidgetsSetLedWithBrightness %i: %i %i\n",
+               assignment_id, led_color, brightness);
+        fflush(stdout);
+    }
+
+    if (brightness < LV2_HMI_LED_Brightness_Normal)
+        brightness = LV2_HMI_LED_Brightness_Normal;
+    else if (brightness > 100)
+        brightness = 100;
+
+    char msg[32];
+    snprintf(msg, sizeof(msg), "%i %i %i", assignment_id, led_color, brightness);
+    msg[sizeof(msg)-1] = '\0';
+
+    pthread_mutex_lock(&g_hmi_mutex);
+    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_led_brightness, page, subpage, msg);
+    pthread_mutex_unlock(&g_hmi_mutex);
+}
+
+static void HMIWidgetsSetLabel(LV2_HMI_WidgetControl_Handle handle,
+                               LV2_HMI_Addressing addressing_ptr,
+                               const char* label)
+{
+    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
+        return;
+    }
+
+    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+
+    const int assignment_id = addressing->actuator_id;
+    const uint8_t page = addressing->page;
+    const uint8_t subpage = addressing->subpage;
+
+    if (g_verbose_debug) {
+        printf("DEBUG: HMIWidgetsSetLabel %i: '%s'\n", assignment_id, label);
+        fflush(stdout);
+    }
+
+    char msg[24];
+    snprintf(msg, sizeof(msg), "%i %s", assignment_id, label);
+    msg[sizeof(msg)-1] = '\0';
+
+    pthread_mutex_lock(&g_hmi_mutex);
+    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_name, page, subpage, msg);
+    pthread_mutex_unlock(&g_hmi_mutex);
+}
+
+static void HMIWidgetsSetValue(LV2_HMI_WidgetControl_Handle handle,
+                               LV2_HMI_Addressing addressing_ptr,
+                               const char* value)
+{
+    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
+        return;
+    }
+
+    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+
+    const int assignment_id = addressing->actuator_id;
+    const uint8_t page = addressing->page;
+    const uint8_t subpage = addressing->subpage;
+
+    if (g_verbose_debug) {
+        printf("DEBUG: HMIWidgetsSetValue %i: '%s'\n", assignment_id, value);
+        fflush(stdout);
+    }
+
+    char msg[24];
+    snprintf(msg, sizeof(msg), "%i %s", assignment_id, value);
+    msg[sizeof(msg)-1] = '\0';
+
+    pthread_mutex_lock(&g_hmi_mutex);
+    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_value, page, subpage, msg);
+    pthread_mutex_unlock(&g_hmi_mutex);
+}
+
+static void HMIWidgetsSetUnit(LV2_HMI_WidgetControl_Handle handle,
+                              LV2_HMI_Addressing addressing_ptr,
+                              const char* unit)
+{
+    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
+        return;
+    }
+
+    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+
+    const int assignment_id = addressing->actuator_id;
+    const uint8_t page = addressing->page;
+    const uint8_t subpage = addressing->subpage;
+
+    if (g_verbose_debug) {
+        printf("DEBUG: HMIWidgetsSetUnit %i: '%s'\n", assignment_id, unit);
+        fflush(stdout);
+    }
+
+    char msg[24];
+    snprintf(msg, sizeof(msg), "%i %s", assignment_id, unit);
+    msg[sizeof(msg)-1] = '\0';
+
+    pthread_mutex_lock(&g_hmi_mutex);
+    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_unit, page, subpage, msg);
+    pthread_mutex_unlock(&g_hmi_mutex);
+}
+
+static void HMIWidgetsSetIndicator(LV2_HMI_WidgetControl_Handle handle,
+                                   LV2_HMI_Addressing addressing_ptr,
+                                   float indicator_poss)
+{
+    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
+        return;
+    }
+
+    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+
+    const int assignment_id = addressing->actuator_id;
+    const uint8_t page = addressing->page;
+    const uint8_t subpage = addressing->subpage;
+
+    if (g_verbose_debug) {
+        printf("DEBUG: HMIWidgetsSetIndicator %i: %f\n", assignment_id, indicator_poss);
+        fflush(stdout);
+    }
+
+    if (indicator_poss < 0.0f)
+        indicator_poss = 0.0f;
+    else if (indicator_poss > 1.0f)
+        indicator_poss = 1.0f;
+
+    char msg[32];
+    snprintf(msg, sizeof(msg), "%i %f", assignment_id, indicator_poss);
+    msg[31] = '\0';
+
+    pthread_mutex_lock(&g_hmi_mutex);
+    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_widget_indicator, page, subpage, msg);
+    pthread_mutex_unlock(&g_hmi_mutex);
+}
+
+static void HMIWidgetsPopupMessage(LV2_HMI_WidgetControl_Handle handle,
+                                   LV2_HMI_Addressing addressing_ptr,
+                                   LV2_HMI_Popup_Style style,
+                                   const char* title,
+                                   const char* text)
+{
+    if (handle == NULL || addressing_ptr == NULL || g_hmi_data == NULL) {
+        return;
+    }
+
+    const hmi_addressing_t *addressing = (const hmi_addressing_t*)addressing_ptr;
+
+    const int assignment_id = addressing->actuator_id;
+    const uint8_t page = addressing->page;
+    const uint8_t subpage = addressing->subpage;
+
+    if (g_verbose_debug) {
+        printf("DEBUG: HMIWidgetsPopupMessage %i: %i '%s' '%s'\n", assignment_id, style, title, text);
+        fflush(stdout);
+    }
+
+    char msg[256];
+    snprintf(msg, sizeof(msg), "%i %i \"%s\" \"%s\"", assignment_id, style, title, text);
+    msg[sizeof(msg)-1] = '\0';
+
+    pthread_mutex_lock(&g_hmi_mutex);
+    sys_serial_write(&g_hmi_data->server, sys_serial_event_type_popup, page, subpage, msg);
+    pthread_mutex_unlock(&g_hmi_mutex);
+}
+
+#endif
+
+static char* GetLicenseFile(MOD_License_Handle handle, const char *license_uri)
+{
+    if (!license_uri || *license_uri == '\0')
+        return NULL;
+
+    // get keys path. note: assumes trailing separator
+    const char* const keyspath = getenv("MOD_KEYS_PATH");
+    if (!keyspath || *keyspath == '\0')
+        return NULL;
+
+    // get path length, check trailing separator
+    const size_t keyspathlen = strlen(keyspath);
+    if (keyspath[keyspathlen-1] != '/')
+        return NULL;
+
+    // local vars
+    uint8_t* hashenc;
+    char hashdec[HASH_LENGTH*2+1];
+    FILE* file;
+    long filesize;
+    size_t filenamesize;
+    char* filename;
+    char* filebuffer = NULL;
+    sha1nfo sha1;
+
+    // hash the uri
+    sha1_init(&sha1);
+    sha1_write(&sha1, license_uri, strlen(license_uri));
+    hashenc = sha1_result(&sha1);
+
+    for (int i=0; i<HASH_LENGTH; i++) {
+        sprintf(hashdec+(i*2), "%02x", hashenc[i]);
+    }
+    hashdec[HASH_LENGTH*2] = '\0';
+
+    // join path
+    filenamesize = strlen(keyspath) + HASH_LENGTH*2;
+    filename = malloc(filenamesize+1);
+
+    if (! filename)
+        return NULL;
+
+    memcpy(filename, keyspath, keyspathlen);
+    memcpy(filename+keyspathlen, hashdec, HASH_LENGTH*2);
+    filename[filenamesize] = '\0';
+
+    // open file
+    file = fopen(filename, "r");
+
+    // cleanup
+    free(filename);
+
+    if (!file)
+        return NULL;
+
+    // get size
+    fseek(file, 0, SEEK_END);
+    filesize = ftell(file);
+    if (filesize <= 0 || filesize > 5*1024*1024) // 5Mb
+        goto end;
+
+    // allocate file buffer
+    filebuffer = (char*)mod_calloc(1, filesize+1);
+    if (! filebuffer)
+        goto end;
+
+    // read file
+    fseek(file, 0, SEEK_SET);
+    if (fread(filebuffer, 1, filesize, file) != (size_t)filesize)
+    {
+        free(filebuffer);
+        filebuffer = NULL;
+    }
+
+end:
+    fclose(file);
+    return filebuffer;
+
+    UNUSED_PARAM(handle);
+}
+
+static int LogPrintf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, ...)
+{
+    int ret;
+    va_list args;
+    va_start(args, fmt);
+    ret = LogVPrintf(handle, type, fmt, args);
+    va_end(args);
+
+    return ret;
+
+    UNUSED_PARAM(handle);
+}
+
+// rt-safe, no allocations or I/O, the message is written out later by the feedback thread
+static int LogVPrintf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, va_list ap)
+{
+    effect_t *effect = (effect_t*)handle;
+    LogType log_type;
+
+    if (type == g_urids.log_Error)
+        log_type = LOG_ERROR;
+    else if (type == g_urids.log_Warning)
+        log_type = LOG_WARNING;
+    else if (type == g_urids.log_Note)
+        log_type = LOG_NOTE;
+    else if (type == g_urids.log_Trace)
+        log_type = LOG_TRACE;
+    else
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint32_t pos;
+    log_ring_slot_t *slot;
+
+    if (effect == NULL)
+    {
+        if ((slot = LogRingReserve(&pos)) == NULL)
+            return 0;
+    }
+    else
+    {
+        const int instance = effect->instance;
+        __atomic_fetch_or(&g_log_active_effects[instance / 32], 1u << (instance % 32), __ATOMIC_RELAXED);
+
+        // plugins logging too much (for example on every run) only get counted, reported once per second
+        if (__atomic_sub_fetch(&effect->log_budget, 1, __ATOMIC_RELAXED) < 0 || (slot = LogRingReserve(&pos)) == NULL)
+        {
+            __atomic_fetch_add(&effect->log_suppressed, 1, __ATOMIC_RELAXED);
+            g_log_suppressed_pending = true;
+            return 0;
+        }
+    }
+
+    // truncates long messages
+    const int ret = vsnprintf(slot->msg, LOG_MESSAGE_SIZE, fmt, ap);
+    slot->type = log_type;
+    LogRingPublish(slot, pos);
+
+    sem_post(&g_postevents_semaphore);
+    return ret;
+}
+
+static LV2_ControlInputPort_Change_Status RequestControlPortChange(LV2_ControlInputPort_Change_Request_Handle handle,
+                                                                   uint32_t index,
+                                                                   float value)
+{
+    effect_t *effect = (effect_t*)handle;
+
+    if (index >= effect->ports_count)
+        return LV2_CONTROL_INPUT_PORT_CHANGE_ERR_INVALID_INDEX;
+
+    port_t *port = effect->ports[index];
+
+    if (port->type != TYPE_CONTROL || port->flow != FLOW_INPUT)
+        return LV2_CONTROL_INPUT_PORT_CHANGE_ERR_INVALID_INDEX;
+
+    // ignore requests for same value
+    if (!floats_differ_enough(port->prev_value, value))
+        return LV2_CONTROL_INPUT_PORT_CHANGE_SUCCESS;
+
+    if (SetPortValue(port, value, effect->instance, false, false))
+        sem_post(&g_postevents_semaphore);
+
+    return LV2_CONTROL_INPUT_PORT_CHANGE_SUCCESS;
+}
+
+static LV2_Control_Port_State_Update_Status UpdateControlPortState(LV2_Control_Port_State_Update_Handle handle,
+                                                                   uint32_t index,
+                                                                   LV2_Control_Port_State state)
+{
+    effect_t *effect = (effect_t*)handle;
+
+    if (index >= effect->ports_count)
+        return LV2_CONTROL_PORT_STATE_UPDATE_ERR_INVALID_INDEX;
+
+    port_t *port = effect->ports[index];
+
+    if (port->type != TYPE_CONTROL)
+        return LV2_CONTROL_PORT_STATE_UPDATE_ERR_INVALID_INDEX;
+
+    LV2_Control_Port_State curstate;
+    if (port->hints & HINT_STATE_BLOCKED)
+        curstate = LV2_CONTROL_PORT_STATE_BLOCKED;
+    else if (port->hints & HINT_STATE_INACTIVE)
+        curstate = LV2_CONTROL_PORT_STATE_INACTIVE;
+    else
+        curstate = LV2_CONTROL_PORT_STATE_NONE;
 
-        /* Default value of bypass */
-        effect->bypass = 0.0f;
-        effect->was_bypassed = false;
+    if (curstate == state)
+        return LV2_CONTROL_PORT_STATE_UPDATE_SUCCESS;
 
-        effect->bypass_port.buffer_count = 1;
-        effect->bypass_port.buffer = &effect->bypass;
-        effect->bypass_port.min_value = 0.0f;
-        effect->bypass_port.max_value = 1.0f;
-        effect->bypass_port.def_value = 0.0f;
-        effect->bypass_port.prev_value = 0.0f;
-        effect->bypass_port.type = TYPE_CONTROL;
-        effect->bypass_port.flow = FLOW_INPUT;
-        effect->bypass_port.hints = HINT_TOGGLE;
-        effect->bypass_port.symbol = g_bypass_port_symbol;
-        pthread_mutex_init(&effect->bypass_port.cv_source_mutex, &mutex_atts);
+    postponed_event_list_data* const posteventptr =
+        RtSafeEventAllocate();
 
-        /* virtual presets port */
-        effect->preset_value = 0.0f;
-        effect->presets_port.buffer_count = 1;
-        effect->presets_port.buffer = &effect->preset_value;
-        effect->presets_port.min_value = 0.0f;
-        effect->presets_port.max_value = 1.0f;
-        effect->presets_port.def_value = 0.0f;
-        effect->presets_port.prev_value = 0.0f;
-        effect->presets_port.type = TYPE_CONTROL;
-        effect->presets_port.flow = FLOW_INPUT;
-        effect->presets_port.hints = HINT_ENUMERATION|HINT_INTEGER;
-        effect->presets_port.symbol = g_presets_port_symbol;
-        pthread_mutex_init(&effect->presets_port.cv_source_mutex, &mutex_atts);
+    if (posteventptr == NULL)
+        return LV2_CONTROL_PORT_STATE_UPDATE_ERR_UNKNOWN;
+
+    switch (state)
+    {
+    case LV2_CONTROL_PORT_STATE_NONE:
+        port->hints &= ~(HINT_STATE_INACTIVE|HINT_STATE_BLOCKED);
+        break;
+    case LV2_CONTROL_PORT_STATE_INACTIVE:
+        port->hints |= HINT_STATE_INACTIVE;
+        port->hints &= ~HINT_STATE_BLOCKED;
+        break;
+    case LV2_CONTROL_PORT_STATE_BLOCKED:
+        port->hints |= HINT_STATE_INACTIVE|HINT_STATE_BLOCKED;
+        break;
     }
 
-    pthread_mutexattr_destroy(&mutex_atts);
+    posteventptr->event.type = POSTPONED_PARAM_STATE;
+    posteventptr->event.state.effect_id = effect->instance;
+    posteventptr->event.state.symbol    = port->symbol;
+    posteventptr->event.state.state     = state;
 
-    /* Set jack callbacks */
-    jack_set_thread_init_callback(g_jack_global_client, JackThreadInit, NULL);
-    jack_set_timebase_callback(g_jack_global_client, 1, JackTimebase, NULL);
-    jack_set_process_callback(g_jack_global_client, ProcessGlobalClient, NULL);
-    jack_set_buffer_size_callback(g_jack_global_client, BufferSize, NULL);
-    jack_set_port_registration_callback(g_jack_global_client, PortRegistration, NULL);
-    jack_set_xrun_callback(g_jack_global_client, XRun, NULL);
+    RtSafeQueuePush(posteventptr);
 
-#ifdef HAVE_HYLIA
-    /* Init hylia */
-    g_hylia_instance = hylia_create();
-    memset(&g_hylia_timeinfo, 0, sizeof(g_hylia_timeinfo));
+    sem_post(&g_postevents_semaphore);
 
-    if (g_hylia_instance)
+    return LV2_CONTROL_PORT_STATE_UPDATE_SUCCESS;
+}
+
+static char* MakePluginStatePathFromSratchDir(LV2_State_Make_Path_Handle handle, const char *path)
+{
+    effect_t *effect = (effect_t*)handle;
+    return MakePluginStatePath(effect->instance, g_lv2_scratch_dir, path);
+}
+
+static char* MakePluginStatePathDuringLoadSave(LV2_State_Make_Path_Handle handle, const char *path)
+{
+    effect_t *effect = (effect_t*)handle;
+    return MakePluginStatePath(effect->instance, effect->state_dir, path);
+}
+
+#ifdef HAVE_CONTROLCHAIN
+static void CCDataUpdate(void* arg)
+{
+    cc_update_list_t *updates = arg;
+
+    bool is_bypass, needs_post = false;
+    const int device_id = updates->device_id;
+
+    for (int i = 0; i < updates->count; i++)
     {
-        hylia_set_beats_per_bar(g_hylia_instance, g_transport_bpb);
-        hylia_set_beats_per_minute(g_hylia_instance, g_transport_bpm);
-        hylia_set_output_latency(g_hylia_instance, GetHyliaOutputLatency());
+        cc_update_data_t *data = &updates->list[i];
+        assignment_t *assignment =
+            &g_assignments_list[device_id][data->assignment_id];
+
+        if (!assignment->port)
+            continue;
+
+        if (g_verbose_debug) {
+            printf("DEBUG: CCDataUpdate received %f as value of portsymbol %s (with prev value as %f)\n",
+                   data->value, assignment->port->symbol, assignment->port->prev_value);
+            fflush(stdout);
+        }
+
+        // invert value if bypass
+        if ((is_bypass = !strcmp(assignment->port->symbol, g_bypass_port_symbol)))
+            data->value = 1.0f - data->value;
+
+        // ignore requests for same value
+        if (!floats_differ_enough(assignment->port->prev_value, data->value))
+        {
+            if (g_verbose_debug) {
+                puts("DEBUG: CCDataUpdate ignoring value change (matches previous value)");
+                fflush(stdout);
+            }
+            continue;
+        }
+
+        if (SetPortValue(assignment->port, data->value, assignment->effect_id, is_bypass, false))
+            needs_post = true;
     }
-#endif
 
-    /* Load all LV2 data */
-    g_lv2_data = lilv_world_new();
-#ifdef LILV_OPTION_OBJECT_INDEX
-    lilv_world_set_option(g_lv2_data, LILV_OPTION_OBJECT_INDEX, NULL);
-#endif
-    lilv_world_load_all(g_lv2_data);
-    g_plugins = lilv_world_get_all_plugins(g_lv2_data);
+    if (needs_post)
+        sem_post(&g_postevents_semaphore);
+}
 
-    /* Lilv Nodes initialization */
-    g_lilv_nodes.atom_port = lilv_new_uri(g_lv2_data, LV2_ATOM__AtomPort);
-    g_lilv_nodes.audio = lilv_new_uri(g_lv2_data, LILV_URI_AUDIO_PORT);
-    g_lilv_nodes.control = lilv_new_uri(g_lv2_data, LILV_URI_CONTROL_PORT);
-    g_lilv_nodes.control_in = lilv_new_uri(g_lv2_data, LV2_CORE__control);
-    g_lilv_nodes.cv = lilv_new_uri(g_lv2_data, LILV_URI_CV_PORT);
-    g_lilv_nodes.default_ = lilv_new_uri(g_lv2_data, LV2_CORE__default);
-    g_lilv_nodes.enabled = lilv_new_uri(g_lv2_data, LV2_CORE__enabled);
-    g_lilv_nodes.enumeration = lilv_new_uri(g_lv2_data, LV2_CORE__enumeration);
-    g_lilv_nodes.event = lilv_new_uri(g_lv2_data, LILV_URI_EVENT_PORT);
-    g_lilv_nodes.freeWheeling = lilv_new_uri(g_lv2_data, LV2_CORE__freeWheeling);
-    g_lilv_nodes.hmi_interface = lilv_new_uri(g_lv2_data, LV2_HMI__PluginNotification);
-    g_lilv_nodes.input = lilv_new_uri(g_lv2_data, LILV_URI_INPUT_PORT);
-    g_lilv_nodes.integer = lilv_new_uri(g_lv2_data, LV2_CORE__integer);
-    g_lilv_nodes.license_interface = lilv_new_uri(g_lv2_data, MOD_LICENSE__interface);
-    g_lilv_nodes.is_live = lilv_new_uri(g_lv2_data, LV2_CORE__isLive);
-    g_lilv_nodes.logarithmic = lilv_new_uri(g_lv2_data, LV2_PORT_PROPS__logarithmic);
-    g_lilv_nodes.maximum = lilv_new_uri(g_lv2_data, LV2_CORE__maximum);
-    g_lilv_nodes.midiEvent = lilv_new_uri(g_lv2_data, LV2_MIDI__MidiEvent);
-    g_lilv_nodes.minimum = lilv_new_uri(g_lv2_data, LV2_CORE__minimum);
-    g_lilv_nodes.minimumSize = lilv_new_uri(g_lv2_data, LV2_RESIZE_PORT__minimumSize);
-    g_lilv_nodes.mod_cvport = lilv_new_uri(g_lv2_data, LILV_NS_MOD "CVPort");
-    g_lilv_nodes.mod_default = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default");
-#if defined(_MOD_DEVICE_DUO)
-    g_lilv_nodes.mod_default_custom = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default_duo");
-#elif defined(_MOD_DEVICE_DUOX)
-    g_lilv_nodes.mod_default_custom = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default_duox");
-#elif defined(_MOD_DEVICE_DWARF)
-    g_lilv_nodes.mod_default_custom = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default_dwarf");
-#elif defined(_MOD_DEVICE_X86_64)
-    g_lilv_nodes.mod_default_custom = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default_x64");
-#else
-    g_lilv_nodes.mod_default_custom = NULL;
-#endif
-    g_lilv_nodes.mod_maximum = lilv_new_uri(g_lv2_data, LILV_NS_MOD "maximum");
-    g_lilv_nodes.mod_minimum = lilv_new_uri(g_lv2_data, LILV_NS_MOD "minimum");
-    g_lilv_nodes.noPreRun = lilv_new_uri(g_lv2_data, "http://www.darkglass.com/lv2/ns#noPreRun");
-    g_lilv_nodes.options_interface = lilv_new_uri(g_lv2_data, LV2_OPTIONS__interface);
-    g_lilv_nodes.output = lilv_new_uri(g_lv2_data, LILV_URI_OUTPUT_PORT);
-    g_lilv_nodes.patch_writable = lilv_new_uri(g_lv2_data, LV2_PATCH__writable);
-    g_lilv_nodes.patch_readable = lilv_new_uri(g_lv2_data, LV2_PATCH__readable);
-    g_lilv_nodes.preferMomentaryOff = lilv_new_uri(g_lv2_data, LILV_NS_MOD "preferMomentaryOffByDefault");
-    g_lilv_nodes.preferMomentaryOn = lilv_new_uri(g_lv2_data, LILV_NS_MOD "preferMomentaryOnByDefault");
-    g_lilv_nodes.preset = lilv_new_uri(g_lv2_data, LV2_PRESETS__Preset);
-    g_lilv_nodes.rawMIDIClockAccess = lilv_new_uri(g_lv2_data, LILV_NS_MOD "rawMIDIClockAccess");
-    g_lilv_nodes.rdfs_range = lilv_new_uri(g_lv2_data, LILV_NS_RDFS "range");
-    g_lilv_nodes.reset = lilv_new_uri(g_lv2_data, LV2_KXSTUDIO_PROPERTIES__Reset);
-    g_lilv_nodes.sample_rate = lilv_new_uri(g_lv2_data, LV2_CORE__sampleRate);
-    g_lilv_nodes.state_interface = lilv_new_uri(g_lv2_data, LV2_STATE__interface);
-    g_lilv_nodes.state_load_default_state = lilv_new_uri(g_lv2_data, LV2_STATE__loadDefaultState);
-    g_lilv_nodes.state_thread_safe_restore = lilv_new_uri(g_lv2_data, LV2_STATE__threadSafeRestore);
-    g_lilv_nodes.timeBeatsPerBar = lilv_new_uri(g_lv2_data, LV2_TIME__beatsPerBar);
-    g_lilv_nodes.timeBeatsPerMinute = lilv_new_uri(g_lv2_data, LV2_TIME__beatsPerMinute);
-    g_lilv_nodes.timePosition = lilv_new_uri(g_lv2_data, LV2_TIME__Position);
-    g_lilv_nodes.timeSpeed = lilv_new_uri(g_lv2_data, LV2_TIME__speed);
-    g_lilv_nodes.toggled = lilv_new_uri(g_lv2_data, LV2_CORE__toggled);
-    g_lilv_nodes.trigger = lilv_new_uri(g_lv2_data, LV2_PORT_PROPS__trigger);
-    g_lilv_nodes.worker_interface = lilv_new_uri(g_lv2_data, LV2_WORKER__interface);
+static void InitializeControlChainIfNeeded(void)
+{
+    if (g_cc_client != NULL)
+        return;
 
-    /* URI and URID Feature initialization */
-    urid_sem_init();
-    g_symap = symap_new();
+    if ((g_cc_client = cc_client_new("/tmp/control-chain.sock")) != NULL)
+        cc_client_data_update_cb(g_cc_client, CCDataUpdate);
+}
 
-    g_uri_map.callback_data = g_symap;
-    g_uri_map.uri_to_id = &uri_to_id;
+static bool CheckCCDeviceProtocolVersion(int device_id, int major, int minor)
+{
+    char *descriptor = cc_client_device_descriptor(g_cc_client, device_id);
 
-    g_urid_map.handle = g_symap;
-    g_urid_map.map = urid_to_id;
-    g_urid_unmap.handle = g_symap;
-    g_urid_unmap.unmap = id_to_urid;
+    if (!descriptor)
+    {
+        printf("CheckCCDeviceProtocolVersion error: failed to get device descriptor with id %i\n", device_id);
+        return false;
+    }
 
-    g_urids.atom_Double          = urid_to_id(g_symap, LV2_ATOM__Double);
-    g_urids.atom_Bool            = urid_to_id(g_symap, LV2_ATOM__Bool);
-    g_urids.atom_Float           = urid_to_id(g_symap, LV2_ATOM__Float);
-    g_urids.atom_Int             = urid_to_id(g_symap, LV2_ATOM__Int);
-    g_urids.atom_Long            = urid_to_id(g_symap, LV2_ATOM__Long);
-    g_urids.atom_Object          = urid_to_id(g_symap, LV2_ATOM__Object);
-    g_urids.atom_Path            = urid_to_id(g_symap, LV2_ATOM__Path);
-    g_urids.atom_String          = urid_to_id(g_symap, LV2_ATOM__String);
-    g_urids.atom_Tuple           = urid_to_id(g_symap, LV2_ATOM__Tuple);
-    g_urids.atom_URI             = urid_to_id(g_symap, LV2_ATOM__URI);
-    g_urids.atom_Vector          = urid_to_id(g_symap, LV2_ATOM__Vector);
-    g_urids.atom_eventTransfer   = urid_to_id(g_symap, LV2_ATOM__eventTransfer);
+    // we quickly parse the json ourselves in order to prevent adding more dependencies into mod-host
+    const char *vsplit, *vstart, *vend;
 
-    g_urids.bufsz_maxBlockLength     = urid_to_id(g_symap, LV2_BUF_SIZE__maxBlockLength);
-    g_urids.bufsz_minBlockLength     = urid_to_id(g_symap, LV2_BUF_SIZE__minBlockLength);
-    g_urids.bufsz_nomimalBlockLength = urid_to_id(g_symap, LV2_BUF_SIZE__nominalBlockLength);
-    g_urids.bufsz_sequenceSize   = urid_to_id(g_symap, LV2_BUF_SIZE__sequenceSize);
+    vsplit = strstr(descriptor, "\"protocol\":");
+    if (!vsplit)
+    {
+        puts("CheckCCDeviceProtocolVersion error: failed to find protocol field");
+        goto free;
+    }
+
+    vstart = strstr(vsplit+10, "\"");
+    if (!vstart)
+    {
+        puts("CheckCCDeviceProtocolVersion error: failed to find protocol field start");
+        goto free;
+    }
+    ++vstart;
+
+    vend = strstr(vstart, "\"");
+    if (!vend)
+    {
+        puts("CheckCCDeviceProtocolVersion error: failed to find protocol field end");
+        goto free;
+    }
+
+    char buf_major[8] = {0};
+    char buf_minor[8] = {0};
+    char *buf = buf_major;
 
-    g_urids.jack_client          = urid_to_id(g_symap, "http://jackaudio.org/metadata/client");
+    for (int i=0; i<7; ++vstart)
+    {
+        if (*vstart >= '0' && *vstart <= '9')
+        {
+            buf[i++] = *vstart;
+            continue;
+        }
 
-    g_urids.log_Error            = urid_to_id(g_symap, LV2_LOG__Error);
-    g_urids.log_Note             = urid_to_id(g_symap, LV2_LOG__Note);
-    g_urids.log_Trace            = urid_to_id(g_symap, LV2_LOG__Trace);
-    g_urids.log_Warning          = urid_to_id(g_symap, LV2_LOG__Warning);
+        if (*vstart == '.' && buf == buf_major)
+        {
+            i = 0;
+            buf = buf_minor;
+            continue;
+        }
 
-    g_urids.midi_MidiEvent       = urid_to_id(g_symap, LV2_MIDI__MidiEvent);
-    g_urids.param_sampleRate     = urid_to_id(g_symap, LV2_PARAMETERS__sampleRate);
+        break;
+    }
 
-    g_urids.patch_Get            = urid_to_id(g_symap, LV2_PATCH__Get);
-    g_urids.patch_Set            = urid_to_id(g_symap, LV2_PATCH__Set);
-    g_urids.patch_property       = urid_to_id(g_symap, LV2_PATCH__property);
-    g_urids.patch_sequence       = urid_to_id(g_symap, LV2_PATCH__sequenceNumber);
-    g_urids.patch_value          = urid_to_id(g_symap, LV2_PATCH__value);
+    const int device_major = atoi(buf_major);
+    const int device_minor = atoi(buf_minor);
 
-    g_urids.time_Position        = urid_to_id(g_symap, LV2_TIME__Position);
-    g_urids.time_bar             = urid_to_id(g_symap, LV2_TIME__bar);
-    g_urids.time_barBeat         = urid_to_id(g_symap, LV2_TIME__barBeat);
-    g_urids.time_beat            = urid_to_id(g_symap, LV2_TIME__beat);
-    g_urids.time_beatUnit        = urid_to_id(g_symap, LV2_TIME__beatUnit);
-    g_urids.time_beatsPerBar     = urid_to_id(g_symap, LV2_TIME__beatsPerBar);
-    g_urids.time_beatsPerMinute  = urid_to_id(g_symap, LV2_TIME__beatsPerMinute);
-    g_urids.time_ticksPerBeat    = urid_to_id(g_symap, LV2_KXSTUDIO_PROPERTIES__TimePositionTicksPerBeat);
-    g_urids.time_frame           = urid_to_id(g_symap, LV2_TIME__frame);
-    g_urids.time_speed           = urid_to_id(g_symap, LV2_TIME__speed);
+    free(descriptor);
+    return device_major >= major && device_minor >= minor;
 
-    g_urids.threads_schedPolicy   = urid_to_id(g_symap, "http://ardour.org/lv2/threads/#schedPolicy");
-    g_urids.threads_schedPriority = urid_to_id(g_symap, "http://ardour.org/lv2/threads/#schedPriority");
+free:
+    free(descriptor);
+    return false;
+}
+#endif
 
-    /* Options Feature initialization */
-    g_options[0].context = LV2_OPTIONS_INSTANCE;
-    g_options[0].subject = 0;
-    g_options[0].key = g_urids.param_sampleRate;
-    g_options[0].size = sizeof(float);
-    g_options[0].type = g_urids.atom_Float;
-    g_options[0].value = &g_sample_rate_f;
+#ifdef HAVE_HYLIA
+static uint32_t GetHyliaOutputLatency(void)
+{
+    const long long int latency = llround(1.0e6 * g_block_length / g_sample_rate);
 
-    g_options[1].context = LV2_OPTIONS_INSTANCE;
-    g_options[1].subject = 0;
-    g_options[1].key = g_urids.bufsz_minBlockLength;
-    g_options[1].size = sizeof(int32_t);
-    g_options[1].type = g_urids.atom_Int;
-    g_options[1].value = &g_block_length;
+    if (latency >= 0 && latency < UINT32_MAX)
+        return (uint32_t)latency;
 
-    g_options[2].context = LV2_OPTIONS_INSTANCE;
-    g_options[2].subject = 0;
-    g_options[2].key = g_urids.bufsz_maxBlockLength;
-    g_options[2].size = sizeof(int32_t);
-    g_options[2].type = g_urids.atom_Int;
-    g_options[2].value = &g_block_length;
+    return 0;
+}
+#endif
 
-    g_options[3].context = LV2_OPTIONS_INSTANCE;
-    g_options[3].subject = 0;
-    g_options[3].key = g_urids.bufsz_nomimalBlockLength;
-    g_options[3].size = sizeof(int32_t);
-    g_options[3].type = g_urids.atom_Int;
-    g_options[3].value = &g_block_length;
+#ifdef WITH_EXTERNAL_UI_SUPPORT
+static void ExternalControllerWriteFunction(LV2UI_Controller controller,
+                                            uint32_t port_index,
+                                            uint32_t buffer_size,
+                                            uint32_t port_protocol,
+                                            const void *buffer)
+{
+    if (port_protocol != 0)
+    {
+        printf("ExternalControllerWriteFunction %p %u %u %u %p\n", controller, port_index, buffer_size, port_protocol, buffer);
+        return;
+    }
 
-    g_options[4].context = LV2_OPTIONS_INSTANCE;
-    g_options[4].subject = 0;
-    g_options[4].key = g_urids.bufsz_sequenceSize;
-    g_options[4].size = sizeof(int32_t);
-    g_options[4].type = g_urids.atom_Int;
-    g_options[4].value = &g_midi_buffer_size;
+    effect_t *effect = (effect_t*)controller;
 
-    g_options[5].context = LV2_OPTIONS_INSTANCE;
-    g_options[5].subject = 0;
-    g_options[5].key = g_urids.threads_schedPolicy;
-    g_options[5].size = sizeof(int32_t);
-    g_options[5].type = g_urids.atom_Int;
-    g_options[5].value = &g_thread_policy;
+    if (port_index >= effect->ports_count)
+        return;
 
-    g_options[6].context = LV2_OPTIONS_INSTANCE;
-    g_options[6].subject = 0;
-    g_options[6].key = g_urids.threads_schedPriority;
-    g_options[6].size = sizeof(int32_t);
-    g_options[6].type = g_urids.atom_Int;
-    g_options[6].value = &g_thread_priority;
+    port_t *port = effect->ports[port_index];
+    const float value = *((const float*)buffer);
 
-    g_options[7].context = LV2_OPTIONS_INSTANCE;
-    g_options[7].subject = 0;
-    g_options[7].key = g_urids.jack_client;
-    g_options[7].size = sizeof(jack_client_t*);
-    g_options[7].type = g_urids.jack_client;
-    g_options[7].value = NULL;
+    if (port->type != TYPE_CONTROL || port->flow != FLOW_INPUT)
+        return;
 
-    g_options[8].context = LV2_OPTIONS_INSTANCE;
-    g_options[8].subject = 0;
-    g_options[8].key = 0;
-    g_options[8].size = 0;
-    g_options[8].type = 0;
-    g_options[8].value = NULL;
+    // ignore requests for same value
+    if (!floats_differ_enough(port->prev_value, value))
+        return;
 
-#ifdef MOD_HMI_CONTROL_ENABLED
-    g_hmi_wc.size                    = sizeof(g_hmi_wc);
-    g_hmi_wc.set_led_with_blink      = HMIWidgetsSetLedWithBlink;
-    g_hmi_wc.set_led_with_brightness = HMIWidgetsSetLedWithBrightness;
-    g_hmi_wc.set_label               = HMIWidgetsSetLabel;
-    g_hmi_wc.set_value               = HMIWidgetsSetValue;
-    g_hmi_wc.set_unit                = HMIWidgetsSetUnit;
-    g_hmi_wc.set_indicator           = HMIWidgetsSetIndicator;
-    g_hmi_wc.popup_message           = HMIWidgetsPopupMessage;
+    if (SetPortValue(port, value, effect->instance, false, true))
+        sem_post(&g_postevents_semaphore);
+}
+#endif
+
+/*
+************************************************************************************************************************
+*           GLOBAL FUNCTIONS
+************************************************************************************************************************
+*/
 
+int effects_init(void* client)
+{
+    /* This global client is for connections / disconnections and midi-learn */
     if (client != NULL)
     {
-        // HMI integration setup
-        if (sys_serial_open(&g_hmi_shmfd, &g_hmi_data))
-        {
-            g_hmi_wc.handle = g_hmi_data;
-            sys_serial_write(&g_hmi_data->server, sys_serial_event_type_special_req, 0, 0, "restart");
-            zix_thread_create(&g_hmi_client_thread, 0, HMIClientThread, &g_hmi_data->client);
-        }
-        else
-        {
-            g_hmi_wc.handle = NULL;
-            fprintf(stderr, "sys_host HMI setup failed\n");
-        }
+        g_jack_global_client = (jack_client_t*)client;
+    }
+    else
+    {
+        g_jack_global_client = jack_client_open("mod-host", JackNoStartServer, NULL);
     }
 
-    for (int i = 0; i < MAX_HMI_ADDRESSINGS; i++)
-        g_hmi_addressings[i].actuator_id = -1;
-#endif
-
-#ifdef MOD_IO_PROCESSING_ENABLED
-    gate_init(&g_noisegate);
-#endif
+    if (g_jack_global_client == NULL)
+    {
+        return ERR_JACK_CLIENT_CREATION;
+    }
 
-    g_license.handle = NULL;
-    g_license.license = GetLicenseFile;
-    g_license.free = FreePluginString;
+    /* Register jack ports */
+    g_midi_in_port = jack_port_register(g_jack_global_client, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
 
-    g_lv2_log.handle = NULL;
-    g_lv2_log.printf = LogPrintf;
-    g_lv2_log.vprintf = LogVPrintf;
+    if (! g_midi_in_port)
+    {
+        fprintf(stderr, "can't register global jack midi-in port\n");
+        if (client == NULL)
+            jack_client_close(g_jack_global_client);
+        return ERR_JACK_PORT_REGISTER;
+    }
 
-    g_state_freePath.handle = NULL;
-    g_state_freePath.free_path = FreePluginString;
+#ifdef MOD_IO_PROCESSING_ENABLED
+    g_audio_in1_port = jack_port_register(g_jack_global_client, "in1", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+    g_audio_in2_port = jack_port_register(g_jack_global_client, "in2", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+    g_audio_out1_port = jack_port_register(g_jack_global_client, "out1", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    g_audio_out2_port = jack_port_register(g_jack_global_client, "out2", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
 
-    g_lv2_scratch_dir = str_duplicate("/tmp/mod-host-scratch-dir");
+    if (! (g_audio_in1_port && g_audio_in2_port && g_audio_out1_port && g_audio_out2_port))
+    {
+        fprintf(stderr, "can't register global jack audio ports\n");
+        if (client == NULL)
+            jack_client_close(g_jack_global_client);
+        return ERR_JACK_PORT_REGISTER;
+    }
 
-    lv2_atom_forge_init(&g_lv2_atom_forge, &g_urid_map);
+    jack_port_tie(g_audio_in1_port, g_audio_out1_port);
+    jack_port_tie(g_audio_in2_port, g_audio_out2_port);
+#endif
 
-    /* Init the midi variables */
-    for (int i = 0; i < MAX_MIDI_CC_ASSIGN; i++)
+    if (g_jack_global_client != NULL && strcmp(jack_get_client_name(g_jack_global_client), "mod-host") == 0 && ! monitor_client_init())
     {
-        g_midi_cc_list[i].channel = -1;
-        g_midi_cc_list[i].controller = 0;
-        g_midi_cc_list[i].minimum = 0.0f;
-        g_midi_cc_list[i].maximum = 1.0f;
-        g_midi_cc_list[i].effect_id = ASSIGNMENT_NULL;
-        g_midi_cc_list[i].symbol = NULL;
-        g_midi_cc_list[i].port = NULL;
+        return ERR_JACK_CLIENT_CREATION;
     }
-    g_midi_learning = NULL;
 
-    memset(g_monitored_midi_controls, 0, sizeof(g_monitored_midi_controls));
-    memset(g_monitored_midi_programs, 0, sizeof(g_monitored_midi_programs));
+    memset(g_effects, 0, sizeof(g_effects));
 
-#ifdef HAVE_CONTROLCHAIN
-    /* Init the control chain variables */
-    memset(&g_assignments_list, 0, sizeof(g_assignments_list));
+    g_rtsafe_queue.stub.next = NULL;
+    g_rtsafe_queue.head = g_rtsafe_queue.tail = &g_rtsafe_queue.stub;
+    g_rtsafe_drops = g_rtsafe_contention = 0;
+    INIT_LIST_HEAD(&g_raw_midi_port_list);
 
-    for (int i = 0; i < CC_MAX_DEVICES; i++)
+    if (!rtsafe_memory_pool_create(&g_rtsafe_mem_pool, sizeof(postponed_event_list_data), MAX_POSTPONED_EVENTS))
     {
-        for (int j = 0; j < CC_MAX_ASSIGNMENTS; j++)
-        {
-            g_assignments_list[i][j].effect_id = ASSIGNMENT_NULL;
-            g_assignments_list[i][j].assignment_pair_id = -1;
-        }
+        fprintf(stderr, "can't allocate realtime-safe memory pool\n");
+        if (client == NULL)
+            jack_client_close(g_jack_global_client);
+        return ERR_MEMORY_ALLOCATION;
     }
+
+    pthread_mutexattr_t mutex_atts;
+    pthread_mutexattr_init(&mutex_atts);
+#ifdef __MOD_DEVICES__
+    pthread_mutexattr_setprotocol(&mutex_atts, PTHREAD_PRIO_INHERIT);
+#endif
+
+    pthread_mutex_init(&g_rtsafe_mutex, &mutex_atts);
+    pthread_mutex_init(&g_raw_midi_port_mutex, &mutex_atts);
+    pthread_mutex_init(&g_audio_monitor_mutex, &mutex_atts);
+    pthread_mutex_init(&g_midi_learning_mutex, &mutex_atts);
+    pthread_mutex_init(&g_graph_mutex, &mutex_atts);
+    pthread_mutex_init(&g_lilv_mutex, &mutex_atts);
+#ifdef MOD_HMI_CONTROL_ENABLED
+    pthread_mutex_init(&g_hmi_mutex, &mutex_atts);
 #endif
 
-    /* Start the thread that consumes from the event queue */
-    g_postevents_running = 1;
-    g_postevents_ready = true;
-    zix_thread_create(&g_postevents_thread, 0, PostPonedEventsThread, NULL);
+    sem_init(&g_postevents_semaphore, 0, 0);
 
-    /* get transport state */
-    UpdateGlobalJackPosition(UPDATE_POSITION_SKIP, false);
+    g_sync_scheduled_staging = &g_sync_scheduled_batches[0];
+    g_sync_scheduled_pending = &g_sync_scheduled_batches[1];
+    g_sync_scheduled_state = SYNC_SCHEDULED_IDLE;
+
+    for (int i = 0; i < MAX_TRANSACTIONS; i++)
+        g_txns[i].client = -1;
+    g_txns_open = 0;
 
-    /* Try activate the jack global client */
-    if (jack_activate(g_jack_global_client) != 0)
     {
-        fprintf(stderr, "can't activate global jack client\n");
-        if (client == NULL)
-            jack_client_close(g_jack_global_client);
-        return ERR_JACK_CLIENT_ACTIVATION;
+        pthread_mutexattr_t recursive_atts;
+        pthread_mutexattr_init(&recursive_atts);
+        pthread_mutexattr_settype(&recursive_atts, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&g_sync_scheduled_lock, &recursive_atts);
+        pthread_mutexattr_destroy(&recursive_atts);
     }
 
-    /* Connect to midi-merger if avaiable */
-    g_aggregated_midi_enabled = jack_port_by_name(g_jack_global_client, "mod-midi-merger:out") != NULL;
+    /* Get the system ports */
+    g_capture_ports = jack_get_ports(g_jack_global_client, "system", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput);
+    g_playback_ports = jack_get_ports(g_jack_global_client, "system", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput);
 
-    if (g_aggregated_midi_enabled)
+    /* Get buffers size */
+    g_block_length = jack_get_buffer_size(g_jack_global_client);
+    g_sample_rate = jack_get_sample_rate(g_jack_global_client);
+    g_sample_rate_f = g_sample_rate;
+    g_midi_buffer_size = jack_port_type_get_buffer_size(g_jack_global_client, JACK_DEFAULT_MIDI_TYPE);
+    g_max_allowed_midi_delta = (jack_nframes_t)(g_sample_rate * 0.2); // max 200ms of allowed delta
+
+    /* Get RT thread information */
+    const char* const mod_plugthreadprio = getenv("MOD_PLUGIN_THREAD_PRIORITY");
+    if (mod_plugthreadprio != NULL)
     {
-        const char *ourportname = jack_port_name(g_midi_in_port);
-        jack_connect(g_jack_global_client, "mod-midi-merger:out", ourportname);
-        ConnectToMIDIThroughPorts();
+        g_thread_priority = atoi(mod_plugthreadprio);
+        g_thread_policy = SCHED_FIFO;
     }
-    /* Else connect to all good hw ports (system, ttymidi and nooice) */
     else
     {
-        ConnectToAllHardwareMIDIPorts();
-    }
-
-#ifdef MOD_IO_PROCESSING_ENABLED
-    /* Connect to capture ports if avaiable */
-    if (g_capture_ports != NULL && g_capture_ports[0] != NULL)
-    {
-        const char *ourportname;
-#ifndef _MOD_DEVICE_DWARF
-        ourportname = jack_port_name(g_audio_in1_port);
-#else
-        ourportname = jack_port_name(g_audio_in2_port);
-#endif
-        jack_connect(g_jack_global_client, g_capture_ports[0], ourportname);
-
-        if (g_capture_ports[1] != NULL)
+        const int prio = jack_is_realtime(g_jack_global_client)
+                       ? jack_client_real_time_priority(g_jack_global_client)
+                       : -1;
+        if (prio > 1)
         {
-#ifndef _MOD_DEVICE_DWARF
-            ourportname = jack_port_name(g_audio_in2_port);
-#else
-            ourportname = jack_port_name(g_audio_in1_port);
-#endif
-            jack_connect(g_jack_global_client, g_capture_ports[1], ourportname);
+            g_thread_priority = prio - 1;
+            g_thread_policy = SCHED_FIFO;
+        }
+        else
+        {
+            g_thread_priority = 0;
+            g_thread_policy = SCHED_OTHER;
         }
     }
-#endif
 
-    g_processing_enabled = true;
-
-    return SUCCESS;
+    /* initial transport state */
+    g_transport_reset = true;
+    g_transport_bpb = 4.0;
+    g_transport_bpm = 120.0;
+    g_transport_sync_mode = TRANSPORT_SYNC_NONE;
 
-    UNUSED_PARAM(global_effect_id_static_check1);
-    UNUSED_PARAM(global_effect_id_static_check2);
-}
+    /* check verbose mode */
+    const char* const mod_log = getenv("MOD_LOG");
+    g_verbose_debug = mod_log != NULL && atoi(mod_log) != 0;
 
-int effects_finish(int close_client)
-{
-    g_postevents_running = -1;
-    sem_post(&g_postevents_semaphore);
-    zix_thread_join(g_postevents_thread, NULL);
+    /* this fails to build if GLOBAL_EFFECT_ID >= MAX_INSTANCES */
+    char global_effect_id_static_check1[GLOBAL_EFFECT_ID >= MAX_PLUGIN_INSTANCES?1:-1];
+    char global_effect_id_static_check2[GLOBAL_EFFECT_ID < MAX_INSTANCES?1:-1];
 
-    if (close_client && g_jack_global_client != NULL && strcmp(jack_get_client_name(g_jack_global_client), "mod-host") == 0)
-        monitor_client_stop();
+    /* global ports */
+    {
+        port_t **ports = (port_t **) calloc(3, sizeof(port_t *));
 
-    effects_remove(REMOVE_ALL);
+        port_t *port_bpb = ports[0] = calloc(1, sizeof(port_t));
+        port_bpb->buffer = &port_bpb->prev_value;
+        port_bpb->buffer_count = 1;
+        port_bpb->min_value = 0.0f;
+        port_bpb->max_value = 1.0f;
+        port_bpb->def_value = 0.0f;
+        port_bpb->type = TYPE_CONTROL;
+        port_bpb->flow = FLOW_INPUT;
+        port_bpb->hints = 0x0;
+        port_bpb->symbol = g_bpb_port_symbol;
+        pthread_mutex_init(&port_bpb->cv_source_mutex, &mutex_atts);
 
-#ifdef MOD_HMI_CONTROL_ENABLED
-    if (g_hmi_data != NULL)
-    {
-        sys_serial_shm_data* hmi_data = g_hmi_data;
-        g_hmi_data = NULL;
+        port_t *port_bpm = ports[1] = calloc(1, sizeof(port_t));
+        port_bpm->index = 1;
+        port_bpm->buffer = &port_bpm->prev_value;
+        port_bpm->buffer_count = 1;
+        port_bpm->min_value = 0.0f;
+        port_bpm->max_value = 1.0f;
+        port_bpm->def_value = 0.0f;
+        port_bpm->type = TYPE_CONTROL;
+        port_bpm->flow = FLOW_INPUT;
+        port_bpm->hints = 0x0;
+        port_bpm->symbol = g_bpm_port_symbol;
+        pthread_mutex_init(&port_bpm->cv_source_mutex, &mutex_atts);
 
-        sem_post(&hmi_data->client.sem);
-        zix_thread_join(g_hmi_client_thread, NULL);
+        port_t *port_rolling = ports[2] = calloc(1, sizeof(port_t));
+        port_rolling->index = 2;
+        port_rolling->buffer = &port_rolling->prev_value;
+        port_rolling->buffer_count = 1;
+        port_rolling->min_value = 0.0f;
+        port_rolling->max_value = 1.0f;
+        port_rolling->def_value = 0.0f;
+        port_rolling->type = TYPE_CONTROL;
+        port_rolling->flow = FLOW_INPUT;
+        port_rolling->hints = HINT_TOGGLE;
+        port_rolling->symbol = g_rolling_port_symbol;
+        pthread_mutex_init(&port_rolling->cv_source_mutex, &mutex_atts);
 
-        sys_serial_close(g_hmi_shmfd, hmi_data);
-    }
-#endif
+        effect_t *effect = &g_effects[GLOBAL_EFFECT_ID];
 
-#ifdef HAVE_CONTROLCHAIN
-    if (g_cc_client)
-    {
-        cc_client_delete(g_cc_client);
-        g_cc_client = NULL;
-    }
-#endif
+        effect->instance = GLOBAL_EFFECT_ID;
+        effect->jack_client = g_jack_global_client;
 
-    if (g_capture_ports) jack_free(g_capture_ports);
-    if (g_playback_ports) jack_free(g_playback_ports);
-    if (close_client) jack_client_close(g_jack_global_client);
-    symap_free(g_symap);
-    lilv_node_free(g_lilv_nodes.atom_port);
-    lilv_node_free(g_lilv_nodes.audio);
-    lilv_node_free(g_lilv_nodes.control);
-    lilv_node_free(g_lilv_nodes.control_in);
-    lilv_node_free(g_lilv_nodes.cv);
-    lilv_node_free(g_lilv_nodes.default_);
-    lilv_node_free(g_lilv_nodes.enabled);
-    lilv_node_free(g_lilv_nodes.enumeration);
-    lilv_node_free(g_lilv_nodes.event);
-    lilv_node_free(g_lilv_nodes.freeWheeling);
-    lilv_node_free(g_lilv_nodes.hmi_interface);
-    lilv_node_free(g_lilv_nodes.input);
-    lilv_node_free(g_lilv_nodes.integer);
-    lilv_node_free(g_lilv_nodes.license_interface);
-    lilv_node_free(g_lilv_nodes.logarithmic);
-    lilv_node_free(g_lilv_nodes.is_live);
-    lilv_node_free(g_lilv_nodes.maximum);
-    lilv_node_free(g_lilv_nodes.midiEvent);
-    lilv_node_free(g_lilv_nodes.minimum);
-    lilv_node_free(g_lilv_nodes.minimumSize);
-    lilv_node_free(g_lilv_nodes.mod_cvport);
-    lilv_node_free(g_lilv_nodes.mod_default);
-    lilv_node_free(g_lilv_nodes.mod_default_custom);
-    lilv_node_free(g_lilv_nodes.mod_maximum);
-    lilv_node_free(g_lilv_nodes.mod_minimum);
-    lilv_node_free(g_lilv_nodes.noPreRun);
-    lilv_node_free(g_lilv_nodes.output);
-    lilv_node_free(g_lilv_nodes.patch_readable);
-    lilv_node_free(g_lilv_nodes.patch_writable);
-    lilv_node_free(g_lilv_nodes.preferMomentaryOff);
-    lilv_node_free(g_lilv_nodes.preferMomentaryOn);
-    lilv_node_free(g_lilv_nodes.preset);
-    lilv_node_free(g_lilv_nodes.rawMIDIClockAccess);
-    lilv_node_free(g_lilv_nodes.rdfs_range);
-    lilv_node_free(g_lilv_nodes.reset);
-    lilv_node_free(g_lilv_nodes.sample_rate);
-    lilv_node_free(g_lilv_nodes.state_interface);
-    lilv_node_free(g_lilv_nodes.state_load_default_state);
-    lilv_node_free(g_lilv_nodes.state_thread_safe_restore);
-    lilv_node_free(g_lilv_nodes.timeBeatsPerBar);
-    lilv_node_free(g_lilv_nodes.timeBeatsPerMinute);
-    lilv_node_free(g_lilv_nodes.timePosition);
-    lilv_node_free(g_lilv_nodes.timeSpeed);
-    lilv_node_free(g_lilv_nodes.toggled);
-    lilv_node_free(g_lilv_nodes.trigger);
-    lilv_node_free(g_lilv_nodes.worker_interface);
-    lilv_world_free(g_lv2_data);
-    rtsafe_memory_pool_destroy(g_rtsafe_mem_pool);
-    sem_destroy(&g_postevents_semaphore);
-    pthread_mutex_destroy(&g_rtsafe_mutex);
-    pthread_mutex_destroy(&g_raw_midi_port_mutex);
-    pthread_mutex_destroy(&g_audio_monitor_mutex);
-    pthread_mutex_destroy(&g_midi_learning_mutex);
-    pthread_mutex_destroy(&g_sync_scheduled_params_mutex);
-#ifdef MOD_HMI_CONTROL_ENABLED
-    pthread_mutex_destroy(&g_hmi_mutex);
-#endif
+        effect->ports = effect->control_ports = effect->input_control_ports = ports;
+        effect->ports_count = effect->control_ports_count = effect->input_control_ports_count = 3;
 
-    effect_t *effect = &g_effects[GLOBAL_EFFECT_ID];
-    if (effect->ports)
-    {
-        for (unsigned int i=0; i < effect->ports_count; i++)
-            free(effect->ports[i]);
-        free(effect->ports);
-    }
+        effect->control_index = -1;
+        effect->enabled_index = -1;
+        effect->freewheel_index = -1;
+        effect->reset_index = -1;
+        effect->bpb_index = -1;
+        effect->bpm_index = -1;
+        effect->speed_index = -1;
 
-#ifdef HAVE_HYLIA
-    hylia_cleanup(g_hylia_instance);
-    g_hylia_instance = NULL;
-#endif
+        /* Default value of bypass */
+        effect->bypass = 0.0f;
+        effect->was_bypassed = false;
 
-    free(g_lv2_scratch_dir);
-    g_lv2_scratch_dir = NULL;
+        effect->bypass_port.buffer_count = 1;
+        effect->bypass_port.buffer = &effect->bypass;
+        effect->bypass_port.min_value = 0.0f;
+        effect->bypass_port.max_value = 1.0f;
+        effect->bypass_port.def_value = 0.0f;
+        effect->bypass_port.prev_value = 0.0f;
+        effect->bypass_port.type = TYPE_CONTROL;
+        effect->bypass_port.flow = FLOW_INPUT;
+        effect->bypass_port.hints = HINT_TOGGLE;
+        effect->bypass_port.symbol = g_bypass_port_symbol;
+        pthread_mutex_init(&effect->bypass_port.cv_source_mutex, &mutex_atts);
 
-    g_processing_enabled = false;
+        /* virtual presets port */
+        effect->preset_value = 0.0f;
+        effect->presets_port.buffer_count = 1;
+        effect->presets_port.buffer = &effect->preset_value;
+        effect->presets_port.min_value = 0.0f;
+        effect->presets_port.max_value = 1.0f;
+        effect->presets_port.def_value = 0.0f;
+        effect->presets_port.prev_value = 0.0f;
+        effect->presets_port.type = TYPE_CONTROL;
+        effect->presets_port.flow = FLOW_INPUT;
+        effect->presets_port.hints = HINT_ENUMERATION|HINT_INTEGER;
+        effect->presets_port.symbol = g_presets_port_symbol;
+        pthread_mutex_init(&effect->presets_port.cv_source_mutex, &mutex_atts);
 
-    return SUCCESS;
-}
+        if (! FeedbackSlotsAllocate(effect))
+        {
+            fprintf(stderr, "can't get global feedback slots\n");
+            pthread_mutexattr_destroy(&mutex_atts);
+            return ERR_MEMORY_ALLOCATION;
+        }
 
-int effects_add(const char *uri, int instance, int activate)
-{
-    unsigned int ports_count;
-    char effect_name[32], port_name[MAX_CHAR_BUF_SIZE+1];
-    float *audio_buffer, *cv_buffer, *control_buffer;
-    jack_port_t *jack_port;
-    uint32_t audio_ports_count, input_audio_ports_count, output_audio_ports_count;
-    uint32_t control_ports_count, input_control_ports_count, output_control_ports_count;
-    uint32_t cv_ports_count, input_cv_ports_count, output_cv_ports_count;
-    uint32_t event_ports_count, input_event_ports_count, output_event_ports_count;
-    effect_t *effect;
-    port_t *port;
-    int32_t error;
+        if (! PortIndexBuild(effect))
+        {
+            fprintf(stderr, "can't get global port index\n");
+            pthread_mutexattr_destroy(&mutex_atts);
+            return ERR_MEMORY_ALLOCATION;
+        }
+    }
 
-    effect_name[31] = '\0';
-    port_name[MAX_CHAR_BUF_SIZE] = '\0';
+    pthread_mutexattr_destroy(&mutex_atts);
 
-    /* Jack */
-    jack_client_t *jack_client;
-    jack_status_t jack_status;
-    unsigned long jack_flags = 0;
-    jack_port_t *raw_midi_port = NULL;
+    /* Set jack callbacks */
+    jack_set_thread_init_callback(g_jack_global_client, JackThreadInit, NULL);
+    jack_set_timebase_callback(g_jack_global_client, 1, JackTimebase, NULL);
+    jack_set_process_callback(g_jack_global_client, ProcessGlobalClient, NULL);
+    jack_set_buffer_size_callback(g_jack_global_client, BufferSize, NULL);
+    jack_set_freewheel_callback(g_jack_global_client, FreeWheelMode, NULL);
+    jack_set_port_registration_callback(g_jack_global_client, PortRegistration, NULL);
+    jack_set_xrun_callback(g_jack_global_client, XRun, NULL);
 
-    /* Lilv */
-    const LilvPlugin *plugin;
-    LilvInstance *lilv_instance;
-    LilvNode *plugin_uri;
-    const LilvPort *control_in_port;
-    const LilvPort *lilv_port;
-    const LilvNode *symbol_node;
-    uint32_t control_in_size, control_out_size, worker_buf_size;
+#ifdef HAVE_HYLIA
+    /* Init hylia */
+    g_hylia_instance = hylia_create();
+    memset(&g_hylia_timeinfo, 0, sizeof(g_hylia_timeinfo));
 
-    if (!uri) return ERR_LV2_INVALID_URI;
-    if (!INSTANCE_IS_VALID(instance)) return ERR_INSTANCE_INVALID;
-    if (InstanceExist(instance)) return ERR_INSTANCE_ALREADY_EXISTS;
+    if (g_hylia_instance)
+    {
+        hylia_set_beats_per_bar(g_hylia_instance, g_transport_bpb);
+        hylia_set_beats_per_minute(g_hylia_instance, g_transport_bpm);
+        hylia_set_output_latency(g_hylia_instance, GetHyliaOutputLatency());
+    }
+#endif
 
-    effect = &g_effects[instance];
+    /* Load all LV2 data */
+    g_lv2_data = lilv_world_new();
+#ifdef LILV_OPTION_OBJECT_INDEX
+    lilv_world_set_option(g_lv2_data, LILV_OPTION_OBJECT_INDEX, NULL);
+#endif
+    // with an up to date plugin cache only the bundles of instantiated plugins are parsed
+    if (!plugin_cache_load_world(g_lv2_data))
+    {
+        lilv_world_load_all(g_lv2_data);
+        plugin_cache_rebuild(g_lv2_data);
+    }
+    g_plugins = lilv_world_get_all_plugins(g_lv2_data);
 
-    /* Init the struct */
-    mod_memset(effect, 0, sizeof(effect_t));
-    effect->instance = instance;
-    effect->jack_activated = activate;
-    effect->lv2_activated = true;
+    /* Lilv Nodes initialization */
+    g_lilv_nodes.atom_port = lilv_new_uri(g_lv2_data, LV2_ATOM__AtomPort);
+    g_lilv_nodes.audio = lilv_new_uri(g_lv2_data, LILV_URI_AUDIO_PORT);
+    g_lilv_nodes.control = lilv_new_uri(g_lv2_data, LILV_URI_CONTROL_PORT);
+    g_lilv_nodes.control_in = lilv_new_uri(g_lv2_data, LV2_CORE__control);
+    g_lilv_nodes.cv = lilv_new_uri(g_lv2_data, LILV_URI_CV_PORT);
+    g_lilv_nodes.default_ = lilv_new_uri(g_lv2_data, LV2_CORE__default);
+    g_lilv_nodes.enabled = lilv_new_uri(g_lv2_data, LV2_CORE__enabled);
+    g_lilv_nodes.enumeration = lilv_new_uri(g_lv2_data, LV2_CORE__enumeration);
+    g_lilv_nodes.event = lilv_new_uri(g_lv2_data, LILV_URI_EVENT_PORT);
+    g_lilv_nodes.freeWheeling = lilv_new_uri(g_lv2_data, LV2_CORE__freeWheeling);
+    g_lilv_nodes.hmi_interface = lilv_new_uri(g_lv2_data, LV2_HMI__PluginNotification);
+    g_lilv_nodes.inPlaceBroken = lilv_new_uri(g_lv2_data, LV2_CORE__inPlaceBroken);
+    g_lilv_nodes.input = lilv_new_uri(g_lv2_data, LILV_URI_INPUT_PORT);
+    g_lilv_nodes.integer = lilv_new_uri(g_lv2_data, LV2_CORE__integer);
+    g_lilv_nodes.license_interface = lilv_new_uri(g_lv2_data, MOD_LICENSE__interface);
+    g_lilv_nodes.is_live = lilv_new_uri(g_lv2_data, LV2_CORE__isLive);
+    g_lilv_nodes.logarithmic = lilv_new_uri(g_lv2_data, LV2_PORT_PROPS__logarithmic);
+    g_lilv_nodes.maximum = lilv_new_uri(g_lv2_data, LV2_CORE__maximum);
+    g_lilv_nodes.midiEvent = lilv_new_uri(g_lv2_data, LV2_MIDI__MidiEvent);
+    g_lilv_nodes.minimum = lilv_new_uri(g_lv2_data, LV2_CORE__minimum);
+    g_lilv_nodes.minimumSize = lilv_new_uri(g_lv2_data, LV2_RESIZE_PORT__minimumSize);
+    g_lilv_nodes.mod_cvport = lilv_new_uri(g_lv2_data, LILV_NS_MOD "CVPort");
+    g_lilv_nodes.mod_default = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default");
+#if defined(_MOD_DEVICE_DUO)
+    g_lilv_nodes.mod_default_custom = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default_duo");
+#elif defined(_MOD_DEVICE_DUOX)
+    g_lilv_nodes.mod_default_custom = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default_duox");
+#elif defined(_MOD_DEVICE_DWARF)
+    g_lilv_nodes.mod_default_custom = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default_dwarf");
+#elif defined(_MOD_DEVICE_X86_64)
+    g_lilv_nodes.mod_default_custom = lilv_new_uri(g_lv2_data, LILV_NS_MOD "default_x64");
+#else
+    g_lilv_nodes.mod_default_custom = NULL;
+#endif
+    g_lilv_nodes.mod_maximum = lilv_new_uri(g_lv2_data, LILV_NS_MOD "maximum");
+    g_lilv_nodes.mod_minimum = lilv_new_uri(g_lv2_data, LILV_NS_MOD "minimum");
+    g_lilv_nodes.noPreRun = lilv_new_uri(g_lv2_data, "http://www.darkglass.com/lv2/ns#noPreRun");
+    g_lilv_nodes.options_interface = lilv_new_uri(g_lv2_data, LV2_OPTIONS__interface);
+    g_lilv_nodes.output = lilv_new_uri(g_lv2_data, LILV_URI_OUTPUT_PORT);
+    g_lilv_nodes.patch_writable = lilv_new_uri(g_lv2_data, LV2_PATCH__writable);
+    g_lilv_nodes.patch_readable = lilv_new_uri(g_lv2_data, LV2_PATCH__readable);
+    g_lilv_nodes.preferMomentaryOff = lilv_new_uri(g_lv2_data, LILV_NS_MOD "preferMomentaryOffByDefault");
+    g_lilv_nodes.preferMomentaryOn = lilv_new_uri(g_lv2_data, LILV_NS_MOD "preferMomentaryOnByDefault");
+    g_lilv_nodes.preset = lilv_new_uri(g_lv2_data, LV2_PRESETS__Preset);
+    g_lilv_nodes.rawMIDIClockAccess = lilv_new_uri(g_lv2_data, LILV_NS_MOD "rawMIDIClockAccess");
+    g_lilv_nodes.rdfs_range = lilv_new_uri(g_lv2_data, LILV_NS_RDFS "range");
+    g_lilv_nodes.reset = lilv_new_uri(g_lv2_data, LV2_KXSTUDIO_PROPERTIES__Reset);
+    g_lilv_nodes.sample_rate = lilv_new_uri(g_lv2_data, LV2_CORE__sampleRate);
+    g_lilv_nodes.state_interface = lilv_new_uri(g_lv2_data, LV2_STATE__interface);
+    g_lilv_nodes.state_load_default_state = lilv_new_uri(g_lv2_data, LV2_STATE__loadDefaultState);
+    g_lilv_nodes.state_thread_safe_restore = lilv_new_uri(g_lv2_data, LV2_STATE__threadSafeRestore);
+    g_lilv_nodes.timeBeatsPerBar = lilv_new_uri(g_lv2_data, LV2_TIME__beatsPerBar);
+    g_lilv_nodes.timeBeatsPerMinute = lilv_new_uri(g_lv2_data, LV2_TIME__beatsPerMinute);
+    g_lilv_nodes.timePosition = lilv_new_uri(g_lv2_data, LV2_TIME__Position);
+    g_lilv_nodes.timeSpeed = lilv_new_uri(g_lv2_data, LV2_TIME__speed);
+    g_lilv_nodes.toggled = lilv_new_uri(g_lv2_data, LV2_CORE__toggled);
+    g_lilv_nodes.trigger = lilv_new_uri(g_lv2_data, LV2_PORT_PROPS__trigger);
+    g_lilv_nodes.worker_interface = lilv_new_uri(g_lv2_data, LV2_WORKER__interface);
 
-    /* Init the pointers */
-    plugin_uri = NULL;
-    lilv_instance = NULL;
+    /* URI and URID Feature initialization */
+    urid_sem_init();
+    g_symap = symap_new();
 
-    /* Create a client to Jack */
-    snprintf(effect_name, 31, "effect_%i", instance);
-    jack_client = jack_client_open(effect_name, JackNoStartServer, &jack_status);
+    g_uri_map.callback_data = g_symap;
+    g_uri_map.uri_to_id = &uri_to_id;
 
-    if (!jack_client)
-    {
-        fprintf(stderr, "can't get jack client\n");
-        error = ERR_JACK_CLIENT_CREATION;
-        goto error;
-    }
-    effect->jack_client = jack_client;
+    g_urid_map.handle = g_symap;
+    g_urid_map.map = urid_to_id;
+    g_urid_unmap.handle = g_symap;
+    g_urid_unmap.unmap = id_to_urid;
 
-    /* Get the plugin */
-    plugin_uri = lilv_new_uri(g_lv2_data, uri);
-    plugin = lilv_plugins_get_by_uri(g_plugins, plugin_uri);
+    g_urids.atom_Double          = urid_to_id(g_symap, LV2_ATOM__Double);
+    g_urids.atom_Bool            = urid_to_id(g_symap, LV2_ATOM__Bool);
+    g_urids.atom_Float           = urid_to_id(g_symap, LV2_ATOM__Float);
+    g_urids.atom_Int             = urid_to_id(g_symap, LV2_ATOM__Int);
+    g_urids.atom_Long            = urid_to_id(g_symap, LV2_ATOM__Long);
+    g_urids.atom_Object          = urid_to_id(g_symap, LV2_ATOM__Object);
+    g_urids.atom_Path            = urid_to_id(g_symap, LV2_ATOM__Path);
+    g_urids.atom_String          = urid_to_id(g_symap, LV2_ATOM__String);
+    g_urids.atom_Tuple           = urid_to_id(g_symap, LV2_ATOM__Tuple);
+    g_urids.atom_URI             = urid_to_id(g_symap, LV2_ATOM__URI);
+    g_urids.atom_Vector          = urid_to_id(g_symap, LV2_ATOM__Vector);
+    g_urids.atom_eventTransfer   = urid_to_id(g_symap, LV2_ATOM__eventTransfer);
 
-    if (!plugin)
-    {
-        // NOTE: Reloading the entire world is nasty!
-        //       It may result in crashes, and we now have a way to add/remove bundles as needed anyway.
-#if 0
-        /* If the plugin are not found reload all plugins */
-        lilv_world_load_all(g_lv2_data);
-        g_plugins = lilv_world_get_all_plugins(g_lv2_data);
+    g_urids.bufsz_maxBlockLength     = urid_to_id(g_symap, LV2_BUF_SIZE__maxBlockLength);
+    g_urids.bufsz_minBlockLength     = urid_to_id(g_symap, LV2_BUF_SIZE__minBlockLength);
+    g_urids.bufsz_nomimalBlockLength = urid_to_id(g_symap, LV2_BUF_SIZE__nominalBlockLength);
+    g_urids.bufsz_sequenceSize   = urid_to_id(g_symap, LV2_BUF_SIZE__sequenceSize);
 
-        /* Try get the plugin again */
-        plugin = lilv_plugins_get_by_uri(g_plugins, plugin_uri);
+    g_urids.jack_client          = urid_to_id(g_symap, "http://jackaudio.org/metadata/client");
 
-        if (!plugin)
-#endif
-        {
-            fprintf(stderr, "can't get plugin\n");
-            error = ERR_LV2_INVALID_URI;
-            goto error;
-        }
-    }
+    g_urids.log_Error            = urid_to_id(g_symap, LV2_LOG__Error);
+    g_urids.log_Note             = urid_to_id(g_symap, LV2_LOG__Note);
+    g_urids.log_Trace            = urid_to_id(g_symap, LV2_LOG__Trace);
+    g_urids.log_Warning          = urid_to_id(g_symap, LV2_LOG__Warning);
 
-    effect->lilv_plugin = plugin;
+    g_urids.midi_MidiEvent       = urid_to_id(g_symap, LV2_MIDI__MidiEvent);
+    g_urids.param_sampleRate     = urid_to_id(g_symap, LV2_PARAMETERS__sampleRate);
 
-    /* Features */
-    GetFeatures(effect);
+    g_urids.patch_Get            = urid_to_id(g_symap, LV2_PATCH__Get);
+    g_urids.patch_Set            = urid_to_id(g_symap, LV2_PATCH__Set);
+    g_urids.patch_property       = urid_to_id(g_symap, LV2_PATCH__property);
+    g_urids.patch_sequence       = urid_to_id(g_symap, LV2_PATCH__sequenceNumber);
+    g_urids.patch_value          = urid_to_id(g_symap, LV2_PATCH__value);
 
-    pthread_mutexattr_t mutex_atts;
-    pthread_mutexattr_init(&mutex_atts);
-#ifdef __MOD_DEVICES__
-    pthread_mutexattr_setprotocol(&mutex_atts, PTHREAD_PRIO_INHERIT);
-#endif
+    g_urids.time_Position        = urid_to_id(g_symap, LV2_TIME__Position);
+    g_urids.time_bar             = urid_to_id(g_symap, LV2_TIME__bar);
+    g_urids.time_barBeat         = urid_to_id(g_symap, LV2_TIME__barBeat);
+    g_urids.time_beat            = urid_to_id(g_symap, LV2_TIME__beat);
+    g_urids.time_beatUnit        = urid_to_id(g_symap, LV2_TIME__beatUnit);
+    g_urids.time_beatsPerBar     = urid_to_id(g_symap, LV2_TIME__beatsPerBar);
+    g_urids.time_beatsPerMinute  = urid_to_id(g_symap, LV2_TIME__beatsPerMinute);
+    g_urids.time_ticksPerBeat    = urid_to_id(g_symap, LV2_KXSTUDIO_PROPERTIES__TimePositionTicksPerBeat);
+    g_urids.time_frame           = urid_to_id(g_symap, LV2_TIME__frame);
+    g_urids.time_speed           = urid_to_id(g_symap, LV2_TIME__speed);
 
-    /* Create and activate the plugin instance */
-    lilv_instance = lilv_plugin_instantiate(plugin, g_sample_rate, effect->features);
+    g_urids.threads_schedPolicy   = urid_to_id(g_symap, "http://ardour.org/lv2/threads/#schedPolicy");
+    g_urids.threads_schedPriority = urid_to_id(g_symap, "http://ardour.org/lv2/threads/#schedPriority");
 
-    if (!lilv_instance)
-    {
-        fprintf(stderr, "can't get lilv instance\n");
-        error = ERR_LV2_INSTANTIATION;
-        goto error;
-    }
-    effect->lilv_instance = lilv_instance;
+    /* Options Feature initialization */
+    g_options[0].context = LV2_OPTIONS_INSTANCE;
+    g_options[0].subject = 0;
+    g_options[0].key = g_urids.param_sampleRate;
+    g_options[0].size = sizeof(float);
+    g_options[0].type = g_urids.atom_Float;
+    g_options[0].value = &g_sample_rate_f;
 
-    /* query control_in port and its minimum size */
-    control_out_size = 0;
-    worker_buf_size = 4096;
-    control_in_port = lilv_plugin_get_port_by_designation(plugin, g_lilv_nodes.input, g_lilv_nodes.control_in);
-    if (control_in_port)
-    {
-        control_in_size = g_midi_buffer_size * 16; // 16 taken from jalv source code
-        effect->control_index = lilv_port_get_index(plugin, control_in_port);
+    g_options[1].context = LV2_OPTIONS_INSTANCE;
+    g_options[1].subject = 0;
+    g_options[1].key = g_urids.bufsz_minBlockLength;
+    g_options[1].size = sizeof(int32_t);
+    g_options[1].type = g_urids.atom_Int;
+    g_options[1].value = &g_block_length;
 
-        LilvNodes *lilvminsize = lilv_port_get_value(plugin, control_in_port, g_lilv_nodes.minimumSize);
-        if (lilvminsize != NULL)
-        {
-            const int minsize = lilv_node_as_int(lilv_nodes_get_first(lilvminsize));
-            if (minsize > 0 && (uint)minsize > worker_buf_size)
-                worker_buf_size = minsize;
-        }
-    }
-    else
-    {
-        control_in_size = 0;
-        effect->control_index = -1;
-    }
+    g_options[2].context = LV2_OPTIONS_INSTANCE;
+    g_options[2].subject = 0;
+    g_options[2].key = g_urids.bufsz_maxBlockLength;
+    g_options[2].size = sizeof(int32_t);
+    g_options[2].type = g_urids.atom_Int;
+    g_options[2].value = &g_block_length;
 
-    /* Query plugin features */
-    if (lilv_plugin_has_feature(effect->lilv_plugin, g_lilv_nodes.is_live))
-        effect->hints |= HINT_IS_LIVE;
+    g_options[3].context = LV2_OPTIONS_INSTANCE;
+    g_options[3].subject = 0;
+    g_options[3].key = g_urids.bufsz_nomimalBlockLength;
+    g_options[3].size = sizeof(int32_t);
+    g_options[3].type = g_urids.atom_Int;
+    g_options[3].value = &g_block_length;
 
-    if (lilv_plugin_has_feature(effect->lilv_plugin, g_lilv_nodes.noPreRun))
-        effect->hints |= HINT_NO_PRE_RUN;
+    g_options[4].context = LV2_OPTIONS_INSTANCE;
+    g_options[4].subject = 0;
+    g_options[4].key = g_urids.bufsz_sequenceSize;
+    g_options[4].size = sizeof(int32_t);
+    g_options[4].type = g_urids.atom_Int;
+    g_options[4].value = &g_midi_buffer_size;
 
-    /* Query plugin extensions/interfaces */
-    if (lilv_plugin_has_extension_data(effect->lilv_plugin, g_lilv_nodes.worker_interface))
-    {
-        const LV2_Worker_Interface *worker_interface =
-            (const LV2_Worker_Interface*) lilv_instance_get_extension_data(lilv_instance,
-                                                                           LV2_WORKER__interface);
+    g_options[5].context = LV2_OPTIONS_INSTANCE;
+    g_options[5].subject = 0;
+    g_options[5].key = g_urids.threads_schedPolicy;
+    g_options[5].size = sizeof(int32_t);
+    g_options[5].type = g_urids.atom_Int;
+    g_options[5].value = &g_thread_policy;
 
-        worker_init(&effect->worker, lilv_instance, worker_interface, worker_buf_size);
-    }
+    g_options[6].context = LV2_OPTIONS_INSTANCE;
+    g_options[6].subject = 0;
+    g_options[6].key = g_urids.threads_schedPriority;
+    g_options[6].size = sizeof(int32_t);
+    g_options[6].type = g_urids.atom_Int;
+    g_options[6].value = &g_thread_priority;
 
-    if (lilv_plugin_has_extension_data(effect->lilv_plugin, g_lilv_nodes.options_interface))
-    {
-        effect->options_interface =
-            (const LV2_Options_Interface*) lilv_instance_get_extension_data(lilv_instance,
-                                                                            LV2_OPTIONS__interface);
-    }
+    g_options[7].context = LV2_OPTIONS_INSTANCE;
+    g_options[7].subject = 0;
+    g_options[7].key = g_urids.jack_client;
+    g_options[7].size = sizeof(jack_client_t*);
+    g_options[7].type = g_urids.jack_client;
+    g_options[7].value = NULL;
 
-    if (lilv_plugin_has_extension_data(effect->lilv_plugin, g_lilv_nodes.license_interface))
-    {
-        effect->license_iface =
-            (const MOD_License_Interface*) lilv_instance_get_extension_data(lilv_instance,
-                                                                            MOD_LICENSE__interface);
-    }
+    g_options[8].context = LV2_OPTIONS_INSTANCE;
+    g_options[8].subject = 0;
+    g_options[8].key = 0;
+    g_options[8].size = 0;
+    g_options[8].type = 0;
+    g_options[8].value = NULL;
 
-    if (lilv_plugin_has_extension_data(effect->lilv_plugin, g_lilv_nodes.state_interface))
-    {
-        effect->state_iface =
-            (const LV2_State_Interface*) lilv_instance_get_extension_data(lilv_instance,
-                                                                          LV2_STATE__interface);
-        effect->hints |= HINT_HAS_STATE;
+#ifdef MOD_HMI_CONTROL_ENABLED
+    g_hmi_wc.size                    = sizeof(g_hmi_wc);
+    g_hmi_wc.set_led_with_blink      = HMIWidgetsSetLedWithBlink;
+    g_hmi_wc.set_led_with_brightness = HMIWidgetsSetLedWithBrightness;
+    g_hmi_wc.set_label               = HMIWidgetsSetLabel;
+    g_hmi_wc.set_value               = HMIWidgetsSetValue;
+    g_hmi_wc.set_unit                = HMIWidgetsSetUnit;
+    g_hmi_wc.set_indicator           = HMIWidgetsSetIndicator;
+    g_hmi_wc.popup_message           = HMIWidgetsPopupMessage;
 
-        if (! lilv_plugin_has_feature(effect->lilv_plugin, g_lilv_nodes.state_thread_safe_restore))
+    if (client != NULL)
+    {
+        // HMI integration setup
+        if (sys_serial_open(&g_hmi_shmfd, &g_hmi_data))
         {
-            effect->hints |= HINT_STATE_UNSAFE;
-            pthread_mutex_init(&effect->state_restore_mutex, &mutex_atts);
+            g_hmi_wc.handle = g_hmi_data;
+            sys_serial_write(&g_hmi_data->server, sys_serial_event_type_special_req, 0, 0, "restart");
+            zix_thread_create(&g_hmi_client_thread, 0, HMIClientThread, &g_hmi_data->client);
         }
-
-        if (lilv_plugin_has_feature(effect->lilv_plugin, g_lilv_nodes.state_load_default_state))
+        else
         {
-            LilvState *state = lilv_state_new_from_world(g_lv2_data, &g_urid_map, plugin_uri);
-
-            if (state != NULL) {
-                lilv_state_restore(state, lilv_instance, NULL, NULL,
-                                   LV2_STATE_IS_POD|LV2_STATE_IS_PORTABLE, effect->features);
-                lilv_state_free(state);
-            }
+            g_hmi_wc.handle = NULL;
+            fprintf(stderr, "sys_host HMI setup failed\n");
         }
     }
 
-#ifdef __MOD_DEVICES__
-    if (lilv_plugin_has_extension_data(effect->lilv_plugin, g_lilv_nodes.hmi_interface))
-    {
-        effect->hmi_notif =
-            (const LV2_HMI_PluginNotification*) lilv_instance_get_extension_data(lilv_instance,
-                                                                                 LV2_HMI__PluginNotification);
-    }
+    for (int i = 0; i < MAX_HMI_ADDRESSINGS; i++)
+        g_hmi_addressings[i].actuator_id = -1;
 #endif
 
-    /* Create the URI for identify the ports */
-    ports_count = lilv_plugin_get_num_ports(plugin);
-
-    /* Allocate memory to ports */
-    audio_ports_count = 0;
-    input_audio_ports_count = 0;
-    output_audio_ports_count = 0;
-    control_ports_count = 0;
-    input_control_ports_count = 0;
-    output_control_ports_count = 0;
-    cv_ports_count = 0;
-    input_cv_ports_count = 0;
-    output_cv_ports_count = 0;
-    event_ports_count = 0;
-    input_event_ports_count = 0;
-    output_event_ports_count = 0;
-    effect->presets_count = 0;
-    effect->presets = NULL;
-    effect->monitors_count = 0;
-    effect->monitors = NULL;
-    effect->ports_count = ports_count;
-    effect->ports = (port_t **) mod_calloc(ports_count, sizeof(port_t *));
-
-    for (unsigned int i = 0; i < ports_count; i++)
-    {
-        /* Allocate memory to current port */
-        effect->ports[i] = port = (port_t *) mod_calloc(1, sizeof(port_t));
-
-        pthread_mutex_init(&port->cv_source_mutex, &mutex_atts);
+#ifdef MOD_IO_PROCESSING_ENABLED
+    gate_init(&g_noisegate);
+#endif
 
-        /* Lilv port */
-        lilv_port = lilv_plugin_get_port_by_index(plugin, i);
-        symbol_node = lilv_port_get_symbol(plugin, lilv_port);
-        port->index = i;
-        port->symbol = lilv_node_as_string(symbol_node);
+    g_license.handle = NULL;
+    g_license.license = GetLicenseFile;
+    g_license.free = FreePluginString;
 
-        snprintf(port_name, MAX_CHAR_BUF_SIZE, "%s", lilv_node_as_string(symbol_node));
+    // used outside of plugin instances (state restore and UIs), no rate limiting
+    g_lv2_log.handle = NULL;
+    g_lv2_log.printf = LogPrintf;
+    g_lv2_log.vprintf = LogVPrintf;
 
-        /* Port flow */
-        port->flow = FLOW_UNKNOWN;
-        if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input))
-        {
-            jack_flags = JackPortIsInput;
-            port->flow = FLOW_INPUT;
-        }
-        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output))
-        {
-            jack_flags = JackPortIsOutput;
-            port->flow = FLOW_OUTPUT;
-        }
+    g_state_freePath.handle = NULL;
+    g_state_freePath.free_path = FreePluginString;
 
-        port->type = TYPE_UNKNOWN;
-        port->hints = 0x0;
+    g_lv2_scratch_dir = str_duplicate("/tmp/mod-host-scratch-dir");
 
-        if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.audio))
-        {
-            port->type = TYPE_AUDIO;
+    lv2_atom_forge_init(&g_lv2_atom_forge, &g_urid_map);
 
-            /* Allocate memory to audio buffer */
-            audio_buffer = (float *) mod_calloc(g_sample_rate, sizeof(float));
-            if (!audio_buffer)
-            {
-                fprintf(stderr, "can't get audio buffer\n");
-                error = ERR_MEMORY_ALLOCATION;
-                goto error;
-            }
+    /* Init the midi variables */
+    for (int i = 0; i < MAX_MIDI_CC_ASSIGN; i++)
+    {
+        g_midi_cc_list[i].channel = -1;
+        g_midi_cc_list[i].controller = 0;
+        g_midi_cc_list[i].minimum = 0.0f;
+        g_midi_cc_list[i].maximum = 1.0f;
+        g_midi_cc_list[i].effect_id = ASSIGNMENT_NULL;
+        g_midi_cc_list[i].symbol = NULL;
+        g_midi_cc_list[i].port = NULL;
+    }
+    g_midi_learning = NULL;
 
-            port->buffer = audio_buffer;
-            port->buffer_count = g_sample_rate;
-            lilv_instance_connect_port(lilv_instance, i, audio_buffer);
+    memset(g_monitored_midi_controls, 0, sizeof(g_monitored_midi_controls));
+    memset(g_monitored_midi_programs, 0, sizeof(g_monitored_midi_programs));
 
-            /* Jack port creation */
-            jack_port = jack_port_register(jack_client, port_name, JACK_DEFAULT_AUDIO_TYPE, jack_flags, 0);
-            if (jack_port == NULL)
-            {
-                fprintf(stderr, "can't get jack port\n");
-                error = ERR_JACK_PORT_REGISTER;
-                goto error;
-            }
-            port->jack_port = jack_port;
-            audio_ports_count++;
+#ifdef HAVE_CONTROLCHAIN
+    /* Init the control chain variables */
+    memset(&g_assignments_list, 0, sizeof(g_assignments_list));
 
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input)) input_audio_ports_count++;
-            else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output)) output_audio_ports_count++;
-        }
-        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.control))
+    for (int i = 0; i < CC_MAX_DEVICES; i++)
+    {
+        for (int j = 0; j < CC_MAX_ASSIGNMENTS; j++)
         {
-            port->type = TYPE_CONTROL;
-
-            /* Allocate memory to control port */
-            control_buffer = (float *) malloc(sizeof(float));
-            if (!control_buffer)
-            {
-                fprintf(stderr, "can't get control buffer\n");
-                error = ERR_MEMORY_ALLOCATION;
-                goto error;
-            }
-            port->buffer = control_buffer;
-            port->buffer_count = 1;
-            lilv_instance_connect_port(lilv_instance, i, control_buffer);
-
-            port->scale_points = lilv_port_get_scale_points(plugin, lilv_port);
-
-            /* Set the minimum value of control */
-            float min_value;
-            LilvNodes* lilvvalue_minimum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_minimum);
-            if (lilvvalue_minimum == NULL)
-                lilvvalue_minimum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.minimum);
+            g_assignments_list[i][j].effect_id = ASSIGNMENT_NULL;
+            g_assignments_list[i][j].assignment_pair_id = -1;
+        }
+    }
+#endif
 
-            if (lilvvalue_minimum != NULL)
-                min_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_minimum));
-            else
-                min_value = 0.0f;
+    LogRingReset();
 
-            /* Set the maximum value of control */
-            float max_value;
-            LilvNodes* lilvvalue_maximum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_maximum);
-            if (lilvvalue_maximum == NULL)
-                lilvvalue_maximum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.maximum);
+    /* Start the thread that consumes from the event queue */
+    g_postevents_running = 1;
+    g_postevents_ready = true;
+    zix_thread_create(&g_postevents_thread, 0, PostPonedEventsThread, NULL);
 
-            if (lilvvalue_maximum != NULL)
-                max_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_maximum));
-            else
-                max_value = 1.0f;
+    /* get transport state */
+    UpdateGlobalJackPosition(UPDATE_POSITION_SKIP, false);
 
-            /* Ensure min < max */
-            if (min_value >= max_value)
-                max_value = min_value + 0.1f;
+    /* Try activate the jack global client */
+    if (jack_activate(g_jack_global_client) != 0)
+    {
+        fprintf(stderr, "can't activate global jack client\n");
+        if (client == NULL)
+            jack_client_close(g_jack_global_client);
+        return ERR_JACK_CLIENT_ACTIVATION;
+    }
 
-            /* multiply ranges by sample rate if requested */
-            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.sample_rate))
-            {
-                min_value *= g_sample_rate;
-                max_value *= g_sample_rate;
-            }
+    /* Connect to midi-merger if avaiable */
+    g_aggregated_midi_enabled = jack_port_by_name(g_jack_global_client, "mod-midi-merger:out") != NULL;
 
-            /* Set the default value of control */
-            float def_value;
+    if (g_aggregated_midi_enabled)
+    {
+        const char *ourportname = jack_port_name(g_midi_in_port);
+        jack_connect(g_jack_global_client, "mod-midi-merger:out", ourportname);
+        ConnectToMIDIThroughPorts();
+    }
+    /* Else connect to all good hw ports (system, ttymidi and nooice) */
+    else
+    {
+        ConnectToAllHardwareMIDIPorts();
+    }
 
-            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.preferMomentaryOff))
-            {
-                def_value = max_value;
-            }
-            else if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.preferMomentaryOn))
-            {
-                def_value = min_value;
-            }
-            else
-            {
-                LilvNodes* lilvvalue_default = g_lilv_nodes.mod_default_custom != NULL
-                                             ? lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_default_custom)
-                                             : NULL;
-                if (lilvvalue_default == NULL)
-                    lilvvalue_default = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_default);
-                if (lilvvalue_default == NULL)
-                    lilvvalue_default = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.default_);
+#ifdef MOD_IO_PROCESSING_ENABLED
+    /* Connect to capture ports if avaiable */
+    if (g_capture_ports != NULL && g_capture_ports[0] != NULL)
+    {
+        const char *ourportname;
+#ifndef _MOD_DEVICE_DWARF
+        ourportname = jack_port_name(g_audio_in1_port);
+#else
+        ourportname = jack_port_name(g_audio_in2_port);
+#endif
+        jack_connect(g_jack_global_client, g_capture_ports[0], ourportname);
 
-                if (lilvvalue_default != NULL)
-                    def_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_default));
-                else
-                    def_value = min_value;
+        if (g_capture_ports[1] != NULL)
+        {
+#ifndef _MOD_DEVICE_DWARF
+            ourportname = jack_port_name(g_audio_in2_port);
+#else
+            ourportname = jack_port_name(g_audio_in1_port);
+#endif
+            jack_connect(g_jack_global_client, g_capture_ports[1], ourportname);
+        }
+    }
+#endif
 
-                lilv_nodes_free(lilvvalue_default);
-            }
+    g_processing_enabled = true;
 
-            (*control_buffer) = def_value;
+    return SUCCESS;
 
-            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.enumeration))
-            {
-                port->hints |= HINT_ENUMERATION;
+    UNUSED_PARAM(global_effect_id_static_check1);
+    UNUSED_PARAM(global_effect_id_static_check2);
+}
 
-                // make 2 scalepoint enumeration work as toggle
-                if (lilv_scale_points_size(port->scale_points) == 2)
-                    port->hints |= HINT_TOGGLE;
-            }
-            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.integer))
-            {
-                port->hints |= HINT_INTEGER;
-            }
-            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.toggled))
-            {
-                port->hints |= HINT_TOGGLE;
-            }
-            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.trigger))
-            {
-                port->hints |= HINT_TRIGGER;
-                effect->hints |= HINT_TRIGGERS;
-            }
-            if (lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.logarithmic))
-            {
-                port->hints |= HINT_LOGARITHMIC;
-            }
+int effects_finish(int close_client)
+{
+    g_postevents_running = -1;
+    sem_post(&g_postevents_semaphore);
+    zix_thread_join(g_postevents_thread, NULL);
 
-            port->jack_port = NULL;
-            port->def_value = def_value;
-            port->min_value = min_value;
-            port->max_value = max_value;
-            port->prev_value = def_value;
+    if (close_client && g_jack_global_client != NULL && strcmp(jack_get_client_name(g_jack_global_client), "mod-host") == 0)
+        monitor_client_stop();
 
-            control_ports_count++;
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input)) input_control_ports_count++;
-            else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output)) output_control_ports_count++;
+    effects_remove(REMOVE_ALL);
 
-            lilv_nodes_free(lilvvalue_maximum);
-            lilv_nodes_free(lilvvalue_minimum);
-        }
-        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.cv) || lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.mod_cvport))
-        {
-            port->type = TYPE_CV;
+#ifdef MOD_HMI_CONTROL_ENABLED
+    if (g_hmi_data != NULL)
+    {
+        sys_serial_shm_data* hmi_data = g_hmi_data;
+        g_hmi_data = NULL;
 
-            /* Allocate memory to cv buffer */
-            cv_buffer = (float *) mod_calloc(g_sample_rate, sizeof(float));
-            if (!cv_buffer)
-            {
-                fprintf(stderr, "can't get cv buffer\n");
-                error = ERR_MEMORY_ALLOCATION;
-                goto error;
-            }
+        sem_post(&hmi_data->client.sem);
+        zix_thread_join(g_hmi_client_thread, NULL);
 
-            port->buffer = cv_buffer;
-            port->buffer_count = g_sample_rate;
-            lilv_instance_connect_port(lilv_instance, i, cv_buffer);
+        sys_serial_close(g_hmi_shmfd, hmi_data);
+    }
+#endif
 
-            /* Jack port creation */
-            jack_flags |= JackPortIsControlVoltage;
-            jack_port = jack_port_register(jack_client, port_name, JACK_DEFAULT_AUDIO_TYPE, jack_flags, 0);
-            if (jack_port == NULL)
-            {
-                fprintf(stderr, "can't get jack port\n");
-                error = ERR_JACK_PORT_REGISTER;
-                goto error;
-            }
+#ifdef HAVE_CONTROLCHAIN
+    if (g_cc_client)
+    {
+        cc_client_delete(g_cc_client);
+        g_cc_client = NULL;
+    }
+#endif
 
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.mod_cvport))
-                port->hints |= HINT_CV_MOD;
+    if (g_capture_ports) jack_free(g_capture_ports);
+    if (g_playback_ports) jack_free(g_playback_ports);
+    if (close_client) jack_client_close(g_jack_global_client);
 
-            /* Set the minimum value of control */
-            float min_value;
-            LilvNodes* lilvvalue_minimum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_minimum);
-            if (lilvvalue_minimum == NULL)
-                lilvvalue_minimum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.minimum);
+    // drop the graph plan before its buffers go away
+    g_graph_engine_enabled = false;
+    GraphRebuild();
+    GraphStopWorkers();
+    free(g_graph_edges);
+    g_graph_edges = NULL;
+    g_graph_edges_count = 0;
+    free(g_graph_silence);
+    g_graph_silence = NULL;
 
-            if (lilvvalue_minimum != NULL)
-                min_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_minimum));
-            else
-                min_value = -5.0f;
+    g_sync_scheduled_state = SYNC_SCHEDULED_IDLE;
+    for (int i = 0; i < 2; i++)
+    {
+        free(g_sync_scheduled_batches[i].params);
+        g_sync_scheduled_batches[i].params = NULL;
+        g_sync_scheduled_batches[i].count = g_sync_scheduled_batches[i].size = 0;
+    }
+    for (int i = 0; i < MAX_TRANSACTIONS; i++)
+    {
+        if (g_txns[i].client >= 0)
+            TxnClose(&g_txns[i]);
+    }
 
-            /* Set the maximum value of control */
-            float max_value;
-            LilvNodes* lilvvalue_maximum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.mod_maximum);
-            if (lilvvalue_maximum == NULL)
-                lilvvalue_maximum = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.maximum);
+    symap_free(g_symap);
+    lilv_node_free(g_lilv_nodes.atom_port);
+    lilv_node_free(g_lilv_nodes.audio);
+    lilv_node_free(g_lilv_nodes.control);
+    lilv_node_free(g_lilv_nodes.control_in);
+    lilv_node_free(g_lilv_nodes.cv);
+    lilv_node_free(g_lilv_nodes.default_);
+    lilv_node_free(g_lilv_nodes.enabled);
+    lilv_node_free(g_lilv_nodes.enumeration);
+    lilv_node_free(g_lilv_nodes.event);
+    lilv_node_free(g_lilv_nodes.freeWheeling);
+    lilv_node_free(g_lilv_nodes.hmi_interface);
+    lilv_node_free(g_lilv_nodes.inPlaceBroken);
+    lilv_node_free(g_lilv_nodes.input);
+    lilv_node_free(g_lilv_nodes.integer);
+    lilv_node_free(g_lilv_nodes.license_interface);
+    lilv_node_free(g_lilv_nodes.logarithmic);
+    lilv_node_free(g_lilv_nodes.is_live);
+    lilv_node_free(g_lilv_nodes.maximum);
+    lilv_node_free(g_lilv_nodes.midiEvent);
+    lilv_node_free(g_lilv_nodes.minimum);
+    lilv_node_free(g_lilv_nodes.minimumSize);
+    lilv_node_free(g_lilv_nodes.mod_cvport);
+    lilv_node_free(g_lilv_nodes.mod_default);
+    lilv_node_free(g_lilv_nodes.mod_default_custom);
+    lilv_node_free(g_lilv_nodes.mod_maximum);
+    lilv_node_free(g_lilv_nodes.mod_minimum);
+    lilv_node_free(g_lilv_nodes.noPreRun);
+    lilv_node_free(g_lilv_nodes.output);
+    lilv_node_free(g_lilv_nodes.patch_readable);
+    lilv_node_free(g_lilv_nodes.patch_writable);
+    lilv_node_free(g_lilv_nodes.preferMomentaryOff);
+    lilv_node_free(g_lilv_nodes.preferMomentaryOn);
+    lilv_node_free(g_lilv_nodes.preset);
+    lilv_node_free(g_lilv_nodes.rawMIDIClockAccess);
+    lilv_node_free(g_lilv_nodes.rdfs_range);
+    lilv_node_free(g_lilv_nodes.reset);
+    lilv_node_free(g_lilv_nodes.sample_rate);
+    lilv_node_free(g_lilv_nodes.state_interface);
+    lilv_node_free(g_lilv_nodes.state_load_default_state);
+    lilv_node_free(g_lilv_nodes.state_thread_safe_restore);
+    lilv_node_free(g_lilv_nodes.timeBeatsPerBar);
+    lilv_node_free(g_lilv_nodes.timeBeatsPerMinute);
+    lilv_node_free(g_lilv_nodes.timePosition);
+    lilv_node_free(g_lilv_nodes.timeSpeed);
+    lilv_node_free(g_lilv_nodes.toggled);
+    lilv_node_free(g_lilv_nodes.trigger);
+    lilv_node_free(g_lilv_nodes.worker_interface);
+    PluginDescriptorsInvalidate();
+    lilv_world_free(g_lv2_data);
+    plugin_cache_finish();
+    rtsafe_memory_pool_destroy(g_rtsafe_mem_pool);
+    sem_destroy(&g_postevents_semaphore);
+    pthread_mutex_destroy(&g_rtsafe_mutex);
+    pthread_mutex_destroy(&g_raw_midi_port_mutex);
+    pthread_mutex_destroy(&g_audio_monitor_mutex);
+    pthread_mutex_destroy(&g_midi_learning_mutex);
+    pthread_mutex_destroy(&g_graph_mutex);
+    pthread_mutex_destroy(&g_lilv_mutex);
+    pthread_mutex_destroy(&g_sync_scheduled_lock);
+#ifdef MOD_HMI_CONTROL_ENABLED
+    pthread_mutex_destroy(&g_hmi_mutex);
+#endif
 
-            if (lilvvalue_maximum != NULL)
-                max_value = lilv_node_as_float(lilv_nodes_get_first(lilvvalue_maximum));
-            else
-                max_value = 5.0f;
+    effect_t *effect = &g_effects[GLOBAL_EFFECT_ID];
+    if (effect->ports)
+    {
+        for (unsigned int i=0; i < effect->ports_count; i++)
+            free(effect->ports[i]);
+        free(effect->ports);
+    }
+    FeedbackSlotsFree(effect);
+    PortIndexFree(effect);
 
-            /* Ensure min < max */
-            if (min_value >= max_value)
-            {
-                max_value = min_value + 0.1f;
-            }
-            else if (lilvvalue_minimum != NULL && lilvvalue_maximum != NULL)
-            {
-                // if range is valid, set metadata
-                port->hints |= HINT_CV_RANGES;
+    free(g_param_handles);
+    g_param_handles = NULL;
+    g_param_handles_count = g_param_handles_size = 0;
+
+#ifdef HAVE_HYLIA
+    hylia_cleanup(g_hylia_instance);
+    g_hylia_instance = NULL;
+#endif
 
-                jack_uuid_t uuid = jack_port_uuid(jack_port);
-                if (!jack_uuid_empty(uuid)) {
-                    char str_value[32];
-                    mod_memset(str_value, 0, sizeof(str_value));
+    BinaryFeedbackReset();
+    g_feedback_mode = FEEDBACK_MODE_SOCKET;
 
-                    snprintf(str_value, 31, "%f", min_value);
-                    jack_set_property(jack_client, uuid, LV2_CORE__minimum, str_value, NULL);
+#ifdef WITH_FEEDBACK_SHM
+    if (g_feedback_shm_requested != NULL && g_feedback_shm_requested != g_feedback_shm)
+        feedback_shm_close(g_feedback_shm_requested_fd, g_feedback_shm_requested, true);
+    if (g_feedback_shm != NULL)
+        feedback_shm_close(g_feedback_shmfd, g_feedback_shm, true);
 
-                    snprintf(str_value, 31, "%f", max_value);
-                    jack_set_property(jack_client, uuid, LV2_CORE__maximum, str_value, NULL);
-                }
-            }
+    g_feedback_shm_requested = g_feedback_shm = NULL;
+#endif
 
-            port->min_value = min_value;
-            port->max_value = max_value;
+    free(g_lv2_scratch_dir);
+    g_lv2_scratch_dir = NULL;
 
-            port->jack_port = jack_port;
+    g_processing_enabled = false;
 
-            cv_ports_count++;
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input)) input_cv_ports_count++;
-            else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output)) output_cv_ports_count++;
+    return SUCCESS;
+}
 
-            lilv_nodes_free(lilvvalue_maximum);
-            lilv_nodes_free(lilvvalue_minimum);
-        }
-        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.event) ||
-                    lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.atom_port))
-        {
-            port->type = TYPE_EVENT;
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.event))
-            {
-                port->hints |= HINT_OLD_EVENT_API;
-                port->hints |= HINT_MIDI_EVENT;
-                effect->hints |= HINT_HAS_MIDI_INPUT;
-            }
-            else
-            {
-                if (lilv_port_supports_event(plugin, lilv_port, g_lilv_nodes.midiEvent))
-                {
-                    port->hints |= HINT_MIDI_EVENT;
-                    effect->hints |= HINT_HAS_MIDI_INPUT;
-                }
-                if (lilv_port_supports_event(plugin, lilv_port, g_lilv_nodes.timePosition))
-                {
-                    port->hints |= HINT_TRANSPORT;
-                    effect->hints |= HINT_TRANSPORT;
-                }
-            }
+int effects_add(const char *uri, int instance, int activate)
+{
+    char effect_name[32], port_name[MAX_CHAR_BUF_SIZE+1];
+    jack_port_t *jack_port;
+    effect_t *effect;
+    port_t *port;
+    int32_t error;
+    bool lilv_locked = false;
 
-            if (port->flow == FLOW_OUTPUT && control_out_size == 0)
-                control_out_size = g_midi_buffer_size * 16; // 16 taken from jalv source code
+    effect_name[31] = '\0';
+    port_name[MAX_CHAR_BUF_SIZE] = '\0';
 
-            LilvNodes *lilvminsize = lilv_port_get_value(plugin, lilv_port, g_lilv_nodes.minimumSize);
-            if (lilvminsize != NULL)
-            {
-                const int iminsize = lilv_node_as_int(lilvminsize);
-                if (iminsize > 0)
-                {
-                    const uint minsize = (uint)iminsize;
-                    if (port->flow == FLOW_INPUT)
-                    {
-                        if (minsize > control_in_size)
-                            control_in_size = minsize;
-                    }
-                    else if (port->flow == FLOW_OUTPUT)
-                    {
-                        if (minsize > control_out_size)
-                            control_out_size = minsize;
-                    }
-                }
-                lilv_nodes_free(lilvminsize);
-            }
+    /* Jack */
+    jack_client_t *jack_client;
+    jack_status_t jack_status;
+    unsigned long jack_flags = 0;
+    jack_port_t *raw_midi_port = NULL;
 
-            jack_port = jack_port_register(jack_client, port_name, JACK_DEFAULT_MIDI_TYPE, jack_flags, 0);
-            if (jack_port == NULL)
-            {
-                fprintf(stderr, "can't get jack port\n");
-                error = ERR_JACK_PORT_REGISTER;
-                goto error;
-            }
-            port->jack_port = jack_port;
-            event_ports_count++;
+    /* Lilv */
+    const LilvPlugin *plugin;
+    LilvInstance *lilv_instance;
+    LilvNode *plugin_uri;
+    LilvState *default_state = NULL;
+    uint32_t control_in_size, control_out_size;
 
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input)) input_event_ports_count++;
-            else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output)) output_event_ports_count++;
+    if (!uri) return ERR_LV2_INVALID_URI;
+    if (!INSTANCE_IS_VALID(instance)) return ERR_INSTANCE_INVALID;
+    if (InstanceExist(instance)) return ERR_INSTANCE_ALREADY_EXISTS;
 
-            if (raw_midi_port == NULL && lilv_port_has_property(plugin, lilv_port, g_lilv_nodes.rawMIDIClockAccess))
-            {
-                raw_midi_port_item* const portitemptr = malloc(sizeof(raw_midi_port_item));
+    effect = &g_effects[instance];
 
-                if (portitemptr != NULL)
-                {
-                    raw_midi_port = jack_port;
-                    portitemptr->instance = instance;
-                    portitemptr->jack_port = jack_port;
+    /* Init the struct */
+    mod_memset(effect, 0, sizeof(effect_t));
+    effect->instance = instance;
+    effect->jack_activated = activate;
+    effect->lv2_activated = true;
+    effect->log_budget = LOG_RATE_LIMIT;
+    effect->adding = true;
 
-                    pthread_mutex_lock(&g_raw_midi_port_mutex);
+    /* Init the pointers */
+    plugin_uri = NULL;
+    lilv_instance = NULL;
 
-                    list_add_tail(&portitemptr->siblings, &g_raw_midi_port_list);
+    if (g_graph_engine_enabled)
+    {
+        /* In-process effects are run by the global client */
+        jack_client = g_jack_global_client;
+    }
+    else
+    {
+        /* Create a client to Jack */
+        snprintf(effect_name, 31, "effect_%i", instance);
+        jack_client = jack_client_open(effect_name, JackNoStartServer, &jack_status);
 
-                    pthread_mutex_unlock(&g_raw_midi_port_mutex);
-                }
-            }
+        if (!jack_client)
+        {
+            fprintf(stderr, "can't get jack client\n");
+            error = ERR_JACK_CLIENT_CREATION;
+            goto error;
         }
     }
+    // publishes adding before the instance can be seen as existing
+    __atomic_store_n(&effect->jack_client, jack_client, __ATOMIC_RELEASE);
 
-    // special ports
+    // only the lilv world and the descriptor list are shared with other adds, ports and buffers are set up unlocked
+    pthread_mutex_lock(&g_lilv_mutex);
+    lilv_locked = true;
+
+    /* Get the plugin */
+    plugin_uri = lilv_new_uri(g_lv2_data, uri);
+    plugin = lilv_plugins_get_by_uri(g_plugins, plugin_uri);
+
+    if (!plugin && plugin_cache_load_resource(g_lv2_data, uri) > 0)
     {
-        const LilvPort* enabled_port = lilv_plugin_get_port_by_designation(plugin,
-                                                                           g_lilv_nodes.input,
-                                                                           g_lilv_nodes.enabled);
-        if (enabled_port)
-        {
-            effect->enabled_index = lilv_port_get_index(plugin, enabled_port);
-            *(effect->ports[effect->enabled_index]->buffer) = 1.0f;
-        }
-        else
-        {
-            effect->enabled_index = -1;
-        }
+        g_plugins = lilv_world_get_all_plugins(g_lv2_data);
+        plugin = lilv_plugins_get_by_uri(g_plugins, plugin_uri);
+    }
 
-        const LilvPort* freewheel_port = lilv_plugin_get_port_by_designation(plugin,
-                                                                             g_lilv_nodes.input,
-                                                                             g_lilv_nodes.freeWheeling);
-        if (freewheel_port)
-        {
-            effect->freewheel_index = lilv_port_get_index(plugin, freewheel_port);
-            *(effect->ports[effect->freewheel_index]->buffer) = 0.0f;
-        }
-        else
-        {
-            effect->freewheel_index = -1;
-        }
+    if (!plugin)
+    {
+        // NOTE: Reloading the entire world is nasty!
+        //       It may result in crashes, and we now have a way to add/remove bundles as needed anyway.
+#if 0
+        /* If the plugin are not found reload all plugins */
+        lilv_world_load_all(g_lv2_data);
+        g_plugins = lilv_world_get_all_plugins(g_lv2_data);
 
-        const LilvPort* reset_port = lilv_plugin_get_port_by_designation(plugin,
-                                                                         g_lilv_nodes.input,
-                                                                         g_lilv_nodes.reset);
-        if (reset_port)
-        {
-            effect->reset_index = lilv_port_get_index(plugin, reset_port);
-            *(effect->ports[effect->reset_index]->buffer) = 0.0f;
-        }
-        else
-        {
-            effect->reset_index = -1;
-        }
+        /* Try get the plugin again */
+        plugin = lilv_plugins_get_by_uri(g_plugins, plugin_uri);
 
-        const LilvPort* bpb_port = lilv_plugin_get_port_by_designation(plugin,
-                                                                       g_lilv_nodes.input,
-                                                                       g_lilv_nodes.timeBeatsPerBar);
-        if (bpb_port)
-        {
-            effect->bpb_index = lilv_port_get_index(plugin, bpb_port);
-            *(effect->ports[effect->bpb_index]->buffer) = g_transport_bpb;
-        }
-        else
+        if (!plugin)
+#endif
         {
-            effect->bpb_index = -1;
+            fprintf(stderr, "can't get plugin\n");
+            error = ERR_LV2_INVALID_URI;
+            goto error;
         }
+    }
 
-        const LilvPort* bpm_port = lilv_plugin_get_port_by_designation(plugin,
-                                                                       g_lilv_nodes.input,
-                                                                       g_lilv_nodes.timeBeatsPerMinute);
-        if (bpm_port)
-        {
-            effect->bpm_index = lilv_port_get_index(plugin, bpm_port);
-            *(effect->ports[effect->bpm_index]->buffer) = g_transport_bpm;
-        }
-        else
-        {
-            effect->bpm_index = -1;
-        }
+    effect->lilv_plugin = plugin;
 
-        const LilvPort* speed_port = lilv_plugin_get_port_by_designation(plugin,
-                                                                         g_lilv_nodes.input,
-                                                                         g_lilv_nodes.timeSpeed);
-        if (speed_port)
-        {
-            effect->speed_index = lilv_port_get_index(plugin, speed_port);
-            *(effect->ports[effect->speed_index]->buffer) = g_jack_rolling ? 1.0f : 0.0f;
-        }
-        else
-        {
-            effect->speed_index = -1;
-        }
+    /* Port layout, hints and properties are shared by all instances of this plugin */
+    effect->descriptor = PluginDescriptorGet(uri, plugin);
+
+    if (!effect->descriptor)
+    {
+        fprintf(stderr, "can't get plugin descriptor\n");
+        error = ERR_MEMORY_ALLOCATION;
+        goto error;
     }
 
-    /* Allocate memory to indexes */
-    /* Audio ports */
-    if (audio_ports_count > 0)
+    const plugin_descriptor_t *descriptor = effect->descriptor;
+
+    /* Features */
+    GetFeatures(effect);
+
+    pthread_mutexattr_t mutex_atts;
+    pthread_mutexattr_init(&mutex_atts);
+#ifdef __MOD_DEVICES__
+    pthread_mutexattr_setprotocol(&mutex_atts, PTHREAD_PRIO_INHERIT);
+#endif
+
+    /* Create and activate the plugin instance, lilv keeps the opened plugin libraries in the world */
+    lilv_instance = lilv_plugin_instantiate(plugin, g_sample_rate, effect->features);
+
+    if (!lilv_instance)
     {
-        effect->audio_ports_count = audio_ports_count;
-        effect->audio_ports = (port_t **) mod_calloc(audio_ports_count, sizeof(port_t *));
+        fprintf(stderr, "can't get lilv instance\n");
+        error = ERR_LV2_INSTANTIATION;
+        goto error;
+    }
+    effect->lilv_instance = lilv_instance;
 
-        if (input_audio_ports_count > 0)
-        {
-            effect->input_audio_ports_count = input_audio_ports_count;
-            effect->input_audio_ports = (port_t **) mod_calloc(input_audio_ports_count, sizeof(port_t *));
-        }
-        if (output_audio_ports_count > 0)
-        {
-            effect->output_audio_ports_count = output_audio_ports_count;
-            effect->output_audio_ports = (port_t **) mod_calloc(output_audio_ports_count, sizeof(port_t *));
-        }
+    effect->hints |= descriptor->hints;
+    effect->control_index = descriptor->control_index;
+    control_in_size = effect->control_index >= 0 ? g_midi_buffer_size * 16 : 0; // 16 taken from jalv source code
+    control_out_size = 0;
+
+    /* Query plugin extensions/interfaces */
+    if (descriptor->has_worker_interface)
+    {
+        const LV2_Worker_Interface *worker_interface =
+            (const LV2_Worker_Interface*) lilv_instance_get_extension_data(lilv_instance,
+                                                                           LV2_WORKER__interface);
+
+        worker_init(&effect->worker, lilv_instance, worker_interface, descriptor->worker_buf_size);
     }
 
-    /* Control ports */
-    if (control_ports_count > 0)
+    if (descriptor->has_options_interface)
     {
-        effect->control_ports_count = control_ports_count;
-        effect->control_ports = (port_t **) mod_calloc(control_ports_count, sizeof(port_t *));
+        effect->options_interface =
+            (const LV2_Options_Interface*) lilv_instance_get_extension_data(lilv_instance,
+                                                                            LV2_OPTIONS__interface);
+    }
 
-        if (input_control_ports_count > 0)
-        {
-            effect->input_control_ports_count = input_control_ports_count;
-            effect->input_control_ports = (port_t **) mod_calloc(input_control_ports_count, sizeof(port_t *));
-        }
-        if (output_control_ports_count > 0)
-        {
-            effect->output_control_ports_count = output_control_ports_count;
-            effect->output_control_ports = (port_t **) mod_calloc(output_control_ports_count, sizeof(port_t *));
-        }
+    if (descriptor->has_license_interface)
+    {
+        effect->license_iface =
+            (const MOD_License_Interface*) lilv_instance_get_extension_data(lilv_instance,
+                                                                            MOD_LICENSE__interface);
     }
 
-    /* CV ports */
-    if (cv_ports_count > 0)
+    if (descriptor->hints & HINT_HAS_STATE)
     {
-        effect->cv_ports_count = cv_ports_count;
-        effect->cv_ports = (port_t **) mod_calloc(cv_ports_count, sizeof(port_t *));
+        effect->state_iface =
+            (const LV2_State_Interface*) lilv_instance_get_extension_data(lilv_instance,
+                                                                          LV2_STATE__interface);
 
-        if (input_cv_ports_count > 0)
-        {
-            effect->input_cv_ports_count = input_cv_ports_count;
-            effect->input_cv_ports = (port_t **) mod_calloc(input_cv_ports_count, sizeof(port_t *));
-        }
-        if (output_cv_ports_count > 0)
-        {
-            effect->output_cv_ports_count = output_cv_ports_count;
-            effect->output_cv_ports = (port_t **) mod_calloc(output_cv_ports_count, sizeof(port_t *));
-        }
+        if (descriptor->hints & HINT_STATE_UNSAFE)
+            pthread_mutex_init(&effect->state_restore_mutex, &mutex_atts);
+
+        if (descriptor->load_default_state)
+            default_state = lilv_state_new_from_world(g_lv2_data, &g_urid_map, plugin_uri);
     }
 
-    /* Event ports */
-    if (event_ports_count > 0)
+#ifdef __MOD_DEVICES__
+    if (descriptor->has_hmi_interface)
     {
-        effect->event_ports_count = event_ports_count;
-        effect->event_ports = (port_t **) mod_calloc(event_ports_count, sizeof(port_t *));
+        effect->hmi_notif =
+            (const LV2_HMI_PluginNotification*) lilv_instance_get_extension_data(lilv_instance,
+                                                                                 LV2_HMI__PluginNotification);
+    }
+#endif
 
-        if (input_event_ports_count > 0)
-        {
-            effect->input_event_ports_count = input_event_ports_count;
-            effect->input_event_ports = (port_t **) mod_calloc(input_event_ports_count, sizeof(port_t *));
-        }
-        if (output_event_ports_count > 0)
-        {
-            effect->output_event_ports_count = output_event_ports_count;
-            effect->output_event_ports = (port_t **) mod_calloc(output_event_ports_count, sizeof(port_t *));
-        }
+    lilv_node_free(plugin_uri);
+    plugin_uri = NULL;
+
+    pthread_mutex_unlock(&g_lilv_mutex);
+    lilv_locked = false;
+
+    if (default_state != NULL)
+    {
+        lilv_state_restore(default_state, lilv_instance, NULL, NULL,
+                           LV2_STATE_IS_POD|LV2_STATE_IS_PORTABLE, effect->features);
+        lilv_state_free(default_state);
     }
 
-    /* Index the audio, control and event ports */
-    audio_ports_count = 0;
-    input_audio_ports_count = 0;
-    output_audio_ports_count = 0;
-    control_ports_count = 0;
-    input_control_ports_count = 0;
-    output_control_ports_count = 0;
-    cv_ports_count = 0;
-    input_cv_ports_count = 0;
-    output_cv_ports_count = 0;
-    event_ports_count = 0;
-    input_event_ports_count = 0;
-    output_event_ports_count = 0;
-
-    for (unsigned int i = 0; i < ports_count; i++)
-    {
-        /* Audio ports */
-        lilv_port = lilv_plugin_get_port_by_index(plugin, i);
-        if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.audio))
+    /* Allocate memory to ports, port indexes and properties */
+    if (! InstanceArenaAllocate(effect, &mutex_atts))
+    {
+        fprintf(stderr, "can't get ports\n");
+        error = ERR_MEMORY_ALLOCATION;
+        goto error;
+    }
+
+    effect->presets_count = descriptor->presets_count;
+    effect->presets = descriptor->presets;
+    effect->monitors_count = 0;
+    effect->monitors = NULL;
+
+    if (! FeedbackSlotsAllocate(effect))
+    {
+        fprintf(stderr, "can't get feedback slots\n");
+        error = ERR_MEMORY_ALLOCATION;
+        goto error;
+    }
+
+    for (uint32_t i = 0; i < effect->ports_count; i++)
+    {
+        const port_descriptor_t *port_desc = &descriptor->ports[i];
+        port = effect->ports[i];
+
+        snprintf(port_name, MAX_CHAR_BUF_SIZE, "%s", port->symbol);
+
+        /* Port flow */
+        if (port->flow == FLOW_INPUT)
+            jack_flags = JackPortIsInput;
+        else if (port->flow == FLOW_OUTPUT)
+            jack_flags = JackPortIsOutput;
+
+        if (port->type == TYPE_AUDIO)
         {
-            effect->audio_ports[audio_ports_count] = effect->ports[i];
-            audio_ports_count++;
+            /* Buffer is allocated later, together with all other audio/cv ports */
 
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input))
+            if (IsInProcessEffect(effect))
             {
-                effect->input_audio_ports[input_audio_ports_count] = effect->ports[i];
-                input_audio_ports_count++;
+                /* Jack port is only created when connected to something outside the graph */
+                jack_port = NULL;
             }
-            else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output))
+            else
             {
-                effect->output_audio_ports[output_audio_ports_count] = effect->ports[i];
-                output_audio_ports_count++;
+                /* Jack port creation */
+                jack_port = jack_port_register(jack_client, port_name, JACK_DEFAULT_AUDIO_TYPE, jack_flags, 0);
+                if (jack_port == NULL)
+                {
+                    fprintf(stderr, "can't get jack port\n");
+                    error = ERR_JACK_PORT_REGISTER;
+                    goto error;
+                }
             }
+            port->jack_port = jack_port;
         }
-        /* Control ports */
-        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.control))
+        else if (port->type == TYPE_CONTROL)
+        {
+            /* Buffer comes from the instance arena */
+            lilv_instance_connect_port(lilv_instance, i, port->buffer);
+        }
+        else if (port->type == TYPE_CV)
         {
-            effect->control_ports[control_ports_count] = effect->ports[i];
-            control_ports_count++;
+            /* Buffer is allocated later, together with all other audio/cv ports */
 
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input))
+            if (IsInProcessEffect(effect))
             {
-                effect->input_control_ports[input_control_ports_count] = effect->ports[i];
-                input_control_ports_count++;
+                /* Jack port is only created when connected to something outside the graph */
+                jack_port = NULL;
             }
-            else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output))
+            else
             {
-                effect->output_control_ports[output_control_ports_count] = effect->ports[i];
-                output_control_ports_count++;
+                /* Jack port creation */
+                jack_flags |= JackPortIsControlVoltage;
+                jack_port = jack_port_register(jack_client, port_name, JACK_DEFAULT_AUDIO_TYPE, jack_flags, 0);
+                if (jack_port == NULL)
+                {
+                    fprintf(stderr, "can't get jack port\n");
+                    error = ERR_JACK_PORT_REGISTER;
+                    goto error;
+                }
             }
+
+            if (jack_port != NULL)
+                SetJackPortRanges(jack_client, jack_port, port);
+
+            port->jack_port = jack_port;
         }
-        /* CV ports */
-        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.cv) || lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.mod_cvport))
+        else if (port->type == TYPE_EVENT)
         {
-            effect->cv_ports[cv_ports_count] = effect->ports[i];
-            cv_ports_count++;
+            if (port->flow == FLOW_OUTPUT && control_out_size == 0)
+                control_out_size = g_midi_buffer_size * 16; // 16 taken from jalv source code
 
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input))
+            if (port->flow == FLOW_INPUT)
             {
-                effect->input_cv_ports[input_cv_ports_count] = effect->ports[i];
-                input_cv_ports_count++;
+                if (port_desc->minimum_size > control_in_size)
+                    control_in_size = port_desc->minimum_size;
             }
-            else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output))
+            else if (port->flow == FLOW_OUTPUT)
             {
-                effect->output_cv_ports[output_cv_ports_count] = effect->ports[i];
-                output_cv_ports_count++;
+                if (port_desc->minimum_size > control_out_size)
+                    control_out_size = port_desc->minimum_size;
             }
-        }
-        /* Event ports */
-        else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.event) ||
-                 lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.atom_port))
-        {
-            effect->event_ports[event_ports_count] = effect->ports[i];
-            event_ports_count++;
 
-            if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.input))
+            jack_port = RegisterEffectJackPort(effect, port_name, JACK_DEFAULT_MIDI_TYPE, jack_flags);
+            if (jack_port == NULL)
             {
-                effect->input_event_ports[input_event_ports_count] = effect->ports[i];
-                input_event_ports_count++;
+                fprintf(stderr, "can't get jack port\n");
+                error = ERR_JACK_PORT_REGISTER;
+                goto error;
             }
-            else if (lilv_port_is_a(plugin, lilv_port, g_lilv_nodes.output))
+            port->jack_port = jack_port;
+
+            if (raw_midi_port == NULL && port_desc->raw_midi_clock)
             {
-                effect->output_event_ports[output_event_ports_count] = effect->ports[i];
-                output_event_ports_count++;
+                raw_midi_port_item* const portitemptr = malloc(sizeof(raw_midi_port_item));
+
+                if (portitemptr != NULL)
+                {
+                    raw_midi_port = jack_port;
+                    portitemptr->instance = instance;
+                    portitemptr->jack_port = jack_port;
+
+                    pthread_mutex_lock(&g_raw_midi_port_mutex);
+
+                    list_add_tail(&portitemptr->siblings, &g_raw_midi_port_list);
+
+                    pthread_mutex_unlock(&g_raw_midi_port_mutex);
+                }
             }
         }
     }
 
-    AllocatePortBuffers(effect, control_in_size, control_out_size);
+    // special ports
+    effect->enabled_index = descriptor->enabled_index;
+    if (effect->enabled_index >= 0)
+        *(effect->ports[effect->enabled_index]->buffer) = 1.0f;
 
-    {
-        // Index readable and writable properties
-        LilvNodes *writable_properties = lilv_world_find_nodes(
-            g_lv2_data,
-            lilv_plugin_get_uri(effect->lilv_plugin),
-            g_lilv_nodes.patch_writable,
-            NULL);
-        LilvNodes *readable_properties = lilv_world_find_nodes(
-            g_lv2_data,
-            lilv_plugin_get_uri(effect->lilv_plugin),
-            g_lilv_nodes.patch_readable,
-            NULL);
-        effect->properties_count = lilv_nodes_size(writable_properties) + lilv_nodes_size(readable_properties);
-        effect->properties = (property_t **) mod_calloc(effect->properties_count, sizeof(property_t *));
+    effect->freewheel_index = descriptor->freewheel_index;
+    if (effect->freewheel_index >= 0)
+        *(effect->ports[effect->freewheel_index]->buffer) = 0.0f;
 
-        // TODO mix readable and writable
-        uint32_t j = 0;
-        LILV_FOREACH(nodes, p, writable_properties)
-        {
-            const LilvNode* property = lilv_nodes_get(writable_properties, p);
-            effect->properties[j] = (property_t *) malloc(sizeof(property_t));
-            effect->properties[j]->uri = lilv_node_duplicate(property);
-            effect->properties[j]->type = lilv_world_get(g_lv2_data, property, g_lilv_nodes.rdfs_range, NULL);
-            effect->properties[j]->monitored = true; // always true for writable properties
-            j++;
-        }
-        LILV_FOREACH(nodes, p, readable_properties)
-        {
-            const LilvNode* property = lilv_nodes_get(readable_properties, p);
-            effect->properties[j] = (property_t *) malloc(sizeof(property_t));
-            effect->properties[j]->uri = lilv_node_duplicate(property);
-            effect->properties[j]->type = lilv_world_get(g_lv2_data, property, g_lilv_nodes.rdfs_range, NULL);
-            effect->properties[j]->monitored = false; // optional
-            j++;
-        }
+    effect->reset_index = descriptor->reset_index;
+    if (effect->reset_index >= 0)
+        *(effect->ports[effect->reset_index]->buffer) = 0.0f;
+
+    effect->bpb_index = descriptor->bpb_index;
+    if (effect->bpb_index >= 0)
+        *(effect->ports[effect->bpb_index]->buffer) = g_transport_bpb;
 
-        lilv_nodes_free(writable_properties);
-        lilv_nodes_free(readable_properties);
+    effect->bpm_index = descriptor->bpm_index;
+    if (effect->bpm_index >= 0)
+        *(effect->ports[effect->bpm_index]->buffer) = g_transport_bpm;
+
+    effect->speed_index = descriptor->speed_index;
+    if (effect->speed_index >= 0)
+        *(effect->ports[effect->speed_index]->buffer) = g_jack_rolling ? 1.0f : 0.0f;
+
+    if (! PortIndexBuild(effect))
+    {
+        fprintf(stderr, "can't get port index\n");
+        error = ERR_MEMORY_ALLOCATION;
+        goto error;
     }
 
-    lilv_node_free(plugin_uri);
+    AllocatePortBuffers(effect, control_in_size, control_out_size);
+
+    /* Allocate memory to audio and cv buffers */
+    if (!AllocateAudioPortBuffers(effect, g_block_length))
+    {
+        fprintf(stderr, "can't get audio buffers\n");
+        error = ERR_MEMORY_ALLOCATION;
+        goto error;
+    }
 
     /* create ring buffer for events from socket/commandline */
     if (control_in_size != 0)
@@ -5999,6 +8768,11 @@ int effects_add(const char *uri, int instance, int activate)
     /* Default value of bypass */
     effect->bypass = 0.0f;
     effect->was_bypassed = false;
+    effect->bypass_policy = BYPASS_POLICY_RUN_SILENT;
+    effect->bypass_tail_done = false;
+
+    /* Sleeping on silence is opt-in */
+    effect->sleep_tail_frames = -1;
 
     effect->bypass_port.buffer_count = 1;
     effect->bypass_port.buffer = &effect->bypass;
@@ -6028,22 +8802,36 @@ int effects_add(const char *uri, int instance, int activate)
 
     pthread_mutexattr_destroy(&mutex_atts);
 
-    /* Jack callbacks */
-    jack_set_thread_init_callback(jack_client, JackThreadInit, effect);
-    jack_set_process_callback(jack_client, ProcessPlugin, effect);
-    jack_set_buffer_size_callback(jack_client, BufferSize, effect);
-    jack_set_freewheel_callback(jack_client, FreeWheelMode, effect);
+    if (IsInProcessEffect(effect))
+    {
+        lilv_instance_activate(lilv_instance);
 
-    lilv_instance_activate(lilv_instance);
+        /* Hand over to the global client, processing starts on the next plan */
+        effect->in_graph = true;
 
-    if (activate)
+        pthread_mutex_lock(&g_lilv_mutex);
+        GraphRebuild();
+        pthread_mutex_unlock(&g_lilv_mutex);
+    }
+    else
     {
-        /* Try activate the Jack client */
-        if (jack_activate(jack_client) != 0)
+        /* Jack callbacks */
+        jack_set_thread_init_callback(jack_client, JackThreadInit, effect);
+        jack_set_process_callback(jack_client, ProcessPlugin, effect);
+        jack_set_buffer_size_callback(jack_client, BufferSize, effect);
+        jack_set_freewheel_callback(jack_client, FreeWheelMode, effect);
+
+        lilv_instance_activate(lilv_instance);
+
+        if (activate)
         {
-            fprintf(stderr, "can't activate jack_client\n");
-            error = ERR_JACK_CLIENT_ACTIVATION;
-            goto error;
+            /* Try activate the Jack client */
+            if (jack_activate(jack_client) != 0)
+            {
+                fprintf(stderr, "can't activate jack_client\n");
+                error = ERR_JACK_CLIENT_ACTIVATION;
+                goto error;
+            }
         }
     }
 
@@ -6070,26 +8858,97 @@ int effects_add(const char *uri, int instance, int activate)
         }
     }
 
-    LoadPresets(effect);
+    __atomic_store_n(&effect->adding, false, __ATOMIC_RELEASE);
     return instance;
 
 error:
+    // removal stops and restarts shared threads, so it is serialized as well
+    if (! lilv_locked)
+        pthread_mutex_lock(&g_lilv_mutex);
+
     lilv_node_free(plugin_uri);
 
+    effect->adding = false;
     effects_remove(instance);
+
+    pthread_mutex_unlock(&g_lilv_mutex);
     return error;
 }
 
-int effects_add_multi(int activate, int num_effects, int *effects, const char *const *uris)
+static void* effects_add_thread(void* arg)
+{
+    multi_add_job_t *job = arg;
+    int i;
+
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->num_effects)
+    {
+        // already failed, a duplicate instance
+        if (job->results[i] != SUCCESS)
+            continue;
+
+        const int ret = effects_add(job->uris[i], job->effects[i], job->activate);
+        job->results[i] = ret < 0 ? ret : SUCCESS;
+    }
+
+    return NULL;
+}
+
+int effects_add_multi(int activate, int num_effects, int *effects, const char *const *uris, int *results)
 {
     if (num_effects <= 0)
         return ERR_INVALID_OPERATION;
 
     if (num_effects == 1)
-        return effects_add(*uris, *effects, activate);
+    {
+        const int ret = effects_add(*uris, *effects, activate);
+        *results = ret < 0 ? ret : SUCCESS;
+        return *results;
+    }
+
+    multi_add_job_t job = { uris, effects, results, num_effects, activate, 0 };
+
+    // the same instance twice would race on its slot, only the first one is added
+    for (int i = 0; i < num_effects; ++i)
+    {
+        results[i] = SUCCESS;
+
+        for (int j = 0; j < i; ++j)
+        {
+            if (effects[j] == effects[i])
+            {
+                results[i] = ERR_INSTANCE_ALREADY_EXISTS;
+                break;
+            }
+        }
+    }
+
+    int num_threads = num_effects < MAX_ADD_THREADS ? num_effects : MAX_ADD_THREADS;
+#ifndef _WIN32
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0 && cpus < num_threads)
+        num_threads = (int)cpus;
+#endif
+
+    ZixThread threads[MAX_ADD_THREADS];
+    int started = 0;
+
+    // the calling thread takes part too
+    for (int i = 1; i < num_threads; ++i)
+    {
+        if (zix_thread_create(&threads[started], 0, effects_add_thread, &job) == 0)
+            ++started;
+    }
+
+    effects_add_thread(&job);
+
+    for (int i = 0; i < started; ++i)
+        zix_thread_join(threads[i], NULL);
 
     for (int i = 0; i < num_effects; ++i)
-        effects_add(uris[i], effects[i], activate);
+    {
+        if (results[i] != SUCCESS)
+            return results[i];
+    }
 
     return SUCCESS;
 }
@@ -6196,7 +9055,17 @@ int effects_preset_show(const char *uri, char **state_str)
         return ERR_LV2_INVALID_PRESET_URI;
     }
 
-    if (lilv_world_load_resource(g_lv2_data, preset_uri) >= 0)
+    int loaded = lilv_world_load_resource(g_lv2_data, preset_uri);
+
+    if (loaded < 0)
+    {
+        pthread_mutex_lock(&g_lilv_mutex);
+        if (plugin_cache_load_resource(g_lv2_data, uri) > 0)
+            loaded = lilv_world_load_resource(g_lv2_data, preset_uri);
+        pthread_mutex_unlock(&g_lilv_mutex);
+    }
+
+    if (loaded >= 0)
     {
         LilvState* state = lilv_state_new_from_world(g_lv2_data, &g_urid_map, preset_uri);
         if (!state)
@@ -6301,9 +9170,7 @@ static void effects_remove_inner_pre(int effect_id)
 
         // RT/mempool stuff
         INIT_LIST_HEAD(&queue);
-        pthread_mutex_lock(&g_rtsafe_mutex);
-        list_splice_init(&g_rtsafe_list, &queue);
-        pthread_mutex_unlock(&g_rtsafe_mutex);
+        RtSafeQueueDrain(&queue);
 
         list_for_each_safe(it, it2, &queue)
         {
@@ -6405,6 +9272,8 @@ static void effects_remove_inner_loop(int effect_id)
 {
     effect_t *effect = &g_effects[effect_id];
 
+    ParamHandlesRelease(effect);
+
 #ifdef WITH_EXTERNAL_UI_SUPPORT
     if (effect->ui_libhandle != NULL)
     {
@@ -6417,6 +9286,10 @@ static void effects_remove_inner_loop(int effect_id)
 
     FreeFeatures(effect);
 
+    // in-process effect ports live on the global client, which stays around
+    if (IsInProcessEffect(effect))
+        GraphReleaseEffectPorts(effect);
+
     if (effect->event_ports)
     {
         for (uint32_t i = 0; i < effect->event_ports_count; i++)
@@ -6453,31 +9326,13 @@ static void effects_remove_inner_loop(int effect_id)
 #endif
 
                 // TODO destroy port mutexes
-                free(effect->ports[i]->buffer);
-
-                lilv_scale_points_free(effect->ports[i]->scale_points);
-
-                free(effect->ports[i]);
             }
         }
-        free(effect->ports);
     }
 
-    if (effect->properties)
-    {
-        for (uint32_t i = 0; i < effect->properties_count; i++)
-        {
-            if (effect->properties[i])
-            {
-                lilv_node_free(effect->properties[i]->uri);
-                lilv_node_free(effect->properties[i]->type);
-            }
-        }
-
-        for (uint32_t i = 0; i < effect->properties_count; i++)
-            free(effect->properties[i]);
-        free(effect->properties);
-    }
+    FreeAudioPortBuffers(effect);
+    FeedbackSlotsFree(effect);
+    PortIndexFree(effect);
 
     if (effect->lilv_instance)
     {
@@ -6487,25 +9342,9 @@ static void effects_remove_inner_loop(int effect_id)
         lilv_instance_free(effect->lilv_instance);
     }
 
-    if (effect->jack_client)
+    if (effect->jack_client && !IsInProcessEffect(effect))
         jack_client_close(effect->jack_client);
 
-    free(effect->audio_ports);
-    free(effect->input_audio_ports);
-    free(effect->output_audio_ports);
-
-    free(effect->control_ports);
-    free(effect->input_control_ports);
-    free(effect->output_control_ports);
-
-    free(effect->cv_ports);
-    free(effect->input_cv_ports);
-    free(effect->output_cv_ports);
-
-    free(effect->event_ports);
-    free(effect->input_event_ports);
-    free(effect->output_event_ports);
-
     if (effect->events_in_buffer)
         jack_ringbuffer_free(effect->events_in_buffer);
     if (effect->events_in_buffer_helper)
@@ -6513,16 +9352,6 @@ static void effects_remove_inner_loop(int effect_id)
     if (effect->events_out_buffer)
         jack_ringbuffer_free(effect->events_out_buffer);
 
-    if (effect->presets)
-    {
-        for (uint32_t i = 0; i < effect->presets_count; i++)
-            lilv_free(effect->presets[i]->uri);
-
-        for (uint32_t i = 0; i < effect->presets_count; i++)
-            free(effect->presets[i]);
-        free(effect->presets);
-    }
-
     if (effect->hints & HINT_HAS_STATE)
     {
         if (g_lv2_scratch_dir != NULL)
@@ -6539,6 +9368,10 @@ static void effects_remove_inner_loop(int effect_id)
             pthread_mutex_destroy(&effect->state_restore_mutex);
     }
 
+    // ports, port lists and properties; scale points and presets belong to the descriptor
+    free(effect->instance_arena);
+    PluginDescriptorRelease(effect->descriptor);
+
     InstanceDelete(effect_id);
 }
 
@@ -6584,32 +9417,41 @@ int effects_remove(int effect_id)
         start = 0;
         end = MAX_PLUGIN_INSTANCES;
 
-        // clear all sync scheduled params if removing all plugins
-        pthread_mutex_lock(&g_sync_scheduled_params_mutex);
-        g_sync_scheduled_param_count = 0;
-        pthread_mutex_unlock(&g_sync_scheduled_params_mutex);
     }
     else
     {
         start = effect_id;
         end = start + 1;
-
-        // trigger sync scheduled params now for no dangling pointers
-        effect_sync_scheduled_params(false);
     }
 
+    // trigger sync scheduled params now and drop staged ones for no dangling pointers
+    effect_sync_scheduled_params(false);
+    SyncScheduledDrop(effect_id);
+
     // stop plugins processing
+    bool graph_changed = false;
+
     for (int j = start; j < end; j++)
     {
         if (InstanceExist(j))
         {
             effect = &g_effects[j];
 
+            if (IsInProcessEffect(effect))
+            {
+                effect->in_graph = false;
+                graph_changed = true;
+                continue;
+            }
+
             if (jack_deactivate(effect->jack_client) != 0)
                 return ERR_JACK_CLIENT_DEACTIVATION;
         }
     }
 
+    if (graph_changed)
+        GraphRebuild();
+
     // remove addressings, midi learn and other stuff related to plugins
     effects_remove_inner_pre(effect_id);
 
@@ -6624,9 +9466,6 @@ int effects_remove(int effect_id)
             effects_remove_inner_loop(j);
     }
 
-    // clear param_set cache
-    effects_set_parameter(-1, NULL, 0.f);
-
     // start thread again
     if (g_postevents_running == 0)
     {
@@ -6666,6 +9505,11 @@ int effects_remove_multi(int num_effects, int *effects)
         zix_thread_join(g_postevents_thread, NULL);
     }
 
+    // trigger sync scheduled params now and drop staged ones for no dangling pointers
+    effect_sync_scheduled_params(false);
+    for (int i = 0; i < num_effects; ++i)
+        SyncScheduledDrop(effects[i]);
+
     // stop plugins processing
     for (int i = 0, effect_id; i < num_effects; ++i)
     {
@@ -6687,6 +9531,23 @@ int effects_remove_multi(int num_effects, int *effects)
     for (int i = 0; i < num_threads; ++i)
         zix_thread_join(threads[i], NULL);
 
+    // take in-process effects out of the graph
+    bool graph_changed = false;
+
+    for (int i = 0; i < num_effects; ++i)
+    {
+        effect = &g_effects[effects[i]];
+
+        if (effect->in_graph)
+        {
+            effect->in_graph = false;
+            graph_changed = true;
+        }
+    }
+
+    if (graph_changed)
+        GraphRebuild();
+
     // remove addressings, midi learn and other stuff related to plugins
     for (int i = 0, effect_id; i < num_effects; ++i)
     {
@@ -6747,7 +9608,7 @@ int effects_activate(int effect_id, int value)
         {
             effect->jack_activated = true;
 
-            if (jack_activate(effect->jack_client) != 0)
+            if (!IsInProcessEffect(effect) && jack_activate(effect->jack_client) != 0)
             {
                 fprintf(stderr, "can't activate jack_client\n");
                 return ERR_JACK_CLIENT_ACTIVATION;
@@ -6760,7 +9621,12 @@ int effects_activate(int effect_id, int value)
         {
             effect->jack_activated = false;
 
-            if (jack_deactivate(effect->jack_client) != 0)
+            if (IsInProcessEffect(effect))
+            {
+                // wait for the current cycle to finish
+                GraphSync();
+            }
+            else if (jack_deactivate(effect->jack_client) != 0)
             {
                 fprintf(stderr, "can't deactivate jack_client\n");
                 return ERR_JACK_CLIENT_DEACTIVATION;
@@ -6789,7 +9655,7 @@ static void* effects_activate_thread(void* arg)
 
     effect->jack_activated = true;
 
-    if (jack_activate(effect->jack_client) != 0)
+    if (!IsInProcessEffect(effect) && jack_activate(effect->jack_client) != 0)
         fprintf(stderr, "can't activate jack_client\n");
 
     return NULL;
@@ -6799,8 +9665,16 @@ static void* effects_deactivate_thread(void* arg)
 {
     effect_t *effect = arg;
 
-    if (jack_deactivate(effect->jack_client) != 0)
+    if (IsInProcessEffect(effect))
+    {
+        // stop processing, then wait for the current cycle to finish
+        effect->jack_activated = false;
+        GraphSync();
+    }
+    else if (jack_deactivate(effect->jack_client) != 0)
+    {
         fprintf(stderr, "can't deactivate jack_client\n");
+    }
 
     if (effect->lv2_activated && ((effect->hints & HINT_NO_PRE_RUN) != 0))
     {
@@ -6874,24 +9748,105 @@ int effects_connect(const char *portA, const char *portB, int check)
 {
     int ret;
 
-    if (check != 0)
+    // in-process effect ports are connected directly, or get a jack port when going outside the graph
+    if (g_graph_engine_enabled)
     {
-        if (jack_port_by_name(g_jack_global_client, portA) == NULL ||
-            jack_port_by_name(g_jack_global_client, portB) == NULL)
-            return ERR_JACK_PORT_CONNECTION;
+        effect_t *effectA, *effectB;
+        port_t *graph_portA = GraphFindPort(portA, &effectA);
+        port_t *graph_portB = GraphFindPort(portB, &effectB);
+
+        if (graph_portA != NULL && graph_portB != NULL)
+            return GraphAddEdge(effectA, graph_portA, effectB, graph_portB);
+
+        if (graph_portA != NULL)
+        {
+            jack_port_t *jack_port = GraphEnsureJackPort(effectA, graph_portA);
+            if (jack_port == NULL)
+                return ERR_JACK_PORT_REGISTER;
+            portA = jack_port_name(jack_port);
+        }
+        else if (graph_portB != NULL)
+        {
+            jack_port_t *jack_port = GraphEnsureJackPort(effectB, graph_portB);
+            if (jack_port == NULL)
+                return ERR_JACK_PORT_REGISTER;
+            portB = jack_port_name(jack_port);
+        }
+    }
+
+    if (check != 0 && (jack_port_by_name(g_jack_global_client, portA) == NULL ||
+                       jack_port_by_name(g_jack_global_client, portB) == NULL))
+    {
+        ret = ERR_JACK_PORT_CONNECTION;
+    }
+    else
+    {
+        ret = jack_connect(g_jack_global_client, portA, portB);
+        if (ret != 0 && ret != EEXIST) ret = jack_connect(g_jack_global_client, portB, portA);
+        if (ret == EEXIST) ret = 0;
     }
 
-    ret = jack_connect(g_jack_global_client, portA, portB);
-    if (ret != 0 && ret != EEXIST) ret = jack_connect(g_jack_global_client, portB, portA);
-    if (ret == EEXIST) ret = 0;
+    if (ret != 0)
+    {
+        if (g_graph_engine_enabled)
+            GraphReleaseUnusedJackPorts();
 
-    if (ret != 0) return ERR_JACK_PORT_CONNECTION;
+        return ERR_JACK_PORT_CONNECTION;
+    }
 
     return ret;
 }
 
 int effects_connect_matching(const char *matching, const char *port)
 {
+    if (g_graph_engine_enabled)
+    {
+        effect_t *effect;
+        port_t *graph_port = GraphFindPort(matching, &effect);
+
+        if (graph_port != NULL)
+        {
+            char peer_name[MAX_CHAR_BUF_SIZE+1];
+            peer_name[MAX_CHAR_BUF_SIZE] = '\0';
+
+            for (uint32_t i = 0; i < g_graph_edges_count; i++)
+            {
+                const graph_edge_t *edge = &g_graph_edges[i];
+
+                if (edge->source == graph_port)
+                    snprintf(peer_name, MAX_CHAR_BUF_SIZE, "effect_%d:%s", edge->target_id, edge->target->symbol);
+                else if (edge->target == graph_port)
+                    snprintf(peer_name, MAX_CHAR_BUF_SIZE, "effect_%d:%s", edge->source_id, edge->source->symbol);
+                else
+                    continue;
+
+                effects_connect(peer_name, port, 0);
+            }
+
+            if (graph_port->jack_port == NULL)
+                return SUCCESS;
+
+            matching = jack_port_name(graph_port->jack_port);
+        }
+
+        if (GraphFindPort(port, &effect) != NULL)
+        {
+            const jack_port_t *jport = jack_port_by_name(g_jack_global_client, matching);
+            if (!jport)
+                return ERR_JACK_PORT_CONNECTION;
+
+            const char **jports = jack_port_get_connections(jport);
+            if (jports)
+            {
+                for (int i = 0; jports[i]; ++i)
+                    effects_connect(jports[i], port, 0);
+                jack_free(jports);
+            }
+
+            return SUCCESS;
+        }
+    }
+
     const jack_port_t *jport = jack_port_by_name(g_jack_global_client, matching);
     if (!jport)
         return ERR_JACK_PORT_CONNECTION;
@@ -6911,6 +9866,29 @@ int effects_disconnect(const char *portA, const char *portB, int check)
 {
     int ret;
 
+    if (g_graph_engine_enabled)
+    {
+        effect_t *effectA, *effectB;
+        port_t *graph_portA = GraphFindPort(portA, &effectA);
+        port_t *graph_portB = GraphFindPort(portB, &effectB);
+
+        if (graph_portA != NULL && graph_portB != NULL)
+            return GraphRemoveEdge(graph_portA, graph_portB) ? SUCCESS : ERR_JACK_PORT_DISCONNECTION;
+
+        if (graph_portA != NULL)
+        {
+            if (graph_portA->jack_port == NULL)
+                return ERR_JACK_PORT_DISCONNECTION;
+            portA = jack_port_name(graph_portA->jack_port);
+        }
+        else if (graph_portB != NULL)
+        {
+            if (graph_portB->jack_port == NULL)
+                return ERR_JACK_PORT_DISCONNECTION;
+            portB = jack_port_name(graph_portB->jack_port);
+        }
+    }
+
     if (check != 0)
     {
         const jack_port_t *jportA = jack_port_by_name(g_jack_global_client, portA);
@@ -6924,6 +9902,10 @@ int effects_disconnect(const char *portA, const char *portB, int check)
 
     ret = jack_disconnect(g_jack_global_client, portA, portB);
     if (ret != 0) ret = jack_disconnect(g_jack_global_client, portB, portA);
+
+    if (g_graph_engine_enabled)
+        GraphReleaseUnusedJackPorts();
+
     if (ret != 0) return ERR_JACK_PORT_DISCONNECTION;
 
     return ret;
@@ -6933,6 +9915,23 @@ int effects_disconnect_all(const char *port)
 {
     int ret;
 
+    if (g_graph_engine_enabled)
+    {
+        effect_t *effect;
+        port_t *graph_port = GraphFindPort(port, &effect);
+
+        if (graph_port != NULL)
+        {
+            GraphRemoveEdge(graph_port, NULL);
+
+            if (graph_port->jack_port != NULL)
+                jack_port_disconnect(g_jack_global_client, graph_port->jack_port);
+
+            GraphReleaseUnusedJackPorts();
+            return SUCCESS;
+        }
+    }
+
     ret = jack_port_disconnect(g_jack_global_client, jack_port_by_name(g_jack_global_client, port));
     if (ret != 0) return ERR_JACK_PORT_DISCONNECTION;
 
@@ -6943,64 +9942,111 @@ int effects_set_parameter(int effect_id, const char *control_symbol, float value
 {
     port_t *port;
 
-    static int last_effect_id = -1;
-    static const char *last_symbol = NULL;
-    static float *last_buffer, *last_prev, last_min, last_max;
+    // no cached port, slow commands set parameters from the background executor while others add and remove
+    if (!InstanceExist(effect_id))
+        return ERR_INSTANCE_NON_EXISTS;
+
+    port = FindEffectInputPortBySymbol(&(g_effects[effect_id]), control_symbol);
+    if (port == NULL)
+        return ERR_LV2_INVALID_PARAM_SYMBOL;
+
+    if (value < port->min_value)
+        value = port->min_value;
+    else if (value > port->max_value)
+        value = port->max_value;
+
+    if (TxnStage(effect_id, port, value))
+        return SUCCESS;
+
+    port->prev_value = *port->buffer = value;
 #ifdef WITH_EXTERNAL_UI_SUPPORT
-    static enum PortHints *last_hints;
+    port->hints |= HINT_SHOULD_UPDATE;
 #endif
+    return SUCCESS;
+}
 
-    if (InstanceExist(effect_id))
+int effects_get_parameter_handle(int effect_id, const char *control_symbol)
+{
+    if (!InstanceExist(effect_id))
+        return ERR_INSTANCE_NON_EXISTS;
+
+    effect_t *effect = &g_effects[effect_id];
+    port_t *port = FindEffectInputPortBySymbol(effect, control_symbol);
+
+    if (port == NULL)
+        return ERR_LV2_INVALID_PARAM_SYMBOL;
+
+    // hand out the same handle again if there is one, otherwise reuse the first free slot
+    uint32_t index = g_param_handles_count;
+
+    for (uint32_t i = 0; i < g_param_handles_count; i++)
+    {
+        if (g_param_handles[i].port == port)
+            return (int)((g_param_handles[i].generation << PARAM_HANDLE_INDEX_BITS) | i);
+
+        if (g_param_handles[i].effect_id == -1 && index == g_param_handles_count)
+            index = i;
+    }
+
+    if (index == g_param_handles_count)
     {
-        // check whether is setting the same parameter
-        if (last_effect_id == effect_id)
+        if (g_param_handles_count == MAX_PARAM_HANDLES)
+            return ERR_ASSIGNMENT_LIST_FULL;
+
+        if (g_param_handles_count == g_param_handles_size)
         {
-            if (last_symbol && strcmp(last_symbol, control_symbol) == 0)
-            {
-                if (value < last_min)
-                    value = last_min;
-                else if (value > last_max)
-                    value = last_max;
+            const uint32_t size = g_param_handles_size != 0 ? g_param_handles_size * 2 : 256;
+            param_handle_t *handles = realloc(g_param_handles, sizeof(param_handle_t) * size);
 
-                *last_buffer = *last_prev = value;
-#ifdef WITH_EXTERNAL_UI_SUPPORT
-                *last_hints |= HINT_SHOULD_UPDATE;
-#endif
-                return SUCCESS;
-            }
+            if (handles == NULL)
+                return ERR_MEMORY_ALLOCATION;
+
+            g_param_handles = handles;
+            g_param_handles_size = size;
         }
 
-        port = FindEffectInputPortBySymbol(&(g_effects[effect_id]), control_symbol);
-        if (port)
-        {
-            // stores the data of the current control
-            last_effect_id = effect_id;
-            last_min = port->min_value;
-            last_max = port->max_value;
-            last_buffer = port->buffer;
-            last_prev   = &port->prev_value;
-            last_symbol = port->symbol;
+        g_param_handles[index].generation = 0;
+        g_param_handles_count++;
+    }
+
+    g_param_handles[index].effect_id = effect_id;
+    g_param_handles[index].port = port;
+    effect->has_param_handles = true;
+
+    return (int)((g_param_handles[index].generation << PARAM_HANDLE_INDEX_BITS) | index);
+}
+
+int effects_set_parameter_handle(int handle, float value)
+{
+    if (handle < 0)
+        return ERR_INSTANCE_NON_EXISTS;
 
-            if (value < last_min)
-                value = last_min;
-            else if (value > last_max)
-                value = last_max;
+    const uint32_t index = (uint32_t)handle & PARAM_HANDLE_INDEX_MASK;
 
-            *last_prev = *last_buffer = value;
+    if (index >= g_param_handles_count)
+        return ERR_INSTANCE_NON_EXISTS;
+
+    const param_handle_t *entry = &g_param_handles[index];
+
+    if (entry->port == NULL || entry->generation != ((uint32_t)handle >> PARAM_HANDLE_INDEX_BITS))
+        return ERR_INSTANCE_NON_EXISTS;
+
+    port_t *port = entry->port;
+
+    if (value < port->min_value)
+        value = port->min_value;
+    else if (value > port->max_value)
+        value = port->max_value;
+
+    if (TxnStage(entry->effect_id, port, value))
+        return SUCCESS;
 
+    port->prev_value = *port->buffer = value;
 #ifdef WITH_EXTERNAL_UI_SUPPORT
-            last_hints = &port->hints;
-            port->hints |= HINT_SHOULD_UPDATE;
+    port->hints |= HINT_SHOULD_UPDATE;
 #endif
-            return SUCCESS;
-        }
 
-        last_effect_id = -1;
-        return ERR_LV2_INVALID_PARAM_SYMBOL;
-    }
-
-    last_effect_id = -1;
-    return ERR_INSTANCE_NON_EXISTS;
+    return SUCCESS;
 }
 
 int effects_set_parameter_multi(const char *control_symbol, float value, int num_effects, int *effects)
@@ -7011,47 +10057,25 @@ int effects_set_parameter_multi(const char *control_symbol, float value, int num
     if (num_effects == 1)
         return effects_set_parameter(*effects, control_symbol, value);
 
-    port_t **ports = malloc(sizeof(port_t*) * num_effects);
+    port_t *port;
+
+    // keeps values staged from other threads out of the middle of this batch
+    pthread_mutex_lock(&g_sync_scheduled_lock);
 
-    if (ports == NULL)
-        return ERR_MEMORY_ALLOCATION;
+    sync_scheduled_batch_t *const batch = TxnBatch();
 
-    int num_ports = 0;
     for (int i = 0, effect_id; i < num_effects; i++)
     {
         effect_id = effects[i];
-        if (InstanceExist(effect_id))
-        {
-            if ((ports[num_ports] = FindEffectInputPortBySymbol(&(g_effects[effect_id]), control_symbol)))
-                ++num_ports;
-        }
-    }
-
-    // the critical loop, must be as fast and small as possible
-    bool scheduled = true;
-    pthread_mutex_lock(&g_sync_scheduled_params_mutex);
-    if (g_sync_scheduled_param_count + num_ports <= MAX_SYNC_SCHEDULED_PARAMS)
-    {
-        int p = g_sync_scheduled_param_count;
-        for (int i = 0; i < num_ports; i++, p++)
-        {
-            g_sync_scheduled_params[p].port = ports[i];
-            g_sync_scheduled_params[p].value = value;
-        }
-        g_sync_scheduled_param_count = p;
-    }
-    else
-    {
-        scheduled = false;
-    }
-    pthread_mutex_unlock(&g_sync_scheduled_params_mutex);
+        if (!InstanceExist(effect_id))
+            continue;
 
-    if (! scheduled)
-    {
-        // no space to schedule events, trigger param changes now
-        for (int i = 0; i < num_ports; i++)
+        if ((port = FindEffectInputPortBySymbol(&(g_effects[effect_id]), control_symbol)) == NULL)
+            continue;
+
+        if (! SyncScheduledStage(batch, effect_id, port, value))
         {
-            port_t *port = ports[i];
+            // out of memory, trigger param change now
             port->prev_value = *port->buffer = value;
 #ifdef WITH_EXTERNAL_UI_SUPPORT
             port->hints |= HINT_SHOULD_UPDATE;
@@ -7059,7 +10083,11 @@ int effects_set_parameter_multi(const char *control_symbol, float value, int num
         }
     }
 
-    free(ports);
+    // all instances change in the same cycle, unless part of a bigger transaction
+    if (batch == g_sync_scheduled_staging)
+        SyncScheduledCommit();
+
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
 
     return SUCCESS;
 }
@@ -7100,7 +10128,7 @@ int effects_flush_parameters(int effect_id, int reset, int param_count, const fl
     for (int i = 0; i < param_count; i++)
     {
         port = FindEffectInputPortBySymbol(effect, params[i].symbol);
-        if (port)
+        if (port && ! TxnStage(effect_id, port, params[i].value))
         {
             port->prev_value = *(port->buffer) = params[i].value;
 #ifdef WITH_EXTERNAL_UI_SUPPORT
@@ -7127,100 +10155,62 @@ int effects_flush_parameters_multi(int reset, int param_count, const flushed_par
     if (num_effects == 1)
         return effects_flush_parameters(*effects, reset, param_count, params);
 
-    cached_effect_flush_t *cached_effect;
     effect_t *effect;
     port_t *port;
 
-    int num_cached_effects = 0;
-    cached_effect_flush_t *cached_effects = malloc(sizeof(cached_effect_flush_t) * num_effects);
+    pthread_mutex_lock(&g_sync_scheduled_lock);
 
-    if (cached_effects == NULL)
-        return ERR_MEMORY_ALLOCATION;
+    sync_scheduled_batch_t *const batch = TxnBatch();
 
     for (int i = 0, effect_id; i < num_effects; i++)
     {
         effect_id = effects[i];
-        if (InstanceExist(effect_id))
-        {
-            effect = &(g_effects[effect_id]);
-
-            if (! effect->lv2_activated)
-            {
-                fprintf(stderr, "multi-param-flush attempted on non-activated plugin #%d\n", effect->instance);
-                continue;
-            }
+        if (!InstanceExist(effect_id))
+            continue;
 
-            cached_effect = &cached_effects[num_cached_effects++];
-            cached_effect->effect = effect;
-            cached_effect->ports = malloc(sizeof(port_t*) * param_count);
-            cached_effect->num_ports = 0;
+        effect = &(g_effects[effect_id]);
 
-            for (int j = 0; j < param_count; j++)
-            {
-                if ((cached_effect->ports[cached_effect->num_ports] = FindEffectInputPortBySymbol(effect, params[j].symbol)))
-                    ++cached_effect->num_ports;
-            }
+        if (! effect->lv2_activated)
+        {
+            fprintf(stderr, "multi-param-flush attempted on non-activated plugin #%d\n", effect->instance);
+            continue;
         }
-    }
 
-    // the critical loop, must be as fast and small as possible
-    bool scheduled = true;
-    const int resetb = reset != 0 ? 1 : 0;
-    pthread_mutex_lock(&g_sync_scheduled_params_mutex);
-    if (g_sync_scheduled_param_count + (param_count + resetb) * num_cached_effects <= MAX_SYNC_SCHEDULED_PARAMS)
-    {
-        int p = g_sync_scheduled_param_count;
-        for (int i = 0; i < num_cached_effects; i++)
+        for (int j = 0; j <= param_count; j++)
         {
-            cached_effect = &cached_effects[i];
-            effect = cached_effect->effect;
-            for (int j = 0; j < cached_effect->num_ports; j++, p++)
+            float value;
+
+            // reset goes last, after all params
+            if (j == param_count)
             {
-                g_sync_scheduled_params[p].port = cached_effect->ports[j];
-                g_sync_scheduled_params[p].value = params[j].value;
+                if (effect->reset_index < 0 || reset == 0)
+                    break;
+                port = effect->ports[effect->reset_index];
+                value = reset;
             }
-            if (effect->reset_index >= 0 && reset != 0)
+            else
             {
-                g_sync_scheduled_params[p].port = effect->ports[effect->reset_index];
-                g_sync_scheduled_params[p].value = reset;
-                ++p;
+                if ((port = FindEffectInputPortBySymbol(effect, params[j].symbol)) == NULL)
+                    continue;
+                value = params[j].value;
             }
-        }
-        g_sync_scheduled_param_count = p;
-    }
-    else
-    {
-        scheduled = false;
-    }
-    pthread_mutex_unlock(&g_sync_scheduled_params_mutex);
 
-    if (! scheduled)
-    {
-        // no space to schedule events, trigger param changes now
-        for (int i = 0; i < num_cached_effects; i++)
-        {
-            cached_effect = &cached_effects[i];
-            effect = cached_effect->effect;
-            for (int j = 0; j < cached_effect->num_ports; j++)
+            if (! SyncScheduledStage(batch, effect_id, port, value))
             {
-                port = cached_effect->ports[j];
-                port->prev_value = *(port->buffer) = params[j].value;
+                // out of memory, trigger param change now
+                port->prev_value = *(port->buffer) = value;
 #ifdef WITH_EXTERNAL_UI_SUPPORT
                 port->hints |= HINT_SHOULD_UPDATE;
 #endif
             }
-            if (effect->reset_index >= 0 && reset != 0)
-            {
-                port = effect->ports[effect->reset_index];
-                port->prev_value = *(port->buffer) = reset;
-            }
         }
     }
 
-    for (int i = 0; i < num_cached_effects; i++)
-        free(cached_effects[i].ports);
+    // all instances change in the same cycle, unless part of a bigger transaction
+    if (batch == g_sync_scheduled_staging)
+        SyncScheduledCommit();
 
-    free(cached_effects);
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
 
     return SUCCESS;
 }
@@ -7774,21 +10764,8 @@ int effects_monitor_output_parameter(int effect_id, const char *control_symbol_o
         port->hints |= HINT_MONITORED;
 
         // simulate an output monitor event here, to report current value
-        postponed_event_list_data* const posteventptr = rtsafe_memory_pool_allocate_atomic(g_rtsafe_mem_pool);
-
-        if (posteventptr != NULL)
-        {
-            posteventptr->event.type = POSTPONED_OUTPUT_MONITOR;
-            posteventptr->event.parameter.effect_id = effect->instance;
-            posteventptr->event.parameter.symbol    = port->symbol;
-            posteventptr->event.parameter.value     = port->prev_value;
-
-            pthread_mutex_lock(&g_rtsafe_mutex);
-            list_add_tail(&posteventptr->siblings, &g_rtsafe_list);
-            pthread_mutex_unlock(&g_rtsafe_mutex);
-
+        if (FeedbackSlotSet(effect, port, FEEDBACK_SLOT_OUTPUT_SET, port->prev_value))
             sem_post(&g_postevents_semaphore);
-        }
     }
     else
     {
@@ -7814,17 +10791,79 @@ int effects_bypass(int effect_id, int value)
     }
 
     effect_t *effect = &g_effects[effect_id];
-    effect->bypass_port.prev_value = effect->bypass = value ? 1.0f : 0.0f;
+
+    if (! TxnStage(effect_id, &effect->bypass_port, value ? 1.0f : 0.0f))
+        effect->bypass_port.prev_value = effect->bypass = value ? 1.0f : 0.0f;
 
     if (effect->enabled_index >= 0)
     {
         port_t *port = effect->ports[effect->enabled_index];
-        port->prev_value = *port->buffer = value ? 0.0f : 1.0f;
+
+        if (! TxnStage(effect_id, port, value ? 0.0f : 1.0f))
+            port->prev_value = *port->buffer = value ? 0.0f : 1.0f;
     }
 
     return SUCCESS;
 }
 
+int effects_bypass_policy(int effect_id, int policy)
+{
+    if (!InstanceExist(effect_id))
+        return ERR_INSTANCE_NON_EXISTS;
+
+    switch (policy)
+    {
+    case BYPASS_POLICY_RUN_SILENT:
+    case BYPASS_POLICY_SKIP:
+    case BYPASS_POLICY_SKIP_AFTER_TAIL:
+        break;
+    default:
+        return ERR_INVALID_OPERATION;
+    }
+
+    effect_t *effect = &g_effects[effect_id];
+    effect->bypass_tail_done = false;
+    effect->bypass_policy = (BypassPolicy)policy;
+
+    return SUCCESS;
+}
+
+int effects_silence_sleep(int effect_id, int tail_ms)
+{
+    if (!InstanceExist(effect_id))
+        return ERR_INSTANCE_NON_EXISTS;
+
+    effect_t *effect = &g_effects[effect_id];
+
+    // disable first, so the audio thread never sees a partial update
+    effect->sleep_tail_frames = -1;
+    effect->silent_frames = 0;
+    effect->sleeping = false;
+
+    if (tail_ms >= 0)
+        effect->sleep_tail_frames = (int32_t)((int64_t)tail_ms * g_sample_rate / 1000);
+
+    return SUCCESS;
+}
+
+int effects_sleep_stats(int effect_id, int *sleeping, float *sleep_ratio, uint32_t *wakeups)
+{
+    if (!InstanceExist(effect_id))
+        return ERR_INSTANCE_NON_EXISTS;
+
+    effect_t *effect = &g_effects[effect_id];
+
+    // cycles spent asleep over all cycles with sleep enabled, since the last call
+    const uint32_t cycles = __atomic_exchange_n(&effect->sleep_cycles, 0, __ATOMIC_RELAXED);
+    const uint32_t total_cycles = __atomic_exchange_n(&effect->sleep_total_cycles, 0, __ATOMIC_RELAXED);
+
+    *sleeping = effect->sleeping ? 1 : 0;
+    *sleep_ratio = total_cycles != 0 ? (float)cycles / (float)total_cycles : 0.f;
+    *wakeups = __atomic_exchange_n(&effect->sleep_wakeups, 0, __ATOMIC_RELAXED);
+
+    return SUCCESS;
+}
+
 int effects_bypass_multi(int value, int num_effects, int *effects)
 {
     if (num_effects <= 0)
@@ -7835,22 +10874,36 @@ int effects_bypass_multi(int value, int num_effects, int *effects)
     float bypass_value = value ? 1.0f : 0.0f;
     float enabled_value = value ? 0.0f : 1.0f;
 
+    pthread_mutex_lock(&g_sync_scheduled_lock);
+
+    sync_scheduled_batch_t *const batch = TxnBatch();
+
     for (int i = 0, effect_id; i < num_effects; i++)
     {
         effect_id = effects[i];
         if (InstanceExist(effect_id))
         {
             effect = &g_effects[effect_id];
-            effect->bypass_port.prev_value = bypass_value;
+
+            if (! SyncScheduledStage(batch, effect_id, &effect->bypass_port, bypass_value))
+                effect->bypass_port.prev_value = effect->bypass = bypass_value;
 
             if (effect->enabled_index >= 0)
             {
                 port = effect->ports[effect->enabled_index];
-                port->prev_value = *port->buffer = enabled_value;
+
+                if (! SyncScheduledStage(batch, effect_id, port, enabled_value))
+                    port->prev_value = *port->buffer = enabled_value;
             }
         }
     }
 
+    // all instances change in the same cycle, unless part of a bigger transaction
+    if (batch == g_sync_scheduled_staging)
+        SyncScheduledCommit();
+
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
+
     return SUCCESS;
 }
 
@@ -7943,7 +10996,6 @@ int effects_get_parameter_info(int effect_id, const char *control_symbol, float
 
                 scale_points[j++] = NULL;
                 scale_points[j] = NULL;
-                lilv_scale_points_free(points);
             }
             else
             {
@@ -8542,7 +11594,24 @@ int effects_cv_map(int effect_id, const char *control_symbol, const char *source
         return ERR_INVALID_OPERATION;
     }
 
-    jack_port_t *source_jack_port = jack_port_by_name(g_jack_global_client, source_port_name);
+    // in-process effect ports need a jack port to be used as cv source
+    const char *source_jack_port_name = source_port_name;
+
+    if (g_graph_engine_enabled)
+    {
+        effect_t *source_effect;
+        port_t *source_port = GraphFindPort(source_port_name, &source_effect);
+
+        if (source_port != NULL)
+        {
+            jack_port_t *jack_port = GraphEnsureJackPort(source_effect, source_port);
+            if (jack_port == NULL)
+                return ERR_JACK_PORT_REGISTER;
+            source_jack_port_name = jack_port_name(jack_port);
+        }
+    }
+
+    jack_port_t *source_jack_port = jack_port_by_name(g_jack_global_client, source_jack_port_name);
 
     // FIXME proper error code
     if (!source_jack_port)
@@ -8582,10 +11651,10 @@ int effects_cv_map(int effect_id, const char *control_symbol, const char *source
         if (!cv_source)
             return ERR_MEMORY_ALLOCATION;
 
-        jack_port = jack_port_register(effect->jack_client,
-                                       port->symbol,
-                                       JACK_DEFAULT_AUDIO_TYPE,
-                                       JackPortIsInput|JackPortIsControlVoltage, 0);
+        jack_port = RegisterEffectJackPort(effect,
+                                           port->symbol,
+                                           JACK_DEFAULT_AUDIO_TYPE,
+                                           JackPortIsInput|JackPortIsControlVoltage);
 
         if (!jack_port) {
             free(cv_source);
@@ -8743,7 +11812,7 @@ int effects_cv_map(int effect_id, const char *control_symbol, const char *source
     port->cv_source = cv_source;
     pthread_mutex_unlock(&port->cv_source_mutex);
 
-    jack_connect(effect->jack_client, source_port_name, jack_port_name(jack_port));
+    jack_connect(effect->jack_client, source_jack_port_name, jack_port_name(jack_port));
 
     if (cv_source_to_delete)
         free(cv_source_to_delete);
@@ -8782,6 +11851,9 @@ int effects_cv_unmap(int effect_id, const char *control_symbol)
 
     free(cv_source);
 
+    if (g_graph_engine_enabled)
+        GraphReleaseUnusedJackPorts();
+
     return SUCCESS;
 }
 
@@ -8942,6 +12014,59 @@ float effects_jack_cpu_load(void)
     return jack_cpu_load(g_jack_global_client);
 }
 
+int effects_graph_parallelism(float *average, float *maximum, int *threads)
+{
+    if (!g_graph_engine_enabled)
+        return ERR_INVALID_OPERATION;
+
+    // busy time of all threads over time spent running the graph, since the last call
+    // read and reset in one go, so no cycle is lost or counted twice
+    const uint64_t busy_ns = __atomic_exchange_n(&g_graph_stats_busy_ns, 0, __ATOMIC_RELAXED);
+    const uint64_t wall_ns = __atomic_exchange_n(&g_graph_stats_wall_ns, 0, __ATOMIC_RELAXED);
+    float zero = 0.f;
+
+    *average = wall_ns != 0 ? (float)((double)busy_ns / (double)wall_ns) : 0.f;
+    __atomic_exchange(&g_graph_stats_max_parallelism, &zero, maximum, __ATOMIC_RELAXED);
+    *threads = (int)g_graph_workers_count + 1;
+
+    __atomic_store_n(&g_graph_stats_cycles, 0, __ATOMIC_RELAXED);
+
+    return SUCCESS;
+}
+
+int effects_plugin_load(int effect_id, plugin_load_t *load)
+{
+    if (!InstanceExist(effect_id))
+        return ERR_INSTANCE_NON_EXISTS;
+
+    effect_t *effect = &g_effects[effect_id];
+
+    load->average = effect->load_average;
+    load->maximum = effect->load_maximum;
+
+    for (uint32_t i = 0; i < PLUGIN_LOAD_HISTOGRAM_SIZE; i++)
+        load->histogram[i] = effect->load_histogram[i];
+
+    // maximum and histogram are per call, the audio thread resets them on its next cycle
+    effect->load_reset = true;
+
+    return SUCCESS;
+}
+
+void effects_rtsafe_queue_stats(uint32_t *drops, uint32_t *contention, uint32_t *pool_size, uint32_t *pool_high_water)
+{
+    RtMemPool_Stats stats;
+    rtsafe_memory_pool_get_stats(g_rtsafe_mem_pool, &stats);
+
+    // since the last call
+    *drops = __atomic_exchange_n(&g_rtsafe_drops, 0, __ATOMIC_RELAXED);
+    *contention = __atomic_exchange_n(&g_rtsafe_contention, 0, __ATOMIC_RELAXED);
+
+    // since startup
+    *pool_size = stats.size;
+    *pool_high_water = stats.highWater;
+}
+
 float effects_jack_max_cpu_load(void)
 {
 #ifdef HAVE_JACK2_1_9_23
@@ -8978,6 +12103,8 @@ void effects_bundle_add(const char* bpath)
     // convert bundle string into a lilv node
     LilvNode* bundlenode = lilv_new_file_uri(g_lv2_data, NULL, bundlepath);
 
+    pthread_mutex_lock(&g_lilv_mutex);
+
     // load the bundle
     lilv_world_load_bundle(g_lv2_data, bundlenode);
 
@@ -8986,6 +12113,12 @@ void effects_bundle_add(const char* bpath)
 
     // refresh plugins
     g_plugins = lilv_world_get_all_plugins(g_lv2_data);
+
+    // new bundles may add presets to known plugins
+    PluginDescriptorsInvalidate();
+
+    plugin_cache_bundle_added(g_lv2_data, bundlepath);
+    pthread_mutex_unlock(&g_lilv_mutex);
 #else
     UNUSED_PARAM(bpath);
 #endif
@@ -9013,6 +12146,8 @@ void effects_bundle_remove(const char *bpath, const char *resource)
         }
     }
 
+    pthread_mutex_lock(&g_lilv_mutex);
+
     // unload resource if requested
     if (resource != NULL && resource[0] != '\0')
     {
@@ -9035,6 +12170,11 @@ void effects_bundle_remove(const char *bpath, const char *resource)
 
     // refresh plugins
     g_plugins = lilv_world_get_all_plugins(g_lv2_data);
+
+    PluginDescriptorsInvalidate();
+
+    plugin_cache_bundle_removed(bundlepath);
+    pthread_mutex_unlock(&g_lilv_mutex);
 #else
     UNUSED_PARAM(bpath);
 #endif
@@ -9372,6 +12512,53 @@ int effects_cpu_load_enable(int enable)
     return SUCCESS;
 }
 
+int effects_plugin_load_enable(int enable)
+{
+    if (g_jack_global_client == NULL)
+        return ERR_INVALID_OPERATION;
+
+    g_plugin_load_enabled = enable != 0;
+    effects_output_data_ready();
+    return SUCCESS;
+}
+
+int effects_feedback_shm_enable(int enable)
+{
+#ifdef WITH_FEEDBACK_SHM
+    feedback_shm_data *const requested = __atomic_load_n(&g_feedback_shm_requested, __ATOMIC_ACQUIRE);
+
+    if ((requested != NULL) == (enable != 0))
+        return SUCCESS;
+
+    // the feedback thread has not picked up the previous change yet
+    if (requested != __atomic_load_n(&g_feedback_shm, __ATOMIC_ACQUIRE))
+        return ERR_INVALID_OPERATION;
+
+    if (enable)
+    {
+        feedback_shm_data *data;
+        int shmfd;
+
+        if (! feedback_shm_create(&shmfd, &data))
+            return ERR_MEMORY_ALLOCATION;
+
+        g_feedback_shm_requested_fd = shmfd;
+        __atomic_store_n(&g_feedback_shm_requested, data, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        __atomic_store_n(&g_feedback_shm_requested, NULL, __ATOMIC_RELEASE);
+    }
+
+    effects_output_data_ready();
+    return SUCCESS;
+#else
+    return ERR_INVALID_OPERATION;
+
+    UNUSED_PARAM(enable);
+#endif
+}
+
 int effects_freewheeling_enable(int enable)
 {
     if (g_jack_global_client == NULL)
@@ -9438,6 +12625,68 @@ int effects_processing_enable(int enable)
     return SUCCESS;
 }
 
+int effects_zero_copy_enable(int enable)
+{
+    g_zero_copy_enabled = enable != 0;
+    return SUCCESS;
+}
+
+uint32_t effects_zero_copy_bytes(void)
+{
+    uint32_t bytes = 0;
+
+    for (int i = 0; i < MAX_INSTANCES; i++)
+    {
+        if (i != GLOBAL_EFFECT_ID && InstanceExist(i) && g_effects[i].jack_activated)
+            bytes += g_effects[i].zero_copy_bytes;
+    }
+
+    return bytes;
+}
+
+int effects_graph_engine_enable(int enable)
+{
+    if (g_jack_global_client == NULL)
+        return ERR_INVALID_OPERATION;
+
+    if ((enable != 0) == g_graph_engine_enabled)
+        return SUCCESS;
+
+    // effects cannot move between own clients and the global one, only switch while empty
+    for (int i = 0; i < MAX_INSTANCES; ++i)
+    {
+        if (i != GLOBAL_EFFECT_ID && InstanceExist(i))
+            return ERR_INVALID_OPERATION;
+    }
+
+    if (enable)
+    {
+        g_graph_silence = (float *) mod_calloc(g_sample_rate, sizeof(float));
+        if (!g_graph_silence)
+            return ERR_MEMORY_ALLOCATION;
+
+        GraphStartWorkers();
+
+        g_graph_engine_enabled = true;
+        GraphRebuild();
+    }
+    else
+    {
+        g_graph_engine_enabled = false;
+        GraphRebuild();
+        GraphStopWorkers();
+
+        free(g_graph_edges);
+        g_graph_edges = NULL;
+        g_graph_edges_count = 0;
+
+        free(g_graph_silence);
+        g_graph_silence = NULL;
+    }
+
+    return SUCCESS;
+}
+
 int effects_monitor_audio_levels(const char *source_port_name, int enable)
 {
     if (g_jack_global_client == NULL)
@@ -9473,7 +12722,24 @@ int effects_monitor_audio_levels(const char *source_port_name, int enable)
 
         snprintf(port_name, sizeof(port_name) - 1, "%s:monitor_%d",
                  jack_get_client_name(g_jack_global_client), g_audio_monitor_count + 1);
-        jack_connect(g_jack_global_client, source_port_name, port_name);
+
+        // in-process effect outputs need a jack port to be monitored
+        const char *source_jack_port_name = source_port_name;
+
+        if (g_graph_engine_enabled)
+        {
+            effect_t *source_effect;
+            port_t *source_port = GraphFindPort(source_port_name, &source_effect);
+
+            if (source_port != NULL)
+            {
+                jack_port_t *source_jack_port = GraphEnsureJackPort(source_effect, source_port);
+                if (source_jack_port != NULL)
+                    source_jack_port_name = jack_port_name(source_jack_port);
+            }
+        }
+
+        jack_connect(g_jack_global_client, source_jack_port_name, port_name);
 
         monitor->port = port;
         monitor->source_port_name = strdup(source_port_name);
@@ -9498,6 +12764,9 @@ int effects_monitor_audio_levels(const char *source_port_name, int enable)
         jack_port_unregister(g_jack_global_client, monitor->port);
         free(monitor->source_port_name);
 
+        if (g_graph_engine_enabled)
+            GraphReleaseUnusedJackPorts();
+
         if (g_audio_monitor_count == 0)
         {
             free(g_audio_monitors);
@@ -9637,29 +12906,100 @@ int effects_transport_sync_mode(const char* mode)
 
 void effect_sync_scheduled_params(int realtime)
 {
-    port_t *port;
+    int32_t state = SYNC_SCHEDULED_PENDING;
+
+    if (__atomic_compare_exchange_n(&g_sync_scheduled_state, &state, SYNC_SCHEDULED_APPLYING, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        SyncScheduledApply(g_sync_scheduled_pending);
+        __atomic_store_n(&g_sync_scheduled_state, SYNC_SCHEDULED_IDLE, __ATOMIC_RELEASE);
+        return;
+    }
 
     if (realtime != 0)
+        return;
+
+    // some other thread is applying, make sure it is done before returning
+    while (__atomic_load_n(&g_sync_scheduled_state, __ATOMIC_ACQUIRE) == SYNC_SCHEDULED_APPLYING)
+        sched_yield();
+}
+
+int effects_txn_begin(void)
+{
+    const int client = protocol_current_sender();
+    int ret = ERR_INVALID_OPERATION;
+
+    if (client < 0)
+        return ERR_INVALID_OPERATION;
+
+    pthread_mutex_lock(&g_sync_scheduled_lock);
+
+    if (TxnFind(client) == NULL)
     {
-        if (pthread_mutex_trylock(&g_sync_scheduled_params_mutex) != 0)
-            return;
+        for (int i = 0; i < MAX_TRANSACTIONS; i++)
+        {
+            if (g_txns[i].client < 0)
+            {
+                g_txns[i].client = client;
+                __atomic_add_fetch(&g_txns_open, 1, __ATOMIC_RELEASE);
+                ret = SUCCESS;
+                break;
+            }
+        }
     }
-    else
+
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
+    return ret;
+}
+
+int effects_txn_commit(void)
+{
+    pthread_mutex_lock(&g_sync_scheduled_lock);
+
+    sync_scheduled_txn_t *const txn = TxnFind(protocol_current_sender());
+
+    if (txn == NULL)
     {
-        pthread_mutex_lock(&g_sync_scheduled_params_mutex);
+        pthread_mutex_unlock(&g_sync_scheduled_lock);
+        return ERR_INVALID_OPERATION;
     }
 
-    for (unsigned int i = 0; i < g_sync_scheduled_param_count; i++)
+    sync_scheduled_batch_t *const staging = g_sync_scheduled_staging;
+
+    if (SyncScheduledReserve(staging, txn->batch.count))
     {
-        port = g_sync_scheduled_params[i].port;
-        port->prev_value = *port->buffer = g_sync_scheduled_params[i].value;
-#ifdef WITH_EXTERNAL_UI_SUPPORT
-        port->hints |= HINT_SHOULD_UPDATE;
-#endif
+        memcpy(staging->params + staging->count, txn->batch.params, sizeof(sync_scheduled_param_t) * txn->batch.count);
+        staging->count += txn->batch.count;
+        SyncScheduledCommit();
+    }
+    else
+    {
+        // out of memory, trigger param changes now
+        SyncScheduledApply(&txn->batch);
     }
 
-    g_sync_scheduled_param_count = 0;
-    pthread_mutex_unlock(&g_sync_scheduled_params_mutex);
+    TxnClose(txn);
+
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
+    return SUCCESS;
+}
+
+int effects_txn_abort(void)
+{
+    return effects_txn_abort_client(protocol_current_sender());
+}
+
+int effects_txn_abort_client(int client)
+{
+    pthread_mutex_lock(&g_sync_scheduled_lock);
+
+    sync_scheduled_txn_t *const txn = TxnFind(client);
+
+    if (txn != NULL)
+        TxnClose(txn);
+
+    pthread_mutex_unlock(&g_sync_scheduled_lock);
+    return txn != NULL ? SUCCESS : ERR_INVALID_OPERATION;
 }
 
 void effects_output_data_ready(void)
@@ -84,6 +84,13 @@ typedef enum {
     LOG_ERROR = 3
 } LogType;
 
+/* Bypass policies, for effects without a lv2:enabled port */
+typedef enum {
+    BYPASS_POLICY_RUN_SILENT = 0,
+    BYPASS_POLICY_SKIP = 1,
+    BYPASS_POLICY_SKIP_AFTER_TAIL = 2
+} BypassPolicy;
+
 /*
 ************************************************************************************************************************
 *           CONFIGURATION DEFINES
@@ -97,7 +104,11 @@ typedef enum {
 #define MAX_POSTPONED_EVENTS    8192
 #define MAX_HMI_ADDRESSINGS     128
 
-#define MAX_SYNC_SCHEDULED_PARAMS 512
+// must fit in the 16 index bits of a param handle
+#define MAX_PARAM_HANDLES       65536
+
+// buckets of the per-plugin dsp load histogram
+#define PLUGIN_LOAD_HISTOGRAM_SIZE 8
 
 // used for local stack variables
 #define MAX_CHAR_BUF_SIZE       255
@@ -119,6 +130,12 @@ typedef struct {
     float value;
 } flushed_param_t;
 
+typedef struct {
+    float average;
+    float maximum;
+    uint32_t histogram[PLUGIN_LOAD_HISTOGRAM_SIZE];
+} plugin_load_t;
+
 
 /*
 ************************************************************************************************************************
@@ -143,7 +160,7 @@ typedef struct {
 int effects_init(void* client);
 int effects_finish(int close_client);
 int effects_add(const char *uri, int instance, int activate);
-int effects_add_multi(int activate, int num_effects, int *effects, const char *const *uris);
+int effects_add_multi(int activate, int num_effects, int *effects, const char *const *uris, int *results);
 int effects_remove(int effect_id);
 int effects_remove_multi(int num_effects, int *effects);
 int effects_activate(int effect_id, int value);
@@ -157,6 +174,8 @@ int effects_disconnect(const char *portA, const char *portB, int check);
 int effects_disconnect_all(const char *port);
 int effects_set_parameter(int effect_id, const char *control_symbol, float value);
 int effects_set_parameter_multi(const char *control_symbol, float value, int num_effects, int *effects);
+int effects_get_parameter_handle(int effect_id, const char *control_symbol);
+int effects_set_parameter_handle(int handle, float value);
 int effects_get_parameter(int effect_id, const char *control_symbol, float *value);
 int effects_flush_parameters(int effect_id, int reset, int param_count, const flushed_param_t *params);
 int effects_flush_parameters_multi(int reset, int param_count, const flushed_param_t *params, int num_effects, int *effects);
@@ -167,6 +186,9 @@ int effects_get_property(int effect_id, const char *uri);
 int effects_monitor_parameter(int effect_id, const char *control_symbol, const char *op, float value);
 int effects_monitor_output_parameter(int effect_id, const char *control_symbol, int enable);
 int effects_bypass(int effect_id, int value);
+int effects_bypass_policy(int effect_id, int policy);
+int effects_silence_sleep(int effect_id, int tail_ms);
+int effects_sleep_stats(int effect_id, int *sleeping, float *sleep_ratio, uint32_t *wakeups);
 int effects_bypass_multi(int value, int num_effects, int *effects);
 int effects_get_parameter_symbols(int effect_id, int output_ports, const char** symbols);
 int effects_get_presets_uris(int effect_id, const char **uris);
@@ -193,6 +215,9 @@ int effects_hmi_unmap(int effect_id, const char *control_symbol);
 
 float effects_jack_cpu_load(void);
 float effects_jack_max_cpu_load(void);
+int effects_plugin_load(int effect_id, plugin_load_t *load);
+void effects_rtsafe_queue_stats(uint32_t *drops, uint32_t *contention, uint32_t *pool_size, uint32_t *pool_high_water);
+int effects_graph_parallelism(float *average, float *maximum, int *threads);
 void effects_bundle_add(const char *bundlepath);
 void effects_bundle_remove(const char *bundlepath, const char *resource);
 int effects_state_load(const char *dir);
@@ -200,14 +225,23 @@ int effects_state_save(const char *dir);
 int effects_state_set_tmpdir(const char *dir);
 int effects_aggregated_midi_enable(int enable);
 int effects_cpu_load_enable(int enable);
+int effects_plugin_load_enable(int enable);
+int effects_feedback_shm_enable(int enable);
 int effects_freewheeling_enable(int enable);
 int effects_processing_enable(int enable);
+int effects_graph_engine_enable(int enable);
+int effects_zero_copy_enable(int enable);
+uint32_t effects_zero_copy_bytes(void);
 int effects_monitor_audio_levels(const char *source_port_name, int enable);
 int effects_monitor_midi_control(int channel, int enable);
 int effects_monitor_midi_program(int channel, int enable);
 void effects_transport(int rolling, double beats_per_bar, double beats_per_minute);
 int effects_transport_sync_mode(const char *mode);
 void effect_sync_scheduled_params(int realtime);
+int effects_txn_begin(void);
+int effects_txn_commit(void);
+int effects_txn_abort(void);
+int effects_txn_abort_client(int client);
 void effects_output_data_ready(void);
 int effects_show_external_ui(int effect_id);
 void effects_idle_external_uis(void);
@@ -0,0 +1,251 @@
+/*
+ * This file is part of mod-host.
+ *
+ * mod-host is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mod-host is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mod-host.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Shared memory feedback channel, used after "feature_enable feedback-shm 1".
+ *
+ * mod-host is the single writer and the UI server the single reader of a ring of binary feedback records, the same
+ * as described in binary-feedback.h. Records are never split, if one does not fit it is dropped and counted.
+ * The semaphore is posted once after each batch of records, readers should drain everything before waiting again.
+ *
+ * Reader side usage:
+ *
+ *   feedback_shm_data* data;
+ *   int shmfd;
+ *   if (feedback_shm_attach(&shmfd, &data)) {
+ *       binary_feedback_record_t record;
+ *       static uint8_t payload[FEEDBACK_SHM_DATA_SIZE];
+ *       while (running) {
+ *           feedback_shm_wait(data, 1);
+ *           while (feedback_shm_read(data, &record, payload))
+ *               handle(&record, payload);
+ *       }
+ *       feedback_shm_close(shmfd, data, false);
+ *   }
+ */
+
+#pragma once
+
+#define FEEDBACK_SHM "/mod-host-feedback"
+
+#include "binary-feedback.h"
+#include "mod-semaphore.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// must be a power of 2
+#define FEEDBACK_SHM_DATA_SIZE (256 * 1024)
+
+typedef struct {
+    // posted by the writer after each batch
+    sem_t sem;
+    // free-running byte counters, head only changes on the writer side and tail on the reader side
+    uint32_t head, tail;
+    // records that did not fit, only changes on the writer side
+    uint32_t dropped;
+    // BINARY_FEEDBACK_VERSION
+    uint32_t version;
+    // actual data buffer
+    uint8_t buffer[FEEDBACK_SHM_DATA_SIZE];
+} feedback_shm_data;
+
+static inline
+bool feedback_shm_map(int fd, feedback_shm_data** data)
+{
+    feedback_shm_data* const ptr = (feedback_shm_data*)mmap(NULL,
+                                                            sizeof(feedback_shm_data),
+                                                            PROT_READ|PROT_WRITE,
+                                                            MAP_SHARED|MAP_LOCKED,
+                                                            fd,
+                                                            0);
+
+    if (ptr == NULL || ptr == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap failed\n");
+        return false;
+    }
+
+    *data = ptr;
+    return true;
+}
+
+// writer side, creates a new channel
+static inline
+bool feedback_shm_create(int* shmfd, feedback_shm_data** data)
+{
+    // always unlink in case of a previous crash
+    shm_unlink(FEEDBACK_SHM);
+
+    const int fd = shm_open(FEEDBACK_SHM, O_CREAT|O_EXCL|O_RDWR, 0600);
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "shm_open failed\n");
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(feedback_shm_data)) != 0)
+    {
+        fprintf(stderr, "ftruncate failed\n");
+        goto cleanup;
+    }
+
+    if (! feedback_shm_map(fd, data))
+        goto cleanup;
+
+    memset(*data, 0, sizeof(feedback_shm_data));
+    (*data)->version = BINARY_FEEDBACK_VERSION;
+
+    if (sem_init(&(*data)->sem, 1, 0) != 0)
+    {
+        fprintf(stderr, "sem_init failed\n");
+        munmap(*data, sizeof(feedback_shm_data));
+        goto cleanup;
+    }
+
+    *shmfd = fd;
+    return true;
+
+cleanup:
+    close(fd);
+    shm_unlink(FEEDBACK_SHM);
+
+    *shmfd = 0;
+    *data = NULL;
+    return false;
+}
+
+// reader side, attaches to the channel created by mod-host
+static inline
+bool feedback_shm_attach(int* shmfd, feedback_shm_data** data)
+{
+    const int fd = shm_open(FEEDBACK_SHM, O_RDWR, 0);
+
+    *data = NULL;
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "shm_open failed\n");
+        return false;
+    }
+
+    if (! feedback_shm_map(fd, data) || (*data)->version != BINARY_FEEDBACK_VERSION)
+    {
+        if (*data != NULL)
+            munmap(*data, sizeof(feedback_shm_data));
+
+        close(fd);
+        *shmfd = 0;
+        *data = NULL;
+        return false;
+    }
+
+    *shmfd = fd;
+    return true;
+}
+
+static inline
+void feedback_shm_close(int shmfd, feedback_shm_data* data, bool unlink)
+{
+    if (unlink)
+        sem_destroy(&data->sem);
+
+    munmap(data, sizeof(feedback_shm_data));
+    close(shmfd);
+
+    if (unlink)
+        shm_unlink(FEEDBACK_SHM);
+}
+
+static inline
+void feedback_shm_copy_in(feedback_shm_data* const data, uint32_t pos, const void* src, uint32_t size)
+{
+    const uint32_t offset = pos & (FEEDBACK_SHM_DATA_SIZE - 1);
+    const uint32_t first = size < FEEDBACK_SHM_DATA_SIZE - offset ? size : FEEDBACK_SHM_DATA_SIZE - offset;
+
+    memcpy(data->buffer + offset, src, first);
+    memcpy(data->buffer, (const uint8_t*)src + first, size - first);
+}
+
+static inline
+void feedback_shm_copy_out(const feedback_shm_data* const data, uint32_t pos, void* dst, uint32_t size)
+{
+    const uint32_t offset = pos & (FEEDBACK_SHM_DATA_SIZE - 1);
+    const uint32_t first = size < FEEDBACK_SHM_DATA_SIZE - offset ? size : FEEDBACK_SHM_DATA_SIZE - offset;
+
+    memcpy(dst, data->buffer + offset, first);
+    memcpy((uint8_t*)dst + first, data->buffer, size - first);
+}
+
+// writer side, single thread only, the record and its payload are written as a whole or not at all
+static inline
+bool feedback_shm_write(feedback_shm_data* const data,
+                        const binary_feedback_record_t* const record,
+                        const void* const payload)
+{
+    const uint32_t size = sizeof(binary_feedback_record_t) + record->size;
+    const uint32_t head = data->head;
+    const uint32_t tail = __atomic_load_n(&data->tail, __ATOMIC_ACQUIRE);
+
+    if (size > FEEDBACK_SHM_DATA_SIZE - (head - tail))
+    {
+        __atomic_store_n(&data->dropped, data->dropped + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    feedback_shm_copy_in(data, head, record, sizeof(binary_feedback_record_t));
+
+    if (record->size != 0 && payload != NULL)
+        feedback_shm_copy_in(data, head + sizeof(binary_feedback_record_t), payload, record->size);
+
+    __atomic_store_n(&data->head, head + size, __ATOMIC_RELEASE);
+    return true;
+}
+
+// reader side, single thread only
+// payload must have room for FEEDBACK_SHM_DATA_SIZE bytes, or be NULL to skip payloads
+static inline
+bool feedback_shm_read(feedback_shm_data* const data, binary_feedback_record_t* const record, void* const payload)
+{
+    const uint32_t tail = data->tail;
+    const uint32_t head = __atomic_load_n(&data->head, __ATOMIC_ACQUIRE);
+
+    if (head - tail < sizeof(binary_feedback_record_t))
+        return false;
+
+    feedback_shm_copy_out(data, tail, record, sizeof(binary_feedback_record_t));
+
+    if (payload != NULL && record->size != 0)
+        feedback_shm_copy_out(data, tail + sizeof(binary_feedback_record_t), payload, record->size);
+
+    __atomic_store_n(&data->tail, tail + sizeof(binary_feedback_record_t) + record->size, __ATOMIC_RELEASE);
+    return true;
+}
+
+// reader side, 0 = ok
+static inline
+int feedback_shm_wait(feedback_shm_data* const data, int secs)
+{
+    return sem_timedwait_secs(&data->sem, secs);
+}
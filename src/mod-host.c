@@ -246,6 +246,49 @@ static void effects_bypass_cb(proto_t *proto)
     protocol_response_int(resp, proto);
 }
 
+static void effects_bypass_policy_cb(proto_t *proto)
+{
+    const char *policy = proto->list[2];
+    int resp;
+
+    if (!strcmp(policy, "run-silent"))
+        resp = effects_bypass_policy(atoi(proto->list[1]), BYPASS_POLICY_RUN_SILENT);
+    else if (!strcmp(policy, "skip"))
+        resp = effects_bypass_policy(atoi(proto->list[1]), BYPASS_POLICY_SKIP);
+    else if (!strcmp(policy, "skip-after-tail"))
+        resp = effects_bypass_policy(atoi(proto->list[1]), BYPASS_POLICY_SKIP_AFTER_TAIL);
+    else
+        resp = ERR_INVALID_OPERATION;
+
+    protocol_response_int(resp, proto);
+}
+
+static void effects_silence_sleep_cb(proto_t *proto)
+{
+    int resp;
+    resp = effects_silence_sleep(atoi(proto->list[1]), atoi(proto->list[2]));
+    protocol_response_int(resp, proto);
+}
+
+static void effects_sleep_stats_cb(proto_t *proto)
+{
+    int sleeping;
+    float sleep_ratio;
+    uint32_t wakeups;
+    const int resp = effects_sleep_stats(atoi(proto->list[1]), &sleeping, &sleep_ratio, &wakeups);
+
+    if (resp != SUCCESS)
+    {
+        protocol_response_int(resp, proto);
+        return;
+    }
+
+    char buffer[128];
+    sprintf(buffer, "resp 0 %i %.04f %u", sleeping, sleep_ratio, wakeups);
+
+    protocol_response(buffer, proto);
+}
+
 static void effects_set_param_cb(proto_t *proto)
 {
     int resp;
@@ -253,6 +296,41 @@ static void effects_set_param_cb(proto_t *proto)
     protocol_response_int(resp, proto);
 }
 
+static void effects_param_handle_cb(proto_t *proto)
+{
+    int resp;
+    resp = effects_get_parameter_handle(atoi(proto->list[1]), proto->list[2]);
+    protocol_response_int(resp, proto);
+}
+
+static void effects_set_param_handle_cb(proto_t *proto)
+{
+    int resp;
+    resp = effects_set_parameter_handle(atoi(proto->list[1]), atof(proto->list[2]));
+    protocol_response_int(resp, proto);
+}
+
+static void effects_set_param_handles_cb(proto_t *proto)
+{
+    if ((proto->list_count - 1) % 2 != 0)
+    {
+        protocol_response_int(ERR_ASSIGNMENT_INVALID_OP, proto);
+        return;
+    }
+
+    // set every valid handle, reply with the last error if any was not
+    int resp = SUCCESS, ret;
+
+    for (uint32_t i = 1; i < proto->list_count; i += 2)
+    {
+        ret = effects_set_parameter_handle(atoi(proto->list[i]), atof(proto->list[i + 1]));
+        if (ret != SUCCESS)
+            resp = ret;
+    }
+
+    protocol_response_int(resp, proto);
+}
+
 static void effects_get_param_cb(proto_t *proto)
 {
     int resp;
@@ -403,7 +481,8 @@ static void monitor_addr_set_cb(proto_t *proto)
 {
     int resp;
     if (atoi(proto->list[3]) == 1)
-        resp = monitor_start(proto->list[1], atoi(proto->list[2]));
+        resp = monitor_start(proto->list[1], atoi(proto->list[2]),
+                             proto->list_count > 4 && strcmp(proto->list[4], "udp") == 0);
     else
         resp = monitor_stop();
 
@@ -597,6 +676,121 @@ static void max_cpu_load_cb(proto_t *proto)
     protocol_response(buffer, proto);
 }
 
+static void plugin_load_cb(proto_t *proto)
+{
+    const int instance = atoi(proto->list[1]);
+    plugin_load_t load;
+    char buffer[256];
+
+    if (instance >= 0)
+    {
+        const int resp = effects_plugin_load(instance, &load);
+
+        if (resp != SUCCESS)
+        {
+            protocol_response_int(resp, proto);
+            return;
+        }
+
+        snprintf(buffer, sizeof(buffer), "resp 0 %.04f %.04f %u %u %u %u %u %u %u %u",
+                 load.average, load.maximum,
+                 load.histogram[0], load.histogram[1], load.histogram[2], load.histogram[3],
+                 load.histogram[4], load.histogram[5], load.histogram[6], load.histogram[7]);
+        buffer[sizeof(buffer)-1] = '\0';
+        protocol_response(buffer, proto);
+        return;
+    }
+
+    // all instances, as a list of "instance average maximum"
+    size_t size = 256, used;
+    char *response = malloc(size);
+
+    if (response == NULL)
+    {
+        protocol_response_int(ERR_MEMORY_ALLOCATION, proto);
+        return;
+    }
+
+    used = (size_t)sprintf(response, "resp 0");
+
+    for (int i = 0; i < MAX_PLUGIN_INSTANCES; i++)
+    {
+        if (effects_plugin_load(i, &load) != SUCCESS)
+            continue;
+
+        const int len = snprintf(buffer, sizeof(buffer), " %i %.04f %.04f", i, load.average, load.maximum);
+
+        if (used + (size_t)len + 1 > size)
+        {
+            char *new_response = realloc(response, size * 2);
+
+            if (new_response == NULL)
+            {
+                free(response);
+                protocol_response_int(ERR_MEMORY_ALLOCATION, proto);
+                return;
+            }
+
+            response = new_response;
+            size *= 2;
+        }
+
+        memcpy(response + used, buffer, (size_t)len + 1);
+        used += (size_t)len;
+    }
+
+    protocol_response(response, proto);
+    free(response);
+}
+
+static void rt_queue_stats_cb(proto_t *proto)
+{
+    uint32_t drops, contention, pool_size, pool_high_water;
+    effects_rtsafe_queue_stats(&drops, &contention, &pool_size, &pool_high_water);
+
+    char buffer[128];
+    sprintf(buffer, "resp 0 %u %u %u %u", drops, contention, pool_size, pool_high_water);
+
+    protocol_response(buffer, proto);
+}
+
+static void feedback_stats_cb(proto_t *proto)
+{
+    uint32_t flushes, messages, bytes;
+    socket_feedback_stats(&flushes, &messages, &bytes);
+
+    char buffer[128];
+    sprintf(buffer, "resp 0 %u %u %u", flushes, messages, bytes);
+
+    protocol_response(buffer, proto);
+}
+
+static void zero_copy_bytes_cb(proto_t *proto)
+{
+    char buffer[128];
+    sprintf(buffer, "resp 0 %u", effects_zero_copy_bytes());
+
+    protocol_response(buffer, proto);
+}
+
+static void graph_parallelism_cb(proto_t *proto)
+{
+    float average, maximum;
+    int threads;
+    const int resp = effects_graph_parallelism(&average, &maximum, &threads);
+
+    if (resp != SUCCESS)
+    {
+        protocol_response_int(resp, proto);
+        return;
+    }
+
+    char buffer[128];
+    sprintf(buffer, "resp 0 %i %.04f %.04f", threads, average, maximum);
+
+    protocol_response(buffer, proto);
+}
+
 #ifndef SKIP_READLINE
 static void load_cb(proto_t *proto)
 {
@@ -691,10 +885,18 @@ static void feature_enable(proto_t *proto)
         resp = effects_aggregated_midi_enable(enabled);
     else if (!strcmp(feature, "cpu-load"))
         resp = effects_cpu_load_enable(enabled);
+    else if (!strcmp(feature, "plugin-load"))
+        resp = effects_plugin_load_enable(enabled);
+    else if (!strcmp(feature, "feedback-shm"))
+        resp = effects_feedback_shm_enable(enabled);
     else if (!strcmp(feature, "freewheeling"))
         resp = effects_freewheeling_enable(enabled);
     else if (!strcmp(feature, "processing"))
         resp = effects_processing_enable(enabled);
+    else if (!strcmp(feature, "graph-engine"))
+        resp = effects_graph_engine_enable(enabled);
+    else if (!strcmp(feature, "zero-copy"))
+        resp = effects_zero_copy_enable(enabled);
     else
         resp = ERR_INVALID_OPERATION;
 
@@ -726,6 +928,31 @@ static void output_data_ready(proto_t *proto)
     protocol_response("resp 0", proto);
 }
 
+// "resp <first error or 0>", followed by the result of each instance if the command ends with "results"
+static void multi_add_response(int resp, const int *results, int instance_count, proto_t *proto)
+{
+    const uint32_t results_index = 2 + (uint32_t)instance_count * 2;
+    if (proto->list_count <= results_index || strcmp(proto->list[results_index], "results") != 0)
+    {
+        protocol_response_int(resp, proto);
+        return;
+    }
+
+    char *buffer = malloc(16 + instance_count * 12);
+    if (buffer == NULL)
+    {
+        protocol_response_int(resp, proto);
+        return;
+    }
+
+    int len = sprintf(buffer, "resp %i", resp);
+    for (int i = 0; i < instance_count; i++)
+        len += sprintf(buffer + len, " %i", results[i]);
+
+    protocol_response(buffer, proto);
+    free(buffer);
+}
+
 static void multi_add(proto_t *proto)
 {
     int instance_count = atoi(proto->list[1]);
@@ -736,8 +963,9 @@ static void multi_add(proto_t *proto)
     }
 
     int *instances = malloc(sizeof(int) * instance_count);
+    int *results = malloc(sizeof(int) * instance_count);
     const char **uris = malloc(sizeof(const char *) * instance_count);
-    if (instances != NULL && uris != NULL)
+    if (instances != NULL && results != NULL && uris != NULL)
     {
         for (int i = 0; i < instance_count; i++)
         {
@@ -748,15 +976,17 @@ static void multi_add(proto_t *proto)
     else
     {
         free(instances);
+        free(results);
         free(uris);
         protocol_response_int(ERR_MEMORY_ALLOCATION, proto);
         return;
     }
 
-    int resp = effects_add_multi(1, instance_count, instances, uris);
-    protocol_response_int(resp, proto);
+    int resp = effects_add_multi(1, instance_count, instances, uris, results);
+    multi_add_response(resp, results, instance_count, proto);
 
     free(instances);
+    free(results);
     free(uris);
 }
 
@@ -824,8 +1054,9 @@ static void multi_preload(proto_t *proto)
     }
 
     int *instances = malloc(sizeof(int) * instance_count);
+    int *results = malloc(sizeof(int) * instance_count);
     const char **uris = malloc(sizeof(const char *) * instance_count);
-    if (instances != NULL && uris != NULL)
+    if (instances != NULL && results != NULL && uris != NULL)
     {
         for (int i = 0; i < instance_count; i++)
         {
@@ -836,15 +1067,17 @@ static void multi_preload(proto_t *proto)
     else
     {
         free(instances);
+        free(results);
         free(uris);
         protocol_response_int(ERR_MEMORY_ALLOCATION, proto);
         return;
     }
 
-    int resp = effects_add_multi(0, instance_count, instances, uris);
-    protocol_response_int(resp, proto);
+    int resp = effects_add_multi(0, instance_count, instances, uris, results);
+    multi_add_response(resp, results, instance_count, proto);
 
     free(instances);
+    free(results);
     free(uris);
 }
 
@@ -1018,6 +1251,27 @@ static void wait_audio_cycle(proto_t *proto)
     protocol_response_int(resp, proto);
 }
 
+static void txn_begin(proto_t *proto)
+{
+    protocol_response_int(effects_txn_begin(), proto);
+}
+
+static void txn_commit(proto_t *proto)
+{
+    protocol_response_int(effects_txn_commit(), proto);
+}
+
+static void txn_abort(proto_t *proto)
+{
+    protocol_response_int(effects_txn_abort(), proto);
+}
+
+static void client_closed(int sender_id)
+{
+    protocol_drop_sender(sender_id);
+    effects_txn_abort_client(sender_id);
+}
+
 static void help_cb(proto_t *proto)
 {
     proto->response = 0;
@@ -1034,6 +1288,7 @@ static void quit_cb(proto_t *proto)
 
     protocol_remove_commands();
     socket_finish();
+    protocol_finish();
     effects_finish(1);
     exit(EXIT_SUCCESS);
 }
@@ -1128,31 +1383,38 @@ static int mod_host_init(jack_client_t* client, int socket_port, int feedback_po
     ne10_init();
 #endif
 
-    /* Setup the protocol */
-    protocol_add_command(EFFECT_ADD, effects_add_cb);
+    /* Setup the protocol, slow commands sent with a request id run in the background
+       while fast ones keep being answered */
+    protocol_add_command_mode(EFFECT_ADD, effects_add_cb, PROTOCOL_CMD_SLOW);
     protocol_add_command(EFFECT_REMOVE, effects_remove_cb);
     protocol_add_command(EFFECT_ACTIVATE, effects_activate_cb);
-    protocol_add_command(EFFECT_PRELOAD, effects_preload_cb);
-    protocol_add_command(EFFECT_PRESET_LOAD, effects_preset_load_cb);
-    protocol_add_command(EFFECT_PRESET_SAVE, effects_preset_save_cb);
-    protocol_add_command(EFFECT_PRESET_SHOW, effects_preset_show_cb);
+    protocol_add_command_mode(EFFECT_PRELOAD, effects_preload_cb, PROTOCOL_CMD_SLOW);
+    protocol_add_command_mode(EFFECT_PRESET_LOAD, effects_preset_load_cb, PROTOCOL_CMD_SLOW);
+    protocol_add_command_mode(EFFECT_PRESET_SAVE, effects_preset_save_cb, PROTOCOL_CMD_SLOW);
+    protocol_add_command_mode(EFFECT_PRESET_SHOW, effects_preset_show_cb, PROTOCOL_CMD_SLOW);
     protocol_add_command(EFFECT_CONNECT, effects_connect_cb);
     protocol_add_command(EFFECT_CONNECT_MATCHING, effects_connect_matching_cb);
     protocol_add_command(EFFECT_CONNECT_SAFE, effects_connect_safe_cb);
     protocol_add_command(EFFECT_DISCONNECT, effects_disconnect_cb);
     protocol_add_command(EFFECT_DISCONNECT_ALL, effects_disconnect_all_cb);
     protocol_add_command(EFFECT_DISCONNECT_SAFE, effects_disconnect_safe_cb);
-    protocol_add_command(EFFECT_BYPASS, effects_bypass_cb);
-    protocol_add_command(EFFECT_PARAM_SET, effects_set_param_cb);
-    protocol_add_command(EFFECT_PARAM_GET, effects_get_param_cb);
+    protocol_add_command_mode(EFFECT_BYPASS, effects_bypass_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command(EFFECT_BYPASS_POLICY, effects_bypass_policy_cb);
+    protocol_add_command(EFFECT_SILENCE_SLEEP, effects_silence_sleep_cb);
+    protocol_add_command(EFFECT_SLEEP_STATS, effects_sleep_stats_cb);
+    protocol_add_command_mode(EFFECT_PARAM_SET, effects_set_param_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(EFFECT_PARAM_GET, effects_get_param_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(EFFECT_PARAM_HANDLE, effects_param_handle_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(EFFECT_PARAM_SET_H, effects_set_param_handle_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(EFFECT_PARAM_SET_HV, effects_set_param_handles_cb, PROTOCOL_CMD_FAST);
     protocol_add_command(EFFECT_PARAM_MON, effects_monitor_param_cb);
-    protocol_add_command(EFFECT_PARAMS_FLUSH, effects_flush_params_cb);
+    protocol_add_command_mode(EFFECT_PARAMS_FLUSH, effects_flush_params_cb, PROTOCOL_CMD_FAST);
     protocol_add_command(EFFECT_PRE_RUN, effects_pre_run_cb);
     protocol_add_command(EFFECT_PATCH_GET, effects_get_property_cb);
     protocol_add_command(EFFECT_PATCH_SET, effects_set_property_cb);
     protocol_add_command(EFFECT_LICENSEE, effects_licensee_cb);
-    protocol_add_command(EFFECT_SET_BPM, effects_set_beats_per_minute_cb);
-    protocol_add_command(EFFECT_SET_BPB, effects_set_beats_per_bar_cb);
+    protocol_add_command_mode(EFFECT_SET_BPM, effects_set_beats_per_minute_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(EFFECT_SET_BPB, effects_set_beats_per_bar_cb, PROTOCOL_CMD_FAST);
     protocol_add_command(MONITOR_ADDR_SET, monitor_addr_set_cb);
     protocol_add_command(MONITOR_OUTPUT, monitor_output_cb);
     protocol_add_command(MONITOR_OUTPUT_OFF, monitor_output_off_cb);
@@ -1169,37 +1431,46 @@ static int mod_host_init(jack_client_t* client, int socket_port, int feedback_po
     protocol_add_command(CV_UNMAP, cv_unmap_cb);
     protocol_add_command(HMI_MAP, hmi_map_cb);
     protocol_add_command(HMI_UNMAP, hmi_unmap_cb);
-    protocol_add_command(CPU_LOAD, cpu_load_cb);
-    protocol_add_command(MAX_CPU_LOAD, max_cpu_load_cb);
+    protocol_add_command_mode(CPU_LOAD, cpu_load_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(MAX_CPU_LOAD, max_cpu_load_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command(PLUGIN_LOAD, plugin_load_cb);
+    protocol_add_command_mode(RT_QUEUE_STATS, rt_queue_stats_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(FEEDBACK_STATS, feedback_stats_cb, PROTOCOL_CMD_FAST);
+    protocol_add_command(GRAPH_PARALLELISM, graph_parallelism_cb);
+    protocol_add_command(ZERO_COPY_BYTES, zero_copy_bytes_cb);
 #ifndef SKIP_READLINE
     protocol_add_command(LOAD_COMMANDS, load_cb);
     protocol_add_command(SAVE_COMMANDS, save_cb);
 #endif
-    protocol_add_command(BUNDLE_ADD, bundle_add);
-    protocol_add_command(BUNDLE_REMOVE, bundle_remove);
+    protocol_add_command_mode(BUNDLE_ADD, bundle_add, PROTOCOL_CMD_SLOW);
+    protocol_add_command_mode(BUNDLE_REMOVE, bundle_remove, PROTOCOL_CMD_SLOW);
     protocol_add_command(FEATURE_ENABLE, feature_enable);
-    protocol_add_command(STATE_LOAD, state_load);
-    protocol_add_command(STATE_SAVE, state_save);
+    protocol_add_command_mode(STATE_LOAD, state_load, PROTOCOL_CMD_SLOW);
+    protocol_add_command_mode(STATE_SAVE, state_save, PROTOCOL_CMD_SLOW);
     protocol_add_command(STATE_TMPDIR, state_tmpdir);
-    protocol_add_command(TRANSPORT, transport);
+    protocol_add_command_mode(TRANSPORT, transport, PROTOCOL_CMD_FAST);
     protocol_add_command(TRANSPORT_SYNC, transport_sync);
     protocol_add_command(SHOW_EXTERNAL_UI, show_external_ui);
-    protocol_add_command(OUTPUT_DATA_READY, output_data_ready);
-    protocol_add_command(MULTI_ADD, multi_add);
+    protocol_add_command_mode(OUTPUT_DATA_READY, output_data_ready, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(MULTI_ADD, multi_add, PROTOCOL_CMD_SLOW);
     protocol_add_command(MULTI_REMOVE, multi_remove);
     protocol_add_command(MULTI_ACTIVATE, multi_activate);
-    protocol_add_command(MULTI_PRELOAD, multi_preload);
-    protocol_add_command(MULTI_BYPASS, multi_bypass);
-    protocol_add_command(MULTI_PARAM_SET, multi_param_set);
-    protocol_add_command(MULTI_PARAMS_FLUSH, multi_params_flush);
+    protocol_add_command_mode(MULTI_PRELOAD, multi_preload, PROTOCOL_CMD_SLOW);
+    protocol_add_command_mode(MULTI_BYPASS, multi_bypass, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(MULTI_PARAM_SET, multi_param_set, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(MULTI_PARAMS_FLUSH, multi_params_flush, PROTOCOL_CMD_FAST);
     protocol_add_command(MULTI_PRE_RUN, multi_pre_run);
     protocol_add_command(WAIT_AUDIO_CYCLE, wait_audio_cycle);
+    protocol_add_command_mode(TXN_BEGIN, txn_begin, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(TXN_COMMIT, txn_commit, PROTOCOL_CMD_FAST);
+    protocol_add_command_mode(TXN_ABORT, txn_abort, PROTOCOL_CMD_FAST);
 
     /* skip help and quit for internal client */
     if (client == NULL)
     {
         protocol_add_command(HELP, help_cb);
-        protocol_add_command(QUIT, quit_cb);
+        // fast, so that waiting for a background command does not deadlock on the exclusive lock
+        protocol_add_command_mode(QUIT, quit_cb, PROTOCOL_CMD_FAST);
     }
 
     /* Startup the effects */
@@ -1211,6 +1482,7 @@ static int mod_host_init(jack_client_t* client, int socket_port, int feedback_po
         return -1;
 
     socket_set_receive_cb(protocol_parse);
+    socket_set_close_cb(client_closed);
 
     return 0;
 }
@@ -1250,6 +1522,10 @@ int main(int argc, char **argv)
         {"verbose", no_argument, 0, 'v'},
         {"socket-port", required_argument, 0, 'p'},
         {"feedback-port", required_argument, 0, 'f'},
+#ifndef _WIN32
+        {"socket-path", required_argument, 0, 'u'},
+        {"feedback-path", required_argument, 0, 'U'},
+#endif
         {"interactive", no_argument, 0, 'i'},
         {"self-test", no_argument, 0, 't'},
         {"version", no_argument, 0, 'V'},
@@ -1262,7 +1538,8 @@ int main(int argc, char **argv)
     /* parse command line options */
     int nofork = 0, verbose = 0,  interactive = 0, selftest = 0;
     int socket_port = SOCKET_DEFAULT_PORT, feedback_port = 0;
-    while ((opt = getopt_long(argc, argv, "nvp:f:iVh", long_options, &opt_index)) != -1)
+    const char *socket_path = NULL, *feedback_path = NULL;
+    while ((opt = getopt_long(argc, argv, "nvp:f:u:U:iVh", long_options, &opt_index)) != -1)
     {
         switch (opt)
         {
@@ -1283,6 +1560,14 @@ int main(int argc, char **argv)
                 feedback_port = atoi(optarg);
                 break;
 
+            case 'u':
+                socket_path = optarg;
+                break;
+
+            case 'U':
+                feedback_path = optarg;
+                break;
+
             case 'i':
                 interactive = 1;
                 nofork = 1;
@@ -1307,6 +1592,10 @@ int main(int argc, char **argv)
                     "  -v, --verbose                  verbose messages\n"
                     "  -p, --socket-port=<port>       socket port definition\n"
                     "  -f, --feedback-port=<port>     feedback port definition\n"
+#ifndef _WIN32
+                    "  -u, --socket-path=<path>       also listen for commands on a unix-domain socket\n"
+                    "  -U, --feedback-path=<path>     also send feedback on a unix-domain socket\n"
+#endif
 #ifndef SKIP_READLINE
                     "  -i, --interactive              interactive mode\n"
 #endif
@@ -1371,11 +1660,18 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if ((socket_path != NULL || feedback_path != NULL) && socket_start_unix(socket_path, feedback_path) != 0)
+    {
+        exit(EXIT_FAILURE);
+        return 1;
+    }
+
 #ifndef SKIP_READLINE
     /* Interactive mode */
     if (interactive)
     {
         interactive_mode();
+        protocol_finish();
         effects_finish(1);
         return 0;
     }
@@ -1407,6 +1703,7 @@ int main(int argc, char **argv)
     while (running) socket_run(interactive);
 
     socket_finish();
+    protocol_finish();
     effects_finish(1);
     protocol_remove_commands();
 
@@ -1451,6 +1748,7 @@ void jack_finish(void* arg)
     running = 0;
     socket_finish();
     zix_thread_join(intclient_socket_thread, NULL);
+    protocol_finish();
     effects_finish(0);
     protocol_remove_commands();
 
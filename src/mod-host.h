@@ -65,8 +65,14 @@
 #define EFFECT_DISCONNECT_ALL   "disconnect_all %s"
 #define EFFECT_DISCONNECT_SAFE  "disconnect_safe %s %s"
 #define EFFECT_BYPASS           "bypass %i %i"
+#define EFFECT_BYPASS_POLICY    "bypass_policy %i %s"
+#define EFFECT_SILENCE_SLEEP    "silence_sleep %i %i"
+#define EFFECT_SLEEP_STATS      "sleep_stats %i"
 #define EFFECT_PARAM_SET        "param_set %i %s %f"
 #define EFFECT_PARAM_GET        "param_get %i %s"
+#define EFFECT_PARAM_HANDLE     "param_handle %i %s"
+#define EFFECT_PARAM_SET_H      "param_set_h %i %f"
+#define EFFECT_PARAM_SET_HV     "param_set_hv %i %f ..."
 #define EFFECT_PARAM_MON        "param_monitor %i %s %s %f"
 #define EFFECT_PARAMS_FLUSH     "params_flush %i %i %i ..."
 #define EFFECT_PRE_RUN          "pre_run %i %i %i ..."
@@ -75,7 +81,7 @@
 #define EFFECT_LICENSEE         "licensee %i"
 #define EFFECT_SET_BPM          "set_bpm %f"
 #define EFFECT_SET_BPB          "set_bpb %f"
-#define MONITOR_ADDR_SET        "monitor %s %i %i"
+#define MONITOR_ADDR_SET        "monitor %s %i %i ..."
 #define MONITOR_OUTPUT          "monitor_output %i %s"
 #define MONITOR_OUTPUT_OFF      "monitor_output_off %i %s"
 #define MONITOR_AUDIO_LEVELS    "monitor_audio_levels %i %s"
@@ -93,6 +99,11 @@
 #define HMI_UNMAP               "hmi_unmap %i %s"
 #define CPU_LOAD                "cpu_load"
 #define MAX_CPU_LOAD            "max_cpu_load"
+#define PLUGIN_LOAD             "plugin_load %i"
+#define RT_QUEUE_STATS          "rt_queue_stats"
+#define FEEDBACK_STATS          "feedback_stats"
+#define GRAPH_PARALLELISM       "graph_parallelism"
+#define ZERO_COPY_BYTES         "zero_copy_bytes"
 #define LOAD_COMMANDS           "load %s"
 #define SAVE_COMMANDS           "save %s"
 #define BUNDLE_ADD              "bundle_add %s"
@@ -114,6 +125,9 @@
 #define MULTI_PARAMS_FLUSH      "multi_params_flush %i %i ... %i ..."
 #define MULTI_PRE_RUN           "multi_pre_run %i %i ... %i ..."
 #define WAIT_AUDIO_CYCLE        "wait_audio_cycle"
+#define TXN_BEGIN               "txn_begin"
+#define TXN_COMMIT              "txn_commit"
+#define TXN_ABORT               "txn_abort"
 #define HELP                    "help"
 #define QUIT                    "quit"
 
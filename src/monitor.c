@@ -27,9 +27,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #ifdef _WIN32
 #include <winsock2.h>
+#define SHUT_RDWR SD_BOTH
 #else
 #include <netdb.h>
 #include <netinet/in.h>
@@ -41,6 +44,8 @@ typedef int SOCKET;
 
 #include "monitor.h"
 #include "utils.h"
+#include "mod-semaphore.h"
+#include "zix/thread.h"
 
 
 /*
@@ -49,6 +54,12 @@ typedef int SOCKET;
 ************************************************************************************************************************
 */
 
+// pending notifications, must be a power of 2
+#define MONITOR_QUEUE_SIZE      1024
+#define MONITOR_SYMBOL_SIZE     64
+// notifications are sent in batches of up to this many bytes over tcp
+#define MONITOR_SEND_BUF_SIZE   4096
+
 
 /*
 ************************************************************************************************************************
@@ -63,6 +74,13 @@ typedef int SOCKET;
 ************************************************************************************************************************
 */
 
+typedef struct MONITOR_EVENT_T {
+    uint32_t sequence;
+    int instance;
+    float value;
+    char symbol[MONITOR_SYMBOL_SIZE];
+} monitor_event_t;
+
 
 /*
 ************************************************************************************************************************
@@ -79,8 +97,20 @@ typedef int SOCKET;
 ************************************************************************************************************************
 */
 
-static int g_status;
+static int g_status; // atomic, checked by the audio threads
 static SOCKET g_sockfd;
+static bool g_udp;
+
+// bounded multi-producer queue, written by the audio threads and read by the sender thread
+static monitor_event_t g_queue[MONITOR_QUEUE_SIZE];
+static uint32_t g_queue_head, g_queue_tail;
+static bool g_queue_ready;
+
+static volatile bool g_sender_running;
+// never destroyed, audio threads might still be posting while the monitor stops
+static sem_t g_sender_sem;
+static bool g_sender_sem_ready;
+static ZixThread g_sender_thread;
 
 /*
 ************************************************************************************************************************
@@ -102,6 +132,142 @@ static SOCKET g_sockfd;
 ************************************************************************************************************************
 */
 
+// single consumer only
+static bool queue_pop(monitor_event_t *event)
+{
+    monitor_event_t *const cell = &g_queue[g_queue_tail & (MONITOR_QUEUE_SIZE - 1)];
+
+    if (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != g_queue_tail + 1)
+        return false;
+
+    *event = *cell;
+    __atomic_store_n(&cell->sequence, g_queue_tail + MONITOR_QUEUE_SIZE, __ATOMIC_RELEASE);
+    ++g_queue_tail;
+    return true;
+}
+
+// audio threads that passed the status check before the monitor stopped may still be pushing,
+// so the queue is only set up once, later starts just drop what is left through the regular pop
+static void queue_start(void)
+{
+    if (! g_queue_ready)
+    {
+        for (uint32_t i = 0; i < MONITOR_QUEUE_SIZE; i++)
+            __atomic_store_n(&g_queue[i].sequence, i, __ATOMIC_RELAXED);
+
+        g_queue_head = g_queue_tail = 0;
+        g_queue_ready = true;
+        return;
+    }
+
+    monitor_event_t event;
+    while (queue_pop(&event)) {}
+}
+
+static int send_all(const char *buffer, int size)
+{
+    while (size > 0)
+    {
+        const int ret = send(g_sockfd, buffer, size, 0);
+
+        if (ret < 0)
+        {
+            perror("send error");
+            return -1;
+        }
+
+        size -= ret;
+        buffer += ret;
+    }
+
+    return 0;
+}
+
+static void* sender_thread(void *arg)
+{
+    static monitor_event_t events[MONITOR_QUEUE_SIZE];
+    // per batch index of the latest event of each (instance, symbol), 0 if unused
+    static uint16_t latest[MONITOR_QUEUE_SIZE * 2];
+    char buffer[MONITOR_SEND_BUF_SIZE];
+
+    while (g_sender_running)
+    {
+        if (sem_timedwait_secs(&g_sender_sem, 1) != 0)
+            continue;
+
+        uint32_t count = 0;
+        while (count < MONITOR_QUEUE_SIZE && queue_pop(&events[count]))
+            ++count;
+
+        if (count == 0)
+            continue;
+
+        // coalesce, only the latest value of each parameter is sent
+        memset(latest, 0, sizeof(latest));
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t hash = str_hash(events[i].symbol) ^ (uint32_t)events[i].instance;
+
+            for (uint32_t j = hash & (MONITOR_QUEUE_SIZE * 2 - 1);; j = (j + 1) & (MONITOR_QUEUE_SIZE * 2 - 1))
+            {
+                if (latest[j] == 0)
+                {
+                    latest[j] = i + 1;
+                    break;
+                }
+
+                monitor_event_t *const prev = &events[latest[j] - 1];
+
+                if (prev->instance == events[i].instance && strcmp(prev->symbol, events[i].symbol) == 0)
+                {
+                    prev->instance = -1;
+                    latest[j] = i + 1;
+                    break;
+                }
+            }
+        }
+
+        int used = 0;
+
+        for (uint32_t i = 0; i < count && g_sender_running; i++)
+        {
+            if (events[i].instance < 0)
+                continue;
+
+            char msg[255];
+            const int size = snprintf(msg, sizeof(msg), "monitor %d %s %f",
+                                      events[i].instance, events[i].symbol, events[i].value) + 1;
+
+            if (size <= 0 || size > (int)sizeof(msg))
+                continue;
+
+            // one datagram per message, tcp gets as many as fit in one send
+            if (g_udp)
+            {
+                send(g_sockfd, msg, size, 0);
+                continue;
+            }
+
+            if (used + size > MONITOR_SEND_BUF_SIZE)
+            {
+                send_all(buffer, used);
+                used = 0;
+            }
+
+            memcpy(buffer + used, msg, size);
+            used += size;
+        }
+
+        if (used != 0)
+            send_all(buffer, used);
+    }
+
+    return NULL;
+
+    (void)arg;
+}
+
 
 /*
 ************************************************************************************************************************
@@ -109,7 +275,7 @@ static SOCKET g_sockfd;
 ************************************************************************************************************************
 */
 
-int monitor_start(char *addr, int port)
+int monitor_start(char *addr, int port, int udp)
 {
     /* connects to the address specified by the client and starts
      * monitoring and sending information according to the settings
@@ -118,7 +284,11 @@ int monitor_start(char *addr, int port)
     struct sockaddr_in serv_addr;
     struct hostent *server;
 
-    g_sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (g_status == ON)
+        monitor_stop();
+
+    g_udp = udp != 0;
+    g_sockfd = socket(AF_INET, g_udp ? SOCK_DGRAM : SOCK_STREAM, 0);
     if (g_sockfd == INVALID_SOCKET)
     {
         perror("ERROR opening socket");
@@ -130,34 +300,44 @@ int monitor_start(char *addr, int port)
     if (server == NULL)
     {
         fprintf(stderr,"ERROR, no such host");
+        closesocket(g_sockfd);
         return 1;
     }
 
     memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
-    memcpy(server->h_addr, &serv_addr.sin_addr.s_addr, server->h_length);
+    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
     serv_addr.sin_port = htons(port);
 
+    // udp sockets are connected too, so that send() can be used for both
     if (connect(g_sockfd,(struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0)
     {
         perror("ERROR connecting");
+        closesocket(g_sockfd);
         return 1;
     }
 
-    g_status = ON;
+    // the socket is left blocking, only the sender thread ever waits on it
+    queue_start();
 
-#ifdef _WIN32
-    unsigned long mode = 1;
-    if (ioctlsocket(g_sockfd, FIONBIO, &mode) != 0)
-#else
-    int flags = fcntl(g_sockfd, F_GETFL, 0);
-    if (fcntl(g_sockfd, F_SETFL, flags | O_NONBLOCK) != 0)
-#endif
+    if (! g_sender_sem_ready)
     {
-        perror("ERROR setting socket to nonblocking");
+        sem_init(&g_sender_sem, 0, 0);
+        g_sender_sem_ready = true;
+    }
+
+    g_sender_running = true;
+
+    if (zix_thread_create(&g_sender_thread, 0, sender_thread, NULL) != 0)
+    {
+        perror("ERROR creating monitor thread");
+        g_sender_running = false;
+        closesocket(g_sockfd);
         return 1;
     }
 
+    // publishes the queue set up above to the audio threads
+    __atomic_store_n(&g_status, ON, __ATOMIC_RELEASE);
     return 0;
 }
 
@@ -169,31 +349,60 @@ int monitor_status(void)
 
 int monitor_stop(void)
 {
+    if (g_status != ON)
+        return 0;
+
+    __atomic_store_n(&g_status, OFF, __ATOMIC_RELAXED);
+
+    // unblock a pending send before waiting for the thread
+    g_sender_running = false;
+    shutdown(g_sockfd, SHUT_RDWR);
+    sem_post(&g_sender_sem);
+    zix_thread_join(g_sender_thread, NULL);
+
     closesocket(g_sockfd);
-    g_status = OFF;
     return 0;
 }
 
+// rt-safe, notifications are queued here and sent by the monitor thread
 int monitor_send(int instance, const char *symbol, float value)
 {
-    int size, ret = -1;
+    if (__atomic_load_n(&g_status, __ATOMIC_ACQUIRE) != ON)
+        return -1;
 
-    char msg[255];
-    char *buffer = msg;
-    size = sprintf(msg, "monitor %d %s %f", instance, symbol, value);
+    uint32_t pos = __atomic_load_n(&g_queue_head, __ATOMIC_RELAXED);
+    monitor_event_t *cell;
 
-    while (size > 0)
+    for (;;)
     {
-        ret = send(g_sockfd, buffer, size + 1, 0);
-        if (ret < 0)
+        cell = &g_queue[pos & (MONITOR_QUEUE_SIZE - 1)];
+
+        const int32_t diff = (int32_t)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0)
         {
-            perror("send error");
+            if (__atomic_compare_exchange_n(&g_queue_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // full, the sender thread is falling behind, the value will be retried on the next cycle
+            return -1;
+        }
+        else
+        {
+            pos = __atomic_load_n(&g_queue_head, __ATOMIC_RELAXED);
         }
-        size -= ret;
-        buffer += ret;
     }
 
-    return ret;
+    cell->instance = instance;
+    cell->value = value;
+    strncpy(cell->symbol, symbol, MONITOR_SYMBOL_SIZE - 1);
+    cell->symbol[MONITOR_SYMBOL_SIZE - 1] = '\0';
+
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+    sem_post(&g_sender_sem);
+    return 0;
 }
 
 
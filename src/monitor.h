@@ -83,7 +83,7 @@
 ************************************************************************************************************************
 */
 
-int monitor_start(char *addr, int port);
+int monitor_start(char *addr, int port, int udp);
 int monitor_status(void);
 int monitor_stop(void);
 
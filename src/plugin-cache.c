@@ -0,0 +1,1173 @@
+/*
+ * This file is part of mod-host.
+ *
+ * mod-host is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mod-host is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mod-host.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+************************************************************************************************************************
+*           INCLUDE FILES
+************************************************************************************************************************
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(HAVE_NEW_LILV) && !defined(_WIN32)
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <lv2/presets/presets.h>
+
+#include "plugin-cache.h"
+
+/*
+************************************************************************************************************************
+*           LOCAL DEFINES
+************************************************************************************************************************
+*/
+
+#define PLUGIN_CACHE_MAGIC      "MODLV2C"
+#define PLUGIN_CACHE_VERSION    1
+
+// bundle flags
+#define BUNDLE_SPECIFICATION    0x1
+
+#ifdef __APPLE__
+#define DEFAULT_LV2_PATH "~/Library/Audio/Plug-Ins/LV2:~/.lv2:/usr/local/lib/lv2:/usr/lib/lv2:/Library/Audio/Plug-Ins/LV2"
+#else
+#define DEFAULT_LV2_PATH "~/.lv2:/usr/local/lib/lv2:/usr/lib/lv2"
+#endif
+
+/*
+************************************************************************************************************************
+*           LOCAL DATA TYPES
+************************************************************************************************************************
+*/
+
+// file layout: header, bundles sorted by path, resources sorted by uri, refs (bundle indexes), string table
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_bundles;
+    uint32_t num_resources;
+    uint32_t num_refs;
+    uint32_t strings_size;
+    uint32_t reserved;
+} cache_header_t;
+
+typedef struct {
+    int64_t mtime;
+    uint32_t path;
+    uint32_t flags;
+} cache_bundle_t;
+
+typedef struct {
+    uint32_t uri;
+    uint32_t first_ref;
+    uint32_t num_refs;
+    uint32_t reserved;
+} cache_resource_t;
+
+// mutable version of the cache, used while (re)writing the file
+typedef struct {
+    char *path;
+    int64_t mtime;
+    uint32_t flags;
+} builder_bundle_t;
+
+typedef struct {
+    char *uri;
+    char *bundle;
+} builder_ref_t;
+
+typedef struct {
+    builder_bundle_t *bundles;
+    uint32_t num_bundles, bundles_size;
+    builder_ref_t *refs;
+    uint32_t num_refs, refs_size;
+} cache_builder_t;
+
+/*
+************************************************************************************************************************
+*           LOCAL MACROS
+************************************************************************************************************************
+*/
+
+#define UNUSED_PARAM(var)           do { (void)(var); } while (0)
+
+
+/*
+************************************************************************************************************************
+*           LOCAL GLOBAL VARIABLES
+************************************************************************************************************************
+*/
+
+#if defined(HAVE_NEW_LILV) && !defined(_WIN32)
+
+static char *g_cache_file;
+
+// LV2_PATH directories, resolved and with a trailing separator
+static char **g_lv2_dirs;
+static uint32_t g_num_lv2_dirs, g_lv2_dirs_size;
+
+// bundles found in LV2_PATH, kept until the cache is rebuilt
+static cache_builder_t g_scanned;
+
+// mapped cache file
+static void *g_map;
+static size_t g_map_size;
+static const cache_header_t *g_header;
+static const cache_bundle_t *g_bundles;
+static const cache_resource_t *g_resources;
+static const uint32_t *g_refs;
+static const char *g_strings;
+
+// set when the world was not fully loaded, bundles are then loaded on demand
+static bool g_lazy;
+static char **g_loaded;
+static uint32_t g_num_loaded, g_loaded_size;
+
+/*
+************************************************************************************************************************
+*           LOCAL FUNCTIONS
+************************************************************************************************************************
+*/
+
+static bool grow_array(void *data, uint32_t *size, uint32_t needed, size_t elem_size)
+{
+    void **ptr = data;
+
+    if (needed <= *size)
+        return true;
+
+    uint32_t new_size = *size != 0 ? *size * 2 : 64;
+    while (new_size < needed)
+        new_size *= 2;
+
+    void *new_data = realloc(*ptr, new_size * elem_size);
+    if (new_data == NULL)
+        return false;
+
+    *ptr = new_data;
+    *size = new_size;
+    return true;
+}
+
+static int64_t stat_mtime(const struct stat *st)
+{
+#ifdef __APPLE__
+    return (int64_t)st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+}
+
+// newest of the bundle directory and its manifest, or -1 if this is not a bundle
+static int64_t bundle_mtime(const char *bundlepath)
+{
+    char manifest[PATH_MAX];
+    struct stat st;
+    int64_t mtime;
+
+    if (snprintf(manifest, sizeof(manifest), "%smanifest.ttl", bundlepath) >= (int)sizeof(manifest))
+        return -1;
+
+    if (stat(manifest, &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+
+    mtime = stat_mtime(&st);
+
+    if (stat(bundlepath, &st) != 0)
+        return -1;
+
+    if (stat_mtime(&st) > mtime)
+        mtime = stat_mtime(&st);
+
+    return mtime;
+}
+
+// resolves path and appends a separator, returns a newly allocated string
+static char *resolve_dir(const char *path)
+{
+    char tmppath[PATH_MAX+2];
+
+    if (realpath(path, tmppath) == NULL)
+        return NULL;
+
+    const size_t size = strlen(tmppath);
+    if (size == 0 || tmppath[size-1] != '/')
+    {
+        tmppath[size  ] = '/';
+        tmppath[size+1] = '\0';
+    }
+
+    return strdup(tmppath);
+}
+
+static void builder_free(cache_builder_t *b)
+{
+    for (uint32_t i = 0; i < b->num_bundles; i++)
+        free(b->bundles[i].path);
+    for (uint32_t i = 0; i < b->num_refs; i++)
+    {
+        free(b->refs[i].uri);
+        free(b->refs[i].bundle);
+    }
+
+    free(b->bundles);
+    free(b->refs);
+    memset(b, 0, sizeof(*b));
+}
+
+static bool builder_add_bundle(cache_builder_t *b, const char *path, int64_t mtime, uint32_t flags)
+{
+    if (!grow_array(&b->bundles, &b->bundles_size, b->num_bundles + 1, sizeof(builder_bundle_t)))
+        return false;
+
+    builder_bundle_t *bundle = &b->bundles[b->num_bundles];
+    bundle->path = strdup(path);
+    bundle->mtime = mtime;
+    bundle->flags = flags;
+
+    if (bundle->path == NULL)
+        return false;
+
+    b->num_bundles++;
+    return true;
+}
+
+static bool builder_add_ref(cache_builder_t *b, const char *uri, const char *bundle)
+{
+    if (!grow_array(&b->refs, &b->refs_size, b->num_refs + 1, sizeof(builder_ref_t)))
+        return false;
+
+    builder_ref_t *ref = &b->refs[b->num_refs];
+    ref->uri = strdup(uri);
+    ref->bundle = strdup(bundle);
+
+    if (ref->uri == NULL || ref->bundle == NULL)
+    {
+        free(ref->uri);
+        free(ref->bundle);
+        return false;
+    }
+
+    b->num_refs++;
+    return true;
+}
+
+// removes a bundle and everything pointing to it
+static void builder_remove_bundle(cache_builder_t *b, const char *path)
+{
+    uint32_t j = 0;
+
+    for (uint32_t i = 0; i < b->num_bundles; i++)
+    {
+        if (strcmp(b->bundles[i].path, path) == 0)
+            free(b->bundles[i].path);
+        else
+            b->bundles[j++] = b->bundles[i];
+    }
+    b->num_bundles = j;
+
+    j = 0;
+    for (uint32_t i = 0; i < b->num_refs; i++)
+    {
+        if (strcmp(b->refs[i].bundle, path) == 0)
+        {
+            free(b->refs[i].uri);
+            free(b->refs[i].bundle);
+        }
+        else
+        {
+            b->refs[j++] = b->refs[i];
+        }
+    }
+    b->num_refs = j;
+}
+
+static int compare_bundles(const void *a, const void *b)
+{
+    return strcmp(((const builder_bundle_t*)a)->path, ((const builder_bundle_t*)b)->path);
+}
+
+static int compare_refs(const void *a, const void *b)
+{
+    const builder_ref_t *ra = a, *rb = b;
+    const int ret = strcmp(ra->uri, rb->uri);
+    return ret != 0 ? ret : strcmp(ra->bundle, rb->bundle);
+}
+
+// sorts bundles by path and drops duplicates, keeping the first one
+static void builder_sort_bundles(cache_builder_t *b)
+{
+    if (b->num_bundles == 0)
+        return;
+
+    qsort(b->bundles, b->num_bundles, sizeof(builder_bundle_t), compare_bundles);
+
+    uint32_t j = 1;
+    for (uint32_t i = 1; i < b->num_bundles; i++)
+    {
+        if (strcmp(b->bundles[i].path, b->bundles[j-1].path) == 0)
+            free(b->bundles[i].path);
+        else
+            b->bundles[j++] = b->bundles[i];
+    }
+    b->num_bundles = j;
+}
+
+static int32_t builder_find_bundle(const cache_builder_t *b, const char *path)
+{
+    uint32_t low = 0, high = b->num_bundles;
+
+    while (low < high)
+    {
+        const uint32_t mid = (low + high) / 2;
+        const int ret = strcmp(b->bundles[mid].path, path);
+
+        if (ret == 0)
+            return mid;
+        if (ret < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return -1;
+}
+
+// finds the bundle containing a file or directory uri, bundles must be sorted
+static builder_bundle_t *builder_bundle_for_node(cache_builder_t *b, const LilvNode *node)
+{
+    if (node == NULL || !lilv_node_is_uri(node))
+        return NULL;
+
+    const char *uri = lilv_node_as_uri(node);
+    if (strncmp(uri, "file://", 7) != 0)
+        return NULL;
+
+    char *filepath = lilv_file_uri_parse(uri, NULL);
+    if (filepath == NULL)
+        return NULL;
+
+    char tmppath[PATH_MAX+2];
+    char *path = realpath(filepath, tmppath);
+    lilv_free(filepath);
+
+    if (path == NULL)
+        return NULL;
+
+    // directories (bundle uris) end with a separator, as bundle paths do
+    const size_t urisize = strlen(uri);
+    const size_t size = strlen(path);
+    if (uri[urisize-1] == '/' && size > 0 && path[size-1] != '/')
+    {
+        path[size  ] = '/';
+        path[size+1] = '\0';
+    }
+
+    // last bundle sorting before or equal to path, which is a prefix of it if path is inside
+    uint32_t low = 0, high = b->num_bundles;
+    while (low < high)
+    {
+        const uint32_t mid = (low + high) / 2;
+        if (strcmp(b->bundles[mid].path, path) <= 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == 0)
+        return NULL;
+
+    builder_bundle_t *bundle = &b->bundles[low-1];
+    if (strncmp(path, bundle->path, strlen(bundle->path)) != 0)
+        return NULL;
+
+    return bundle;
+}
+
+static void collect_ref(cache_builder_t *b, const char *uri, const LilvNode *node, const char *only_bundle)
+{
+    const builder_bundle_t *bundle = builder_bundle_for_node(b, node);
+
+    if (bundle == NULL)
+        return;
+    if (only_bundle != NULL && strcmp(bundle->path, only_bundle) != 0)
+        return;
+
+    builder_add_ref(b, uri, bundle->path);
+}
+
+// adds refs for every plugin and preset in the world, optionally only those coming from a specific bundle
+static void builder_collect(cache_builder_t *b, LilvWorld *world, const char *only_bundle)
+{
+    LilvNode *rdf_type = lilv_new_uri(world, LILV_NS_RDF "type");
+    LilvNode *rdfs_see_also = lilv_new_uri(world, LILV_NS_RDFS "seeAlso");
+    LilvNode *applies_to = lilv_new_uri(world, LILV_NS_LV2 "appliesTo");
+    LilvNode *specification = lilv_new_uri(world, LILV_NS_LV2 "Specification");
+    LilvNode *preset = lilv_new_uri(world, LV2_PRESETS__Preset);
+
+    const LilvPlugins *plugins = lilv_world_get_all_plugins(world);
+    LILV_FOREACH(plugins, it, plugins)
+    {
+        const LilvPlugin *plugin = lilv_plugins_get(plugins, it);
+        const char *uri = lilv_node_as_uri(lilv_plugin_get_uri(plugin));
+
+        collect_ref(b, uri, lilv_plugin_get_bundle_uri(plugin), only_bundle);
+
+        const LilvNodes *data_uris = lilv_plugin_get_data_uris(plugin);
+        LILV_FOREACH(nodes, itd, data_uris)
+            collect_ref(b, uri, lilv_nodes_get(data_uris, itd), only_bundle);
+    }
+
+    // presets can live in other bundles, the plugin needs those to list them
+    LilvNodes *presets = lilv_world_find_nodes(world, NULL, rdf_type, preset);
+    LILV_FOREACH(nodes, it, presets)
+    {
+        const LilvNode *preset_node = lilv_nodes_get(presets, it);
+        if (!lilv_node_is_uri(preset_node))
+            continue;
+
+        LilvNodes *files = lilv_world_find_nodes(world, preset_node, rdfs_see_also, NULL);
+        LilvNodes *applies = lilv_world_find_nodes(world, preset_node, applies_to, NULL);
+
+        LILV_FOREACH(nodes, itf, files)
+        {
+            const LilvNode *file = lilv_nodes_get(files, itf);
+            collect_ref(b, lilv_node_as_uri(preset_node), file, only_bundle);
+
+            LILV_FOREACH(nodes, ita, applies)
+            {
+                const LilvNode *plugin_node = lilv_nodes_get(applies, ita);
+                if (lilv_node_is_uri(plugin_node))
+                    collect_ref(b, lilv_node_as_uri(plugin_node), file, only_bundle);
+            }
+        }
+
+        lilv_nodes_free(files);
+        lilv_nodes_free(applies);
+    }
+    lilv_nodes_free(presets);
+
+    // specification bundles are always loaded
+    LilvNodes *specs = lilv_world_find_nodes(world, NULL, rdf_type, specification);
+    LILV_FOREACH(nodes, it, specs)
+    {
+        LilvNodes *files = lilv_world_find_nodes(world, lilv_nodes_get(specs, it), rdfs_see_also, NULL);
+
+        LILV_FOREACH(nodes, itf, files)
+        {
+            builder_bundle_t *bundle = builder_bundle_for_node(b, lilv_nodes_get(files, itf));
+
+            if (bundle != NULL && (only_bundle == NULL || strcmp(bundle->path, only_bundle) == 0))
+                bundle->flags |= BUNDLE_SPECIFICATION;
+        }
+
+        lilv_nodes_free(files);
+    }
+    lilv_nodes_free(specs);
+
+    lilv_node_free(rdf_type);
+    lilv_node_free(rdfs_see_also);
+    lilv_node_free(applies_to);
+    lilv_node_free(specification);
+    lilv_node_free(preset);
+}
+
+static void cache_unmap(void)
+{
+    if (g_map != NULL)
+        munmap(g_map, g_map_size);
+
+    g_map = NULL;
+    g_map_size = 0;
+    g_header = NULL;
+    g_bundles = NULL;
+    g_resources = NULL;
+    g_refs = NULL;
+    g_strings = NULL;
+}
+
+static bool cache_map(void)
+{
+    struct stat st;
+    int fd;
+
+    cache_unmap();
+
+    fd = open(g_cache_file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(cache_header_t))
+    {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    const cache_header_t *header = map;
+    const uint64_t expected_size = sizeof(cache_header_t)
+                                 + (uint64_t)header->num_bundles * sizeof(cache_bundle_t)
+                                 + (uint64_t)header->num_resources * sizeof(cache_resource_t)
+                                 + (uint64_t)header->num_refs * sizeof(uint32_t)
+                                 + header->strings_size;
+
+    if (memcmp(header->magic, PLUGIN_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != PLUGIN_CACHE_VERSION ||
+        expected_size != (uint64_t)st.st_size)
+        goto invalid;
+
+    const cache_bundle_t *bundles = (const cache_bundle_t*)(header + 1);
+    const cache_resource_t *resources = (const cache_resource_t*)(bundles + header->num_bundles);
+    const uint32_t *refs = (const uint32_t*)(resources + header->num_resources);
+    const char *strings = (const char*)(refs + header->num_refs);
+
+    if (header->strings_size == 0 || strings[header->strings_size - 1] != '\0')
+        goto invalid;
+
+    for (uint32_t i = 0; i < header->num_bundles; i++)
+    {
+        if (bundles[i].path >= header->strings_size)
+            goto invalid;
+    }
+
+    for (uint32_t i = 0; i < header->num_resources; i++)
+    {
+        if (resources[i].uri >= header->strings_size ||
+            (uint64_t)resources[i].first_ref + resources[i].num_refs > header->num_refs)
+            goto invalid;
+    }
+
+    for (uint32_t i = 0; i < header->num_refs; i++)
+    {
+        if (refs[i] >= header->num_bundles)
+            goto invalid;
+    }
+
+    g_map = map;
+    g_map_size = st.st_size;
+    g_header = header;
+    g_bundles = bundles;
+    g_resources = resources;
+    g_refs = refs;
+    g_strings = strings;
+    return true;
+
+invalid:
+    fprintf(stderr, "plugin cache file %s is invalid, ignoring it\n", g_cache_file);
+    munmap(map, st.st_size);
+    return false;
+}
+
+static bool cache_matches(const cache_builder_t *scanned)
+{
+    if (g_header->num_bundles != scanned->num_bundles)
+        return false;
+
+    for (uint32_t i = 0; i < scanned->num_bundles; i++)
+    {
+        if (g_bundles[i].mtime != scanned->bundles[i].mtime ||
+            strcmp(g_strings + g_bundles[i].path, scanned->bundles[i].path) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+static int32_t cache_find_bundle(const char *path)
+{
+    uint32_t low = 0, high = g_header->num_bundles;
+
+    while (low < high)
+    {
+        const uint32_t mid = (low + high) / 2;
+        const int ret = strcmp(g_strings + g_bundles[mid].path, path);
+
+        if (ret == 0)
+            return mid;
+        if (ret < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return -1;
+}
+
+static const cache_resource_t *cache_find_resource(const char *uri)
+{
+    uint32_t low = 0, high = g_header->num_resources;
+
+    while (low < high)
+    {
+        const uint32_t mid = (low + high) / 2;
+        const int ret = strcmp(g_strings + g_resources[mid].uri, uri);
+
+        if (ret == 0)
+            return &g_resources[mid];
+        if (ret < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return NULL;
+}
+
+// bundles outside LV2_PATH are not part of the cache, they would not be found when validating it
+static bool cache_tracks_bundle(const char *bundlepath)
+{
+    if (cache_find_bundle(bundlepath) >= 0)
+        return true;
+
+    const size_t size = strlen(bundlepath);
+    for (uint32_t i = 0; i < g_num_lv2_dirs; i++)
+    {
+        const size_t dirsize = strlen(g_lv2_dirs[i]);
+
+        if (size > dirsize + 1 &&
+            strncmp(bundlepath, g_lv2_dirs[i], dirsize) == 0 &&
+            strchr(bundlepath + dirsize, '/') == bundlepath + size - 1)
+            return true;
+    }
+
+    return false;
+}
+
+static bool builder_load_map(cache_builder_t *b)
+{
+    for (uint32_t i = 0; i < g_header->num_bundles; i++)
+    {
+        if (!builder_add_bundle(b, g_strings + g_bundles[i].path, g_bundles[i].mtime, g_bundles[i].flags))
+            return false;
+    }
+
+    for (uint32_t i = 0; i < g_header->num_resources; i++)
+    {
+        const cache_resource_t *res = &g_resources[i];
+
+        for (uint32_t j = 0; j < res->num_refs; j++)
+        {
+            const uint32_t bundle = g_refs[res->first_ref + j];
+
+            if (!builder_add_ref(b, g_strings + res->uri, g_strings + g_bundles[bundle].path))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static void create_parent_dirs(const char *path)
+{
+    char *tmppath = strdup(path);
+
+    if (tmppath == NULL)
+        return;
+
+    for (char *sep = strchr(tmppath + 1, '/'); sep != NULL; sep = strchr(sep + 1, '/'))
+    {
+        *sep = '\0';
+        mkdir(tmppath, 0755);
+        *sep = '/';
+    }
+
+    free(tmppath);
+}
+
+// writes the whole cache to a temporary file and moves it in place, then maps the new file
+static bool builder_write(cache_builder_t *b)
+{
+    builder_sort_bundles(b);
+
+    if (b->num_refs != 0)
+        qsort(b->refs, b->num_refs, sizeof(builder_ref_t), compare_refs);
+
+    // drop duplicated refs and refs to unknown bundles
+    uint32_t num_refs = 0;
+    for (uint32_t i = 0; i < b->num_refs; i++)
+    {
+        builder_ref_t *ref = &b->refs[i];
+
+        if ((num_refs != 0 && compare_refs(ref, &b->refs[num_refs-1]) == 0) ||
+            builder_find_bundle(b, ref->bundle) < 0)
+        {
+            free(ref->uri);
+            free(ref->bundle);
+            continue;
+        }
+
+        b->refs[num_refs++] = *ref;
+    }
+    b->num_refs = num_refs;
+
+    uint64_t strings_size = 0;
+    uint32_t num_resources = 0;
+
+    for (uint32_t i = 0; i < b->num_bundles; i++)
+        strings_size += strlen(b->bundles[i].path) + 1;
+
+    for (uint32_t i = 0; i < b->num_refs; i++)
+    {
+        if (i == 0 || strcmp(b->refs[i].uri, b->refs[i-1].uri) != 0)
+        {
+            ++num_resources;
+            strings_size += strlen(b->refs[i].uri) + 1;
+        }
+    }
+
+    if (strings_size == 0)
+        strings_size = 1;
+    if (strings_size > UINT32_MAX)
+        return false;
+
+    const size_t size = sizeof(cache_header_t)
+                      + b->num_bundles * sizeof(cache_bundle_t)
+                      + num_resources * sizeof(cache_resource_t)
+                      + num_refs * sizeof(uint32_t)
+                      + strings_size;
+
+    char *data = calloc(1, size);
+    if (data == NULL)
+        return false;
+
+    cache_header_t *header = (cache_header_t*)data;
+    cache_bundle_t *bundles = (cache_bundle_t*)(header + 1);
+    cache_resource_t *resources = (cache_resource_t*)(bundles + b->num_bundles);
+    uint32_t *refs = (uint32_t*)(resources + num_resources);
+    char *strings = (char*)(refs + num_refs);
+    uint32_t strings_used = 0;
+
+    memcpy(header->magic, PLUGIN_CACHE_MAGIC, sizeof(header->magic));
+    header->version = PLUGIN_CACHE_VERSION;
+    header->num_bundles = b->num_bundles;
+    header->num_resources = num_resources;
+    header->num_refs = num_refs;
+    header->strings_size = strings_size;
+
+    for (uint32_t i = 0; i < b->num_bundles; i++)
+    {
+        const size_t len = strlen(b->bundles[i].path) + 1;
+
+        bundles[i].mtime = b->bundles[i].mtime;
+        bundles[i].flags = b->bundles[i].flags;
+        bundles[i].path = strings_used;
+        memcpy(strings + strings_used, b->bundles[i].path, len);
+        strings_used += len;
+    }
+
+    cache_resource_t *res = NULL;
+
+    for (uint32_t i = 0; i < b->num_refs; i++)
+    {
+        if (i == 0 || strcmp(b->refs[i].uri, b->refs[i-1].uri) != 0)
+        {
+            const size_t len = strlen(b->refs[i].uri) + 1;
+
+            res = res != NULL ? res + 1 : resources;
+            res->uri = strings_used;
+            res->first_ref = i;
+            memcpy(strings + strings_used, b->refs[i].uri, len);
+            strings_used += len;
+        }
+
+        refs[i] = builder_find_bundle(b, b->refs[i].bundle);
+        res->num_refs++;
+    }
+
+    char *tmpfile;
+    bool ok = false;
+
+    if (asprintf(&tmpfile, "%s.tmp", g_cache_file) < 0)
+    {
+        free(data);
+        return false;
+    }
+
+    create_parent_dirs(g_cache_file);
+
+    FILE *f = fopen(tmpfile, "wb");
+    if (f != NULL)
+    {
+        ok = fwrite(data, 1, size, f) == size;
+        ok = fclose(f) == 0 && ok;
+        ok = ok && rename(tmpfile, g_cache_file) == 0;
+
+        if (!ok)
+            unlink(tmpfile);
+    }
+
+    if (!ok)
+        fprintf(stderr, "failed to write plugin cache file %s\n", g_cache_file);
+
+    free(tmpfile);
+    free(data);
+
+    return ok && cache_map();
+}
+
+static void scan_lv2_path(void)
+{
+    const char *lv2path = getenv("LV2_PATH");
+    char *paths = strdup(lv2path != NULL ? lv2path : DEFAULT_LV2_PATH);
+
+    if (paths == NULL)
+        return;
+
+    char *saveptr = NULL;
+    for (char *dir = strtok_r(paths, ":", &saveptr); dir != NULL; dir = strtok_r(NULL, ":", &saveptr))
+    {
+        char *expanded = NULL;
+        char *resolved;
+
+        if (dir[0] == '~')
+        {
+            const char *home = getenv("HOME");
+            if (home == NULL || asprintf(&expanded, "%s%s", home, dir + 1) < 0)
+                continue;
+        }
+
+        resolved = resolve_dir(expanded != NULL ? expanded : dir);
+        free(expanded);
+
+        if (resolved == NULL)
+            continue;
+
+        bool duplicate = false;
+        for (uint32_t i = 0; i < g_num_lv2_dirs; i++)
+        {
+            if (strcmp(g_lv2_dirs[i], resolved) == 0)
+            {
+                duplicate = true;
+                break;
+            }
+        }
+
+        if (duplicate || !grow_array(&g_lv2_dirs, &g_lv2_dirs_size, g_num_lv2_dirs + 1, sizeof(char*)))
+        {
+            free(resolved);
+            continue;
+        }
+        g_lv2_dirs[g_num_lv2_dirs++] = resolved;
+
+        DIR *d = opendir(resolved);
+        if (d == NULL)
+            continue;
+
+        for (struct dirent *entry; (entry = readdir(d)) != NULL;)
+        {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            char bundlepath[PATH_MAX];
+            if (snprintf(bundlepath, sizeof(bundlepath), "%s%s", resolved, entry->d_name) >= (int)sizeof(bundlepath))
+                continue;
+
+            char *bundle = resolve_dir(bundlepath);
+            if (bundle == NULL)
+                continue;
+
+            const int64_t mtime = bundle_mtime(bundle);
+            if (mtime >= 0)
+                builder_add_bundle(&g_scanned, bundle, mtime, 0);
+
+            free(bundle);
+        }
+
+        closedir(d);
+    }
+
+    free(paths);
+    builder_sort_bundles(&g_scanned);
+}
+
+static char *get_cache_file(void)
+{
+    const char *env = getenv("MOD_LV2_CACHE_FILE");
+    char *path;
+
+    if (env != NULL)
+        return env[0] != '\0' ? strdup(env) : NULL;
+
+    const char *xdg_cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg_cache != NULL && xdg_cache[0] != '\0')
+    {
+        if (asprintf(&path, "%s/mod-host/lv2-cache.bin", xdg_cache) < 0)
+            return NULL;
+    }
+    else if (home != NULL && home[0] != '\0')
+    {
+        if (asprintf(&path, "%s/.cache/mod-host/lv2-cache.bin", home) < 0)
+            return NULL;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    return path;
+}
+
+static bool bundle_is_loaded(const char *bundlepath)
+{
+    for (uint32_t i = 0; i < g_num_loaded; i++)
+    {
+        if (strcmp(g_loaded[i], bundlepath) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void set_bundle_loaded(const char *bundlepath, bool loaded)
+{
+    for (uint32_t i = 0; i < g_num_loaded; i++)
+    {
+        if (strcmp(g_loaded[i], bundlepath) == 0)
+        {
+            if (!loaded)
+            {
+                free(g_loaded[i]);
+                g_loaded[i] = g_loaded[--g_num_loaded];
+            }
+            return;
+        }
+    }
+
+    if (!loaded || !grow_array(&g_loaded, &g_loaded_size, g_num_loaded + 1, sizeof(char*)))
+        return;
+
+    char *path = strdup(bundlepath);
+    if (path != NULL)
+        g_loaded[g_num_loaded++] = path;
+}
+
+static void load_bundle(LilvWorld *world, const char *bundlepath)
+{
+    LilvNode *bundlenode = lilv_new_file_uri(world, NULL, bundlepath);
+
+    lilv_world_load_bundle(world, bundlenode);
+    lilv_node_free(bundlenode);
+
+    set_bundle_loaded(bundlepath, true);
+}
+
+/*
+************************************************************************************************************************
+*           GLOBAL FUNCTIONS
+************************************************************************************************************************
+*/
+
+bool plugin_cache_load_world(LilvWorld *world)
+{
+    g_cache_file = get_cache_file();
+
+    if (g_cache_file == NULL)
+        return false;
+
+    scan_lv2_path();
+
+    if (!cache_map())
+        return false;
+
+    if (!cache_matches(&g_scanned))
+    {
+        cache_unmap();
+        return false;
+    }
+
+    builder_free(&g_scanned);
+
+    for (uint32_t i = 0; i < g_header->num_bundles; i++)
+    {
+        if (g_bundles[i].flags & BUNDLE_SPECIFICATION)
+            load_bundle(world, g_strings + g_bundles[i].path);
+    }
+
+#ifdef HAVE_LILV_LOAD_SPECIFICATIONS
+    lilv_world_load_specifications(world);
+    lilv_world_load_plugin_classes(world);
+#endif
+
+    g_lazy = true;
+    return true;
+}
+
+void plugin_cache_rebuild(LilvWorld *world)
+{
+    if (g_cache_file == NULL)
+        return;
+
+    builder_collect(&g_scanned, world, NULL);
+    builder_write(&g_scanned);
+    builder_free(&g_scanned);
+}
+
+void plugin_cache_finish(void)
+{
+    cache_unmap();
+    builder_free(&g_scanned);
+
+    for (uint32_t i = 0; i < g_num_lv2_dirs; i++)
+        free(g_lv2_dirs[i]);
+    for (uint32_t i = 0; i < g_num_loaded; i++)
+        free(g_loaded[i]);
+
+    free(g_lv2_dirs);
+    free(g_loaded);
+    free(g_cache_file);
+
+    g_lv2_dirs = NULL;
+    g_num_lv2_dirs = g_lv2_dirs_size = 0;
+    g_loaded = NULL;
+    g_num_loaded = g_loaded_size = 0;
+    g_cache_file = NULL;
+    g_lazy = false;
+}
+
+int plugin_cache_load_resource(LilvWorld *world, const char *uri)
+{
+    if (!g_lazy || g_header == NULL)
+        return 0;
+
+    const cache_resource_t *res = cache_find_resource(uri);
+    if (res == NULL)
+        return 0;
+
+    int loaded = 0;
+    for (uint32_t i = 0; i < res->num_refs; i++)
+    {
+        const char *bundlepath = g_strings + g_bundles[g_refs[res->first_ref + i]].path;
+
+        if (bundle_is_loaded(bundlepath))
+            continue;
+
+        load_bundle(world, bundlepath);
+        ++loaded;
+    }
+
+    return loaded;
+}
+
+void plugin_cache_bundle_added(LilvWorld *world, const char *bundlepath)
+{
+    if (g_lazy)
+        set_bundle_loaded(bundlepath, true);
+
+    if (g_header == NULL || !cache_tracks_bundle(bundlepath))
+        return;
+
+    const int64_t mtime = bundle_mtime(bundlepath);
+    if (mtime < 0)
+        return;
+
+    cache_builder_t b;
+    memset(&b, 0, sizeof(b));
+
+    if (builder_load_map(&b))
+    {
+        builder_remove_bundle(&b, bundlepath);
+
+        if (builder_add_bundle(&b, bundlepath, mtime, 0))
+        {
+            builder_sort_bundles(&b);
+            builder_collect(&b, world, bundlepath);
+            builder_write(&b);
+        }
+    }
+
+    builder_free(&b);
+}
+
+void plugin_cache_bundle_removed(const char *bundlepath)
+{
+    if (g_lazy)
+        set_bundle_loaded(bundlepath, false);
+
+    if (g_header == NULL || cache_find_bundle(bundlepath) < 0)
+        return;
+
+    cache_builder_t b;
+    memset(&b, 0, sizeof(b));
+
+    if (builder_load_map(&b))
+    {
+        builder_remove_bundle(&b, bundlepath);
+        builder_write(&b);
+    }
+
+    builder_free(&b);
+}
+
+#else // HAVE_NEW_LILV && !_WIN32
+
+bool plugin_cache_load_world(LilvWorld *world)
+{
+    return false;
+
+    UNUSED_PARAM(world);
+}
+
+void plugin_cache_rebuild(LilvWorld *world)
+{
+    UNUSED_PARAM(world);
+}
+
+void plugin_cache_finish(void)
+{
+}
+
+int plugin_cache_load_resource(LilvWorld *world, const char *uri)
+{
+    return 0;
+
+    UNUSED_PARAM(world);
+    UNUSED_PARAM(uri);
+}
+
+void plugin_cache_bundle_added(LilvWorld *world, const char *bundlepath)
+{
+    UNUSED_PARAM(world);
+    UNUSED_PARAM(bundlepath);
+}
+
+void plugin_cache_bundle_removed(const char *bundlepath)
+{
+    UNUSED_PARAM(bundlepath);
+}
+
+#endif // HAVE_NEW_LILV && !_WIN32
@@ -0,0 +1,67 @@
+/*
+ * This file is part of mod-host.
+ *
+ * mod-host is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * mod-host is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mod-host.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+************************************************************************************************************************
+*
+************************************************************************************************************************
+*/
+
+#ifndef PLUGIN_CACHE_H
+#define PLUGIN_CACHE_H
+
+/*
+************************************************************************************************************************
+*           INCLUDE FILES
+************************************************************************************************************************
+*/
+
+#include <stdbool.h>
+#include <lilv/lilv.h>
+
+/*
+************************************************************************************************************************
+*           FUNCTION PROTOTYPES
+************************************************************************************************************************
+*/
+
+// the cache maps plugin and preset URIs to the bundles describing them, so that only the bundles of
+// instantiated plugins need to be parsed; it is stored in MOD_LV2_CACHE_FILE (empty to disable) or
+// $XDG_CACHE_HOME/mod-host/lv2-cache.bin and validated against the path and mtime of every bundle in LV2_PATH.
+
+// returns true if the cache is up to date, in which case only the specification bundles are loaded into the world
+// and plugin_cache_load_resource must be used for the rest; otherwise the caller loads the whole world and
+// calls plugin_cache_rebuild afterwards.
+bool plugin_cache_load_world(LilvWorld *world);
+void plugin_cache_rebuild(LilvWorld *world);
+void plugin_cache_finish(void);
+
+// loads the bundles describing uri, returns how many bundles were loaded
+int plugin_cache_load_resource(LilvWorld *world, const char *uri);
+
+// bundle paths must be absolute and end with a separator, like the ones given to lilv
+void plugin_cache_bundle_added(LilvWorld *world, const char *bundlepath);
+void plugin_cache_bundle_removed(const char *bundlepath);
+
+/*
+************************************************************************************************************************
+*           END HEADER
+************************************************************************************************************************
+*/
+
+#endif
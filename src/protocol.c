@@ -22,8 +22,11 @@
 ************************************************************************************************************************
 */
 
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #ifndef SKIP_READLINE
 #include <unistd.h>
@@ -44,6 +47,12 @@
 #define FEW_ARGUMENTS       (-3)
 #define INVALID_ARGUMENT    (-4)
 
+// command lookup table, must be a power of 2 and well above PROTOCOL_MAX_COMMANDS
+#define COMMANDS_HASH_SIZE  256
+
+// messages starting with "#<id>" are answered with "resp <id> ..."
+#define REQUEST_ID_PREFIX   '#'
+
 
 /*
 ************************************************************************************************************************
@@ -65,13 +74,26 @@ const char *g_error_messages[] = {
 ************************************************************************************************************************
 */
 
+// the command format is parsed once on registration, only the name is kept
 typedef struct CMD_T {
     char* command;
-    char** list;
-    uint32_t count;
+    uint32_t count;             // tokens in the format, including the name and "..."
+    bool variable_arguments;    // format ends in "..."
+    enum ProtocolCommandMode mode;
     void (*callback)(proto_t *proto);
 } cmd_t;
 
+// a slow command waiting for the background executor, arguments are copied into the same allocation
+typedef struct PROTOCOL_JOB_T {
+    struct PROTOCOL_JOB_T *next;
+    int sender_id;
+    bool dropped;               // atomic, the sender went away while this job ran, its fd may belong to someone else now
+    uint32_t request_id;
+    int32_t index;
+    uint32_t list_count;
+    char **list;
+} protocol_job_t;
+
 
 /*
 ************************************************************************************************************************
@@ -89,6 +111,23 @@ typedef struct CMD_T {
 static int g_verbose = 0;
 static unsigned int g_command_count = 0;
 static cmd_t g_commands[PROTOCOL_MAX_COMMANDS];
+static uint8_t g_commands_hash[COMMANDS_HASH_SIZE]; // index + 1 into g_commands, 0 if unused
+
+// held while running anything but fast commands, recursive since load_cb parses commands itself
+static pthread_mutex_t g_exclusive_lock;
+
+// background executor, runs slow commands one at a time in the order they arrived
+static pthread_once_t g_executor_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t g_jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_jobs_cond = PTHREAD_COND_INITIALIZER;
+static protocol_job_t *g_jobs_head, *g_jobs_tail;
+static protocol_job_t *g_jobs_running;
+static pthread_t g_executor_thread;
+static bool g_executor_started, g_executor_stopping;
+
+// the command being run on this thread, inline or on the executor
+static __thread int g_current_sender = -1;
+static __thread protocol_job_t *g_current_job;
 
 
 /*
@@ -104,6 +143,10 @@ static cmd_t g_commands[PROTOCOL_MAX_COMMANDS];
 ************************************************************************************************************************
 */
 
+#if PROTOCOL_MAX_COMMANDS > COMMANDS_HASH_SIZE / 2
+#error "COMMANDS_HASH_SIZE is too small for PROTOCOL_MAX_COMMANDS"
+#endif
+
 
 /*
 ************************************************************************************************************************
@@ -111,10 +154,208 @@ static cmd_t g_commands[PROTOCOL_MAX_COMMANDS];
 ************************************************************************************************************************
 */
 
-static int is_wildcard(const char *str)
+static int32_t command_find(const char *name)
+{
+    uint32_t i, slot;
+
+    for (i = str_hash(name);; i++)
+    {
+        slot = g_commands_hash[i & (COMMANDS_HASH_SIZE - 1)];
+
+        if (slot == 0)
+            return NOT_FOUND;
+
+        if (strcmp(g_commands[slot - 1].command, name) == 0)
+            return slot - 1;
+    }
+}
+
+
+static void protocol_send(int sender_id, const char *response, size_t size)
+{
+#ifndef SKIP_READLINE
+    if (sender_id == STDOUT_FILENO)
+        write(sender_id, response, size);
+    else
+#endif
+        socket_send(sender_id, response, size);
+}
+
+// with a request id "resp <code> ..." becomes "resp <id> <code> ...", other replies get "resp <id>" in front
+static void protocol_reply(int sender_id, bool has_id, uint32_t request_id, const char *response)
+{
+    if (! has_id)
+    {
+        protocol_send(sender_id, response, strlen(response) + 1);
+        return;
+    }
+
+    const char *rest = strncmp(response, "resp ", 5) == 0 ? response + 5 : response;
+    const size_t size = strlen(rest) + 17;
+    char *buffer = MALLOC(size);
+
+    if (buffer == NULL)
+        return;
+
+    const int len = snprintf(buffer, size, "resp %u %s", request_id, rest);
+    protocol_send(sender_id, buffer, (size_t)len + 1);
+    FREE(buffer);
+}
+
+static void* protocol_executor_run(void *arg)
+{
+    protocol_job_t *job;
+    proto_t proto;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&g_jobs_lock);
+
+        while (g_jobs_head == NULL && ! g_executor_stopping)
+            pthread_cond_wait(&g_jobs_cond, &g_jobs_lock);
+
+        // protocol_finish cancels whatever is still queued
+        if (g_executor_stopping)
+        {
+            pthread_mutex_unlock(&g_jobs_lock);
+            break;
+        }
+
+        job = g_jobs_head;
+        g_jobs_head = job->next;
+        if (g_jobs_head == NULL)
+            g_jobs_tail = NULL;
+        g_jobs_running = job;
+
+        pthread_mutex_unlock(&g_jobs_lock);
+
+        proto.list = job->list;
+        proto.list_count = job->list_count;
+        proto.response = NULL;
+
+        g_current_job = job;
+        pthread_mutex_lock(&g_exclusive_lock);
+        g_commands[job->index].callback(&proto);
+        pthread_mutex_unlock(&g_exclusive_lock);
+        g_current_job = NULL;
+
+        // replied while locked, so the sender can't go away in between
+        pthread_mutex_lock(&g_jobs_lock);
+
+        if (proto.response && ! __atomic_load_n(&job->dropped, __ATOMIC_RELAXED))
+        {
+            protocol_reply(job->sender_id, true, job->request_id, proto.response);
+            if (g_verbose) printf("PROTOCOL: response #%u '%s'\n", job->request_id, proto.response);
+        }
+
+        g_jobs_running = NULL;
+        pthread_mutex_unlock(&g_jobs_lock);
+
+        FREE(proto.response);
+        free(job);
+    }
+
+    return NULL;
+    (void)arg;
+}
+
+static void protocol_executor_start(void)
 {
-    if (str && strchr(str, '%') != NULL) return 1;
-    return 0;
+    pthread_mutexattr_t atts;
+    pthread_mutexattr_init(&atts);
+    pthread_mutexattr_settype(&atts, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&g_exclusive_lock, &atts);
+    pthread_mutexattr_destroy(&atts);
+
+    pthread_mutex_lock(&g_jobs_lock);
+
+    // protocol_finish might have come first
+    if (! g_executor_stopping)
+    {
+        if (pthread_create(&g_executor_thread, NULL, protocol_executor_run, NULL) == 0)
+            g_executor_started = true;
+        else
+            fprintf(stderr, "can't start the protocol executor, slow commands will run inline\n");
+    }
+
+    pthread_mutex_unlock(&g_jobs_lock);
+}
+
+// must be called with g_jobs_lock held
+static void protocol_unqueue_jobs(bool all, int sender_id)
+{
+    protocol_job_t **link = &g_jobs_head;
+
+    g_jobs_tail = NULL;
+
+    while (*link != NULL)
+    {
+        protocol_job_t *const job = *link;
+
+        if (all || job->sender_id == sender_id)
+        {
+            *link = job->next;
+            free(job);
+            continue;
+        }
+
+        g_jobs_tail = job;
+        link = &job->next;
+    }
+}
+
+static bool protocol_queue_job(int sender_id, uint32_t request_id, int32_t index, char **list, uint32_t list_count)
+{
+    size_t size = sizeof(protocol_job_t) + sizeof(char*) * (list_count + 1);
+    uint32_t i;
+
+    for (i = 0; i < list_count; i++)
+        size += strlen(list[i]) + 1;
+
+    protocol_job_t *job = malloc(size);
+
+    if (job == NULL)
+        return false;
+
+    job->next = NULL;
+    job->sender_id = sender_id;
+    job->dropped = false;
+    job->request_id = request_id;
+    job->index = index;
+    job->list_count = list_count;
+    job->list = (char**)(job + 1);
+
+    char *data = (char*)(job->list + list_count + 1);
+
+    for (i = 0; i < list_count; i++)
+    {
+        const size_t len = strlen(list[i]) + 1;
+        memcpy(data, list[i], len);
+        job->list[i] = data;
+        data += len;
+    }
+    job->list[list_count] = NULL;
+
+    pthread_mutex_lock(&g_jobs_lock);
+
+    // nothing would ever run it
+    if (! g_executor_started || g_executor_stopping)
+    {
+        pthread_mutex_unlock(&g_jobs_lock);
+        free(job);
+        return false;
+    }
+
+    if (g_jobs_tail != NULL)
+        g_jobs_tail->next = job;
+    else
+        g_jobs_head = job;
+    g_jobs_tail = job;
+
+    pthread_cond_signal(&g_jobs_cond);
+    pthread_mutex_unlock(&g_jobs_lock);
+
+    return true;
 }
 
 
@@ -126,12 +367,30 @@ static int is_wildcard(const char *str)
 
 void protocol_parse(msg_t *msg)
 {
-    uint32_t i, j;
+    uint32_t i;
     int32_t index;
     proto_t proto;
+    char *list[PROTOCOL_MAX_ARGUMENTS];
+    char **split;
+    bool has_id = false;
+    uint32_t request_id = 0;
+
+    pthread_once(&g_executor_once, protocol_executor_start);
 
-    proto.list = strarr_split(msg->data);
-    proto.list_count = strarr_length(proto.list);
+    // split in place, only very long messages need the heap
+    proto.list_count = strarr_split_into(msg->data, list, PROTOCOL_MAX_ARGUMENTS);
+
+    if (proto.list_count < PROTOCOL_MAX_ARGUMENTS)
+    {
+        split = list;
+    }
+    else
+    {
+        split = strarr_split(msg->data);
+        proto.list_count = strarr_length(split);
+    }
+
+    proto.list = split;
     proto.response = NULL;
 
     if (g_verbose)
@@ -144,124 +403,140 @@ void protocol_parse(msg_t *msg)
 
     // TODO: check invalid argumets (wildcards)
 
-    if (proto.list_count == 0) return;
-
-    unsigned int match, variable_arguments = 0;
-
-    index = NOT_FOUND;
+    if (proto.list_count == 0) goto end;
 
-    // loop all registered commands
-    for (i = 0; i < g_command_count; i++)
+    // optional request id, not part of the command arguments
+    if (proto.list[0][0] == REQUEST_ID_PREFIX)
     {
-        match = 0;
+        char *id_end;
+        request_id = strtoul(proto.list[0] + 1, &id_end, 10);
+        has_id = true;
 
-        // checks received protocol
-        for (j = 0; j < proto.list_count && j < g_commands[i].count; j++)
-        {
-            if (strcmp(g_commands[i].list[j], proto.list[j]) == 0)
-            {
-                match++;
-            }
-            else if (match > 0)
-            {
-                if (is_wildcard(g_commands[i].list[j]))
-                {
-                    match++;
-                }
-                else if (strcmp(g_commands[i].list[j], "...") == 0)
-                {
-                    match++;
-                    variable_arguments = 1;
-                }
-            }
-        }
+        ++proto.list;
+        --proto.list_count;
 
-        if (match > 0)
+        if (id_end == proto.list[-1] + 1 || *id_end != '\0')
         {
-            // checks if the last argument is ...
-            if (j < g_commands[i].count)
-            {
-                if (strcmp(g_commands[i].list[j], "...") == 0) variable_arguments = 1;
-            }
+            has_id = false;
+            index = INVALID_ARGUMENT;
+            goto error;
+        }
 
-            // few arguments
-            if (proto.list_count < (g_commands[i].count - variable_arguments))
-            {
-                index = FEW_ARGUMENTS;
-            }
+        if (proto.list_count == 0) goto end;
+    }
 
-            // many arguments
-            else if (proto.list_count > g_commands[i].count && !variable_arguments)
-            {
-                index = MANY_ARGUMENTS;
-            }
+    index = command_find(proto.list[0]);
 
-            // arguments match
-            else if (match == proto.list_count || variable_arguments)
-            {
-                index = i;
-            }
+    if (index >= 0)
+    {
+        const cmd_t *const cmd = &g_commands[index];
 
-            // not found
-            else
-            {
-                index = NOT_FOUND;
-            }
+        // few arguments
+        if (proto.list_count < cmd->count - cmd->variable_arguments)
+            index = FEW_ARGUMENTS;
 
-            break;
-        }
+        // many arguments
+        else if (proto.list_count > cmd->count && !cmd->variable_arguments)
+            index = MANY_ARGUMENTS;
     }
 
     // Protocol OK
     if (index >= 0)
     {
-        if (g_commands[index].callback)
+        const cmd_t *const cmd = &g_commands[index];
+
+        if (cmd->callback)
         {
-            g_commands[index].callback(&proto);
+            // answered out of order once done, following commands keep running meanwhile
+            if (has_id && cmd->mode == PROTOCOL_CMD_SLOW &&
+                protocol_queue_job(msg->sender_id, request_id, index, proto.list, proto.list_count))
+                goto end;
+
+            // restored afterwards, load_cb parses commands from within a command
+            const int outer_sender = g_current_sender;
+            g_current_sender = msg->sender_id;
+
+            if (cmd->mode == PROTOCOL_CMD_FAST)
+            {
+                cmd->callback(&proto);
+            }
+            else
+            {
+                pthread_mutex_lock(&g_exclusive_lock);
+                cmd->callback(&proto);
+                pthread_mutex_unlock(&g_exclusive_lock);
+            }
+
+            g_current_sender = outer_sender;
+
             if (proto.response)
             {
-#ifndef SKIP_READLINE
-                if (msg->sender_id == STDOUT_FILENO)
-                    write(msg->sender_id, proto.response, proto.response_size+1);
-                else
-#endif
-                    socket_send(msg->sender_id, proto.response, proto.response_size+1);
+                protocol_reply(msg->sender_id, has_id, request_id, proto.response);
                 if (g_verbose) printf("PROTOCOL: response '%s'\n", proto.response);
 
                 FREE(proto.response);
             }
         }
+
+        goto end;
     }
+
+error:
     // Protocol error
-    else
-    {
-#ifndef SKIP_READLINE
-        if (msg->sender_id == STDOUT_FILENO)
-            write(msg->sender_id, g_error_messages[-index-1], strlen(g_error_messages[-index-1])+1);
-        else
-#endif
-            socket_send(msg->sender_id, g_error_messages[-index-1], strlen(g_error_messages[-index-1])+1);
-        if (g_verbose) printf("PROTOCOL: error '%s'\n", g_error_messages[-index-1]);
-    }
+    protocol_reply(msg->sender_id, has_id, request_id, g_error_messages[-index-1]);
+    if (g_verbose) printf("PROTOCOL: error '%s'\n", g_error_messages[-index-1]);
 
-    FREE(proto.list);
+end:
+    if (split != list)
+        FREE(split);
 }
 
 
 void protocol_add_command(const char *command, void (*callback)(proto_t *proto))
 {
-    if (g_command_count >= PROTOCOL_MAX_COMMANDS)
+    protocol_add_command_mode(command, callback, PROTOCOL_CMD_DEFAULT);
+}
+
+
+void protocol_add_command_mode(const char *command, void (*callback)(proto_t *proto), enum ProtocolCommandMode mode)
+{
+    char *cmd = str_duplicate(command);
+    char **list = strarr_split(cmd);
+    const uint32_t count = strarr_length(list);
+
+    // registering a command again replaces it (used by the self-test)
+    int32_t index = command_find(list[0]);
+
+    if (index >= 0)
     {
-        printf("error: PROTOCOL_MAX_COMMANDS reached (reconfigure it)\n");
-        return;
+        FREE(g_commands[index].command);
+    }
+    else
+    {
+        if (g_command_count >= PROTOCOL_MAX_COMMANDS)
+        {
+            printf("error: PROTOCOL_MAX_COMMANDS reached (reconfigure it)\n");
+            FREE(list);
+            FREE(cmd);
+            return;
+        }
+
+        index = g_command_count++;
+
+        uint32_t i = str_hash(cmd);
+        while (g_commands_hash[i & (COMMANDS_HASH_SIZE - 1)] != 0)
+            i++;
+        g_commands_hash[i & (COMMANDS_HASH_SIZE - 1)] = index + 1;
     }
 
-    char *cmd = str_duplicate(command);
-    g_commands[g_command_count].command = cmd;
-    g_commands[g_command_count].list = strarr_split(cmd);
-    g_commands[g_command_count].count = strarr_length(g_commands[g_command_count].list);
-    g_commands[g_command_count].callback = callback;
-    g_command_count++;
+    // splitting leaves only the command name in cmd
+    g_commands[index].command = cmd;
+    g_commands[index].count = count;
+    g_commands[index].variable_arguments = strcmp(list[count - 1], "...") == 0;
+    g_commands[index].mode = mode;
+    g_commands[index].callback = callback;
+
+    FREE(list);
 }
 
 
@@ -287,10 +562,10 @@ void protocol_remove_commands(void)
     unsigned int i;
 
     for (i = 0; i < g_command_count; i++)
-    {
         FREE(g_commands[i].command);
-        FREE(g_commands[i].list);
-    }
+
+    g_command_count = 0;
+    memset(g_commands_hash, 0, sizeof(g_commands_hash));
 }
 
 
@@ -298,3 +573,44 @@ void protocol_verbose(int verbose)
 {
     g_verbose = verbose;
 }
+
+
+int protocol_current_sender(void)
+{
+    // a background command of a client that went away, its fd may already be someone else's
+    if (g_current_job != NULL)
+        return __atomic_load_n(&g_current_job->dropped, __ATOMIC_RELAXED) ? -1 : g_current_job->sender_id;
+
+    return g_current_sender;
+}
+
+
+void protocol_drop_sender(int sender_id)
+{
+    pthread_mutex_lock(&g_jobs_lock);
+
+    protocol_unqueue_jobs(false, sender_id);
+
+    if (g_jobs_running != NULL && g_jobs_running->sender_id == sender_id)
+        __atomic_store_n(&g_jobs_running->dropped, true, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&g_jobs_lock);
+}
+
+
+void protocol_finish(void)
+{
+    pthread_mutex_lock(&g_jobs_lock);
+
+    const bool started = g_executor_started && ! g_executor_stopping;
+
+    // queued commands are cancelled, a running one is completed
+    g_executor_stopping = true;
+    protocol_unqueue_jobs(true, 0);
+    pthread_cond_signal(&g_jobs_cond);
+
+    pthread_mutex_unlock(&g_jobs_lock);
+
+    if (started)
+        pthread_join(g_executor_thread, NULL);
+}
@@ -48,7 +48,9 @@
 ************************************************************************************************************************
 */
 
-#define PROTOCOL_MAX_COMMANDS       80
+#define PROTOCOL_MAX_COMMANDS       96
+// messages with more tokens than this are split on the heap
+#define PROTOCOL_MAX_ARGUMENTS      64
 
 // error messages configuration
 #define MESSAGE_COMMAND_NOT_FOUND   "not found"
@@ -63,6 +65,13 @@
 ************************************************************************************************************************
 */
 
+// how a command is run, see protocol_add_command_mode
+enum ProtocolCommandMode {
+    PROTOCOL_CMD_DEFAULT,   // inline, waits for a running background command
+    PROTOCOL_CMD_FAST,      // inline, even while a background command runs
+    PROTOCOL_CMD_SLOW,      // in the background when sent with a request id, otherwise like default
+};
+
 // This struct is used on callbacks argument
 typedef struct PROTO_T {
     char **list;
@@ -94,10 +103,17 @@ typedef struct PROTO_T {
 
 void protocol_parse(msg_t *msg);
 void protocol_add_command(const char *command, void (*callback)(proto_t *proto));
+void protocol_add_command_mode(const char *command, void (*callback)(proto_t *proto), enum ProtocolCommandMode mode);
 void protocol_response(const char *response, proto_t *proto);
 void protocol_response_int(int resp, proto_t *proto);
 void protocol_remove_commands(void);
 void protocol_verbose(int verbose);
+// sender of the command running on the calling thread, -1 outside of commands
+int protocol_current_sender(void);
+// forgets the background commands of a client that disconnected, so nothing is sent to its reused fd
+void protocol_drop_sender(int sender_id);
+// cancels queued background commands and waits for the running one, no background command runs afterwards
+void protocol_finish(void);
 
 
 /*
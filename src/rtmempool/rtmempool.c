@@ -16,7 +16,6 @@
  * For a full copy of the GNU General Public License see the GPL.txt file
  */
 
-#include "list.h"
 #include "rtmempool.h"
 
 #include <assert.h>
@@ -26,55 +25,151 @@
 #include <string.h>
 
 // ------------------------------------------------------------------------------------------------
+// Free chunks are kept in a Treiber stack.
+// Chunks are referenced by index instead of pointer so that the stack head, index plus ABA tag,
+// fits in 64 bits and can be swapped with a single compare-and-swap on 32 and 64 bit targets.
+// Chunks are never released before the pool is destroyed, so reading a stale "next" is harmless.
 
-typedef struct list_head k_list_head;
+// max number of blocks the pool can grow to, each block holds the initial number of chunks
+#define RTMEMPOOL_MAX_BLOCKS 16
 
-// ------------------------------------------------------------------------------------------------
+// keep chunk data aligned as malloc would
+#define RTMEMPOOL_NODE_HEADER_SIZE 16
+
+// grow when less than 1/4 of the chunks are free
+#define RTMEMPOOL_LOW_WATER_DIVIDER 4
+
+#define RTMEMPOOL_INDEX_MASK 0xffffffffULL
+#define RTMEMPOOL_TAG_ONE    0x100000000ULL
+
+typedef struct _RtMemPool_Node
+{
+    uint32_t next;  // index + 1 of the next free chunk, 0 if last
+    uint32_t index; // own index
+} RtMemPool_Node;
 
 typedef struct _RtMemPool
 {
-    k_list_head used;
-    k_list_head unused;
-    pthread_mutex_t mutex;
+    uint64_t head; // ABA tag << 32 | index + 1 of the first free chunk, 0 if empty
+
+    size_t nodeSize;
+    uint32_t nodesPerBlock;
+    uint32_t blockCount;
+    char* blocks[RTMEMPOOL_MAX_BLOCKS];
+
+    uint32_t size;
+    uint32_t used;
+    uint32_t highWater;
+    uint32_t exhausted;
+
+    pthread_mutex_t growMutex;
 } RtMemPool;
 
 // ------------------------------------------------------------------------------------------------
 
+static inline RtMemPool_Node* rtmempool_node(RtMemPool* poolPtr, uint32_t index)
+{
+    char* const block = __atomic_load_n(&poolPtr->blocks[index / poolPtr->nodesPerBlock], __ATOMIC_ACQUIRE);
+    return (RtMemPool_Node*)(block + (size_t)(index % poolPtr->nodesPerBlock) * poolPtr->nodeSize);
+}
+
+static void rtmempool_push(RtMemPool* poolPtr, RtMemPool_Node* nodePtr)
+{
+    uint64_t oldHead = __atomic_load_n(&poolPtr->head, __ATOMIC_RELAXED);
+    uint64_t newHead;
+
+    do {
+        __atomic_store_n(&nodePtr->next, (uint32_t)(oldHead & RTMEMPOOL_INDEX_MASK), __ATOMIC_RELAXED);
+        newHead = ((oldHead & ~RTMEMPOOL_INDEX_MASK) + RTMEMPOOL_TAG_ONE) | (nodePtr->index + 1);
+    } while (! __atomic_compare_exchange_n(&poolPtr->head, &oldHead, newHead, true,
+                                           __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static RtMemPool_Node* rtmempool_pop(RtMemPool* poolPtr)
+{
+    uint64_t oldHead = __atomic_load_n(&poolPtr->head, __ATOMIC_ACQUIRE);
+    uint64_t newHead;
+    RtMemPool_Node* nodePtr;
+
+    do {
+        const uint32_t first = (uint32_t)(oldHead & RTMEMPOOL_INDEX_MASK);
+
+        if (first == 0)
+            return NULL;
+
+        nodePtr = rtmempool_node(poolPtr, first - 1);
+        newHead = ((oldHead & ~RTMEMPOOL_INDEX_MASK) + RTMEMPOOL_TAG_ONE)
+                | __atomic_load_n(&nodePtr->next, __ATOMIC_RELAXED);
+    } while (! __atomic_compare_exchange_n(&poolPtr->head, &oldHead, newHead, true,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return nodePtr;
+}
+
+// allocate a new block and make its chunks available, must hold growMutex or be the only user
+static bool rtmempool_add_block(RtMemPool* poolPtr)
+{
+    const uint32_t blockIndex = poolPtr->blockCount;
+
+    if (blockIndex == RTMEMPOOL_MAX_BLOCKS)
+        return false;
+
+    char* const block = calloc(poolPtr->nodesPerBlock, poolPtr->nodeSize);
+
+    if (block == NULL)
+        return false;
+
+    __atomic_store_n(&poolPtr->blocks[blockIndex], block, __ATOMIC_RELEASE);
+    poolPtr->blockCount = blockIndex + 1;
+
+    for (uint32_t i = 0; i < poolPtr->nodesPerBlock; ++i)
+    {
+        RtMemPool_Node* const nodePtr = (RtMemPool_Node*)(block + (size_t)i * poolPtr->nodeSize);
+        nodePtr->index = blockIndex * poolPtr->nodesPerBlock + i;
+        rtmempool_push(poolPtr, nodePtr);
+    }
+
+    __atomic_add_fetch(&poolPtr->size, poolPtr->nodesPerBlock, __ATOMIC_RELAXED);
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+
 bool rtsafe_memory_pool_create(RtMemPool_Handle* handlePtr,
                                size_t dataSize,
                                size_t maxPreallocated)
 {
-    k_list_head* nodePtr;
     RtMemPool* poolPtr;
 
-    poolPtr = malloc(sizeof(RtMemPool));
+    if (maxPreallocated == 0 || maxPreallocated > UINT32_MAX / RTMEMPOOL_MAX_BLOCKS)
+    {
+        return false;
+    }
+
+    poolPtr = calloc(1, sizeof(RtMemPool));
 
     if (poolPtr == NULL)
     {
         return false;
     }
 
-    INIT_LIST_HEAD(&poolPtr->used);
-    INIT_LIST_HEAD(&poolPtr->unused);
+    poolPtr->nodeSize = RTMEMPOOL_NODE_HEADER_SIZE
+                      + ((dataSize + RTMEMPOOL_NODE_HEADER_SIZE - 1) & ~(size_t)(RTMEMPOOL_NODE_HEADER_SIZE - 1));
+    poolPtr->nodesPerBlock = (uint32_t)maxPreallocated;
 
     pthread_mutexattr_t atts;
     pthread_mutexattr_init(&atts);
 #ifdef __MOD_DEVICES__
     pthread_mutexattr_setprotocol(&atts, PTHREAD_PRIO_INHERIT);
 #endif
-    pthread_mutex_init(&poolPtr->mutex, &atts);
+    pthread_mutex_init(&poolPtr->growMutex, &atts);
     pthread_mutexattr_destroy(&atts);
 
-    for (unsigned int unusedCount = 0; unusedCount < maxPreallocated; unusedCount++)
+    if (! rtmempool_add_block(poolPtr))
     {
-        nodePtr = malloc(sizeof(k_list_head) + dataSize);
-
-        if (nodePtr == NULL)
-        {
-            break;
-        }
-
-        list_add_tail(nodePtr, &poolPtr->unused);
+        pthread_mutex_destroy(&poolPtr->growMutex);
+        free(poolPtr);
+        return false;
     }
 
     *handlePtr = (RtMemPool_Handle)poolPtr;
@@ -88,64 +183,88 @@ void rtsafe_memory_pool_destroy(RtMemPool_Handle handle)
 {
     assert(handle);
 
-    k_list_head* nodePtr;
     RtMemPool* poolPtr = (RtMemPool*)handle;
 
-    while (! list_empty(&poolPtr->unused))
-    {
-        nodePtr = poolPtr->unused.next;
-        list_del(nodePtr);
-        free(nodePtr);
-    }
+    for (uint32_t i = 0; i < poolPtr->blockCount; ++i)
+        free(poolPtr->blocks[i]);
 
-    assert(list_empty(&poolPtr->unused));
-
-    pthread_mutex_destroy(&poolPtr->mutex);
+    pthread_mutex_destroy(&poolPtr->growMutex);
 
     free(poolPtr);
 }
 
 // ------------------------------------------------------------------------------------------------
-// find entry in unused list, fail if it is empty
+// pop from the free stack, fail if it is empty
 
 void* rtsafe_memory_pool_allocate_atomic(RtMemPool_Handle handle)
 {
     assert(handle);
 
-    k_list_head* nodePtr;
     RtMemPool* poolPtr = (RtMemPool*)handle;
+    RtMemPool_Node* const nodePtr = rtmempool_pop(poolPtr);
 
-    pthread_mutex_lock(&poolPtr->mutex);
-
-    if (list_empty(&poolPtr->unused))
+    if (nodePtr == NULL)
     {
-        pthread_mutex_unlock(&poolPtr->mutex);
+        __atomic_add_fetch(&poolPtr->exhausted, 1, __ATOMIC_RELAXED);
         return NULL;
     }
 
-    nodePtr = poolPtr->unused.next;
-    list_del(nodePtr);
+    const uint32_t used = __atomic_add_fetch(&poolPtr->used, 1, __ATOMIC_RELAXED);
+    uint32_t highWater = __atomic_load_n(&poolPtr->highWater, __ATOMIC_RELAXED);
 
-    list_add_tail(nodePtr, &poolPtr->used);
+    while (used > highWater &&
+           ! __atomic_compare_exchange_n(&poolPtr->highWater, &highWater, used, true,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
 
-    pthread_mutex_unlock(&poolPtr->mutex);
-
-    return (nodePtr + 1);
+    return (char*)nodePtr + RTMEMPOOL_NODE_HEADER_SIZE;
 }
 
 // ------------------------------------------------------------------------------------------------
-// move from used to unused list
+// push back into the free stack
 
 void rtsafe_memory_pool_deallocate(RtMemPool_Handle handle, void* memoryPtr)
+{
+    assert(handle);
+    assert(memoryPtr);
+
+    RtMemPool* poolPtr = (RtMemPool*)handle;
+
+    rtmempool_push(poolPtr, (RtMemPool_Node*)((char*)memoryPtr - RTMEMPOOL_NODE_HEADER_SIZE));
+    __atomic_sub_fetch(&poolPtr->used, 1, __ATOMIC_RELAXED);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+bool rtsafe_memory_pool_grow_if_needed(RtMemPool_Handle handle)
 {
     assert(handle);
 
     RtMemPool* poolPtr = (RtMemPool*)handle;
+    bool grown = false;
+
+    pthread_mutex_lock(&poolPtr->growMutex);
+
+    const uint32_t size = __atomic_load_n(&poolPtr->size, __ATOMIC_RELAXED);
+    const uint32_t used = __atomic_load_n(&poolPtr->used, __ATOMIC_RELAXED);
+
+    if (size - used < size / RTMEMPOOL_LOW_WATER_DIVIDER)
+        grown = rtmempool_add_block(poolPtr);
 
-    pthread_mutex_lock(&poolPtr->mutex);
+    pthread_mutex_unlock(&poolPtr->growMutex);
 
-    list_del((k_list_head*)memoryPtr - 1);
-    list_add_tail((k_list_head*)memoryPtr - 1, &poolPtr->unused);
+    return grown;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void rtsafe_memory_pool_get_stats(RtMemPool_Handle handle, RtMemPool_Stats* statsPtr)
+{
+    assert(handle);
+
+    RtMemPool* poolPtr = (RtMemPool*)handle;
 
-    pthread_mutex_unlock(&poolPtr->mutex);
+    statsPtr->size      = __atomic_load_n(&poolPtr->size, __ATOMIC_RELAXED);
+    statsPtr->used      = __atomic_load_n(&poolPtr->used, __ATOMIC_RELAXED);
+    statsPtr->highWater = __atomic_load_n(&poolPtr->highWater, __ATOMIC_RELAXED);
+    statsPtr->exhausted = __atomic_load_n(&poolPtr->exhausted, __ATOMIC_RELAXED);
 }
@@ -21,9 +21,11 @@
 
 #ifdef __cplusplus
 # include <cstddef>
+# include <cstdint>
 #else
 # include <stdbool.h>
 # include <stddef.h>
+# include <stdint.h>
 #endif
 
 /** max size of memory pool name, in chars, including terminating zero char */
@@ -34,6 +36,20 @@
  */
 typedef void* RtMemPool_Handle;
 
+/**
+ * Memory pool statistics.
+ */
+typedef struct {
+    /** chunks owned by the pool, grows with rtsafe_memory_pool_grow_if_needed */
+    uint32_t size;
+    /** chunks currently allocated */
+    uint32_t used;
+    /** highest number of chunks allocated at the same time */
+    uint32_t highWater;
+    /** number of allocations that failed because the pool was empty */
+    uint32_t exhausted;
+} RtMemPool_Stats;
+
 /**
  * Create new memory pool
  *
@@ -58,7 +74,7 @@ void rtsafe_memory_pool_destroy(RtMemPool_Handle handle);
 /**
  * Allocate memory in context where sleeping is not allowed
  *
- * <b>will not sleep</b>
+ * <b>will not sleep</b>, lock-free
  *
  * @return Pointer to allocated memory or NULL if memory no memory is available
  */
@@ -67,11 +83,30 @@ void* rtsafe_memory_pool_allocate_atomic(RtMemPool_Handle handle);
 /**
  * Deallocate previously allocated memory
  *
- * <b>will not sleep</b>
+ * <b>will not sleep</b>, lock-free
  *
  * @param memoryPtr pointer to previously allocated memory chunk
  */
 void rtsafe_memory_pool_deallocate(RtMemPool_Handle handle,
                                    void* memoryPtr);
 
+/**
+ * Add more chunks to the pool if it is running low
+ *
+ * <b>may/will sleep</b>
+ *
+ * @return true if the pool was grown
+ */
+bool rtsafe_memory_pool_grow_if_needed(RtMemPool_Handle handle);
+
+/**
+ * Get current pool statistics
+ *
+ * <b>will not sleep</b>
+ *
+ * @param statsPtr where to write the statistics
+ */
+void rtsafe_memory_pool_get_stats(RtMemPool_Handle handle,
+                                  RtMemPool_Stats* statsPtr);
+
 #endif // __RTMEMPOOL_H__
@@ -26,11 +26,18 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
 
 #ifdef _WIN32
 #include <winsock2.h>
+#define poll WSAPoll
 #else
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #define closesocket close
@@ -38,72 +45,919 @@
 typedef int SOCKET;
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #include "socket.h"
 #include "effects.h"
-#include "mod-memset.h"
 
 
-/*
-************************************************************************************************************************
-*           LOCAL DEFINES
-************************************************************************************************************************
-*/
+/*
+************************************************************************************************************************
+*           LOCAL DEFINES
+************************************************************************************************************************
+*/
+
+// batched feedback is written out once it reaches this size or age, whatever comes first
+#define FEEDBACK_BATCH_SIZE     (32 * 1024)
+#define FEEDBACK_BATCH_TIME_NS  (5 * 1000000ULL)
+
+// command and feedback connections served at the same time
+#define MAX_SOCKET_CLIENTS      32
+
+// tcp and unix-domain listeners, each for commands and feedback
+#define MAX_SOCKET_LISTENERS    4
+
+// a client that leaves this much output unread is considered stuck and gets disconnected
+#define SOCKET_CLIENT_QUEUE_MAX (4 * 1024 * 1024)
+
+// feedback message names a client can subscribe to
+#define MAX_FEEDBACK_SUBSCRIPTIONS  16
+#define FEEDBACK_SUBSCRIPTION_SIZE  32
+
+#define MAX_SOCKET_EVENTS       16
+
+// without epoll nothing wakes up the poll loop, so it checks for pending writes on its own
+#define SOCKET_POLL_TIMEOUT_MS  20
+
+// a single message bigger than this gets the client disconnected
+#define SOCKET_MSG_MAX_SIZE     (64 * 1024 * 1024)
+
+// event tags, clients are tagged with their slot index
+#define SOCKET_TAG_LISTENER     0x10000
+#define SOCKET_TAG_WAKEUP       0x20000
+
+
+/*
+************************************************************************************************************************
+*           LOCAL CONSTANTS
+************************************************************************************************************************
+*/
+
+
+/*
+************************************************************************************************************************
+*           LOCAL DATA TYPES
+************************************************************************************************************************
+*/
+
+typedef struct SOCKET_LISTENER_T {
+    SOCKET fd;
+    bool feedback;
+#ifndef _WIN32
+    char path[sizeof(((struct sockaddr_un*)NULL)->sun_path)];
+#endif
+} socket_listener_t;
+
+// incoming bytes not yet split into messages, positions are free-running and masked on access
+typedef struct SOCKET_RECV_RING_T {
+    char *data;
+    size_t size;            // power of two
+    size_t head;            // start of the message being received
+    size_t scan;            // there are no null bytes between head and scan
+    size_t tail;            // end of the received bytes
+    char *scratch;          // messages wrapping around the end are made contiguous here
+    size_t scratch_size;
+} socket_recv_ring_t;
+
+typedef struct SOCKET_CLIENT_T {
+    SOCKET fd;
+    bool feedback;
+
+    // socket thread only
+    socket_recv_ring_t recv;
+
+    // protected by g_clients_lock, bytes not yet accepted by the kernel
+    char *send_buffer;
+    size_t send_offset, send_used, send_size;
+    bool want_write;
+    bool closing;
+
+    // protected by g_clients_lock, feedback message names to deliver, all of them if empty
+    uint32_t subscriptions_count;
+    char subscriptions[MAX_FEEDBACK_SUBSCRIPTIONS][FEEDBACK_SUBSCRIPTION_SIZE];
+
+    // protected by g_clients_lock, feedback is sent as binary-feedback.h records instead of text
+    bool binary;
+
+    // protected by g_clients_lock, bitmap of the binary feedback symbol ids already defined on this connection
+    uint32_t *symbols_sent;
+    uint32_t symbols_sent_words;
+} socket_client_t;
+
+
+/*
+************************************************************************************************************************
+*           LOCAL MACROS
+************************************************************************************************************************
+*/
+
+#ifdef _WIN32
+#define SOCKET_WOULD_BLOCK()    (WSAGetLastError() == WSAEWOULDBLOCK)
+#define SOCKET_INTERRUPTED()    (WSAGetLastError() == WSAEINTR)
+#else
+#define SOCKET_WOULD_BLOCK()    (errno == EAGAIN || errno == EWOULDBLOCK)
+#define SOCKET_INTERRUPTED()    (errno == EINTR)
+#endif
+
+// a client that went away must not kill the host
+#ifdef MSG_NOSIGNAL
+#define SOCKET_SEND_FLAGS       MSG_NOSIGNAL
+#else
+#define SOCKET_SEND_FLAGS       0
+#endif
+
+
+/*
+************************************************************************************************************************
+*           LOCAL GLOBAL VARIABLES
+************************************************************************************************************************
+*/
+
+static volatile bool g_running;
+
+static socket_listener_t g_listeners[MAX_SOCKET_LISTENERS];
+static uint32_t g_listeners_count;
+
+static socket_client_t g_clients[MAX_SOCKET_CLIENTS];
+static pthread_mutex_t g_clients_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef __linux__
+// both live as long as the process, socket_finish can run from a signal handler
+static int g_pollfd = -1;
+static int g_wakefd = -1;
+#endif
+
+static int g_buffer_size;
+static void (*g_receive_cb)(msg_t *msg);
+static void (*g_close_cb)(int sender_id);
+
+// feedback batch, only used by the thread sending feedback
+static size_t g_feedback_batch_bytes;
+static uint32_t g_feedback_batch_messages;
+static uint64_t g_feedback_batch_start;
+static bool g_feedback_batching;
+
+// feedback write statistics, reset on read
+static volatile uint32_t g_feedback_flushes, g_feedback_messages, g_feedback_bytes;
+
+// feedback clients per format, changed under g_clients_lock and read without it
+static uint32_t g_feedback_text_clients, g_feedback_binary_clients; // atomic
+
+/*
+************************************************************************************************************************
+*           LOCAL FUNCTION PROTOTYPES
+************************************************************************************************************************
+*/
+
+
+/*
+************************************************************************************************************************
+*           LOCAL CONFIGURATION ERRORS
+************************************************************************************************************************
+*/
+
+
+/*
+************************************************************************************************************************
+*           LOCAL FUNCTIONS
+************************************************************************************************************************
+*/
+
+static uint64_t get_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int socket_set_nonblocking(SOCKET fd)
+{
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(fd, FIONBIO, &mode) == 0 ? 0 : -1;
+#else
+    const int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+        return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+static int socket_watch(SOCKET fd, uint32_t tag, bool write)
+{
+#ifdef __linux__
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | (write ? EPOLLOUT : 0);
+    event.data.u32 = tag;
+    return epoll_ctl(g_pollfd, EPOLL_CTL_ADD, fd, &event);
+#else
+    // the poll loop rebuilds its set on every iteration
+    return 0;
+    (void)fd;
+    (void)tag;
+    (void)write;
+#endif
+}
+
+static int socket_listener_add(SOCKET fd, bool feedback, const char *path)
+{
+    if (g_listeners_count == MAX_SOCKET_LISTENERS)
+        return -1;
+
+    socket_listener_t *listener = &g_listeners[g_listeners_count];
+
+    if (socket_set_nonblocking(fd) < 0 ||
+        socket_watch(fd, SOCKET_TAG_LISTENER | g_listeners_count, false) < 0)
+    {
+        perror("listener setup error");
+        return -1;
+    }
+
+    listener->fd = fd;
+    listener->feedback = feedback;
+#ifndef _WIN32
+    if (path != NULL)
+        snprintf(listener->path, sizeof(listener->path), "%s", path);
+    else
+        listener->path[0] = '\0';
+#else
+    (void)path;
+#endif
+
+    ++g_listeners_count;
+    return 0;
+}
+
+static socket_client_t* client_find_locked(SOCKET fd)
+{
+    for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
+    {
+        if (g_clients[i].fd == fd)
+            return &g_clients[i];
+    }
+
+    return NULL;
+}
+
+// the socket thread notices the hangup and closes the client
+static void client_drop_locked(socket_client_t *client)
+{
+    if (client->closing)
+        return;
+
+    client->closing = true;
+    shutdown(client->fd, SHUT_RDWR);
+}
+
+static void client_want_write_locked(socket_client_t *client, bool want_write)
+{
+    if (client->want_write == want_write)
+        return;
+
+    client->want_write = want_write;
+
+#ifdef __linux__
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    event.data.u32 = (uint32_t)(client - g_clients);
+    epoll_ctl(g_pollfd, EPOLL_CTL_MOD, client->fd, &event);
+#endif
+}
+
+// writes as much as the kernel takes right now, returns the number of bytes written or -1 on error
+static ssize_t client_send_some_locked(socket_client_t *client, const char *data, size_t size)
+{
+    size_t written = 0;
+
+    while (written < size)
+    {
+        const ssize_t ret = send(client->fd, data + written, size - written, SOCKET_SEND_FLAGS);
+
+        if (ret > 0)
+        {
+            written += (size_t)ret;
+        }
+        else if (ret < 0 && SOCKET_INTERRUPTED())
+        {
+            continue;
+        }
+        else if (ret < 0 && SOCKET_WOULD_BLOCK())
+        {
+            break;
+        }
+        else
+        {
+            client_drop_locked(client);
+            return -1;
+        }
+    }
+
+    return (ssize_t)written;
+}
+
+static bool client_queue_locked(socket_client_t *client, const char *data, size_t size)
+{
+    if (client->closing)
+        return false;
+
+    const size_t pending = client->send_used - client->send_offset;
+
+    if (pending + size > SOCKET_CLIENT_QUEUE_MAX)
+    {
+        fprintf(stderr, "socket client %d is not reading, disconnecting it\n", (int)client->fd);
+        client_drop_locked(client);
+        return false;
+    }
+
+    if (client->send_used + size > client->send_size)
+    {
+        // move what is left to the front before growing
+        if (client->send_offset != 0)
+        {
+            memmove(client->send_buffer, client->send_buffer + client->send_offset, pending);
+            client->send_offset = 0;
+            client->send_used = pending;
+        }
+
+        if (pending + size > client->send_size)
+        {
+            size_t new_size = client->send_size != 0 ? client->send_size : (size_t)g_buffer_size;
+            while (new_size < pending + size)
+                new_size *= 2;
+
+            char *new_buffer = realloc(client->send_buffer, new_size);
+            if (new_buffer == NULL)
+            {
+                client_drop_locked(client);
+                return false;
+            }
+
+            client->send_buffer = new_buffer;
+            client->send_size = new_size;
+        }
+    }
+
+    memcpy(client->send_buffer + client->send_used, data, size);
+    client->send_used += size;
+    return true;
+}
+
+static void client_flush_locked(socket_client_t *client)
+{
+    const size_t pending = client->send_used - client->send_offset;
+
+    if (pending == 0 || client->closing)
+        return;
+
+    const ssize_t written = client_send_some_locked(client, client->send_buffer + client->send_offset, pending);
+
+    if (written < 0)
+        return;
+
+    client->send_offset += (size_t)written;
+
+    if (client->send_offset == client->send_used)
+    {
+        client->send_offset = client->send_used = 0;
+        client_want_write_locked(client, false);
+    }
+    else
+    {
+        client_want_write_locked(client, true);
+    }
+}
+
+// sends right away if nothing is queued, whatever the kernel does not take waits for the socket to be writable
+static int client_write_locked(socket_client_t *client, const char *data, size_t size)
+{
+    if (client->closing)
+        return -1;
+
+    if (client->send_used == client->send_offset)
+    {
+        const ssize_t written = client_send_some_locked(client, data, size);
+
+        if (written < 0)
+            return -1;
+        if ((size_t)written == size)
+            return 0;
+
+        data += written;
+        size -= (size_t)written;
+    }
+
+    if (! client_queue_locked(client, data, size))
+        return -1;
+
+    client_want_write_locked(client, true);
+    return 0;
+}
+
+static bool client_subscribed_locked(const socket_client_t *client, const char *message)
+{
+    if (client->subscriptions_count == 0 || message == NULL)
+        return true;
+
+    const char *sep = strchr(message, ' ');
+    const size_t len = sep != NULL ? (size_t)(sep - message) : strlen(message);
+
+    for (uint32_t i = 0; i < client->subscriptions_count; i++)
+    {
+        if (strncmp(client->subscriptions[i], message, len) == 0 && client->subscriptions[i][len] == '\0')
+            return true;
+    }
+
+    return false;
+}
+
+static void client_count_format_locked(const socket_client_t *client, int32_t change)
+{
+    uint32_t *const count = client->binary ? &g_feedback_binary_clients : &g_feedback_text_clients;
+    __atomic_add_fetch(count, (uint32_t)change, __ATOMIC_RELAXED);
+}
+
+// "subscribe <name> ..." on a feedback connection, no names means everything
+static void client_subscribe(socket_client_t *client, const char *message)
+{
+    pthread_mutex_lock(&g_clients_lock);
+
+    client->subscriptions_count = 0;
+
+    for (const char *name = message + 9; *name != '\0';)
+    {
+        while (*name == ' ')
+            ++name;
+
+        const char *end = name;
+        while (*end != ' ' && *end != '\0')
+            ++end;
+
+        const size_t len = (size_t)(end - name);
+
+        if (len != 0 && len < FEEDBACK_SUBSCRIPTION_SIZE &&
+            client->subscriptions_count < MAX_FEEDBACK_SUBSCRIPTIONS)
+        {
+            memcpy(client->subscriptions[client->subscriptions_count], name, len);
+            client->subscriptions[client->subscriptions_count][len] = '\0';
+            ++client->subscriptions_count;
+        }
+
+        name = end;
+    }
+
+    pthread_mutex_unlock(&g_clients_lock);
+}
+
+// "binary_feedback <enable>" on a feedback connection, only changes the format of this connection
+static void client_set_binary(socket_client_t *client, bool binary)
+{
+    pthread_mutex_lock(&g_clients_lock);
+
+    if (client->binary == binary)
+    {
+        pthread_mutex_unlock(&g_clients_lock);
+        return;
+    }
+
+    // written in between two messages, the feedback thread only sends whole messages under the lock
+    if (binary)
+    {
+        static const char message[] = "binary_feedback 1";
+        client_write_locked(client, message, sizeof(message));
+    }
+    else
+    {
+        binary_feedback_record_t record;
+        memset(&record, 0, sizeof(record));
+        record.type = BINARY_FEEDBACK_END;
+        client_write_locked(client, (const char*)&record, sizeof(record));
+    }
+
+    // a new stream starts without any symbol ids
+    if (client->symbols_sent != NULL)
+        memset(client->symbols_sent, 0, sizeof(uint32_t) * client->symbols_sent_words);
+
+    client_count_format_locked(client, -1);
+    client->binary = binary;
+    client_count_format_locked(client, 1);
+
+    pthread_mutex_unlock(&g_clients_lock);
+}
+
+static void client_feedback_message(socket_client_t *client, const char *message)
+{
+    if (strncmp(message, "subscribe", 9) == 0 && (message[9] == ' ' || message[9] == '\0'))
+        client_subscribe(client, message);
+    else if (strncmp(message, "binary_feedback ", 16) == 0)
+        client_set_binary(client, atoi(message + 16) != 0);
+    else
+        fprintf(stderr, "unknown feedback client message '%s'\n", message);
+}
+
+static void client_close(socket_client_t *client)
+{
+    // before the fd can be reused, so nothing meant for this client reaches the next one
+    if (! client->feedback && g_close_cb)
+        g_close_cb(client->fd);
+
+    pthread_mutex_lock(&g_clients_lock);
+
+    if (client->feedback)
+        client_count_format_locked(client, -1);
+
+    // closing the fd also removes it from the epoll set
+    closesocket(client->fd);
+    client->fd = INVALID_SOCKET;
+    client->closing = false;
+    client->want_write = false;
+    client->binary = false;
+    client->subscriptions_count = 0;
+
+    free(client->symbols_sent);
+    client->symbols_sent = NULL;
+    client->symbols_sent_words = 0;
+
+    free(client->send_buffer);
+    client->send_buffer = NULL;
+    client->send_offset = client->send_used = client->send_size = 0;
+
+    pthread_mutex_unlock(&g_clients_lock);
+
+    free(client->recv.data);
+    free(client->recv.scratch);
+    memset(&client->recv, 0, sizeof(client->recv));
+}
+
+static void socket_accept(const socket_listener_t *listener)
+{
+    while (g_running)
+    {
+        const SOCKET fd = accept(listener->fd, NULL, NULL);
+
+        if (fd == INVALID_SOCKET)
+        {
+            if (SOCKET_INTERRUPTED())
+                continue;
+            if (! SOCKET_WOULD_BLOCK())
+                perror("accept error");
+            return;
+        }
+
+        size_t recv_size = 64;
+        while (recv_size < (size_t)g_buffer_size)
+            recv_size *= 2;
+
+        char *recv_buffer = malloc(recv_size);
+
+        if (recv_buffer == NULL || socket_set_nonblocking(fd) < 0)
+        {
+            perror("client setup error");
+            free(recv_buffer);
+            closesocket(fd);
+            continue;
+        }
+
+        pthread_mutex_lock(&g_clients_lock);
+
+        socket_client_t *client = client_find_locked(INVALID_SOCKET);
+
+        // registered while locked, so other threads never arm writes on an unwatched fd
+        if (client == NULL || socket_watch(fd, (uint32_t)(client - g_clients), false) < 0)
+        {
+            pthread_mutex_unlock(&g_clients_lock);
+            fprintf(stderr, "too many socket clients, refusing connection\n");
+            free(recv_buffer);
+            closesocket(fd);
+            continue;
+        }
+
+        client->fd = fd;
+        client->feedback = listener->feedback;
+        client->recv.data = recv_buffer;
+        client->recv.size = recv_size;
+
+        if (client->feedback)
+            client_count_format_locked(client, 1);
+
+        pthread_mutex_unlock(&g_clients_lock);
+    }
+}
+
+static bool recv_ring_grow(socket_recv_ring_t *ring)
+{
+    const size_t used = ring->tail - ring->head;
+
+    if (ring->size * 2 > SOCKET_MSG_MAX_SIZE)
+    {
+        fprintf(stderr, "socket message bigger than %d bytes, disconnecting client\n", SOCKET_MSG_MAX_SIZE);
+        return false;
+    }
+
+    char *data = malloc(ring->size * 2);
+    if (data == NULL)
+    {
+        perror("malloc error");
+        return false;
+    }
+
+    // the ring is full, so the partial message starts at head and wraps at most once
+    const size_t head = ring->head & (ring->size - 1);
+    const size_t first = ring->size - head < used ? ring->size - head : used;
+    memcpy(data, ring->data + head, first);
+    memcpy(data + first, ring->data, used - first);
+
+    free(ring->data);
+    ring->data = data;
+    ring->size *= 2;
+    ring->scan -= ring->head;
+    ring->head = 0;
+    ring->tail = used;
+    return true;
+}
+
+static void client_dispatch(socket_client_t *client, char *data, size_t size)
+{
+    if (client->feedback)
+    {
+        client_feedback_message(client, data);
+    }
+    else if (g_receive_cb)
+    {
+        msg_t msg;
+        msg.sender_id = client->fd;
+        msg.data = data;
+        msg.data_size = size;
+        g_receive_cb(&msg);
+    }
+}
+
+// hands out every complete message, each received byte is only looked at once
+static bool recv_ring_split(socket_client_t *client)
+{
+    socket_recv_ring_t *ring = &client->recv;
+    const size_t mask = ring->size - 1;
+
+    while (ring->scan != ring->tail)
+    {
+        const size_t scan = ring->scan & mask;
+        const size_t len = ring->size - scan < ring->tail - ring->scan ? ring->size - scan
+                                                                       : ring->tail - ring->scan;
+        const char *nul = memchr(ring->data + scan, '\0', len);
+
+        if (nul == NULL)
+        {
+            ring->scan += len;
+            continue;
+        }
+
+        const size_t size = ring->scan + (size_t)(nul - (ring->data + scan)) + 1 - ring->head;
+
+        // messages are separated by null bytes, skip empty ones
+        if (size > 1)
+        {
+            const size_t head = ring->head & mask;
+
+            if (head + size <= ring->size)
+            {
+                client_dispatch(client, ring->data + head, size);
+            }
+            else
+            {
+                if (ring->scratch_size < size)
+                {
+                    char *scratch = realloc(ring->scratch, size);
+                    if (scratch == NULL)
+                    {
+                        perror("realloc error");
+                        return false;
+                    }
+                    ring->scratch = scratch;
+                    ring->scratch_size = size;
+                }
+
+                const size_t first = ring->size - head;
+                memcpy(ring->scratch, ring->data + head, first);
+                memcpy(ring->scratch + first, ring->data, size - first);
+                client_dispatch(client, ring->scratch, size);
+            }
+        }
+
+        ring->head = ring->scan = ring->head + size;
+    }
+
+    // nothing pending, start over so the next recv gets the whole buffer
+    if (ring->head == ring->tail)
+        ring->head = ring->scan = ring->tail = 0;
+
+    return true;
+}
+
+// returns false once the client should be closed
+static bool client_receive(socket_client_t *client, int exit_on_failure)
+{
+    socket_recv_ring_t *ring = &client->recv;
+
+    for (;;)
+    {
+        // full without a complete message, the message is bigger than our buffer
+        if (ring->tail - ring->head == ring->size && ! recv_ring_grow(ring))
+            return false;
+
+        const size_t tail = ring->tail & (ring->size - 1);
+        const size_t space = ring->size - (ring->tail - ring->head);
+        const size_t len = ring->size - tail < space ? ring->size - tail : space;
+
+        const ssize_t count = recv(client->fd, ring->data + tail, len, 0);
+
+        if (count > 0) /* Data received */
+        {
+            ring->tail += (size_t)count;
+
+            if (! recv_ring_split(client))
+                return false;
+        }
+        else if (count == 0) /* Client disconnected */
+        {
+            return false;
+        }
+        else if (SOCKET_INTERRUPTED())
+        {
+            continue;
+        }
+        else if (SOCKET_WOULD_BLOCK())
+        {
+            break;
+        }
+        else /* Error */
+        {
+            if (exit_on_failure)
+            {
+                perror("read error");
+                exit(EXIT_FAILURE);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void socket_handle_event(uint32_t tag, bool readable, bool writable, bool *received, int exit_on_failure)
+{
+    if (tag & SOCKET_TAG_LISTENER)
+    {
+        socket_accept(&g_listeners[tag & ~SOCKET_TAG_LISTENER]);
+        return;
+    }
 
+    socket_client_t *client = &g_clients[tag];
 
-/*
-************************************************************************************************************************
-*           LOCAL CONSTANTS
-************************************************************************************************************************
-*/
+    if (client->fd == INVALID_SOCKET)
+        return;
 
+    if (writable)
+    {
+        pthread_mutex_lock(&g_clients_lock);
+        client_flush_locked(client);
+        pthread_mutex_unlock(&g_clients_lock);
+    }
 
-/*
-************************************************************************************************************************
-*           LOCAL DATA TYPES
-************************************************************************************************************************
-*/
+    if (readable)
+    {
+        *received = true;
 
+        if (! client_receive(client, exit_on_failure))
+        {
+            client_close(client);
+            return;
+        }
+    }
 
-/*
-************************************************************************************************************************
-*           LOCAL MACROS
-************************************************************************************************************************
-*/
+    if (client->closing)
+        client_close(client);
+}
 
+static void feedback_flush_clients(void)
+{
+    pthread_mutex_lock(&g_clients_lock);
 
-/*
-************************************************************************************************************************
-*           LOCAL GLOBAL VARIABLES
-************************************************************************************************************************
-*/
+    for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
+    {
+        if (g_clients[i].fd != INVALID_SOCKET && g_clients[i].feedback)
+            client_flush_locked(&g_clients[i]);
+    }
 
-static SOCKET g_serverfd = INVALID_SOCKET;
-static SOCKET g_fbserverfd = INVALID_SOCKET;
-static SOCKET g_clientfd = INVALID_SOCKET;
-static SOCKET g_fbclientfd = INVALID_SOCKET;
+    pthread_mutex_unlock(&g_clients_lock);
 
-static int g_buffer_size;
-static void (*g_receive_cb)(msg_t *msg);
+    if (g_feedback_batch_messages != 0)
+    {
+        g_feedback_flushes += 1;
+        g_feedback_messages += g_feedback_batch_messages;
+        g_feedback_bytes += (uint32_t)g_feedback_batch_bytes;
+    }
 
-/*
-************************************************************************************************************************
-*           LOCAL FUNCTION PROTOTYPES
-************************************************************************************************************************
-*/
+    g_feedback_batch_bytes = 0;
+    g_feedback_batch_messages = 0;
+    g_feedback_batch_start = get_time_ns();
+}
+
+static void client_feedback_locked(socket_client_t *client, const void *data, size_t size)
+{
+    // while batching nothing is written until the batch is flushed
+    if (g_feedback_batching)
+        client_queue_locked(client, (const char*)data, size);
+    else
+        client_write_locked(client, (const char*)data, size);
+}
 
+// sends the definition of a binary feedback symbol id, unless this connection already has it
+static bool client_define_symbol_locked(socket_client_t *client, uint32_t id, const char *symbol)
+{
+    const uint32_t word = id / 32;
+    const uint32_t bit = 1u << (id % 32);
 
-/*
-************************************************************************************************************************
-*           LOCAL CONFIGURATION ERRORS
-************************************************************************************************************************
-*/
+    if (word < client->symbols_sent_words && (client->symbols_sent[word] & bit) != 0)
+        return true;
 
+    if (word >= client->symbols_sent_words)
+    {
+        uint32_t words = client->symbols_sent_words != 0 ? client->symbols_sent_words : 8;
+        while (words <= word)
+            words *= 2;
+
+        uint32_t *symbols_sent = realloc(client->symbols_sent, sizeof(uint32_t) * words);
+        if (symbols_sent == NULL)
+            return false;
+
+        memset(symbols_sent + client->symbols_sent_words, 0,
+               sizeof(uint32_t) * (words - client->symbols_sent_words));
+        client->symbols_sent = symbols_sent;
+        client->symbols_sent_words = words;
+    }
 
-/*
-************************************************************************************************************************
-*           LOCAL FUNCTIONS
-************************************************************************************************************************
-*/
+    binary_feedback_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.type = BINARY_FEEDBACK_SYMBOL;
+    record.symbol = id;
+    record.size = (uint32_t)strlen(symbol);
+
+    client_feedback_locked(client, &record, sizeof(record));
+    client_feedback_locked(client, symbol, record.size);
+
+    client->symbols_sent[word] |= bit;
+    return true;
+}
+
+// accounts for a message sent to one or more clients, flushing the batch when due
+static int feedback_sent(size_t size)
+{
+    if (! g_feedback_batching)
+    {
+        g_feedback_flushes += 1;
+        g_feedback_messages += 1;
+        g_feedback_bytes += (uint32_t)size;
+        return (int)size;
+    }
+
+    g_feedback_batch_bytes += size;
+    ++g_feedback_batch_messages;
+
+    if (g_feedback_batch_bytes >= FEEDBACK_BATCH_SIZE ||
+        get_time_ns() - g_feedback_batch_start >= FEEDBACK_BATCH_TIME_NS)
+        feedback_flush_clients();
+
+    return (int)size;
+}
+
+// name is the text message to match against subscriptions
+static int feedback_send(const char *data, size_t size, const char *name)
+{
+    uint32_t recipients = 0;
+
+    pthread_mutex_lock(&g_clients_lock);
+
+    for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
+    {
+        socket_client_t *client = &g_clients[i];
+
+        if (client->fd == INVALID_SOCKET || ! client->feedback || client->binary || client->closing)
+            continue;
+        if (! client_subscribed_locked(client, name))
+            continue;
+
+        client_feedback_locked(client, data, size);
+        ++recipients;
+    }
+
+    pthread_mutex_unlock(&g_clients_lock);
+
+    return recipients != 0 ? feedback_sent(size) : -1;
+}
 
 
 /*
@@ -130,10 +984,25 @@ int socket_start(int socket_port, int feedback_port, int buffer_size)
     }
 #endif
 
-    g_clientfd = g_fbclientfd = INVALID_SOCKET;
-    g_serverfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
+        g_clients[i].fd = INVALID_SOCKET;
+    g_listeners_count = 0;
+
+#ifdef __linux__
+    g_pollfd = epoll_create1(EPOLL_CLOEXEC);
+    g_wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (g_pollfd < 0 || g_wakefd < 0 || socket_watch(g_wakefd, SOCKET_TAG_WAKEUP, false) < 0)
+    {
+        perror("epoll setup error");
+        return -1;
+    }
+#endif
+
+    SOCKET serverfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    SOCKET fbserverfd = INVALID_SOCKET;
 
-    if (g_serverfd == INVALID_SOCKET)
+    if (serverfd == INVALID_SOCKET)
     {
         perror("g_serverfd socket error");
         return -1;
@@ -141,36 +1010,32 @@ int socket_start(int socket_port, int feedback_port, int buffer_size)
 
     if (feedback_port != 0)
     {
-        g_fbserverfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        fbserverfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 
-        if (g_fbserverfd == INVALID_SOCKET)
+        if (fbserverfd == INVALID_SOCKET)
         {
             perror("g_fbserverfd socket error");
             return -1;
         }
     }
-    else
-    {
-        g_fbserverfd = INVALID_SOCKET;
-    }
 
 #ifndef _WIN32
     /* Allow the reuse of the socket address */
     int value = 1;
-    setsockopt(g_serverfd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
+    setsockopt(serverfd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
     if (feedback_port != 0)
-        setsockopt(g_fbserverfd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
+        setsockopt(fbserverfd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
 
     /* Increase socket size */
     value = 131071;
-    setsockopt(g_serverfd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+    setsockopt(serverfd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
     if (feedback_port != 0)
-        setsockopt(g_fbserverfd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+        setsockopt(fbserverfd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
 
     /* Set TCP_NODELAY */
-    setsockopt(g_serverfd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+    setsockopt(serverfd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
     if (feedback_port != 0)
-        setsockopt(g_fbserverfd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+        setsockopt(fbserverfd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
 #endif
 
     /* Startup the socket struct */
@@ -185,7 +1050,7 @@ int socket_start(int socket_port, int feedback_port, int buffer_size)
 
     /* Try assign the server address */
     serv_addr.sin_port = htons(socket_port);
-    if (bind(g_serverfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
+    if (bind(serverfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
     {
         perror("bind error");
         return -1;
@@ -195,7 +1060,7 @@ int socket_start(int socket_port, int feedback_port, int buffer_size)
     {
         /* Try assign the receiver address */
         serv_addr.sin_port = htons(feedback_port);
-        if (bind(g_fbserverfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
+        if (bind(fbserverfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
         {
             perror("bind error");
             return -1;
@@ -203,49 +1068,121 @@ int socket_start(int socket_port, int feedback_port, int buffer_size)
     }
 
     /* Start listen the sockets */
-    if (listen(g_serverfd, -1) < 0)
+    if (listen(serverfd, -1) < 0)
     {
         perror("listen error");
         return -1;
     }
 
-    if (feedback_port != 0 && listen(g_fbserverfd, -1) < 0)
+    if (feedback_port != 0 && listen(fbserverfd, -1) < 0)
     {
         perror("listen error");
         return -1;
     }
 
+    if (socket_listener_add(serverfd, false, NULL) < 0)
+        return -1;
+    if (feedback_port != 0 && socket_listener_add(fbserverfd, true, NULL) < 0)
+        return -1;
+
     g_receive_cb = NULL;
     g_buffer_size = buffer_size;
+    g_running = true;
+
+    return 0;
+}
+
+
+int socket_start_unix(const char *socket_path, const char *feedback_path)
+{
+#ifdef _WIN32
+    fprintf(stderr, "unix-domain sockets are not supported on this platform\n");
+    return -1;
+    (void)socket_path;
+    (void)feedback_path;
+#else
+    const char *paths[2] = { socket_path, feedback_path };
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (paths[i] == NULL)
+            continue;
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+
+        if (strlen(paths[i]) >= sizeof(addr.sun_path))
+        {
+            fprintf(stderr, "socket path '%s' is too long\n", paths[i]);
+            return -1;
+        }
+
+        strcpy(addr.sun_path, paths[i]);
+
+        const SOCKET fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd == INVALID_SOCKET)
+        {
+            perror("unix socket error");
+            return -1;
+        }
+
+        // remove a stale socket left by a previous run
+        unlink(paths[i]);
+
+        if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        {
+            perror("bind error");
+            closesocket(fd);
+            return -1;
+        }
+
+        if (listen(fd, -1) < 0 || socket_listener_add(fd, i == 1, paths[i]) < 0)
+        {
+            perror("listen error");
+            closesocket(fd);
+            unlink(paths[i]);
+            return -1;
+        }
+    }
 
     return 0;
+#endif
 }
 
 
 void socket_finish(void)
 {
-    if (g_serverfd == INVALID_SOCKET)
+    if (! g_running)
         return;
 
-    // make local copies so that we can invalidate these vars first
-    const SOCKET serverfd   = g_serverfd;
-    const SOCKET fbserverfd = g_fbserverfd;
-    g_serverfd = g_fbserverfd = INVALID_SOCKET;
+    g_running = false;
 
-    // shutdown clients, but don't close them
-    if (g_fbclientfd != INVALID_SOCKET)
-        shutdown(g_fbclientfd, SHUT_RDWR);
-    shutdown(g_clientfd, SHUT_RDWR);
+#ifdef __linux__
+    // wake up the event loop
+    const uint64_t value = 1;
+    if (write(g_wakefd, &value, sizeof(value)) < 0) {}
+#endif
 
-    // shutdown and close servers
-    if (fbserverfd != INVALID_SOCKET)
+    // shutdown clients, but don't close them, the socket thread does that
+    for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
     {
-        shutdown(fbserverfd, SHUT_RDWR);
-        closesocket(fbserverfd);
+        if (g_clients[i].fd != INVALID_SOCKET)
+            shutdown(g_clients[i].fd, SHUT_RDWR);
     }
 
-    shutdown(serverfd, SHUT_RDWR);
-    closesocket(serverfd);
+    // shutdown and close servers
+    for (uint32_t i = 0; i < g_listeners_count; i++)
+    {
+        shutdown(g_listeners[i].fd, SHUT_RDWR);
+        closesocket(g_listeners[i].fd);
+
+#ifndef _WIN32
+        if (g_listeners[i].path[0] != '\0')
+            unlink(g_listeners[i].path);
+#endif
+    }
 
 #ifdef _WIN32
     WSACleanup();
@@ -259,16 +1196,37 @@ void socket_set_receive_cb(void (*receive_cb)(msg_t *msg))
 }
 
 
+void socket_set_close_cb(void (*close_cb)(int sender_id))
+{
+    g_close_cb = close_cb;
+}
+
+
 int socket_send(int destination, const char *buffer, int size)
 {
     int ret = -1;
 
+    pthread_mutex_lock(&g_clients_lock);
+
+    socket_client_t *client = client_find_locked(destination);
+
+    if (client != NULL)
+    {
+        ret = client_write_locked(client, buffer, (size_t)size) == 0 ? size : -1;
+        pthread_mutex_unlock(&g_clients_lock);
+        return ret;
+    }
+
+    pthread_mutex_unlock(&g_clients_lock);
+
+    // not one of our clients, write it all out
     while (size > 0)
     {
-        ret = send(destination, buffer, size, 0);
+        ret = send(destination, buffer, size, SOCKET_SEND_FLAGS);
         if (ret < 0)
         {
             perror("send error");
+            break;
         }
         size -= ret;
         buffer += ret;
@@ -280,183 +1238,193 @@ int socket_send(int destination, const char *buffer, int size)
 
 int socket_send_feedback(const char *buffer)
 {
-    if (g_fbclientfd == INVALID_SOCKET) return -1;
-
-    return socket_send(g_fbclientfd, buffer, strlen(buffer)+1);
+    return feedback_send(buffer, strlen(buffer)+1, buffer);
 }
 
 
-void socket_run(int exit_on_failure)
+int socket_send_feedback_record(const binary_feedback_record_t *record, const void *payload,
+                                const char *name, const char *symbol)
 {
-    SOCKET clientfd, fbclientfd;
-    int count;
-    char *buffer;
-    char *msgbuffer;
-    msg_t msg;
+    uint32_t recipients = 0;
+
+    pthread_mutex_lock(&g_clients_lock);
 
-    /* Allocates memory to receive buffer */
-    buffer = malloc(g_buffer_size);
-    if (buffer == NULL)
+    for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
     {
-        if (! exit_on_failure)
-            return;
+        socket_client_t *client = &g_clients[i];
 
-        perror("malloc error");
-        exit(EXIT_FAILURE);
-    }
+        if (client->fd == INVALID_SOCKET || ! client->feedback || ! client->binary || client->closing)
+            continue;
+        if (! client_subscribed_locked(client, name))
+            continue;
 
-    /* Wait for client connection */
-    clientfd = accept(g_serverfd, NULL, NULL);
-    if (clientfd == INVALID_SOCKET)
-    {
-        free(buffer);
+        // clients connected later learn each symbol on its first use, like everyone else did
+        if (record->symbol != 0 && ! client_define_symbol_locked(client, record->symbol, symbol))
+            continue;
 
-        if (! exit_on_failure)
-            return;
+        client_feedback_locked(client, record, sizeof(*record));
+
+        if (record->size != 0)
+            client_feedback_locked(client, payload, record->size);
 
-        perror("accept error");
-        exit(EXIT_FAILURE);
+        ++recipients;
     }
 
-    if (g_fbserverfd != INVALID_SOCKET)
-    {
-        fbclientfd = accept(g_fbserverfd, NULL, NULL);
-        if (fbclientfd == INVALID_SOCKET)
-        {
-            free(buffer);
-            closesocket(clientfd);
+    pthread_mutex_unlock(&g_clients_lock);
 
-            if (! exit_on_failure)
-                return;
+    return recipients != 0 ? feedback_sent(sizeof(*record) + record->size) : -1;
+}
 
-            perror("accept error");
-            exit(EXIT_FAILURE);
-        }
-    }
-    else
+
+int socket_feedback_formats(void)
+{
+    int formats = 0;
+
+    if (__atomic_load_n(&g_feedback_text_clients, __ATOMIC_RELAXED) != 0)
+        formats |= SOCKET_FEEDBACK_TEXT;
+    if (__atomic_load_n(&g_feedback_binary_clients, __ATOMIC_RELAXED) != 0)
+        formats |= SOCKET_FEEDBACK_BINARY;
+
+    return formats;
+}
+
+
+void socket_feedback_symbols_reset(void)
+{
+    pthread_mutex_lock(&g_clients_lock);
+
+    for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
     {
-        fbclientfd = INVALID_SOCKET;
+        if (g_clients[i].symbols_sent != NULL)
+            memset(g_clients[i].symbols_sent, 0, sizeof(uint32_t) * g_clients[i].symbols_sent_words);
     }
 
-    g_clientfd = clientfd;
-    g_fbclientfd = fbclientfd;
+    pthread_mutex_unlock(&g_clients_lock);
+}
 
-    while (g_serverfd != INVALID_SOCKET)
-    {
-        mod_memset(buffer, 0, g_buffer_size);
-        count = recv(clientfd, buffer, g_buffer_size, 0);
 
-        if (count > 0) /* Data received */
-        {
-            if (count == g_buffer_size && buffer[count - 1] != '\0')
-            {
-                /* if message is bigger than our buffer, dynamically allocate more data until we receive it all */
-                int new_count, new_buffer_size;
+void socket_feedback_begin(void)
+{
+    g_feedback_batch_bytes = 0;
+    g_feedback_batch_messages = 0;
+    g_feedback_batch_start = get_time_ns();
+    g_feedback_batching = true;
+}
 
-                msgbuffer = NULL;
-                new_count = g_buffer_size;
-                new_buffer_size = g_buffer_size;
 
-                while (new_count == g_buffer_size)
-                {
-                    new_buffer_size += g_buffer_size;
+int socket_feedback_flush(void)
+{
+    const bool empty = g_feedback_batch_messages == 0;
 
-                    if (msgbuffer == NULL)
-                    {
-                        msgbuffer = malloc(new_buffer_size);
-                        memcpy(msgbuffer, buffer, g_buffer_size);
-                    }
-                    else
-                    {
-                        msgbuffer = realloc(msgbuffer, new_buffer_size);
-                    }
+    g_feedback_batching = false;
+    feedback_flush_clients();
+
+    return empty ? -1 : 0;
+}
 
-                    mod_memset(msgbuffer + count, 0, g_buffer_size);
-                    new_count = recv(clientfd, msgbuffer + count, g_buffer_size, 0);
 
-                    if (new_count > 0) /* Data received */
-                    {
-                        count += new_count;
+void socket_feedback_stats(uint32_t *flushes, uint32_t *messages, uint32_t *bytes)
+{
+    *flushes = g_feedback_flushes;
+    *messages = g_feedback_messages;
+    *bytes = g_feedback_bytes;
 
-                        if (msgbuffer[count - 1] == '\0')
-                            break;
-                    }
-                    else if (new_count < 0) /* Error */
-                    {
-                        if (! exit_on_failure)
-                            goto outside_loop;
+    g_feedback_flushes = g_feedback_messages = g_feedback_bytes = 0;
+}
 
-                        perror("read error");
-                        exit(EXIT_FAILURE);
-                    }
-                    else if (new_count == 0) /* Client disconnected */
-                    {
-                        goto outside_loop;
-                    }
-                }
-            }
-            else
-            {
-                msgbuffer = buffer;
-            }
 
-            if (g_receive_cb)
-            {
-                // ignore leftover null bytes
-                while (count > 1 && msgbuffer[count - 1] == '\0')
-                    --count;
+void socket_run(int exit_on_failure)
+{
+    bool received;
 
-                // make sure to keep 1 null byte at the end of the string
-                ++count;
+    while (g_running)
+    {
+        received = false;
 
-                msg.data = msgbuffer;
+#ifdef __linux__
+        struct epoll_event events[MAX_SOCKET_EVENTS];
+        const int count = epoll_wait(g_pollfd, events, MAX_SOCKET_EVENTS, -1);
 
-                while (count > 0)
-                {
-                    if (*msg.data == '\0')
-                    {
-                        --count;
-                        ++msg.data;
-                        continue;
-                    }
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (! exit_on_failure)
+                return;
 
-                    msg.sender_id = clientfd;
-                    msg.data_size = strlen(msg.data) + 1;
-                    g_receive_cb(&msg);
+            perror("epoll_wait error");
+            exit(EXIT_FAILURE);
+        }
 
-                    count -= msg.data_size;
-                    msg.data += msg.data_size;
-                }
-            }
+        for (int i = 0; i < count && g_running; i++)
+        {
+            if (events[i].data.u32 == SOCKET_TAG_WAKEUP)
+                continue;
 
-            if (msgbuffer != buffer)
-                free(msgbuffer);
+            socket_handle_event(events[i].data.u32,
+                                events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR),
+                                events[i].events & EPOLLOUT,
+                                &received, exit_on_failure);
+        }
+#else
+        struct pollfd fds[MAX_SOCKET_LISTENERS + MAX_SOCKET_CLIENTS];
+        uint32_t tags[MAX_SOCKET_LISTENERS + MAX_SOCKET_CLIENTS];
+        int nfds = 0;
 
-            effects_idle_external_uis();
+        for (uint32_t i = 0; i < g_listeners_count; i++, nfds++)
+        {
+            fds[nfds].fd = g_listeners[i].fd;
+            fds[nfds].events = POLLIN;
+            fds[nfds].revents = 0;
+            tags[nfds] = SOCKET_TAG_LISTENER | i;
+        }
+
+        pthread_mutex_lock(&g_clients_lock);
+        for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
+        {
+            if (g_clients[i].fd == INVALID_SOCKET)
+                continue;
+
+            fds[nfds].fd = g_clients[i].fd;
+            fds[nfds].events = POLLIN | (g_clients[i].want_write ? POLLOUT : 0);
+            fds[nfds].revents = 0;
+            tags[nfds++] = (uint32_t)i;
         }
-        else if (count < 0) /* Error */
+        pthread_mutex_unlock(&g_clients_lock);
+
+        const int count = poll(fds, nfds, SOCKET_POLL_TIMEOUT_MS);
+
+        if (count < 0)
         {
+            if (SOCKET_INTERRUPTED())
+                continue;
             if (! exit_on_failure)
-                break;
+                return;
 
-            perror("read error");
+            perror("poll error");
             exit(EXIT_FAILURE);
         }
-        else /* Client disconnected */
+
+        for (int i = 0; i < nfds && g_running; i++)
         {
-            break;
+            if (fds[i].revents == 0)
+                continue;
+
+            socket_handle_event(tags[i],
+                                fds[i].revents & (POLLIN | POLLHUP | POLLERR),
+                                fds[i].revents & POLLOUT,
+                                &received, exit_on_failure);
         }
+#endif
+
+        if (received)
+            effects_idle_external_uis();
     }
 
-outside_loop:
-    if (fbclientfd != INVALID_SOCKET)
+    // finished, drop everyone still connected
+    for (int i = 0; i < MAX_SOCKET_CLIENTS; i++)
     {
-        g_fbclientfd = INVALID_SOCKET;
-        closesocket(fbclientfd);
+        if (g_clients[i].fd != INVALID_SOCKET)
+            client_close(&g_clients[i]);
     }
-
-    g_clientfd = INVALID_SOCKET;
-    closesocket(clientfd);
-
-    free(buffer);
 }
@@ -32,6 +32,7 @@
 */
 
 #include "utils.h"       // just for get the msg_t struct
+#include "binary-feedback.h"
 
 
 /*
@@ -40,6 +41,10 @@
 ************************************************************************************************************************
 */
 
+// feedback formats asked for by the connected feedback clients
+#define SOCKET_FEEDBACK_TEXT    0x1
+#define SOCKET_FEEDBACK_BINARY  0x2
+
 
 /*
 ************************************************************************************************************************
@@ -76,10 +81,25 @@
 */
 
 int socket_start(int socket_port, int feedback_port, int buffer_size);
+int socket_start_unix(const char *socket_path, const char *feedback_path);
 void socket_finish(void);
 void socket_set_receive_cb(void (*receive_cb)(msg_t *msg));
+// called on the socket thread when a command client disconnects, before its fd is closed
+void socket_set_close_cb(void (*close_cb)(int sender_id));
 int socket_send(int destination, const char *buffer, int size);
+// sent to the text feedback clients
 int socket_send_feedback(const char *buffer);
+// sent to the binary feedback clients, record followed by record->size bytes of payload
+// name is the text message name matched against subscriptions, symbol is the string of record->symbol
+int socket_send_feedback_record(const binary_feedback_record_t *record, const void *payload,
+                                const char *name, const char *symbol);
+// SOCKET_FEEDBACK_* bits of the formats currently in use
+int socket_feedback_formats(void);
+// symbol ids are about to be reused, forget which ones each client has seen
+void socket_feedback_symbols_reset(void);
+void socket_feedback_begin(void);
+int socket_feedback_flush(void);
+void socket_feedback_stats(uint32_t *flushes, uint32_t *messages, uint32_t *bytes);
 void socket_run(int exit_on_failure);
 
 
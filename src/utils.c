@@ -108,23 +108,13 @@ static void trim_spaces(char *str)
     }
 }
 
-/*
-************************************************************************************************************************
-*           GLOBAL FUNCTIONS
-************************************************************************************************************************
-*/
-
-char** strarr_split(char *str)
+static uint32_t strarr_count(const char *str)
 {
     uint32_t count;
-    char *pstr, **list = NULL;
+    const char *pstr;
     const char token = ' ';
     uint8_t quote;
 
-    if (!str) return list;
-
-    trim_spaces(str);
-
     // count the tokens
     pstr = str;
     quote = 0;
@@ -159,9 +149,15 @@ char** strarr_split(char *str)
         pstr++;
     }
 
-    // allocates memory to list
-    list = MALLOC((count + 1) * sizeof(char *));
-    if (list == NULL) return NULL;
+    return count;
+}
+
+static void strarr_fill(char *str, char **list)
+{
+    uint32_t count;
+    char *pstr;
+    const char token = ' ';
+    uint8_t quote;
 
     // fill the list pointers
     pstr = str;
@@ -210,11 +206,48 @@ char** strarr_split(char *str)
     count = 0;
     while (list[count]) parse_quote(list[count++]);
 #endif
+}
+
+/*
+************************************************************************************************************************
+*           GLOBAL FUNCTIONS
+************************************************************************************************************************
+*/
+
+char** strarr_split(char *str)
+{
+    char **list;
+
+    if (!str) return NULL;
+
+    trim_spaces(str);
+
+    // allocates memory to list
+    list = MALLOC((strarr_count(str) + 1) * sizeof(char *));
+    if (list == NULL) return NULL;
 
+    strarr_fill(str, list);
     return list;
 }
 
 
+uint32_t strarr_split_into(char *str, char **list, uint32_t list_size)
+{
+    uint32_t count;
+
+    if (!str) return 0;
+
+    trim_spaces(str);
+
+    // the list must have room for the NULL terminator too, otherwise str is left untouched
+    count = strarr_count(str);
+    if (count >= list_size) return count;
+
+    strarr_fill(str, list);
+    return count;
+}
+
+
 uint32_t strarr_length(char** const str_array)
 {
     uint32_t count = 0;
@@ -96,6 +96,9 @@ typedef struct MSG_T {
 
 // splits the string in each whitespace occurrence and returns an array of strings NULL terminated
 char** strarr_split(char *str);
+// same as strarr_split but fills a caller provided list, returns the number of strings
+// if that is not less than list_size nothing is split, and the caller should use strarr_split instead
+uint32_t strarr_split_into(char *str, char **list, uint32_t list_size);
 // returns the string array length
 uint32_t strarr_length(char **str_array);
 // joins a string array in a single string
@@ -116,6 +119,18 @@ bool doubles_differ_enough(double a, double b)
     return fabs(a - b) >= DBL_EPSILON;
 }
 
+// FNV-1a hash of a string, shared by all string keyed hash tables
+static inline
+uint32_t str_hash(const char *str)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*str != '\0')
+        hash = (hash ^ (uint8_t)*str++) * 16777619u;
+
+    return hash;
+}
+
 // clamp a value to be within a certain range
 static inline
 int clamp(int value, int min, int max)
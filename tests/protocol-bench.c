@@ -0,0 +1,280 @@
+/*
+ * Protocol parser benchmark, compares the old linear command scan with the current hash dispatch.
+ *
+ * Build and run with: make protocol-bench-run
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/mod-host.h"
+#include "../src/utils.c"
+#include "../src/protocol.c"
+
+// messages as sent by a pedalboard load, repeated over and over
+#define ITERATIONS 200000
+
+static const char* const g_messages[] = {
+    "add http://lv2plug.in/plugins/eg-amp 1",
+    "param_set 1 gain -3.500000",
+    "bypass 1 0",
+    "connect system:capture_1 effect_1:in",
+    "connect effect_1:out system:playback_1",
+    "preset_load 1 http://lv2plug.in/plugins/eg-amp#preset1",
+    "patch_set 1 http://lv2plug.in/plugins/eg-sampler#sample \"/tmp/sample.wav\"",
+    "monitor_output 1 meter",
+    "midi_map 1 gain 0 7 -90.000000 24.000000",
+    "param_set 1 gain 1.250000",
+    "multi_param_set gain 0.500000 1 2 3 4 5 6 7 8",
+    "param_get 1 gain",
+    "activate 1 1",
+    "output_data_ready",
+    // errors
+    "param_set 1 gain",
+    "bypass 1 0 1",
+    "unknown 1",
+};
+
+#define MESSAGES_COUNT (sizeof(g_messages) / sizeof(g_messages[0]))
+
+static const char* const g_formats[] = {
+    EFFECT_ADD,
+    EFFECT_REMOVE,
+    EFFECT_ACTIVATE,
+    EFFECT_PRELOAD,
+    EFFECT_PRESET_LOAD,
+    EFFECT_PRESET_SAVE,
+    EFFECT_PRESET_SHOW,
+    EFFECT_CONNECT,
+    EFFECT_CONNECT_MATCHING,
+    EFFECT_CONNECT_SAFE,
+    EFFECT_DISCONNECT,
+    EFFECT_DISCONNECT_ALL,
+    EFFECT_DISCONNECT_SAFE,
+    EFFECT_BYPASS,
+    EFFECT_BYPASS_POLICY,
+    EFFECT_SILENCE_SLEEP,
+    EFFECT_SLEEP_STATS,
+    EFFECT_PARAM_SET,
+    EFFECT_PARAM_GET,
+    EFFECT_PARAM_MON,
+    EFFECT_PARAMS_FLUSH,
+    EFFECT_PRE_RUN,
+    EFFECT_PATCH_GET,
+    EFFECT_PATCH_SET,
+    EFFECT_LICENSEE,
+    EFFECT_SET_BPM,
+    EFFECT_SET_BPB,
+    MONITOR_ADDR_SET,
+    MONITOR_OUTPUT,
+    MONITOR_OUTPUT_OFF,
+    MONITOR_AUDIO_LEVELS,
+    MONITOR_MIDI_CONTROL,
+    MONITOR_MIDI_PROGRAM,
+    MIDI_LEARN,
+    MIDI_MAP,
+    MIDI_UNMAP,
+    CC_MAP,
+    CC_VALUE_SET,
+    CC_UNMAP,
+    CV_MAP,
+    CV_UNMAP,
+    HMI_MAP,
+    HMI_UNMAP,
+    CPU_LOAD,
+    MAX_CPU_LOAD,
+    PLUGIN_LOAD,
+    RT_QUEUE_STATS,
+    FEEDBACK_STATS,
+    GRAPH_PARALLELISM,
+    ZERO_COPY_BYTES,
+    LOAD_COMMANDS,
+    SAVE_COMMANDS,
+    BUNDLE_ADD,
+    BUNDLE_REMOVE,
+    FEATURE_ENABLE,
+    STATE_LOAD,
+    STATE_SAVE,
+    STATE_TMPDIR,
+    TRANSPORT,
+    TRANSPORT_SYNC,
+    SHOW_EXTERNAL_UI,
+    OUTPUT_DATA_READY,
+    MULTI_ADD,
+    MULTI_REMOVE,
+    MULTI_ACTIVATE,
+    MULTI_PRELOAD,
+    MULTI_BYPASS,
+    MULTI_PARAM_SET,
+    MULTI_PARAMS_FLUSH,
+    MULTI_PRE_RUN,
+    WAIT_AUDIO_CYCLE,
+    HELP,
+    QUIT,
+};
+
+#define FORMATS_COUNT (sizeof(g_formats) / sizeof(g_formats[0]))
+
+static uint32_t g_dispatched;
+
+static void dummy_cb(proto_t *proto)
+{
+    g_dispatched++;
+    (void)proto;
+}
+
+int socket_send(int destination, const char *buffer, int size)
+{
+    return size;
+    (void)destination;
+    (void)buffer;
+}
+
+// the previous protocol_parse, linear scan of every registered command format
+
+typedef struct LEGACY_CMD_T {
+    char* command;
+    char** list;
+    uint32_t count;
+    void (*callback)(proto_t *proto);
+} legacy_cmd_t;
+
+static legacy_cmd_t g_legacy_commands[PROTOCOL_MAX_COMMANDS];
+static uint32_t g_legacy_command_count;
+
+static void legacy_add_command(const char *command, void (*callback)(proto_t *proto))
+{
+    legacy_cmd_t *const cmd = &g_legacy_commands[g_legacy_command_count++];
+    cmd->command = str_duplicate(command);
+    cmd->list = strarr_split(cmd->command);
+    cmd->count = strarr_length(cmd->list);
+    cmd->callback = callback;
+}
+
+static void legacy_parse(msg_t *msg)
+{
+    uint32_t i, j;
+    int32_t index;
+    proto_t proto;
+
+    proto.list = strarr_split(msg->data);
+    proto.list_count = strarr_length(proto.list);
+    proto.response = NULL;
+
+    if (proto.list_count == 0) return;
+
+    unsigned int match, variable_arguments = 0;
+
+    index = NOT_FOUND;
+
+    for (i = 0; i < g_legacy_command_count; i++)
+    {
+        match = 0;
+
+        for (j = 0; j < proto.list_count && j < g_legacy_commands[i].count; j++)
+        {
+            if (strcmp(g_legacy_commands[i].list[j], proto.list[j]) == 0)
+            {
+                match++;
+            }
+            else if (match > 0)
+            {
+                if (strchr(g_legacy_commands[i].list[j], '%') != NULL)
+                {
+                    match++;
+                }
+                else if (strcmp(g_legacy_commands[i].list[j], "...") == 0)
+                {
+                    match++;
+                    variable_arguments = 1;
+                }
+            }
+        }
+
+        if (match > 0)
+        {
+            if (j < g_legacy_commands[i].count)
+            {
+                if (strcmp(g_legacy_commands[i].list[j], "...") == 0) variable_arguments = 1;
+            }
+
+            if (proto.list_count < (g_legacy_commands[i].count - variable_arguments))
+                index = FEW_ARGUMENTS;
+            else if (proto.list_count > g_legacy_commands[i].count && !variable_arguments)
+                index = MANY_ARGUMENTS;
+            else if (match == proto.list_count || variable_arguments)
+                index = i;
+            else
+                index = NOT_FOUND;
+
+            break;
+        }
+    }
+
+    if (index >= 0)
+        g_legacy_commands[index].callback(&proto);
+
+    FREE(proto.list);
+}
+
+static double run(void (*parse)(msg_t *msg))
+{
+    char buffer[MESSAGES_COUNT][256];
+    struct timespec start, end;
+    msg_t msg = { 0, NULL, 0 };
+
+    g_dispatched = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        for (uint32_t m = 0; m < MESSAGES_COUNT; m++)
+        {
+            // parsing is done in place, so start from a fresh copy each time
+            strcpy(buffer[m], g_messages[m]);
+            msg.data = buffer[m];
+            msg.data_size = strlen(buffer[m]);
+            parse(&msg);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    const double secs = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)ITERATIONS * MESSAGES_COUNT / secs;
+}
+
+int main(void)
+{
+    for (uint32_t i = 0; i < FORMATS_COUNT; i++)
+    {
+        legacy_add_command(g_formats[i], dummy_cb);
+        protocol_add_command(g_formats[i], dummy_cb);
+    }
+
+    const double legacy = run(legacy_parse);
+    const uint32_t legacy_dispatched = g_dispatched;
+
+    const double current = run(protocol_parse);
+    const uint32_t current_dispatched = g_dispatched;
+
+    printf("linear scan:   %12.0f commands/sec\n", legacy);
+    printf("hash dispatch: %12.0f commands/sec (%.2fx)\n", current, current / legacy);
+
+    if (legacy_dispatched != current_dispatched)
+    {
+        fprintf(stderr, "dispatch mismatch: %u vs %u\n", legacy_dispatched, current_dispatched);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < g_legacy_command_count; i++)
+    {
+        FREE(g_legacy_commands[i].command);
+        FREE(g_legacy_commands[i].list);
+    }
+
+    protocol_remove_commands();
+    return 0;
+}
@@ -12,9 +12,11 @@
 #define rtsafe_memory_pool_deallocate(X,arg) free(arg)
 #define rtsafe_memory_pool_allocate_atomic(X) malloc(sizeof(postponed_event_list_data))
 #define rtsafe_memory_pool_destroy(X)
-#define rtsafe_memory_pool_create(A,B,C,D,E) (1)
+#define rtsafe_memory_pool_create(A,B,C) (1)
+#define rtsafe_memory_pool_grow_if_needed(X) (false)
+#define rtsafe_memory_pool_get_stats(X,stats) memset(stats, 0, sizeof(RtMemPool_Stats))
 #define RtMemPool_Handle void*
-#define RtMemPool void*
+typedef struct { uint32_t size, used, highWater, exhausted; } RtMemPool_Stats;
 #endif
 
 #include <stdbool.h>
@@ -25,9 +27,19 @@
 
 #include <signal.h>
 #include <pthread.h>
+#include <time.h>
 
 #define MAX_POSTPONED_EVENTS    1024
 
+// stress test, small pool so that it runs out and needs to grow
+#define STRESS_POOL_SIZE        16
+#define STRESS_THREADS          4
+#define STRESS_BATCH            8
+#define STRESS_ITERATIONS       500000
+
+// how long to run the postponed events simulation for, unless interrupted
+#define SIMULATION_SECONDS      2
+
 // used for local stack variables
 #define MAX_CHAR_BUF_SIZE       255
 
@@ -79,6 +91,22 @@ static pthread_t     g_postevents_thread;
 
 int socket_send_feedback(const char *buffer);
 
+static void PrintPoolStats(const char* step, RtMemPool_Handle pool)
+{
+    RtMemPool_Stats stats;
+    rtsafe_memory_pool_get_stats(pool, &stats);
+
+    printf("%s size %u used %u highWater %u exhausted %u\n",
+           step, stats.size, stats.used, stats.highWater, stats.exhausted);
+}
+
+static double GetTimeSecs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
 #ifdef ENABLE_POSTPONED_CACHE
 static bool ShouldIgnorePostPonedEvent(postponed_event_list_data* ev, postponed_cached_events* cached_events)
 {
@@ -135,15 +163,13 @@ void RunPostPonedEvents(int ignored_effect_id)
     list_splice_init(&g_rtsafe_list, &queue);
     pthread_mutex_unlock(&g_rtsafe_mutex);
 
-    RtMemPool* poolPtr = g_rtsafe_mem_pool;
+    // grow pool if running low, as done in mod-host
+    rtsafe_memory_pool_grow_if_needed(g_rtsafe_mem_pool);
 
     if (ignored_effect_id >= 0)
     {
         printf("flushing events 001\n");
-#ifdef RTMEMPOOL_REAL_TEST
-        printf("STEP0 usedCount %i\n", poolPtr->usedCount);
-        printf("STEP0 unusedCount %i\n", poolPtr->unusedCount);
-#endif
+        PrintPoolStats("STEP0", g_rtsafe_mem_pool);
     }
 
     if (list_empty(&queue))
@@ -275,10 +301,7 @@ void RunPostPonedEvents(int ignored_effect_id)
     if (ignored_effect_id >= 0)
     {
         printf("flushing events END!\n");
-#ifdef RTMEMPOOL_REAL_TEST
-        printf("STEP0 usedCount %i\n", poolPtr->usedCount);
-        printf("STEP0 unusedCount %i\n", poolPtr->unusedCount);
-#endif
+        PrintPoolStats("STEP0", g_rtsafe_mem_pool);
     }
 
     if (g_postevents_ready)
@@ -457,6 +480,133 @@ int effects_remove(int effect_id)
 
 // ----------------------------------------------------------------------------------------------------------
 
+typedef struct {
+    uint32_t id;
+    uint64_t operations;
+    uint64_t failures;
+    bool error;
+    pthread_t _thread;
+} STRESS_THREAD;
+
+static RtMemPool_Handle g_stress_pool;
+static volatile bool g_stress_running;
+
+static void* StressThreadLoop(void* arg)
+{
+    STRESS_THREAD* const thread = (STRESS_THREAD*)arg;
+    uint32_t* chunks[STRESS_BATCH];
+
+    for (int i = 0; i < STRESS_ITERATIONS; i++)
+    {
+        int count = 0;
+
+        for (int j = 0; j < STRESS_BATCH; j++)
+        {
+            uint32_t* const chunk = rtsafe_memory_pool_allocate_atomic(g_stress_pool);
+
+            if (chunk == NULL)
+            {
+                thread->failures++;
+                continue;
+            }
+
+            // a chunk must never be handed out twice
+            if (__atomic_exchange_n(chunk, thread->id, __ATOMIC_RELAXED) != 0)
+                thread->error = true;
+
+            chunks[count++] = chunk;
+        }
+
+        for (int j = 0; j < count; j++)
+        {
+            if (__atomic_exchange_n(chunks[j], 0, __ATOMIC_RELAXED) != thread->id)
+                thread->error = true;
+
+            rtsafe_memory_pool_deallocate(g_stress_pool, chunks[j]);
+        }
+
+        thread->operations += (uint64_t)count * 2;
+    }
+
+    return NULL;
+}
+
+static void* StressGrowLoop(void* arg)
+{
+    while (g_stress_running)
+    {
+        rtsafe_memory_pool_grow_if_needed(g_stress_pool);
+        usleep(100);
+    }
+
+    return NULL;
+
+    UNUSED_PARAM(arg);
+}
+
+static int StressTest(void)
+{
+    STRESS_THREAD threads[STRESS_THREADS];
+    pthread_t grow_thread;
+    uint64_t operations = 0, failures = 0;
+    bool error = false;
+
+    if (!rtsafe_memory_pool_create(&g_stress_pool, sizeof(uint32_t), STRESS_POOL_SIZE))
+    {
+        fprintf(stderr, "can't allocate stress test memory pool\n");
+        return 1;
+    }
+
+    g_stress_running = true;
+    pthread_create(&grow_thread, NULL, StressGrowLoop, NULL);
+
+    const double start = GetTimeSecs();
+
+    for (int i = 0; i < STRESS_THREADS; ++i)
+    {
+        memset(&threads[i], 0, sizeof(STRESS_THREAD));
+        threads[i].id = (uint32_t)i + 1;
+        pthread_create(&threads[i]._thread, NULL, StressThreadLoop, &threads[i]);
+    }
+
+    for (int i = 0; i < STRESS_THREADS; ++i)
+    {
+        pthread_join(threads[i]._thread, NULL);
+        operations += threads[i].operations;
+        failures += threads[i].failures;
+        error |= threads[i].error;
+    }
+
+    const double elapsed = GetTimeSecs() - start;
+
+    g_stress_running = false;
+    pthread_join(grow_thread, NULL);
+
+    RtMemPool_Stats stats;
+    rtsafe_memory_pool_get_stats(g_stress_pool, &stats);
+
+    printf("STRESS %i threads, %.2f Mops/s, %llu failed allocations\n",
+           STRESS_THREADS, (double)operations / elapsed * 1e-6, (unsigned long long)failures);
+    PrintPoolStats("STRESS", g_stress_pool);
+
+#ifdef RTMEMPOOL_REAL_TEST
+    if (stats.used != 0 || stats.highWater > stats.size || stats.exhausted != failures)
+        error = true;
+#endif
+
+    rtsafe_memory_pool_destroy(g_stress_pool);
+
+    if (error)
+    {
+        fprintf(stderr, "STRESS failed\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+
 volatile bool running;
 
 static void term_signal(int sig)
@@ -469,19 +619,21 @@ static void term_signal(int sig)
 
 int main(void)
 {
+    // -- STRESS --------------------------------------------------------------------------------------------
+
+    if (StressTest() != 0)
+        return 1;
+
     // -- INIT ----------------------------------------------------------------------------------------------
 
     INIT_LIST_HEAD(&g_rtsafe_list);
 
-    if (!rtsafe_memory_pool_create(&g_rtsafe_mem_pool, "mod-host", sizeof(postponed_event_list_data),
-                                   MAX_POSTPONED_EVENTS))
+    if (!rtsafe_memory_pool_create(&g_rtsafe_mem_pool, sizeof(postponed_event_list_data), MAX_POSTPONED_EVENTS))
     {
         fprintf(stderr, "can't allocate realtime-safe memory pool\n");
         return 1;
     }
 
-    RtMemPool* poolPtr = g_rtsafe_mem_pool;
-
     pthread_mutexattr_t atts;
     pthread_mutexattr_init(&atts);
 #ifdef __ARM_ARCH_7A__
@@ -496,10 +648,7 @@ int main(void)
     g_postevents_ready = true;
     pthread_create(&g_postevents_thread, NULL, PostPonedEventsThread, NULL);
 
-#ifdef RTMEMPOOL_REAL_TEST
-    printf("STEP1 usedCount %i\n", poolPtr->usedCount);
-    printf("STEP1 unusedCount %i\n", poolPtr->unusedCount);
-#endif
+    PrintPoolStats("STEP1", g_rtsafe_mem_pool);
 
     // -- IDLE ----------------------------------------------------------------------------------------------
 
@@ -516,14 +665,13 @@ int main(void)
 
     for (int i=0; i<5; ++i)
     {
-#ifdef RTMEMPOOL_REAL_TEST
-        printf("STEP2 p%i usedCount %i\n", i+1, poolPtr->usedCount);
-        printf("STEP2 p%i unusedCount %i\n", i+1, poolPtr->unusedCount);
-#endif
+        PrintPoolStats("STEP2", g_rtsafe_mem_pool);
         effects_add(i);
     }
 
-    while (running)
+    const double end = GetTimeSecs() + SIMULATION_SECONDS;
+
+    while (running && GetTimeSecs() < end)
     {
         usleep(1000*5);
         g_postevents_ready = true;
@@ -531,10 +679,7 @@ int main(void)
 
     for (int i=0; i<5; ++i)
     {
-#ifdef RTMEMPOOL_REAL_TEST
-        printf("STEP3 p%i usedCount %i\n", i+1, poolPtr->usedCount);
-        printf("STEP3 p%i unusedCount %i\n", i+1, poolPtr->unusedCount);
-#endif
+        PrintPoolStats("STEP3", g_rtsafe_mem_pool);
         effects_remove(i);
     }
 
@@ -544,10 +689,7 @@ int main(void)
     sem_post(&g_postevents_semaphore);
     pthread_join(g_postevents_thread, NULL);
 
-#ifdef RTMEMPOOL_REAL_TEST
-    printf("STEP4 usedCount %i\n", poolPtr->usedCount);
-    printf("STEP4 unusedCount %i\n", poolPtr->unusedCount);
-#endif
+    PrintPoolStats("STEP4", g_rtsafe_mem_pool);
 
     struct list_head *it, *it2;
     postponed_event_list_data* eventptr;
@@ -559,10 +701,7 @@ int main(void)
         rtsafe_memory_pool_deallocate(g_rtsafe_mem_pool, eventptr);
     }
 
-#ifdef RTMEMPOOL_REAL_TEST
-    printf("STEP5 usedCount %i\n", poolPtr->usedCount);
-    printf("STEP5 unusedCount %i\n", poolPtr->unusedCount);
-#endif
+    PrintPoolStats("STEP5", g_rtsafe_mem_pool);
 
     rtsafe_memory_pool_destroy(g_rtsafe_mem_pool);
     sem_destroy(&g_postevents_semaphore);